@@ -0,0 +1,48 @@
+#include <algorithm>
+
+#include "arena.h"
+
+namespace bpftrace {
+namespace ast {
+
+namespace {
+thread_local Arena *current_arena = nullptr;
+} // namespace
+
+void *Arena::allocate(size_t size)
+{
+  const size_t align = alignof(std::max_align_t);
+  size = (size + align - 1) & ~(align - 1);
+  if (used_ + size > CHUNK_SIZE)
+  {
+    // Oversized allocations get a chunk of their own, before the one in use
+    if (size > CHUNK_SIZE / 4 && !chunks_.empty())
+    {
+      chunks_.emplace(chunks_.end() - 1, new char[size]);
+      return chunks_[chunks_.size() - 2].get();
+    }
+    chunks_.emplace_back(new char[std::max(size, CHUNK_SIZE)]);
+    used_ = 0;
+  }
+  void *ptr = chunks_.back().get() + used_;
+  used_ += size;
+  return ptr;
+}
+
+Arena *Arena::current()
+{
+  return current_arena;
+}
+
+Arena::Scope::Scope(Arena &arena) : previous_(current_arena)
+{
+  current_arena = &arena;
+}
+
+Arena::Scope::~Scope()
+{
+  current_arena = previous_;
+}
+
+} // namespace ast
+} // namespace bpftrace
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace bpftrace {
+namespace ast {
+
+// Bump allocator for the nodes of a parsed program, see Node::operator new.
+//
+// Nodes allocated while a Scope is active are stored contiguously in the
+// arena, which frees their memory in bulk when it is destroyed. Their
+// destructors still run when the tree is torn down, and the nodes created
+// outside of a Scope, like those added by later passes, live on the heap.
+class Arena
+{
+public:
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  void *allocate(size_t size);
+
+  // Arena in use on this thread, or nullptr for the heap
+  static Arena *current();
+
+  // Makes arena current for its lifetime
+  class Scope
+  {
+  public:
+    explicit Scope(Arena &arena);
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    Arena *previous_;
+  };
+
+private:
+  static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+  std::vector<std::unique_ptr<char[]>> chunks_;
+  size_t used_ = CHUNK_SIZE; // bytes used in the last chunk
+};
+
+} // namespace ast
+} // namespace bpftrace
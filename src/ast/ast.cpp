@@ -2,6 +2,7 @@
 #include "log.h"
 #include "parser.tab.hh"
 #include <iostream>
+#include <new>
 
 namespace bpftrace {
 namespace ast {
@@ -14,6 +15,31 @@ Node::Node(location loc) : loc(loc)
 {
 }
 
+namespace {
+// Prefix of every node allocation, recording where it was made
+struct alignas(std::max_align_t) NodeHeader
+{
+  bool in_arena;
+};
+} // namespace
+
+void *Node::operator new(size_t size)
+{
+  Arena *arena = Arena::current();
+  size += sizeof(NodeHeader);
+  void *mem = arena ? arena->allocate(size) : ::operator new(size);
+  auto *header = new (mem) NodeHeader{ arena != nullptr };
+  return header + 1;
+}
+
+void Node::operator delete(void *ptr)
+{
+  // Arena allocations are freed with their arena
+  auto *header = static_cast<NodeHeader *>(ptr) - 1;
+  if (!header->in_arena)
+    ::operator delete(header);
+}
+
 Expression::Expression() : Node()
 {
 }
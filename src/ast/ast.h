@@ -1,5 +1,6 @@
 #pragma once
 
+#include "arena.h"
 #include "location.hh"
 #include "utils.h"
 #include <map>
@@ -21,6 +22,10 @@ public:
   virtual ~Node() = default;
   virtual void accept(Visitor &v) = 0;
   location loc;
+
+  // Nodes are allocated in Arena::current() when there is one
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr);
 };
 
 class Map;
@@ -388,10 +393,21 @@ using ProbeList = std::vector<std::unique_ptr<Probe>>;
 class Program : public Node {
 public:
   Program(const std::string &c_definitions, std::unique_ptr<ProbeList> probes);
+  // Arena of the parsed nodes, outliving them. Program owns it, so is
+  // never allocated in one.
+  std::unique_ptr<Arena> arena;
   std::string c_definitions;
   std::unique_ptr<ProbeList> probes;
 
   void accept(Visitor &v) override;
+  static void *operator new(size_t size)
+  {
+    return ::operator new(size);
+  }
+  static void operator delete(void *ptr)
+  {
+    ::operator delete(ptr);
+  }
 };
 
 class Visitor {
@@ -0,0 +1,58 @@
+#include <cstring>
+#include <elf.h>
+#include <stdexcept>
+
+#include "bpf_object.h"
+
+namespace bpftrace {
+
+BpfObject::BpfObject(llvm::SmallVector<char, 0> &&elf) : elf_(std::move(elf))
+{
+  auto invalid = [](const std::string &what) {
+    return std::runtime_error("invalid BPF object: " + what);
+  };
+
+  Elf64_Ehdr ehdr;
+  if (elf_.size() < sizeof(ehdr))
+    throw invalid("truncated ELF header");
+  std::memcpy(&ehdr, elf_.data(), sizeof(ehdr));
+  if (std::memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 ||
+      ehdr.e_ident[EI_CLASS] != ELFCLASS64)
+    throw invalid("not a 64-bit ELF file");
+  if (ehdr.e_shentsize != sizeof(Elf64_Shdr) || ehdr.e_shoff > elf_.size() ||
+      ehdr.e_shnum > (elf_.size() - ehdr.e_shoff) / sizeof(Elf64_Shdr) ||
+      ehdr.e_shstrndx >= ehdr.e_shnum)
+    throw invalid("invalid section headers");
+
+  std::vector<Elf64_Shdr> shdrs(ehdr.e_shnum);
+  std::memcpy(shdrs.data(),
+              elf_.data() + ehdr.e_shoff,
+              shdrs.size() * sizeof(Elf64_Shdr));
+  auto in_bounds = [this](const Elf64_Shdr &shdr) {
+    return shdr.sh_offset <= elf_.size() &&
+           shdr.sh_size <= elf_.size() - shdr.sh_offset;
+  };
+
+  auto &shstrtab = shdrs[ehdr.e_shstrndx];
+  if (!in_bounds(shstrtab))
+    throw invalid("section out of bounds");
+  const char *names = elf_.data() + shstrtab.sh_offset;
+  for (auto &shdr : shdrs)
+  {
+    if (shdr.sh_type != SHT_PROGBITS || !(shdr.sh_flags & SHF_ALLOC) ||
+        shdr.sh_size == 0)
+      continue;
+    if (!in_bounds(shdr))
+      throw invalid("section out of bounds");
+    if (shdr.sh_name >= shstrtab.sh_size ||
+        !std::memchr(names + shdr.sh_name,
+                     '\0',
+                     shstrtab.sh_size - shdr.sh_name))
+      throw invalid("invalid section name");
+    sections_[names + shdr.sh_name] = std::make_tuple(
+        reinterpret_cast<uint8_t *>(elf_.data() + shdr.sh_offset),
+        shdr.sh_size);
+  }
+}
+
+} // namespace bpftrace
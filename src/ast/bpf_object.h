@@ -0,0 +1,33 @@
+#pragma once
+
+#include <llvm/ADT/SmallVector.h>
+
+#include "bpftrace.h"
+
+namespace bpftrace {
+
+// BPF ELF object emitted by the code generator, kept in memory.
+//
+// The programs are loaded straight from the sections of the object: they
+// need no relocation, as map fds are embedded in the instructions and the
+// helper functions are inlined.
+class BpfObject
+{
+public:
+  /**
+     Take ownership of an object file and find its sections. Throws
+     std::runtime_error if it is malformed.
+  */
+  explicit BpfObject(llvm::SmallVector<char, 0> &&elf);
+
+  BpfObject(const BpfObject &) = delete;
+  BpfObject &operator=(const BpfObject &) = delete;
+
+  // Allocated sections of the object, pointing into it
+  ProgramSections sections_;
+
+private:
+  llvm::SmallVector<char, 0> elf_;
+};
+
+} // namespace bpftrace
@@ -2,7 +2,7 @@
 #include "arch/arch.h"
 #include "ast.h"
 #include "ast/async_event_types.h"
-#include "bpforc.h"
+#include "bpf_object.h"
 #include "codegen_helper.h"
 #include "log.h"
 #include "parser.tab.hh"
@@ -11,21 +11,48 @@
 #include "usdt.h"
 #include <algorithm>
 #include <arpa/inet.h>
+#include <atomic>
 #include <cerrno>
 #include <csignal>
 #include <ctime>
 #include <fstream>
+#include <limits>
+#include <linux/bpf.h>
+#include <thread>
 
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/Support/TargetRegistry.h>
+#include <llvm/Support/TargetSelect.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Linker/Linker.h>
 #include <llvm/Transforms/IPO.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Utils/Cloning.h>
 #include <llvm-c/Transforms/IPO.h>
 
 namespace bpftrace {
 namespace ast {
 
+static const std::string TARGET_TRIPLE = "bpf-pc-linux";
+
+// A TargetMachine is not safe to share between threads, so each thread that
+// optimizes programs creates its own
+static std::unique_ptr<TargetMachine> createTargetMachine()
+{
+  std::string error;
+  const Target *target = TargetRegistry::lookupTarget(TARGET_TRIPLE, error);
+  if (!target)
+    throw std::runtime_error("Could not create LLVM target " + error);
+
+  TargetOptions opt;
+  auto RM = Reloc::Model();
+  return std::unique_ptr<TargetMachine>(
+      target->createTargetMachine(TARGET_TRIPLE, "generic", "", opt, RM));
+}
+
 CodegenLLVM::CodegenLLVM(Node *root, BPFtrace &bpftrace)
     : root_(root),
       module_(std::make_unique<Module>("bpftrace", context_)),
@@ -38,20 +65,10 @@ CodegenLLVM::CodegenLLVM(Node *root, BPFtrace &bpftrace)
   LLVMInitializeBPFTargetMC();
   LLVMInitializeBPFAsmPrinter();
 
-  std::string targetTriple = "bpf-pc-linux";
-  module_->setTargetTriple(targetTriple);
-
-  std::string error;
-  const Target *target = TargetRegistry::lookupTarget(targetTriple, error);
-  if (!target)
-    throw std::runtime_error("Could not create LLVM target " + error);
-
-  TargetOptions opt;
-  auto RM = Reloc::Model();
-  TM_ = target->createTargetMachine(targetTriple, "generic", "", opt, RM);
+  module_->setTargetTriple(TARGET_TRIPLE);
+  TM_ = createTargetMachine();
   module_->setDataLayout(TM_->createDataLayout());
   layout_ = DataLayout(module_.get());
-  orc_ = std::make_unique<BpfOrc>(TM_);
 }
 
 void CodegenLLVM::visit(Integer &integer)
@@ -133,8 +150,11 @@ void CodegenLLVM::visit(Builtin &builtin)
   }
   else if (builtin.ident == "kstack" || builtin.ident == "ustack")
   {
-    Value *stackid = b_.CreateGetStackId(
-        ctx_, builtin.ident == "ustack", builtin.type.stack_type, builtin.loc);
+    Value *stackid = b_.CreateGetStackId(ctx_,
+                                         builtin.ident == "ustack",
+                                         builtin.type.stack_type,
+                                         stackIdSite(builtin.ident),
+                                         builtin.loc);
     // Kernel stacks should not be differentiated by tid, since the kernel
     // address space is the same between pids (and when aggregating you *want*
     // to be able to correlate between pids in most cases). User-space stacks
@@ -226,7 +246,12 @@ void CodegenLLVM::visit(Builtin &builtin)
                                           builtin.loc);
         return;
       }
-      offset = arch::arg_offset(arg_num);
+      // The context of raw tracepoints is the array of their arguments
+      if (probetype(current_attach_point_->provider) ==
+          ProbeType::rawtracepoint)
+        offset = arg_num;
+      else
+        offset = arch::arg_offset(arg_num);
     }
 
     Value *ctx = b_.CreatePointerCast(ctx_, b_.getInt64Ty()->getPointerTo());
@@ -320,6 +345,93 @@ void CodegenLLVM::visit(Call &call)
     b_.CreateLifetimeEnd(newval);
     expr_ = nullptr;
   }
+  else if (call.func == "count_distinct")
+  {
+    if (!hll_hash_func_)
+      hll_hash_func_ = createHLLHashFunction();
+    if (!log2_func_)
+      log2_func_ = createLog2Function();
+
+    Map &map = *call.map;
+    auto &arg = *call.vargs->front();
+    auto scoped_del = accept(&arg);
+
+    Value *hash;
+    if (arg.type.IsStringTy())
+    {
+      // FNV-1a over the bytes up to the first NUL, so strings hash the same
+      // regardless of their buffer size, then mix the result
+      hash = b_.getInt64(0xcbf29ce484222325ULL);
+      Value *ended = b_.getFalse();
+      for (size_t i = 0; i < arg.type.size; i++)
+      {
+        Value *ptr = b_.CreateGEP(expr_, { b_.getInt32(0), b_.getInt32(i) });
+        Value *byte = b_.CreateIntCast(b_.CreateLoad(b_.getInt8Ty(), ptr),
+                                       b_.getInt64Ty(),
+                                       false);
+        ended = b_.CreateOr(ended, b_.CreateICmpEQ(byte, b_.getInt64(0)));
+        hash = b_.CreateSelect(ended,
+                               hash,
+                               b_.CreateMul(b_.CreateXor(hash, byte),
+                                            b_.getInt64(0x100000001b3ULL)));
+      }
+      hash = b_.CreateCall(hll_hash_func_, { hash }, "hll_hash");
+    }
+    else
+    {
+      // promote int to 64-bit
+      Value *value = b_.CreateIntCast(expr_,
+                                      b_.getInt64Ty(),
+                                      arg.type.IsSigned());
+      hash = b_.CreateCall(hll_hash_func_, { value }, "hll_hash");
+    }
+
+    // The top HLL_PRECISION bits of the hash select a register, which keeps
+    // the highest rank (position of the first set bit) of the other bits.
+    // The guard bit caps the rank if the other bits are all zero.
+    Value *index = b_.CreateLShr(hash, 64 - HLL_PRECISION);
+    Value *rest = b_.CreateOr(b_.CreateShl(hash, HLL_PRECISION),
+                              b_.getInt64(1ULL << (HLL_PRECISION - 1)));
+    // log2() returns the position of the highest set bit plus 2, and 0 for
+    // values with the sign bit set
+    Value *log2 = b_.CreateCall(log2_func_, { rest }, "log2");
+    Value *rank = b_.CreateSelect(b_.CreateICmpSLT(rest, b_.getInt64(0)),
+                                  b_.getInt64(1),
+                                  b_.CreateSub(b_.getInt64(66), log2));
+
+    AllocaInst *key = getMapKey(map);
+    Value *registers = b_.CreateMapLookupOrInitElemPtr(ctx_,
+                                                       map,
+                                                       key,
+                                                       call.loc);
+    b_.CreateLifetimeEnd(key);
+
+    Function *parent = b_.GetInsertBlock()->getParent();
+    BasicBlock *found = BasicBlock::Create(module_->getContext(),
+                                           "count_distinct.found",
+                                           parent);
+    BasicBlock *greater = BasicBlock::Create(module_->getContext(),
+                                             "count_distinct.greater",
+                                             parent);
+    BasicBlock *done = BasicBlock::Create(module_->getContext(),
+                                          "count_distinct.done",
+                                          parent);
+    b_.CreateCondBr(b_.CreateIsNotNull(registers), found, done);
+
+    b_.SetInsertPoint(found);
+    Value *reg = b_.CreateGEP(registers, index);
+    Value *oldrank = b_.CreateIntCast(b_.CreateLoad(b_.getInt8Ty(), reg),
+                                      b_.getInt64Ty(),
+                                      false);
+    b_.CreateCondBr(b_.CreateICmpUGT(rank, oldrank), greater, done);
+
+    b_.SetInsertPoint(greater);
+    b_.CreateStore(b_.CreateIntCast(rank, b_.getInt8Ty(), false), reg);
+    b_.CreateBr(done);
+
+    b_.SetInsertPoint(done);
+    expr_ = nullptr;
+  }
   else if (call.func == "sum")
   {
     Map &map = *call.map;
@@ -497,6 +609,87 @@ void CodegenLLVM::visit(Call &call)
     b_.CreateLifetimeEnd(newval);
     expr_ = nullptr;
   }
+  else if (call.func == "llhist")
+  {
+    if (!loglinear_func_)
+      loglinear_func_ = createLogLinearFunction();
+
+    Map &map = *call.map;
+    auto scoped_del = accept(call.vargs->front().get());
+    // promote int to 64-bit
+    expr_ = b_.CreateIntCast(expr_,
+                             b_.getInt64Ty(),
+                             call.vargs->front()->type.IsSigned());
+
+    int64_t bits = LLHIST_DEFAULT_BITS;
+    if (call.vargs->size() > 1)
+      bits = static_cast<Integer *>(call.vargs->at(1).get())->n;
+
+    Value *loglinear = b_.CreateCall(loglinear_func_,
+                                     { expr_, b_.getInt64(bits) },
+                                     "loglinear");
+    AllocaInst *key = getHistMapKey(map, loglinear);
+
+    Value *oldval = b_.CreateMapLookupElem(ctx_, map, key, call.loc);
+    AllocaInst *newval = b_.CreateAllocaBPF(map.type, map.ident + "_val");
+    b_.CreateStore(b_.CreateAdd(oldval, b_.getInt64(1)), newval);
+    b_.CreateMapUpdateElem(ctx_, map, key, newval, call.loc);
+
+    // oldval can only be an integer so won't be in memory and doesn't need lifetime end
+    b_.CreateLifetimeEnd(key);
+    b_.CreateLifetimeEnd(newval);
+    expr_ = nullptr;
+  }
+  else if (call.func == "quantiles")
+  {
+    if (!loglinear_func_)
+      loglinear_func_ = createLogLinearFunction();
+
+    Map &map = *call.map;
+    auto scoped_del = accept(call.vargs->front().get());
+    bool is_signed = call.vargs->front()->type.IsSigned();
+    // promote int to 64-bit
+    Value *value = b_.CreateIntCast(expr_, b_.getInt64Ty(), is_signed);
+
+    int64_t bits = QUANTILES_DEFAULT_BITS;
+    if (call.vargs->size() > 1)
+      bits = static_cast<Integer *>(call.vargs->at(1).get())->n;
+
+    // negative values are counted under the negated bucket of their magnitude
+    Value *is_negative = nullptr;
+    if (is_signed)
+    {
+      is_negative = b_.CreateICmpSLT(value, b_.getInt64(0), "is_negative");
+      value = b_.CreateSelect(is_negative, b_.CreateNeg(value), value);
+    }
+    // the magnitude of INT64_MIN and unsigned values above INT64_MAX look
+    // negative to the helper: count them in the top bucket, see
+    // quantiles_key()
+    value = b_.CreateSelect(b_.CreateICmpSLT(value, b_.getInt64(0)),
+                            b_.getInt64(std::numeric_limits<int64_t>::max()),
+                            value);
+
+    Value *loglinear = b_.CreateCall(loglinear_func_,
+                                     { value, b_.getInt64(bits) },
+                                     "loglinear");
+    if (is_signed)
+      loglinear = b_.CreateSelect(is_negative,
+                                  b_.CreateNeg(loglinear),
+                                  loglinear);
+    // only the buckets hit get a key, so once the map is full the update
+    // fails and values in new buckets are dropped
+    AllocaInst *key = getHistMapKey(map, loglinear);
+
+    Value *oldval = b_.CreateMapLookupElem(ctx_, map, key, call.loc);
+    AllocaInst *newval = b_.CreateAllocaBPF(map.type, map.ident + "_val");
+    b_.CreateStore(b_.CreateAdd(oldval, b_.getInt64(1)), newval);
+    b_.CreateMapUpdateElem(ctx_, map, key, newval, call.loc);
+
+    // oldval can only be an integer so won't be in memory and doesn't need lifetime end
+    b_.CreateLifetimeEnd(key);
+    b_.CreateLifetimeEnd(newval);
+    expr_ = nullptr;
+  }
   else if (call.func == "delete")
   {
     auto &arg = *call.vargs->at(0);
@@ -602,6 +795,7 @@ void CodegenLLVM::visit(Call &call)
     uint64_t addr;
     auto &name = static_cast<String&>(*call.vargs->at(0)).str;
     addr = bpftrace_.resolve_kname(name);
+    bpftrace_.boot_specific_ = true; // KASLR
     expr_ = b_.getInt64(addr);
   }
   else if (call.func == "uaddr")
@@ -620,8 +814,85 @@ void CodegenLLVM::visit(Call &call)
     uint64_t cgroupid;
     auto &path = static_cast<String&>(*call.vargs->at(0)).str;
     cgroupid = bpftrace_.resolve_cgroupid(path);
+    bpftrace_.boot_specific_ = true;
     expr_ = b_.getInt64(cgroupid);
   }
+  else if (call.func == "sample" || call.func == "ratelimit")
+  {
+    uint64_t rate = static_cast<Integer &>(*call.vargs->at(0)).n;
+    Value *slot = b_.CreateGetSamplingSlot(ctx_, sampling_id_, call.loc);
+    sampling_id_++;
+
+    // keep the event if the per-CPU slot can't be found
+    AllocaInst *result = b_.CreateAllocaBPF(b_.getInt64Ty(),
+                                            call.func + "_result");
+    b_.CreateStore(b_.getInt64(1), result);
+
+    Function *parent = b_.GetInsertBlock()->getParent();
+    BasicBlock *found = BasicBlock::Create(module_->getContext(),
+                                           call.func + ".found",
+                                           parent);
+    BasicBlock *done = BasicBlock::Create(module_->getContext(),
+                                          call.func + ".done",
+                                          parent);
+    b_.CreateCondBr(b_.CreateIsNotNull(slot), found, done);
+
+    b_.SetInsertPoint(found);
+    Value *fields = b_.CreatePointerCast(slot,
+                                         b_.getInt64Ty()->getPointerTo());
+    Value *dropped = b_.CreateGEP(fields,
+                                  b_.getInt64(offsetof(SamplingSlot, dropped) /
+                                              8));
+    Value *keep;
+    if (call.func == "sample")
+    {
+      keep = b_.CreateICmpEQ(b_.CreateURem(b_.CreateGetRandom(),
+                                           b_.getInt64(rate)),
+                             b_.getInt64(0),
+                             "sample_keep");
+    }
+    else
+    {
+      // Token bucket holding up to one second of events. The bucket refills
+      // by rate tokens per nanosecond and an event costs a second's worth,
+      // which avoids divisions. The elapsed time is capped at one second,
+      // so a full refill doesn't overflow.
+      const uint64_t second = 1000000000ULL;
+      Value *last_ptr = b_.CreateGEP(
+          fields, b_.getInt64(offsetof(SamplingSlot, last_ns) / 8));
+      Value *tokens_ptr = b_.CreateGEP(
+          fields, b_.getInt64(offsetof(SamplingSlot, tokens) / 8));
+
+      Value *now = b_.CreateGetNs(false);
+      Value *elapsed = b_.CreateSub(now, b_.CreateLoad(last_ptr));
+      elapsed = b_.CreateSelect(b_.CreateICmpUGT(elapsed,
+                                                 b_.getInt64(second)),
+                                b_.getInt64(second),
+                                elapsed);
+      Value *tokens = b_.CreateAdd(b_.CreateLoad(tokens_ptr),
+                                   b_.CreateMul(elapsed, b_.getInt64(rate)));
+      tokens = b_.CreateSelect(b_.CreateICmpUGT(tokens,
+                                                b_.getInt64(rate * second)),
+                               b_.getInt64(rate * second),
+                               tokens);
+      keep = b_.CreateICmpUGE(tokens, b_.getInt64(second), "ratelimit_keep");
+      tokens = b_.CreateSelect(keep,
+                               b_.CreateSub(tokens, b_.getInt64(second)),
+                               tokens);
+      b_.CreateStore(now, last_ptr);
+      b_.CreateStore(tokens, tokens_ptr);
+    }
+    b_.CreateStore(b_.CreateAdd(b_.CreateLoad(dropped),
+                                b_.CreateZExt(b_.CreateNot(keep),
+                                              b_.getInt64Ty())),
+                   dropped);
+    b_.CreateStore(b_.CreateZExt(keep, b_.getInt64Ty()), result);
+    b_.CreateBr(done);
+
+    b_.SetInsertPoint(done);
+    expr_ = b_.CreateLoad(result);
+    b_.CreateLifetimeEnd(result);
+  }
   else if (call.func == "join")
   {
     auto &arg0 = call.vargs->front();
@@ -900,8 +1171,11 @@ void CodegenLLVM::visit(Call &call)
   }
   else if (call.func == "kstack" || call.func == "ustack")
   {
-    Value *stackid = b_.CreateGetStackId(
-        ctx_, call.func == "ustack", call.type.stack_type, call.loc);
+    Value *stackid = b_.CreateGetStackId(ctx_,
+                                         call.func == "ustack",
+                                         call.type.stack_type,
+                                         stackIdSite(call.func + "()"),
+                                         call.loc);
     // Kernel stacks should not be differentiated by tid, since the kernel
     // address space is the same between pids (and when aggregating you *want*
     // to be able to correlate between pids in most cases). User-space stacks
@@ -991,6 +1265,22 @@ void CodegenLLVM::visit(Call &call)
     auto &arg = call.vargs->at(0);
     auto scoped_del = accept(arg.get());
   }
+  else if (call.func == "pid_filter_add")
+  {
+    // New threads are added too, which is harmless as the filter compares
+    // process ids
+    auto &arg = *call.vargs->at(0);
+    auto scoped_del = accept(&arg);
+    int mapfd = bpftrace_.maps[MapManager::Type::PidFilter].value()->mapfd_;
+    AllocaInst *key = b_.CreateAllocaBPF(b_.getInt64Ty(), "pid_filter_key");
+    b_.CreateStore(b_.CreateIntCast(expr_, b_.getInt64Ty(), false), key);
+    AllocaInst *val = b_.CreateAllocaBPF(b_.getInt64Ty(), "pid_filter_val");
+    b_.CreateStore(b_.getInt64(1), val);
+    b_.CreateMapUpdateElem(ctx_, mapfd, key, val, call.loc);
+    b_.CreateLifetimeEnd(key);
+    b_.CreateLifetimeEnd(val);
+    expr_ = nullptr;
+  }
   else
   {
     LOG(FATAL) << "missing codegen for function \"" << call.func << "\"";
@@ -1921,6 +2211,13 @@ void CodegenLLVM::generateProbe(Probe &probe,
 
   // check: do the following 8 lines need to be in the wildcard loop?
   ctx_ = func->arg_begin();
+  if (runsInTracedProcess(probe))
+  {
+    if (!bpftrace_.pid_filter_.empty())
+      createPidFilter();
+    if (bpftrace_.cgroup_filter_)
+      createCgroupFilter();
+  }
   if (probe.pred)
   {
     auto scoped_del = accept(probe.pred.get());
@@ -1948,6 +2245,7 @@ void CodegenLLVM::visit(Probe &probe)
     probe.need_expansion = true;
 
   current_attach_point_ = attach_point.get();
+  probe_name_ = probe.name();
 
   /*
    * Most of the time, we can take a probe like kprobe:do_f* and build a
@@ -1972,6 +2270,8 @@ void CodegenLLVM::visit(Probe &probe)
     int starting_time_id = time_id_;
     int starting_strftime_id = strftime_id_;
     int starting_join_id = join_id_;
+    int starting_sampling_id = sampling_id_;
+    int starting_stackid_site_id = stackid_site_id_;
     int starting_helper_error_id = b_.helper_error_id_;
     int starting_non_map_print_id = non_map_print_id_;
 
@@ -1982,6 +2282,8 @@ void CodegenLLVM::visit(Probe &probe)
       time_id_ = starting_time_id;
       strftime_id_ = starting_strftime_id;
       join_id_ = starting_join_id;
+      sampling_id_ = starting_sampling_id;
+      stackid_site_id_ = starting_stackid_site_id;
       b_.helper_error_id_ = starting_helper_error_id;
       non_map_print_id_ = starting_non_map_print_id;
     };
@@ -2080,12 +2382,97 @@ void CodegenLLVM::visit(Probe &probe)
   current_attach_point_ = nullptr;
 }
 
+// BEGIN, END and interval probes don't run in the context of the traced
+// processes, so the pid and cgroup filters leave them alone
+bool CodegenLLVM::runsInTracedProcess(Probe &probe)
+{
+  for (auto &attach_point : *probe.attach_points)
+  {
+    if (attach_point->provider == "BEGIN" || attach_point->provider == "END" ||
+        probetype(attach_point->provider) == ProbeType::interval)
+      return false;
+  }
+  return true;
+}
+
+// Return early from programs running outside of the traced processes, before
+// the probe does any work
+void CodegenLLVM::createPidFilter()
+{
+  Function *parent = b_.GetInsertBlock()->getParent();
+  BasicBlock *filter_false = BasicBlock::Create(module_->getContext(),
+                                                "pid_filter_false",
+                                                parent);
+  BasicBlock *filter_true = BasicBlock::Create(module_->getContext(),
+                                               "pid_filter_true",
+                                               parent);
+
+  Value *pid = b_.CreateLShr(b_.CreateGetPidTgid(), 32);
+  Value *cond;
+  if (bpftrace_.maps.Has(MapManager::Type::PidFilter))
+  {
+    AllocaInst *key = b_.CreateAllocaBPF(b_.getInt64Ty(), "pid_filter_key");
+    b_.CreateStore(pid, key);
+    Value *found = b_.CreatePidFilterLookup(key);
+    b_.CreateLifetimeEnd(key);
+    cond = b_.CreateIsNotNull(found, "pid_filter_cond");
+  }
+  else
+  {
+    // a single compare is enough for a single pid that isn't followed
+    cond = b_.CreateICmpEQ(pid,
+                           b_.getInt64(bpftrace_.pid_filter_.front()),
+                           "pid_filter_cond");
+  }
+  b_.CreateCondBr(cond, filter_true, filter_false);
+
+  b_.SetInsertPoint(filter_false);
+  b_.CreateRet(ConstantInt::get(module_->getContext(), APInt(64, 0)));
+
+  b_.SetInsertPoint(filter_true);
+}
+
+// Return early from programs running outside of the traced cgroups
+void CodegenLLVM::createCgroupFilter()
+{
+  Function *parent = b_.GetInsertBlock()->getParent();
+  BasicBlock *filter_false = BasicBlock::Create(module_->getContext(),
+                                                "cgroup_filter_false",
+                                                parent);
+  BasicBlock *filter_true = BasicBlock::Create(module_->getContext(),
+                                               "cgroup_filter_true",
+                                               parent);
+
+  AllocaInst *key = b_.CreateAllocaBPF(b_.getInt64Ty(), "cgroup_filter_key");
+  b_.CreateStore(b_.CreateGetCurrentCgroupId(), key);
+  Value *found = b_.CreateCgroupFilterLookup(key);
+  b_.CreateLifetimeEnd(key);
+  b_.CreateCondBr(b_.CreateIsNotNull(found, "cgroup_filter_cond"),
+                  filter_true,
+                  filter_false);
+
+  b_.SetInsertPoint(filter_false);
+  b_.CreateRet(ConstantInt::get(module_->getContext(), APInt(64, 0)));
+
+  b_.SetInsertPoint(filter_true);
+}
+
 void CodegenLLVM::visit(Program &program)
 {
   for (auto &probe : *program.probes)
     auto scoped_del = accept(probe.get());
 }
 
+// Slot of the next kstack/ustack call site in the get_stackid() error counts.
+// The semantic analyser sized the map, but may visit the sites in another
+// order, so the site names are set here.
+int CodegenLLVM::stackIdSite(const std::string &func)
+{
+  int site = stackid_site_id_++;
+  bpftrace_.stackid_sites_.at(site) = func + " in " + probe_name_;
+  return site;
+}
+
 int CodegenLLVM::getNextIndexForProbe(const std::string &probe_name) {
   if (next_probe_index_.count(probe_name) == 0)
     next_probe_index_[probe_name] = 1;
@@ -2436,6 +2823,150 @@ Function *CodegenLLVM::createLinearFunction()
   return module_->getFunction("linear");
 }
 
+Function *CodegenLLVM::createLogLinearFunction()
+{
+  auto ip = b_.saveIP();
+  // llhist() returns a bucket index for the given value. Each power-of-2
+  // range is split into 2^k linear sub-buckets, so the relative width of a
+  // bucket is at most 2^-k. Index 0 is for values less than 0. Values below
+  // 2^(k+1) get an exact bucket of their own.
+  //
+  // int loglinear(int n, int k)
+  // {
+  //   int e = 0;
+  //   int m = n;
+  //   int shift;
+  //   if (n < 0) return 0;
+  //   if (n < (2 << k)) return n + 1;
+  //   for (int i = 5; i >= 0; i--)
+  //   {
+  //     shift = (m >= (1<<(1<<i))) << i;
+  //     m >>= shift;
+  //     e += shift;
+  //   }
+  //   return ((e - k) << k) + (n >> (e - k)) + 1;
+  // }
+
+  FunctionType *loglinear_func_type = FunctionType::get(
+      b_.getInt64Ty(), { b_.getInt64Ty(), b_.getInt64Ty() }, false);
+  Function *loglinear_func = Function::Create(loglinear_func_type,
+                                              Function::InternalLinkage,
+                                              "loglinear",
+                                              module_.get());
+  loglinear_func->addFnAttr(Attribute::AlwaysInline);
+  loglinear_func->setSection("helpers");
+  BasicBlock *entry = BasicBlock::Create(module_->getContext(),
+                                         "entry",
+                                         loglinear_func);
+  b_.SetInsertPoint(entry);
+
+  // pull in arguments
+  Value *n_alloc = b_.CreateAllocaBPF(CreateUInt64());
+  Value *k_alloc = b_.CreateAllocaBPF(CreateUInt64());
+  Value *m_alloc = b_.CreateAllocaBPF(CreateUInt64());
+  Value *e_alloc = b_.CreateAllocaBPF(CreateUInt64());
+  b_.CreateStore(loglinear_func->arg_begin() + 0, n_alloc);
+  b_.CreateStore(loglinear_func->arg_begin() + 1, k_alloc);
+
+  // test for less than zero
+  BasicBlock *is_less_than_zero = BasicBlock::Create(
+      module_->getContext(), "llhist.is_less_than_zero", loglinear_func);
+  BasicBlock *is_not_less_than_zero = BasicBlock::Create(
+      module_->getContext(), "llhist.is_not_less_than_zero", loglinear_func);
+  b_.CreateCondBr(b_.CreateICmpSLT(b_.CreateLoad(n_alloc), b_.getInt64(0)),
+                  is_less_than_zero,
+                  is_not_less_than_zero);
+  b_.SetInsertPoint(is_less_than_zero);
+  b_.CreateRet(b_.getInt64(0));
+  b_.SetInsertPoint(is_not_less_than_zero);
+
+  // small values are exact
+  BasicBlock *is_exact = BasicBlock::Create(module_->getContext(),
+                                            "llhist.is_exact",
+                                            loglinear_func);
+  BasicBlock *is_not_exact = BasicBlock::Create(module_->getContext(),
+                                                "llhist.is_not_exact",
+                                                loglinear_func);
+  {
+    Value *n = b_.CreateLoad(n_alloc);
+    Value *limit = b_.CreateShl(b_.getInt64(2), b_.CreateLoad(k_alloc));
+    b_.CreateCondBr(b_.CreateICmpULT(n, limit), is_exact, is_not_exact);
+  }
+  b_.SetInsertPoint(is_exact);
+  b_.CreateRet(b_.CreateAdd(b_.CreateLoad(n_alloc), b_.getInt64(1)));
+  b_.SetInsertPoint(is_not_exact);
+
+  // e = floor(log2(n))
+  b_.CreateStore(b_.CreateLoad(n_alloc), m_alloc);
+  b_.CreateStore(b_.getInt64(0), e_alloc);
+  for (int i = 5; i >= 0; i--)
+  {
+    Value *m = b_.CreateLoad(m_alloc);
+    Value *shift = b_.CreateShl(
+        b_.CreateIntCast(b_.CreateICmpUGE(m, b_.getInt64(1ULL << (1 << i))),
+                         b_.getInt64Ty(),
+                         false),
+        i);
+    b_.CreateStore(b_.CreateLShr(m, shift), m_alloc);
+    b_.CreateStore(b_.CreateAdd(b_.CreateLoad(e_alloc), shift), e_alloc);
+  }
+
+  // ((e - k) << k) + (n >> (e - k)) + 1
+  {
+    Value *n = b_.CreateLoad(n_alloc);
+    Value *k = b_.CreateLoad(k_alloc);
+    Value *e = b_.CreateLoad(e_alloc);
+    Value *exp = b_.CreateSub(e, k);
+    Value *result = b_.CreateAdd(b_.CreateShl(exp, k), b_.CreateLShr(n, exp));
+    b_.CreateRet(b_.CreateAdd(result, b_.getInt64(1)));
+  }
+
+  b_.restoreIP(ip);
+  return module_->getFunction("loglinear");
+}
+
+Function *CodegenLLVM::createHLLHashFunction()
+{
+  auto ip = b_.saveIP();
+  // hll_hash() mixes the bits of a value so that every bit of the result
+  // depends on every bit of the input, as count_distinct() needs uniformly
+  // distributed hashes. It is the splitmix64 finaliser and must match
+  // hll_hash() in sketch.cpp.
+  //
+  // hll_hash(uint64 x)
+  // {
+  //   x += 0x9e3779b97f4a7c15;
+  //   x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+  //   x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+  //   return x ^ (x >> 31);
+  // }
+
+  FunctionType *hll_hash_func_type = FunctionType::get(b_.getInt64Ty(),
+                                                       { b_.getInt64Ty() },
+                                                       false);
+  Function *hll_hash_func = Function::Create(hll_hash_func_type,
+                                             Function::InternalLinkage,
+                                             "hll_hash",
+                                             module_.get());
+  hll_hash_func->addFnAttr(Attribute::AlwaysInline);
+  hll_hash_func->setSection("helpers");
+  BasicBlock *entry = BasicBlock::Create(module_->getContext(),
+                                         "entry",
+                                         hll_hash_func);
+  b_.SetInsertPoint(entry);
+
+  Value *x = hll_hash_func->arg_begin();
+  x = b_.CreateAdd(x, b_.getInt64(0x9e3779b97f4a7c15ULL));
+  x = b_.CreateMul(b_.CreateXor(x, b_.CreateLShr(x, 30)),
+                   b_.getInt64(0xbf58476d1ce4e5b9ULL));
+  x = b_.CreateMul(b_.CreateXor(x, b_.CreateLShr(x, 27)),
+                   b_.getInt64(0x94d049bb133111ebULL));
+  b_.CreateRet(b_.CreateXor(x, b_.CreateLShr(x, 31)));
+
+  b_.restoreIP(ip);
+  return module_->getFunction("hll_hash");
+}
+
 void CodegenLLVM::createFormatStringCall(Call &call, int &id, CallArgs &call_args,
                                          const std::string &call_name, AsyncAction async_action)
 {
@@ -2579,10 +3110,10 @@ void CodegenLLVM::generate_ir()
   state_ = State::IR;
 }
 
-void CodegenLLVM::emit_elf(const std::string &filename)
+void CodegenLLVM::emitObject(SmallVector<char, 0> &object)
 {
-  assert(state_ == State::OPT);
   legacy::PassManager PM;
+  raw_svector_ostream out(object);
 
 #if LLVM_VERSION_MAJOR >= 10
   auto type = llvm::CGFT_ObjectFile;
@@ -2591,42 +3122,39 @@ void CodegenLLVM::emit_elf(const std::string &filename)
 #endif
 
 #if LLVM_VERSION_MAJOR >= 7
-  std::error_code err;
-  raw_fd_ostream out(filename, err);
-
-  if (err)
-    throw std::system_error(err.value(),
-                            std::generic_category(),
-                            "Failed to open: " + filename);
   if (TM_->addPassesToEmitFile(PM, out, nullptr, type))
+#else
+  if (TM_->addPassesToEmitFile(PM, out, type, true, nullptr))
+#endif
     throw std::runtime_error("Cannot emit a file of this type");
   PM.run(*module_.get());
+}
 
-  return;
-
-#else
+void CodegenLLVM::emit_elf(const std::string &filename)
+{
+  assert(state_ == State::OPT);
   std::ofstream file(filename);
   if (!file.is_open())
     throw std::system_error(errno,
                             std::generic_category(),
                             "Failed to open: " + filename);
-  std::unique_ptr<SmallVectorImpl<char>> buf(new SmallVector<char, 0>());
-  raw_svector_ostream out(*buf);
-
-  if (TM_->addPassesToEmitFile(PM, out, type, true, nullptr))
-    throw std::runtime_error("Cannot emit a file of this type");
-
-  file.write(buf->data(), buf->size_in_bytes());
-#endif
+  SmallVector<char, 0> object;
+  emitObject(object);
+  file.write(object.data(), object.size());
 }
 
-void CodegenLLVM::optimize()
+// Optimization levels, as selected with -O:
+//  0: only inline the helpers and promote stack slots to registers, which
+//     most programs need to fit in the 512 bytes of BPF stack
+//  1, 2: the standard pipeline of that level, with the BPF target's own
+//     passes, which keep the verifier happy, and without vectorization,
+//     which BPF has no instructions for
+//  3: the standard O3 pipeline
+static void optimizeModule(Module &module, TargetMachine *TM, int level)
 {
-  assert(state_ == State::IR);
-  PassManagerBuilder PMB;
-  PMB.OptLevel = 3;
   legacy::PassManager PM;
-  PM.add(createFunctionInliningPass());
+  if (level == 3)
+    PM.add(createFunctionInliningPass());
   /*
    * llvm < 4.0 needs
    * PM.add(createAlwaysInlinerPass());
@@ -2635,21 +3163,172 @@ void CodegenLLVM::optimize()
    * use below 'stable' workaround
    */
   LLVMAddAlwaysInlinerPass(reinterpret_cast<LLVMPassManagerRef>(&PM));
-  PMB.populateModulePassManager(PM);
 
-  PM.run(*module_.get());
+  if (level == 0)
+  {
+    PM.add(createSROAPass());
+  }
+  else
+  {
+    PassManagerBuilder PMB;
+    PMB.OptLevel = level;
+    if (level < 3)
+    {
+      PMB.LoopVectorize = false;
+      PMB.SLPVectorize = false;
+      TM->adjustPassManager(PMB);
+    }
+    PMB.populateModulePassManager(PM);
+  }
+
+  PM.run(module);
+}
+
+static size_t countInstructions(const Module &module)
+{
+  size_t count = 0;
+  for (auto &func : module)
+    for (auto &block : func)
+      count += block.size();
+  return count;
+}
+
+static std::string writeBitcode(const Module &module)
+{
+  std::string bitcode;
+  raw_string_ostream out(bitcode);
+#if LLVM_VERSION_MAJOR >= 7
+  WriteBitcodeToFile(module, out);
+#else
+  WriteBitcodeToFile(&module, out);
+#endif
+  out.flush();
+  return bitcode;
+}
+
+static std::unique_ptr<Module> readBitcode(const std::string &bitcode,
+                                           LLVMContext &context)
+{
+  auto buffer = MemoryBuffer::getMemBuffer(bitcode, "", false);
+  return cantFail(parseBitcodeFile(buffer->getMemBufferRef(), context));
+}
+
+// Bitcode of one module per BPF program, with the helpers it may inline
+static std::vector<std::string> splitPrograms(const Module &module)
+{
+  std::vector<std::string> programs;
+  for (auto &func : module)
+  {
+    if (func.isDeclaration() || func.hasLocalLinkage())
+      continue;
+    ValueToValueMapTy vmap;
+    auto should_clone = [&func](const GlobalValue *gv) {
+      return gv == &func || gv->hasLocalLinkage();
+    };
+#if LLVM_VERSION_MAJOR >= 7
+    auto program = CloneModule(module, vmap, should_clone);
+#else
+    auto program = CloneModule(&module, vmap, should_clone);
+#endif
+    programs.push_back(writeBitcode(*program));
+  }
+  return programs;
+}
+
+void CodegenLLVM::optimize(unsigned int max_threads)
+{
+  assert(state_ == State::IR);
+  int level = bpftrace_.opt_level_;
+  size_t ir_before = countInstructions(*module_);
+  auto programs = splitPrograms(*module_);
+  if (programs.size() <= 1)
+    optimizeModule(*module_, TM_.get(), level);
+  else
+    optimizePrograms(programs, level, max_threads);
+
+  if (bt_verbose)
+    std::cerr << "IR: " << ir_before << " instructions before optimization, "
+              << countInstructions(*module_) << " after (-O" << level << ")"
+              << std::endl;
   state_ = State::OPT;
 }
 
-std::unique_ptr<BpfOrc> CodegenLLVM::emit(void)
+void CodegenLLVM::optimizePrograms(std::vector<std::string> &programs,
+                                   int level,
+                                   unsigned int max_threads)
+{
+  // BPF programs never call each other, so each one is optimized on its own
+  // in a separate context, which lets them be optimized in parallel. IR was
+  // generated in program order, so the ids of async events don't depend on
+  // the order they finish in.
+  std::atomic<size_t> next{ 0 };
+  auto worker = [&programs, &next, level]() {
+    auto TM = createTargetMachine();
+    for (size_t i = next++; i < programs.size(); i = next++)
+    {
+      LLVMContext context;
+      auto program = readBitcode(programs[i], context);
+      optimizeModule(*program, TM.get(), level);
+      programs[i] = writeBitcode(*program);
+    }
+  };
+  if (max_threads == 0)
+    max_threads = std::max(1U, std::thread::hardware_concurrency());
+  size_t num_threads = std::min<size_t>(programs.size(), max_threads);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; i++)
+    threads.emplace_back(worker);
+  worker();
+  for (auto &thread : threads)
+    thread.join();
+
+  // Link the optimized programs back in place of the original ones, which
+  // keeps them in the same order. The helpers have been inlined.
+  std::vector<Function *> helpers;
+  for (auto &func : *module_)
+  {
+    if (func.hasLocalLinkage())
+      helpers.push_back(&func);
+    func.deleteBody();
+  }
+  for (auto *func : helpers)
+    func->eraseFromParent();
+  log2_func_ = linear_func_ = loglinear_func_ = hll_hash_func_ = nullptr;
+
+  Linker linker(*module_);
+  for (auto &program : programs)
+  {
+    if (linker.linkInModule(readBitcode(program, context_)))
+      throw std::runtime_error("Failed to link the optimized BPF programs");
+  }
+}
+
+std::unique_ptr<BpfObject> CodegenLLVM::emit(void)
 {
   assert(state_ == State::OPT);
-  orc_->compileModule(move(module_));
+  SmallVector<char, 0> elf;
+  emitObject(elf);
+  module_.reset();
+  auto object = std::make_unique<BpfObject>(std::move(elf));
   state_ = State::DONE;
-  return std::move(orc_);
+
+  if (bt_verbose)
+  {
+    size_t programs = 0, insns = 0;
+    for (auto &section : object->sections_)
+    {
+      if (section.first.rfind("s_", 0) != 0)
+        continue;
+      programs++;
+      insns += std::get<1>(section.second) / sizeof(struct bpf_insn);
+    }
+    std::cerr << "BPF: " << insns << " instructions in " << programs
+              << " programs" << std::endl;
+  }
+  return object;
 }
 
-std::unique_ptr<BpfOrc> CodegenLLVM::compile(void)
+std::unique_ptr<BpfObject> CodegenLLVM::compile(void)
 {
   generate_ir();
   optimize();
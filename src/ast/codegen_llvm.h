@@ -9,11 +9,14 @@
 #include "map.h"
 
 #include <llvm/Support/raw_os_ostream.h>
-#include <llvm/ExecutionEngine/MCJIT.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
+#include <llvm/Target/TargetMachine.h>
 
 namespace bpftrace {
+
+class BpfObject;
+
 namespace ast {
 
 using namespace llvm;
@@ -68,11 +71,13 @@ public:
   void createPrintNonMapCall(Call &call, int &id);
 
   void generate_ir(void);
-  void optimize(void);
-  std::unique_ptr<BpfOrc> emit(void);
+  // Optimize the programs on up to max_threads threads, one per CPU if 0.
+  // The result does not depend on the number of threads.
+  void optimize(unsigned int max_threads = 0);
+  std::unique_ptr<BpfObject> emit(void);
   void emit_elf(const std::string &filename);
   // Combine generate_ir, optimize and emit into one call
-  std::unique_ptr<BpfOrc> compile(void);
+  std::unique_ptr<BpfObject> compile(void);
 
 private:
   class ScopedExprDeleter
@@ -105,15 +110,27 @@ private:
                      const std::string &section_name,
                      FunctionType *func_type,
                      bool expansion);
+  // Optimize the programs split out of module_ in parallel, and link them
+  // back in place of the originals
+  void optimizePrograms(std::vector<std::string> &programs,
+                        int level,
+                        unsigned int max_threads);
+  // Run the BPF backend on module_, writing an ELF object
+  void emitObject(SmallVector<char, 0> &object);
+  bool runsInTracedProcess(Probe &probe);
+  void createPidFilter();
+  void createCgroupFilter();
+  int stackIdSite(const std::string &func);
   [[nodiscard]] ScopedExprDeleter accept(Node *node);
 
   Function *createLog2Function();
   Function *createLinearFunction();
+  Function *createLogLinearFunction();
+  Function *createHLLHashFunction();
   Node *root_;
   LLVMContext context_;
   std::unique_ptr<Module> module_;
-  std::unique_ptr<ExecutionEngine> ee_;
-  TargetMachine *TM_;
+  std::unique_ptr<TargetMachine> TM_;
   IRBuilderBPF b_;
   DataLayout layout_;
   Value *expr_ = nullptr;
@@ -122,6 +139,7 @@ private:
   AttachPoint *current_attach_point_ = nullptr;
   BPFtrace &bpftrace_;
   std::string probefull_;
+  std::string probe_name_;
   std::string tracepoint_struct_;
   std::map<std::string, int> next_probe_index_;
   // Used if there are duplicate USDT entries
@@ -133,12 +151,15 @@ private:
   int cat_id_ = 0;
   int strftime_id_ = 0;
   uint64_t join_id_ = 0;
+  int sampling_id_ = 0;
+  int stackid_site_id_ = 0;
   int system_id_ = 0;
   int non_map_print_id_ = 0;
 
   Function *linear_func_ = nullptr;
   Function *log2_func_ = nullptr;
-  std::unique_ptr<BpfOrc> orc_;
+  Function *loglinear_func_ = nullptr;
+  Function *hll_hash_func_ = nullptr;
 
   size_t getStructSize(StructType *s)
   {
@@ -64,6 +64,11 @@ void FieldAnalyser::visit(Builtin &builtin)
   else if (builtin.ident == "args")
   {
     has_builtin_args_ = true;
+    if (!args_error_.empty())
+    {
+      LOG(ERROR, builtin.loc, err_) << args_error_;
+      args_error_.clear();
+    }
   }
   else if (builtin.ident == "retval")
   {
@@ -256,7 +261,14 @@ bool FieldAnalyser::compare_args(const std::map<std::string, SizedType>& args1,
 bool FieldAnalyser::resolve_args(AttachPoint &ap)
 {
   bool kretfunc = ap.provider == "kretfunc";
-  std::string func = ap.func;
+  bool rawtracepoint = probetype(ap.provider) == ProbeType::rawtracepoint;
+  auto resolve = [&](const std::string &func,
+                     std::map<std::string, SizedType> &args) {
+    if (rawtracepoint)
+      bpftrace_.btf_.resolve_raw_tracepoint_args(func, args);
+    else
+      bpftrace_.btf_.resolve_args(func, args, kretfunc);
+  };
 
   // load AP arguments into ap_args_
   ap_args_.clear();
@@ -293,11 +305,14 @@ bool FieldAnalyser::resolve_args(AttachPoint &ap)
       // other functions.
       try
       {
-        bpftrace_.btf_.resolve_args(func, first ? ap_args_ : args, kretfunc);
+        resolve(func, first ? ap_args_ : args);
       }
       catch (const std::runtime_error &e)
       {
-        LOG(WARNING) << "kfunc:" << ap.func << ": " << e.what();
+        if (rawtracepoint)
+          args_error_ = ap.provider + ":" + func + ": " + e.what();
+        else
+          LOG(WARNING) << ap.provider << ":" << ap.func << ": " << e.what();
         continue;
       }
 
@@ -310,17 +325,28 @@ bool FieldAnalyser::resolve_args(AttachPoint &ap)
 
       first = false;
     }
+
+    if (rawtracepoint)
+    {
+      if (first)
+        return false;
+      args_error_.clear();
+    }
   }
   else
   {
     // Resolving args for an explicit function failed, print an error and fail
     try
     {
-      bpftrace_.btf_.resolve_args(ap.func, ap_args_, kretfunc);
+      resolve(ap.func, ap_args_);
     }
     catch (const std::runtime_error &e)
     {
-      LOG(ERROR, ap.loc, err_) << "kfunc:" << ap.func << ": " << e.what();
+      if (rawtracepoint)
+        args_error_ = ap.provider + ":" + ap.func + ": " + e.what();
+      else
+        LOG(ERROR, ap.loc, err_)
+            << ap.provider << ":" << ap.func << ": " << e.what();
       return false;
     }
   }
@@ -348,7 +374,12 @@ bool FieldAnalyser::resolve_args(AttachPoint &ap)
 
 void FieldAnalyser::visit(AttachPoint &ap)
 {
-  if (ap.provider == "kfunc" || ap.provider == "kretfunc")
+  // Raw tracepoints get typed arguments only with BTF, their argN builtins
+  // work without it. Not finding the arguments in BTF, as for module
+  // tracepoints or kernels without btf_trace_ typedefs, is only an error once
+  // args is used.
+  if (ap.provider == "kfunc" || ap.provider == "kretfunc" ||
+      (ap.provider == "rawtracepoint" && bpftrace_.btf_.has_data()))
   {
     has_kfunc_probe_ = true;
 
@@ -373,6 +404,7 @@ void FieldAnalyser::visit(Probe &probe)
 {
   has_kfunc_probe_ = false;
   has_mixed_args_ = false;
+  args_error_.clear();
   probe_ = &probe;
 
   for (auto &ap : *probe.attach_points)
@@ -66,6 +66,9 @@ private:
   bool           has_kfunc_probe_;
   Probe         *probe_;
   location       mixed_args_loc_;
+  // Why the typed arguments of a rawtracepoint probe could not be resolved,
+  // reported if the probe uses args
+  std::string    args_error_;
 
   std::ostream       &out_;
   std::ostringstream  err_;
@@ -1,3 +1,5 @@
+#include <cerrno>
+#include <cstddef>
 #include <iostream>
 #include <sstream>
 
@@ -321,6 +323,36 @@ CallInst *IRBuilderBPF::CreateGetJoinMap(Value *ctx, const location &loc)
   return call;
 }
 
+CallInst *IRBuilderBPF::CreateGetSamplingSlot(Value *ctx,
+                                              int site,
+                                              const location &loc)
+{
+  AllocaInst *key = CreateAllocaBPF(getInt32Ty(), "sampling_key");
+  CreateStore(getInt32(site), key);
+
+  CallInst *call = createMapLookup(
+      bpftrace_.maps[MapManager::Type::Sampling].value()->mapfd_, key);
+  CreateHelperErrorCond(ctx, call, libbpf::BPF_FUNC_map_lookup_elem, loc, true);
+  CreateLifetimeEnd(key);
+  return call;
+}
+
+// Returns a pointer to the value stored under the pid in key, or NULL if the
+// pid is not traced
+CallInst *IRBuilderBPF::CreatePidFilterLookup(AllocaInst *key)
+{
+  return createMapLookup(
+      bpftrace_.maps[MapManager::Type::PidFilter].value()->mapfd_, key);
+}
+
+// Returns a pointer to the value stored under the cgroup id in key, or NULL
+// if the cgroup is not traced
+CallInst *IRBuilderBPF::CreateCgroupFilterLookup(AllocaInst *key)
+{
+  return createMapLookup(
+      bpftrace_.maps[MapManager::Type::CgroupFilter].value()->mapfd_, key);
+}
+
 Value *IRBuilderBPF::CreateMapLookupElem(Value *ctx,
                                          Map &map,
                                          AllocaInst *key,
@@ -383,13 +415,64 @@ Value *IRBuilderBPF::CreateMapLookupElem(Value *ctx,
   return ret;
 }
 
+// Returns a pointer to the value stored under key, for updating it in place.
+// A zeroed value is inserted first if the key is not in the map yet. The
+// pointer is NULL if the value could not be inserted, e.g. the map is full.
+Value *IRBuilderBPF::CreateMapLookupOrInitElemPtr(Value *ctx,
+                                                  Map &map,
+                                                  AllocaInst *key,
+                                                  const location &loc)
+{
+  int mapfd = bpftrace_.maps[map.ident].value()->mapfd_;
+  CallInst *call = createMapLookup(mapfd, key);
+
+  Function *parent = GetInsertBlock()->getParent();
+  BasicBlock *lookup_init_block = BasicBlock::Create(module_.getContext(),
+                                                     "lookup_init",
+                                                     parent);
+  BasicBlock *lookup_merge_block = BasicBlock::Create(module_.getContext(),
+                                                      "lookup_init_merge",
+                                                      parent);
+
+  AllocaInst *ptr = CreateAllocaBPF(getInt8PtrTy(), "lookup_elem_ptr");
+  CreateStore(call, ptr);
+  Value *condition = CreateICmpNE(
+      CreateIntCast(call, getInt8PtrTy(), true),
+      ConstantExpr::getCast(Instruction::IntToPtr, getInt64(0), getInt8PtrTy()),
+      "map_lookup_cond");
+  CreateCondBr(condition, lookup_merge_block, lookup_init_block);
+
+  SetInsertPoint(lookup_init_block);
+  AllocaInst *zero = CreateAllocaBPF(map.type.size, map.ident + "_init");
+  CREATE_MEMSET(zero, getInt8(0), map.type.size, 1);
+  CreateMapUpdateElem(ctx, map, key, zero, loc);
+  CreateLifetimeEnd(zero);
+  CreateStore(createMapLookup(mapfd, key), ptr);
+  CreateBr(lookup_merge_block);
+
+  SetInsertPoint(lookup_merge_block);
+  Value *ret = CreateLoad(ptr);
+  CreateLifetimeEnd(ptr);
+  return ret;
+}
+
 void IRBuilderBPF::CreateMapUpdateElem(Value *ctx,
                                        Map &map,
                                        AllocaInst *key,
                                        Value *val,
                                        const location &loc)
 {
-  Value *map_ptr = CreateBpfPseudoCall(map);
+  int mapfd = bpftrace_.maps[map.ident].value()->mapfd_;
+  CreateMapUpdateElem(ctx, mapfd, key, val, loc);
+}
+
+void IRBuilderBPF::CreateMapUpdateElem(Value *ctx,
+                                       int mapfd,
+                                       AllocaInst *key,
+                                       Value *val,
+                                       const location &loc)
+{
+  Value *map_ptr = CreateBpfPseudoCall(mapfd);
 
   assert(ctx && ctx->getType() == getInt8PtrTy());
   assert(key->getType()->isPointerTy());
@@ -918,6 +1001,7 @@ CallInst *IRBuilderBPF::CreateGetRandom()
 CallInst *IRBuilderBPF::CreateGetStackId(Value *ctx,
                                          bool ustack,
                                          StackType stack_type,
+                                         int site,
                                          const location &loc)
 {
   assert(ctx && ctx->getType() == getInt8PtrTy());
@@ -928,6 +1012,10 @@ CallInst *IRBuilderBPF::CreateGetStackId(Value *ctx,
   int flags = 0;
   if (ustack)
     flags |= (1<<8);
+  // BPF_F_REUSE_STACKID: replace the stack stored under a colliding id
+  // instead of failing with -EEXIST
+  if (bpftrace_.stack_reuse_ids_)
+    flags |= (1<<10);
   Value *flags_val = getInt64(flags);
 
   // int bpf_get_stackid(struct pt_regs *ctx, struct bpf_map *map, u64 flags)
@@ -945,9 +1033,52 @@ CallInst *IRBuilderBPF::CreateGetStackId(Value *ctx,
                               { ctx, map_ptr, flags_val },
                               "get_stackid");
   CreateHelperErrorCond(ctx, call, libbpf::BPF_FUNC_get_stackid, loc);
+  CreateStackIdErrorCount(call, site);
   return call;
 }
 
+// Count a failed get_stackid() in the per-CPU slot of its call site, so
+// collisions and full stack maps can be reported on exit
+void IRBuilderBPF::CreateStackIdErrorCount(Value *return_value, int site)
+{
+  Function *parent = GetInsertBlock()->getParent();
+  BasicBlock *failure_block = BasicBlock::Create(module_.getContext(),
+                                                 "get_stackid_failure",
+                                                 parent);
+  BasicBlock *count_block = BasicBlock::Create(module_.getContext(),
+                                               "get_stackid_count",
+                                               parent);
+  BasicBlock *merge_block = BasicBlock::Create(module_.getContext(),
+                                               "get_stackid_merge",
+                                               parent);
+  auto *ret = CreateIntCast(return_value, getInt32Ty(), true);
+  CreateCondBr(CreateICmpSGE(ret, getInt32(0)), merge_block, failure_block);
+
+  SetInsertPoint(failure_block);
+  AllocaInst *key = CreateAllocaBPF(getInt32Ty(), "stackid_errors_key");
+  CreateStore(getInt32(site), key);
+  CallInst *slot = createMapLookup(
+      bpftrace_.maps[MapManager::Type::StackIdErrors].value()->mapfd_, key);
+  CreateLifetimeEnd(key);
+  CreateCondBr(CreateIsNotNull(slot), count_block, merge_block);
+
+  SetInsertPoint(count_block);
+  Value *fields = CreatePointerCast(slot, getInt64Ty()->getPointerTo());
+  Value *is_collision = CreateICmpEQ(ret, getInt32(-EEXIST));
+  Value *is_full = CreateICmpEQ(ret, getInt32(-ENOMEM));
+  Value *index = CreateSelect(is_full,
+                              getInt64(offsetof(StackIdErrors, full) / 8),
+                              getInt64(offsetof(StackIdErrors, other) / 8));
+  index = CreateSelect(is_collision,
+                       getInt64(offsetof(StackIdErrors, collisions) / 8),
+                       index);
+  Value *counter = CreateGEP(fields, index);
+  CreateStore(CreateAdd(CreateLoad(counter), getInt64(1)), counter);
+  CreateBr(merge_block);
+
+  SetInsertPoint(merge_block);
+}
+
 void IRBuilderBPF::CreateGetCurrentComm(Value *ctx,
                                         AllocaInst *buf,
                                         size_t size,
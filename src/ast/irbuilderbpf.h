@@ -65,11 +65,20 @@ public:
                              AllocaInst *key,
                              SizedType &type,
                              const location &loc);
+  Value *CreateMapLookupOrInitElemPtr(Value *ctx,
+                                      Map &map,
+                                      AllocaInst *key,
+                                      const location &loc);
   void CreateMapUpdateElem(Value *ctx,
                            Map &map,
                            AllocaInst *key,
                            Value *val,
                            const location &loc);
+  void CreateMapUpdateElem(Value *ctx,
+                           int mapfd,
+                           AllocaInst *key,
+                           Value *val,
+                           const location &loc);
   void CreateMapDeleteElem(Value *ctx,
                            Map &map,
                            AllocaInst *key,
@@ -147,8 +156,12 @@ public:
   CallInst   *CreateGetCpuId();
   CallInst   *CreateGetCurrentTask();
   CallInst   *CreateGetRandom();
-  CallInst   *CreateGetStackId(Value *ctx, bool ustack, StackType stack_type, const location& loc);
+  CallInst   *CreateGetStackId(Value *ctx, bool ustack, StackType stack_type, int site, const location& loc);
+  void        CreateStackIdErrorCount(Value *return_value, int site);
   CallInst   *CreateGetJoinMap(Value *ctx, const location& loc);
+  CallInst   *CreateGetSamplingSlot(Value *ctx, int site, const location& loc);
+  CallInst   *CreatePidFilterLookup(AllocaInst *key);
+  CallInst   *CreateCgroupFilterLookup(AllocaInst *key);
   CallInst   *createCall(Value *callee, ArrayRef<Value *> args, const Twine &Name);
   void        CreateGetCurrentComm(Value *ctx, AllocaInst *buf, size_t size, const location& loc);
   void        CreatePerfEventOutput(Value *ctx, Value *data, size_t size);
@@ -0,0 +1,29 @@
+#include "pid_filter_fork.h"
+#include "parser.tab.hh"
+
+namespace bpftrace {
+namespace ast {
+
+void add_pid_filter_fork_probe(Program &program)
+{
+  auto attach_points = std::make_unique<AttachPointList>();
+  attach_points->push_back(
+      std::make_unique<AttachPoint>("tracepoint:sched:sched_process_fork"));
+
+  auto vargs = std::make_unique<ExpressionList>();
+  // args->child_pid
+  vargs->push_back(std::make_unique<FieldAccess>(
+      std::make_unique<Unop>(bpftrace::Parser::token::MUL,
+                             std::make_unique<Builtin>("args"),
+                             false),
+      "child_pid"));
+  auto stmts = std::make_unique<StatementList>();
+  stmts->push_back(std::make_unique<ExprStatement>(
+      std::make_unique<Call>("pid_filter_add", std::move(vargs))));
+
+  program.probes->push_back(std::make_unique<Probe>(
+      std::move(attach_points), nullptr, std::move(stmts)));
+}
+
+} // namespace ast
+} // namespace bpftrace
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "ast.h"
+
+namespace bpftrace {
+namespace ast {
+
+// Add the probe following the forks of the traced processes for
+// --follow-forks:
+//
+//   tracepoint:sched:sched_process_fork { pid_filter_add(args->child_pid) }
+//
+// The tracepoint runs in the context of the parent, so the pid filter of the
+// probe only lets the forks of traced processes through. args is resolved
+// like in any other tracepoint probe, from BTF or the format file.
+void add_pid_filter_fork_probe(Program &program);
+
+} // namespace ast
+} // namespace bpftrace
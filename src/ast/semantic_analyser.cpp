@@ -33,6 +33,19 @@ static const std::map<std::string, std::tuple<size_t, bool>>& getIntcasts() {
   return intcasts;
 }
 
+// Precision of an llhist() or quantiles() call: the literal second argument,
+// if given
+static int64_t loglinear_bits(const ExpressionList &vargs,
+                              int64_t default_bits)
+{
+  if (vargs.size() > 1)
+  {
+    if (auto *bits = dynamic_cast<Integer *>(vargs.at(1).get()))
+      return bits->n;
+  }
+  return default_bits;
+}
+
 void SemanticAnalyser::visit(Integer &integer)
 {
   integer.type = CreateInt64();
@@ -101,6 +114,8 @@ void SemanticAnalyser::visit(StackMode &mode)
     mode.type.stack_type.mode = bpftrace::StackMode::bpftrace;
   } else if (mode.mode == "perf") {
     mode.type.stack_type.mode = bpftrace::StackMode::perf;
+  } else if (mode.mode == "build_id") {
+    mode.type.stack_type.mode = bpftrace::StackMode::build_id;
   } else {
     mode.type = CreateNone();
     LOG(ERROR, mode.loc, err_) << "Unknown stack mode: '" + mode.mode + "'";
@@ -264,10 +279,14 @@ void SemanticAnalyser::visit(Builtin &builtin)
   else if (builtin.ident == "kstack") {
     builtin.type = CreateStack(true, StackType());
     needs_stackid_maps_.insert(builtin.type.stack_type);
+    if (is_final_pass())
+      bpftrace_.stackid_sites_.push_back("kstack in " + probe_->name());
   }
   else if (builtin.ident == "ustack") {
     builtin.type = CreateStack(false, StackType());
     needs_stackid_maps_.insert(builtin.type.stack_type);
+    if (is_final_pass())
+      bpftrace_.stackid_sites_.push_back("ustack in " + probe_->name());
   }
   else if (builtin.ident == "comm") {
     builtin.type = CreateString(COMM_SIZE);
@@ -294,13 +313,22 @@ void SemanticAnalyser::visit(Builtin &builtin)
       ProbeType type = probetype(attach_point->provider);
       if (type != ProbeType::kprobe &&
           type != ProbeType::uprobe &&
-          type != ProbeType::usdt)
+          type != ProbeType::usdt &&
+          type != ProbeType::rawtracepoint)
         LOG(ERROR, builtin.loc, err_)
             << "The " << builtin.ident << " builtin can only be used with "
-            << "'kprobes', 'uprobes' and 'usdt' probes";
+            << "'kprobes', 'uprobes', 'usdt' and 'rawtracepoint' probes";
     }
     int arg_num = atoi(builtin.ident.substr(3).c_str());
-    if (arg_num > arch::max_arg())
+    // Raw tracepoints get their arguments in an array, not in registers
+    if (single_provider_type() == ProbeType::rawtracepoint)
+    {
+      if (!ap_args_.empty() && arg_num >= static_cast<int>(ap_args_.size()))
+        LOG(ERROR, builtin.loc, err_)
+            << probe_->name() << " has only " << ap_args_.size()
+            << " arguments";
+    }
+    else if (arg_num > arch::max_arg())
       LOG(ERROR, builtin.loc, err_)
           << arch::name() << " doesn't support " << builtin.ident;
     builtin.type = CreateUInt64();
@@ -358,8 +386,13 @@ void SemanticAnalyser::visit(Builtin &builtin)
     {
       // no special action in here
     }
-    else if (type == ProbeType::kfunc || type == ProbeType::kretfunc)
+    else if (type == ProbeType::kfunc || type == ProbeType::kretfunc ||
+             type == ProbeType::rawtracepoint)
     {
+      if (type == ProbeType::rawtracepoint && !bpftrace_.btf_.has_data())
+        LOG(ERROR, builtin.loc, err_)
+            << "The args builtin needs BTF with rawtracepoint probes, use "
+            << "arg0, arg1, ... instead";
       builtin.type = CreatePointer(CreateRecord(0, "struct kfunc"));
       builtin.type.MarkCtxAccess();
       builtin.type.is_kfarg = true;
@@ -367,8 +400,9 @@ void SemanticAnalyser::visit(Builtin &builtin)
     else
     {
       LOG(ERROR, builtin.loc, err_)
-          << "The args builtin can only be used with tracepoint/kfunc probes ("
-          << probetypeName(type) << " used here)";
+          << "The args builtin can only be used with "
+          << "tracepoint/kfunc/rawtracepoint probes (" << probetypeName(type)
+          << " used here)";
     }
   }
   else {
@@ -413,6 +447,9 @@ void SemanticAnalyser::visit(Call &call)
     {
       auto &expr = (*call.vargs)[i];
       func_arg_idx_ = i;
+      map_ref_ = i == 0 && expr->is_map &&
+                 (call.func == "print" || call.func == "clear" ||
+                  call.func == "zero" || call.func == "delete");
       expr->accept(*this);
     }
   }
@@ -481,12 +518,70 @@ void SemanticAnalyser::visit(Call &call)
     }
     call.type = CreateLhist();
   }
+  else if (call.func == "llhist" || call.func == "quantiles") {
+    check_assignment(call, true, false, false);
+    if (check_varargs(call, 1, 2))
+    {
+      check_arg(call, Type::integer, 0);
+      if (call.vargs->size() > 1)
+        check_arg(call, Type::integer, 1, true);
+    }
+
+    int64_t default_bits = call.func == "llhist" ? LLHIST_DEFAULT_BITS
+                                                 : QUANTILES_DEFAULT_BITS;
+    if (is_final_pass() && call.vargs)
+    {
+      int64_t bits = loglinear_bits(*call.vargs, default_bits);
+      if (bits < 0 || bits > LOGLINEAR_MAX_BITS)
+      {
+        LOG(ERROR, call.loc, err_)
+            << call.func << "() precision must be between 0 and "
+            << LOGLINEAR_MAX_BITS << " (" << bits << " provided)";
+      }
+    }
+
+    if (is_final_pass() && call.vargs && call.map)
+    {
+      // store args for later passing to bpftrace::Map
+      auto search = map_args_.find(call.map->ident);
+      if (search == map_args_.end())
+        map_args_.insert({ call.map->ident, call.vargs.get() });
+      else if (loglinear_bits(*search->second, default_bits) !=
+               loglinear_bits(*call.vargs, default_bits))
+      {
+        LOG(ERROR, call.loc, err_)
+            << call.func << "() precision must be the same for all uses of "
+            << call.map->ident << " ("
+            << loglinear_bits(*search->second, default_bits) << " and "
+            << loglinear_bits(*call.vargs, default_bits) << " provided)";
+      }
+    }
+    if (call.func == "llhist")
+      call.type = CreateLLhist();
+    else
+      call.type = CreateQuantiles();
+  }
   else if (call.func == "count") {
     check_assignment(call, true, false, false);
     check_nargs(call, 0);
 
     call.type = CreateCount(true);
   }
+  else if (call.func == "count_distinct") {
+    check_assignment(call, true, false, false);
+    if (check_nargs(call, 1) && is_final_pass())
+    {
+      auto &arg = *call.vargs->at(0);
+      if (!(arg.type.IsIntTy() || arg.type.IsStringTy()))
+      {
+        LOG(ERROR, call.loc, err_)
+            << "count_distinct() only supports int or string arguments"
+            << " (" << arg.type.type << " provided)";
+      }
+    }
+
+    call.type = CreateCountDistinct();
+  }
   else if (call.func == "sum") {
     bool sign = false;
     check_assignment(call, true, false, false);
@@ -785,6 +880,28 @@ void SemanticAnalyser::visit(Call &call)
     }
     call.type = CreateUInt64();
   }
+  else if (call.func == "sample" || call.func == "ratelimit")
+  {
+    call.type = CreateUInt64();
+    if (!check_nargs(call, 1) || !check_arg(call, Type::integer, 0, true))
+      return;
+
+    auto &rate = static_cast<Integer &>(*call.vargs->at(0)).n;
+    if (rate < 1 || rate > SAMPLING_MAX_RATE)
+    {
+      LOG(ERROR, call.loc, err_)
+          << call.func << "() argument must be between 1 and "
+          << SAMPLING_MAX_RATE << " (" << rate << " provided)";
+      return;
+    }
+
+    // each call site gets its own slot in the sampling map, in the order
+    // codegen visits them
+    if (is_final_pass())
+      bpftrace_.sampling_sites_.push_back(call.func + "(" +
+                                          std::to_string(rate) + ") in " +
+                                          probe_->name());
+  }
   else if (call.func == "printf" || call.func == "system" || call.func == "cat")
   {
     check_assignment(call, false, false, false);
@@ -1070,6 +1187,14 @@ void SemanticAnalyser::visit(Call &call)
     call.type = call.vargs->front()->type;
     call.type.SetAS(as);
   }
+  else if (call.func == "pid_filter_add" && bpftrace_.pid_filter_follow_forks_)
+  {
+    // only called by the probe added for --follow-forks, see
+    // add_pid_filter_fork_probe()
+    if (check_nargs(call, 1))
+      check_arg(call, Type::integer, 0);
+    call.type = CreateNone();
+  }
   else
   {
     LOG(ERROR, call.loc, err_) << "Unknown function: '" << call.func << "'";
@@ -1124,14 +1249,24 @@ void SemanticAnalyser::check_stack_call(Call &call, bool kernel)
           << call.func << "([int limit]): limit shouldn't exceed "
           << MAX_STACK_SIZE << ", " << stack_type.limit << " given";
     }
+    if (kernel && stack_type.mode == bpftrace::StackMode::build_id)
+    {
+      LOG(ERROR, call.loc, err_)
+          << "build_id stack mode is only supported by ustack";
+    }
     call.type = CreateStack(kernel, stack_type);
     needs_stackid_maps_.insert(stack_type);
+    // Only reached on the final pass, so there is one site per call, as
+    // for the kstack and ustack builtins
+    bpftrace_.stackid_sites_.push_back(call.func + "() in " + probe_->name());
   }
 }
 
 void SemanticAnalyser::visit(Map &map)
 {
   MapKey key;
+  bool is_ref = map_ref_;
+  map_ref_ = false;
 
   if (map.vargs) {
     for (unsigned int i = 0; i < map.vargs->size(); i++){
@@ -1197,6 +1332,9 @@ void SemanticAnalyser::visit(Map &map)
     }
   }
 
+  if (!is_final_pass())
+    map_probes_[map.ident].insert(probe_idx_);
+
   auto search_val = map_val_.find(map.ident);
   if (search_val != map_val_.end()) {
     map.type = search_val->second;
@@ -1207,6 +1345,15 @@ void SemanticAnalyser::visit(Map &map)
     }
     map.type = CreateNone();
   }
+
+  // A count_distinct() value is the whole HyperLogLog register array, which
+  // only the runtime turns into an estimate
+  if (is_final_pass() && !is_ref && map.type.IsCountDistinctTy())
+  {
+    LOG(ERROR, map.loc, err_)
+        << "The value of count_distinct() map " << map.ident
+        << " cannot be read in a probe, it can only be printed";
+  }
 }
 
 void SemanticAnalyser::visit(Variable &var)
@@ -1768,6 +1915,7 @@ void SemanticAnalyser::visit(ExprStatement &expr)
 
 void SemanticAnalyser::visit(AssignMapStatement &assignment)
 {
+  map_ref_ = true;
   assignment.map->accept(*this);
   assignment.expr->accept(*this);
 
@@ -2218,6 +2366,24 @@ void SemanticAnalyser::visit(AttachPoint &ap)
       LOG(ERROR, ap.loc, err_) << "Failed to resolve kfunc args.";
     }
   }
+  else if (ap.provider == "rawtracepoint")
+  {
+    if (ap.func == "")
+      LOG(ERROR, ap.loc, err_) << "rawtracepoint probe must have an event";
+
+    if (!feature_.has_prog_raw_tracepoint())
+    {
+      LOG(ERROR, ap.loc, err_)
+          << "rawtracepoint not available for your kernel version.";
+      return;
+    }
+
+    // Typed arguments, if FieldAnalyser could read them from BTF
+    ap_args_.clear();
+    auto it = bpftrace_.btf_ap_args_.find(probe_->name());
+    if (it != bpftrace_.btf_ap_args_.end())
+      ap_args_.insert(it->second.begin(), it->second.end());
+  }
   else {
     LOG(ERROR, ap.loc, err_) << "Invalid provider: '" << ap.provider << "'";
   }
@@ -2244,13 +2410,25 @@ void SemanticAnalyser::visit(Probe &probe)
 
 void SemanticAnalyser::visit(Program &program)
 {
-  for (auto &probe : *program.probes)
-    probe->accept(*this);
+  // The first and final passes visit every probe. In between, only the
+  // probes referencing maps whose type changed since they were last visited
+  // can see new types.
+  if (pass_ == 1)
+    pending_probes_.assign(program.probes->size(), true);
+
+  for (size_t i = 0; i < program.probes->size(); i++)
+  {
+    if (!is_final_pass() && !pending_probes_[i])
+      continue;
+    pending_probes_[i] = false;
+    probe_idx_ = i;
+    program.probes->at(i)->accept(*this);
+  }
 }
 
 int SemanticAnalyser::analyse()
 {
-  // Multiple passes to handle variables being used before they are defined
+  // Multiple passes to handle maps being used before they are assigned
   std::string errors;
 
   for (pass_ = 1; pass_ <= num_passes_; pass_++) {
@@ -2260,6 +2438,13 @@ int SemanticAnalyser::analyse()
       out_ << errors;
       return pass_;
     }
+
+    // Once types stop changing, only the final checks are left
+    if (!is_final_pass() &&
+        std::none_of(pending_probes_.begin(),
+                     pending_probes_.end(),
+                     [](bool pending) { return pending; }))
+      pass_ = num_passes_ - 1;
   }
 
   return 0;
@@ -2282,10 +2467,46 @@ int SemanticAnalyser::create_maps_impl(void)
 {
   uint32_t failed_maps = 0;
   auto is_invalid_map = [](int a) -> uint8_t { return a < 0 ? 1 : 0; };
+
+  auto warn_unused = [this](const std::string &env_var,
+                            const std::string &map_name) {
+    if (map_val_.find(map_name) == map_val_.end())
+      LOG(WARNING) << env_var << ": map " << map_name
+                   << " is not used by the program";
+  };
+  for (auto &map_size : bpftrace_.map_sizes_)
+    warn_unused("BPFTRACE_MAP_SIZES", map_size.first);
+  for (auto &map_name : bpftrace_.lru_maps_)
+    warn_unused("BPFTRACE_LRU_MAPS", map_name);
+  for (auto &map_name : bpftrace_.no_prealloc_maps_)
+  {
+    warn_unused("BPFTRACE_NO_PREALLOC_MAPS", map_name);
+    if (bpftrace_.lru_maps_.count(map_name))
+      LOG(WARNING) << "BPFTRACE_NO_PREALLOC_MAPS: LRU map " << map_name
+                   << " is always preallocated";
+  }
+  if (!bpftrace_.lru_maps_.empty() && !feature_.has_map_lru_hash())
+  {
+    LOG(ERROR) << "BPFTRACE_LRU_MAPS: LRU maps are not supported by the kernel";
+    return 1;
+  }
+  if (bpftrace_.cgroup_filter_ && !feature_.has_helper_get_current_cgroup_id())
+  {
+    LOG(ERROR) << "--cgroups: BPF_FUNC_get_current_cgroup_id is not available "
+                  "for your kernel version";
+    return 1;
+  }
+
   for (auto &map_val : map_val_)
   {
     std::string map_name = map_val.first;
     SizedType type = map_val.second;
+    int max_entries = bpftrace_.mapmax_;
+    auto map_size = bpftrace_.map_sizes_.find(map_name);
+    if (map_size != bpftrace_.map_sizes_.end())
+      max_entries = map_size->second;
+    bool lru = bpftrace_.lru_maps_.count(map_name) > 0;
+    bool no_prealloc = bpftrace_.no_prealloc_maps_.count(map_name) > 0;
 
     auto search_args = map_key_.find(map_name);
     if (search_args == map_key_.end())
@@ -2311,14 +2532,39 @@ int SemanticAnalyser::create_maps_impl(void)
       Integer &min = static_cast<Integer &>(min_arg);
       Integer &max = static_cast<Integer &>(max_arg);
       Integer &step = static_cast<Integer &>(step_arg);
+      auto map = std::make_unique<T>(map_name,
+                                     type,
+                                     key,
+                                     min.n,
+                                     max.n,
+                                     step.n,
+                                     max_entries,
+                                     lru,
+                                     no_prealloc);
+      failed_maps += is_invalid_map(map->mapfd_);
+      bpftrace_.maps.Add(std::move(map));
+    }
+    else if (type.IsLLhistTy() || type.IsQuantilesTy())
+    {
+      auto map_args = map_args_.find(map_name);
+      if (map_args == map_args_.end())
+      {
+        out_ << "map arg \"" << map_name << "\" not found" << std::endl;
+        abort();
+      }
+
       auto map = std::make_unique<T>(
-          map_name, type, key, min.n, max.n, step.n, bpftrace_.mapmax_);
+          map_name, type, key, max_entries, lru, no_prealloc);
+      map->llbits = loglinear_bits(*map_args->second,
+                                   type.IsLLhistTy() ? LLHIST_DEFAULT_BITS
+                                                     : QUANTILES_DEFAULT_BITS);
       failed_maps += is_invalid_map(map->mapfd_);
       bpftrace_.maps.Add(std::move(map));
     }
     else
     {
-      auto map = std::make_unique<T>(map_name, type, key, bpftrace_.mapmax_);
+      auto map = std::make_unique<T>(
+          map_name, type, key, max_entries, lru, no_prealloc);
       failed_maps += is_invalid_map(map->mapfd_);
       bpftrace_.maps.Add(std::move(map));
     }
@@ -2328,10 +2574,24 @@ int SemanticAnalyser::create_maps_impl(void)
     // The stack type doesn't matter here, so we use kstack to force SizedType
     // to set stack_size.
 
-    auto map = std::make_unique<T>(CreateStack(true, stack_type));
+    auto map = std::make_unique<T>(CreateStack(true, stack_type),
+                                   bpftrace_.stack_max_);
     failed_maps += is_invalid_map(map->mapfd_);
     bpftrace_.maps.Set(stack_type, std::move(map));
   }
+  if (!bpftrace_.stackid_sites_.empty())
+  {
+    // per-CPU get_stackid() failure counters, one per call site
+    std::string map_ident = "stackid_errors";
+    SizedType type = CreateStackIdErrors();
+    MapKey key;
+    auto map = std::make_unique<T>(map_ident,
+                                   type,
+                                   key,
+                                   bpftrace_.stackid_sites_.size());
+    failed_maps += is_invalid_map(map->mapfd_);
+    bpftrace_.maps.Set(MapManager::Type::StackIdErrors, std::move(map));
+  }
 
   if (needs_join_map_)
   {
@@ -2345,6 +2605,46 @@ int SemanticAnalyser::create_maps_impl(void)
     failed_maps += is_invalid_map(map->mapfd_);
     bpftrace_.maps.Set(MapManager::Type::Join, std::move(map));
   }
+  if (bpftrace_.pid_filter_.size() > 1 || bpftrace_.pid_filter_follow_forks_)
+  {
+    // traced pids, looked up by every probe. Forked children are added in
+    // the kernel, so the map must have room for them.
+    std::string map_ident = "pid_filter";
+    SizedType type = CreateUInt64();
+    MapKey key;
+    key.args_.push_back(CreateUInt64());
+    int max_entries = bpftrace_.pid_filter_follow_forks_
+                          ? std::max<uint64_t>(bpftrace_.mapmax_,
+                                               bpftrace_.pid_filter_.size())
+                          : bpftrace_.pid_filter_.size();
+    auto map = std::make_unique<T>(map_ident, type, key, max_entries);
+    failed_maps += is_invalid_map(map->mapfd_);
+    bpftrace_.maps.Set(MapManager::Type::PidFilter, std::move(map));
+  }
+  if (bpftrace_.cgroup_filter_)
+  {
+    // cgroup ids kept in sync with the cgroups matching --cgroups
+    std::string map_ident = "cgroup_filter";
+    SizedType type = CreateUInt64();
+    MapKey key;
+    key.args_.push_back(CreateUInt64());
+    auto map = std::make_unique<T>(map_ident, type, key, bpftrace_.mapmax_);
+    failed_maps += is_invalid_map(map->mapfd_);
+    bpftrace_.maps.Set(MapManager::Type::CgroupFilter, std::move(map));
+  }
+  if (!bpftrace_.sampling_sites_.empty())
+  {
+    // per-CPU drop counters and ratelimit() token buckets, one per call site
+    std::string map_ident = "sampling";
+    SizedType type = CreateSampling();
+    MapKey key;
+    auto map = std::make_unique<T>(map_ident,
+                                   type,
+                                   key,
+                                   bpftrace_.sampling_sites_.size());
+    failed_maps += is_invalid_map(map->mapfd_);
+    bpftrace_.maps.Set(MapManager::Type::Sampling, std::move(map));
+  }
   if (needs_elapsed_map_)
   {
     std::string map_ident = "elapsed";
@@ -2576,6 +2876,8 @@ void SemanticAnalyser::assign_map_type(const Map &map, const SizedType &type)
       }
       else {
         search->second = type;
+        if (!type.IsNoneTy())
+          map_type_changed(map_ident);
       }
     }
     else if (search->second.type != type.type) {
@@ -2588,6 +2890,8 @@ void SemanticAnalyser::assign_map_type(const Map &map, const SizedType &type)
   else {
     // This map hasn't been seen before
     map_val_.insert({map_ident, type});
+    if (!type.IsNoneTy())
+      map_type_changed(map_ident);
     if (map_val_[map_ident].IsIntTy())
     {
       // Store all integer values as 64-bit in maps, so that there will
@@ -2597,6 +2901,15 @@ void SemanticAnalyser::assign_map_type(const Map &map, const SizedType &type)
   }
 }
 
+void SemanticAnalyser::map_type_changed(const std::string &map_ident)
+{
+  auto probes = map_probes_.find(map_ident);
+  if (probes == map_probes_.end())
+    return;
+  for (auto idx : probes->second)
+    pending_probes_[idx] = true;
+}
+
 void SemanticAnalyser::accept_statements(StatementList *stmts)
 {
   for (size_t i = 0; i < stmts->size(); i++)
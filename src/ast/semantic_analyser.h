@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <set>
 #include <sstream>
 #include <unordered_set>
 
@@ -87,6 +88,8 @@ private:
   void check_stack_call(Call &call, bool kernel);
 
   void assign_map_type(const Map &map, const SizedType &type);
+  // Schedule the probes referencing a map to be visited again
+  void map_type_changed(const std::string &map_ident);
 
   void builtin_args_tracepoint(AttachPoint *attach_point, Builtin &builtin);
   ProbeType single_provider_type(void);
@@ -100,12 +103,21 @@ private:
   void accept_statements(StatementList *stmts);
 
   Probe *probe_;
+  // Index of probe_ in the program
+  size_t probe_idx_ = 0;
+  // Probes which are visited in the next pass, by index
+  std::vector<bool> pending_probes_;
+  // Probes referencing each map, by index
+  std::map<std::string, std::set<size_t>> map_probes_;
 
   // Temporarily record the function currently being visited by this SemanticAnalyser.
   std::string func_;
   // Temporarily record the function argument index currently being visited by this
   // SemanticAnalyser.
   int func_arg_idx_ = -1;
+  // Set while visiting a map that is named rather than read: the target of a
+  // map assignment or the map passed to print(), clear(), zero() or delete().
+  bool map_ref_ = false;
 
   std::map<std::string, SizedType> variable_val_;
   std::map<std::string, SizedType> map_val_;
@@ -75,6 +75,10 @@ bpf_prog_type progtype(ProbeType t)
     case ProbeType::kretfunc:
       return static_cast<enum ::bpf_prog_type>(libbpf::BPF_PROG_TYPE_TRACING);
       break;
+    case ProbeType::rawtracepoint:
+      return static_cast<enum ::bpf_prog_type>(
+          libbpf::BPF_PROG_TYPE_RAW_TRACEPOINT);
+      break;
     case ProbeType::invalid:
       LOG(FATAL) << "program type invalid";
   }
@@ -91,6 +95,10 @@ std::string progtypeName(bpf_prog_type t)
     case BPF_PROG_TYPE_TRACEPOINT: return "BPF_PROG_TYPE_TRACEPOINT"; break;
     case BPF_PROG_TYPE_PERF_EVENT: return "BPF_PROG_TYPE_PERF_EVENT"; break;
     // clang-format on
+    case static_cast<enum ::bpf_prog_type>(
+        libbpf::BPF_PROG_TYPE_RAW_TRACEPOINT):
+      return "BPF_PROG_TYPE_RAW_TRACEPOINT";
+      break;
     default:
       LOG(FATAL) << "invalid program type: " << t;
   }
@@ -133,6 +141,14 @@ int AttachedProbe::detach_kfunc(void)
 }
 #endif // HAVE_BCC_KFUNC
 
+void AttachedProbe::attach_rawtracepoint(void)
+{
+  tracing_fd_ = bpf_attach_raw_tracepoint(progfd_,
+                                          probe_.attach_point.c_str());
+  if (tracing_fd_ < 0)
+    throw std::runtime_error("Error attaching probe: " + probe_.name);
+}
+
 AttachedProbe::AttachedProbe(Probe &probe, std::tuple<uint8_t *, uintptr_t> func, bool safe_mode)
   : probe_(probe), func_(func)
 {
@@ -171,6 +187,9 @@ AttachedProbe::AttachedProbe(Probe &probe, std::tuple<uint8_t *, uintptr_t> func
     case ProbeType::kretfunc:
       attach_kfunc();
       break;
+    case ProbeType::rawtracepoint:
+      attach_rawtracepoint();
+      break;
     default:
       LOG(FATAL) << "invalid attached probe type \""
                  << probetypeName(probe_.type) << "\"";
@@ -216,6 +235,9 @@ AttachedProbe::~AttachedProbe()
     case ProbeType::kretfunc:
       err = detach_kfunc();
       break;
+    case ProbeType::rawtracepoint:
+      err = close(tracing_fd_);
+      break;
     case ProbeType::uprobe:
     case ProbeType::uretprobe:
     case ProbeType::usdt:
@@ -44,15 +44,14 @@ private:
   void attach_watchpoint(int pid, const std::string &mode);
   void attach_kfunc(void);
   int detach_kfunc(void);
+  void attach_rawtracepoint(void);
 
   Probe &probe_;
   std::tuple<uint8_t *, uintptr_t> func_;
   std::vector<int> perf_event_fds_;
   int progfd_ = -1;
   uint64_t offset_ = 0;
-#ifdef HAVE_BCC_KFUNC
   int tracing_fd_ = -1;
-#endif
   std::function<void()> usdt_destructor_;
 };
 
@@ -311,6 +311,8 @@ std::string BPFfeature::report(void)
   buf << "Map types" << std::endl
       << "  hash: " << to_str(has_map_hash())
       << "  percpu hash: " << to_str(has_map_percpu_hash())
+      << "  lru hash: " << to_str(has_map_lru_hash())
+      << "  lru percpu hash: " << to_str(has_map_lru_percpu_hash())
       << "  array: " << to_str(has_map_array())
       << "  percpu array: " << to_str(has_map_percpu_array())
       << "  stack_trace: " << to_str(has_map_stack_trace())
@@ -321,7 +323,8 @@ std::string BPFfeature::report(void)
       << "  kprobe: " << to_str(has_prog_kprobe())
       << "  tracepoint: " << to_str(has_prog_tracepoint())
       << "  perf_event: " << to_str(has_prog_perf_event())
-      << "  kfunc: " << to_str(has_prog_kfunc()) << std::endl;
+      << "  kfunc: " << to_str(has_prog_kfunc())
+      << "  rawtracepoint: " << to_str(has_prog_raw_tracepoint()) << std::endl;
 
   return buf.str();
 }
@@ -76,6 +76,8 @@ public:
   DEFINE_MAP_TEST(hash, libbpf::BPF_MAP_TYPE_HASH);
   DEFINE_MAP_TEST(percpu_array, libbpf::BPF_MAP_TYPE_PERCPU_ARRAY);
   DEFINE_MAP_TEST(percpu_hash, libbpf::BPF_MAP_TYPE_ARRAY);
+  DEFINE_MAP_TEST(lru_hash, libbpf::BPF_MAP_TYPE_LRU_HASH);
+  DEFINE_MAP_TEST(lru_percpu_hash, libbpf::BPF_MAP_TYPE_LRU_PERCPU_HASH);
   DEFINE_MAP_TEST(stack_trace, libbpf::BPF_MAP_TYPE_STACK_TRACE);
   DEFINE_MAP_TEST(perf_event_array, libbpf::BPF_MAP_TYPE_PERF_EVENT_ARRAY);
   DEFINE_HELPER_TEST(send_signal, libbpf::BPF_PROG_TYPE_KPROBE);
@@ -92,6 +94,7 @@ public:
   DEFINE_PROG_TEST(tracepoint, libbpf::BPF_PROG_TYPE_TRACEPOINT);
   DEFINE_PROG_TEST(perf_event, libbpf::BPF_PROG_TYPE_PERF_EVENT);
   DEFINE_PROG_TEST(kfunc, libbpf::BPF_PROG_TYPE_TRACING);
+  DEFINE_PROG_TEST(raw_tracepoint, libbpf::BPF_PROG_TYPE_RAW_TRACEPOINT);
 
 protected:
   std::optional<bool> has_loop_;
@@ -30,11 +30,12 @@
 
 #include "ast/async_event_types.h"
 #include "attached_probe.h"
-#include "bpforc.h"
 #include "bpftrace.h"
+#include "list.h"
 #include "log.h"
 #include "printf.h"
 #include "resolve_cgroupid.h"
+#include "sketch.h"
 #include "triggers.h"
 #include "utils.h"
 
@@ -415,6 +416,23 @@ std::set<std::string> BPFtrace::find_wildcard_matches(
       func = attach_point.func;
       break;
     }
+    case ProbeType::rawtracepoint:
+    {
+      if (btf_.has_data())
+        symbol_stream = btf_.rawtracepoints();
+      else
+      {
+        // Raw tracepoints are named as their events, without the category
+        auto events = get_symbols_from_file(
+            "/sys/kernel/debug/tracing/available_events");
+        std::string line, names;
+        while (std::getline(*events, line))
+          names += line.substr(line.find(':') + 1) + "\n";
+        symbol_stream = std::make_unique<std::istringstream>(names);
+      }
+      func = attach_point.func;
+      break;
+    }
     default:
     {
       throw WildcardException("Wildcard matches aren't available on probe type '"
@@ -477,6 +495,10 @@ std::set<std::string> BPFtrace::find_symbol_matches(
 
 std::unique_ptr<std::istream> BPFtrace::get_symbols_from_file(const std::string &path) const
 {
+  // Share the copy BTF keeps to check kfunc probes
+  if (path == kprobe_path && !btf_.traceable_funcs().empty())
+    return btf_.traceable_funcs().lines();
+
   auto file = std::make_unique<std::ifstream>(path);
   if (file->fail())
   {
@@ -929,7 +951,7 @@ std::vector<std::unique_ptr<AttachedProbe>> BPFtrace::attach_usdt_probe(
 
 std::vector<std::unique_ptr<AttachedProbe>> BPFtrace::attach_probe(
     Probe &probe,
-    const BpfOrc &bpforc)
+    const ProgramSections &sections)
 {
   std::vector<std::unique_ptr<AttachedProbe>> ret;
 
@@ -941,10 +963,10 @@ std::vector<std::unique_ptr<AttachedProbe>> BPFtrace::attach_probe(
   // and the name builtin, which must be expanded into separate programs per
   // probe), else try to find a the program based on the original probe name
   // that includes wildcards.
-  auto func = bpforc.sections_.find("s_" + probe.name + index_str);
-  if (func == bpforc.sections_.end())
-    func = bpforc.sections_.find("s_" + probe.orig_name + index_str);
-  if (func == bpforc.sections_.end())
+  auto func = sections.find("s_" + probe.name + index_str);
+  if (func == sections.end())
+    func = sections.find("s_" + probe.orig_name + index_str);
+  if (func == sections.end())
   {
     if (probe.name != probe.orig_name)
       LOG(ERROR) << "Code not generated for probe: " << probe.name
@@ -1001,6 +1023,7 @@ bool attach_reverse(const Probe &p)
     case ProbeType::kretfunc:
     case ProbeType::kretprobe:
     case ProbeType::tracepoint:
+    case ProbeType::rawtracepoint:
     case ProbeType::profile:
     case ProbeType::interval:
     case ProbeType::watchpoint:
@@ -1014,7 +1037,7 @@ bool attach_reverse(const Probe &p)
 }
 
 int BPFtrace::run_special_probe(std::string name,
-                                const BpfOrc &bpforc,
+                                const ProgramSections &sections,
                                 void (*trigger)(void))
 {
   for (auto probe = special_probes_.rbegin(); probe != special_probes_.rend();
@@ -1022,7 +1045,7 @@ int BPFtrace::run_special_probe(std::string name,
   {
     if ((*probe).attach_point == name)
     {
-      auto aps = attach_probe(*probe, bpforc);
+      auto aps = attach_probe(*probe, sections);
 
       trigger();
       return aps.size() ? 0 : -1;
@@ -1078,7 +1101,49 @@ int BPFtrace::deploy()
     }
   }
 
-  if (run_special_probe("BEGIN_trigger", *bpforc_, BEGIN_trigger))
+  if (maps.Has(MapManager::Type::PidFilter))
+  {
+    for (uint64_t pid : pid_filter_)
+    {
+      uint64_t traced = 1;
+      if (bpf_update_elem(maps[MapManager::Type::PidFilter].value()->mapfd_,
+                          &pid,
+                          &traced,
+                          0) < 0)
+      {
+        perror("Failed to write pid to pid filter map");
+        return -1;
+      }
+    }
+  }
+
+  if (cgroup_filter_)
+  {
+    try
+    {
+      cgroup_filter_->attach(
+          maps[MapManager::Type::CgroupFilter].value()->mapfd_);
+    }
+    catch (const std::runtime_error &e)
+    {
+      LOG(ERROR) << e.what();
+      return -1;
+    }
+    if (cgroup_filter_->num_cgroups() == 0)
+      LOG(WARNING) << "--cgroups: no cgroup matches yet";
+
+    // the inotify fd is told apart from the perf readers by its data
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = cgroup_filter_.get();
+    if (epoll_ctl(epollfd_, EPOLL_CTL_ADD, cgroup_filter_->fd(), &ev) == -1)
+    {
+      LOG(ERROR) << "Failed to add cgroup filter to epoll";
+      return -1;
+    }
+  }
+
+  if (run_special_probe("BEGIN_trigger", *sections_, BEGIN_trigger))
     return -1;
 
   if (child_ && has_usdt_)
@@ -1103,7 +1168,7 @@ int BPFtrace::deploy()
   for (auto probes = probes_.begin(); probes != probes_.end(); ++probes)
   {
     if (!attach_reverse(*probes)) {
-      auto aps = attach_probe(*probes, *bpforc_);
+      auto aps = attach_probe(*probes, *sections_);
 
       if (aps.empty())
         return -1;
@@ -1116,7 +1181,7 @@ int BPFtrace::deploy()
   for (auto r_probes = probes_.rbegin(); r_probes != probes_.rend(); ++r_probes)
   {
     if (attach_reverse(*r_probes)) {
-      auto aps = attach_probe(*r_probes, *bpforc_);
+      auto aps = attach_probe(*r_probes, *sections_);
 
       if (aps.empty())
         return -1;
@@ -1153,7 +1218,7 @@ int BPFtrace::finalize() {
   finalize_ = false;
   exitsig_recv = false;
 
-  if (bpforc_ != nullptr && run_special_probe("END_trigger", *bpforc_, END_trigger))
+  if (sections_ != nullptr && run_special_probe("END_trigger", *sections_, END_trigger))
     return -1;
 
   poll_perf_events(true);
@@ -1206,9 +1271,9 @@ int BPFtrace::poll_perf_events(bool drain, int timeout)
     return 1;
   }
 
-  auto events = std::vector<struct epoll_event>(online_cpus_);
+  auto events = std::vector<struct epoll_event>(online_cpus_ + 1);
 
-  int ready = epoll_wait(epollfd_, events.data(), online_cpus_, timeout);
+  int ready = epoll_wait(epollfd_, events.data(), events.size(), timeout);
   if (ready < 0 && errno == EINTR && !BPFtrace::exitsig_recv) {
     // We received an interrupt not caused by SIGINT, skip and run again
     return 0;
@@ -1225,7 +1290,10 @@ int BPFtrace::poll_perf_events(bool drain, int timeout)
 
   for (int i=0; i<ready; i++)
   {
-    perf_reader_event_read((perf_reader*)events[i].data.ptr);
+    if (cgroup_filter_ && events[i].data.ptr == cgroup_filter_.get())
+      cgroup_filter_->sync();
+    else
+      perf_reader_event_read((perf_reader*)events[i].data.ptr);
   }
 
   // If we are tracing a specific pid and it has exited, we should exit
@@ -1323,7 +1391,20 @@ int BPFtrace::print_maps()
 {
   for (auto &mapmap : maps)
   {
-    int err = print_map(*mapmap.get(), 0, 0);
+    IMap &map = *mapmap.get();
+    // the kernel doesn't count LRU evictions, but a full map has likely
+    // evicted some of its keys
+    if (map.is_lru_type() &&
+        count_map_elems(map) >= static_cast<uint64_t>(map.max_entries_))
+    {
+      LOG(WARNING) << "map " << map.name_ << " reached its limit of "
+                   << map.max_entries_
+                   << " elements, least recently used keys may have been "
+                      "evicted. Try increasing BPFTRACE_MAP_KEYS_MAX or "
+                      "BPFTRACE_MAP_SIZES.";
+    }
+
+    int err = print_map(map, 0, 0);
     if (err)
       return err;
   }
@@ -1331,18 +1412,203 @@ int BPFtrace::print_maps()
   return 0;
 }
 
+int BPFtrace::print_dropped_events()
+{
+  auto map = maps[MapManager::Type::Sampling];
+  if (!map)
+    return 0;
+
+  std::vector<SamplingSlot> slots(ncpus_);
+  for (uint32_t site = 0; site < sampling_sites_.size(); site++)
+  {
+    int err = bpf_lookup_elem(map.value()->mapfd_, &site, slots.data());
+    if (err)
+    {
+      LOG(ERROR) << "failed to look up sampling slot " << site << ": " << err;
+      return -1;
+    }
+
+    uint64_t dropped = 0;
+    for (auto &slot : slots)
+      dropped += slot.dropped;
+    out_->dropped_events(sampling_sites_[site], dropped);
+  }
+
+  return 0;
+}
+
+int BPFtrace::print_stackid_errors()
+{
+  auto map = maps[MapManager::Type::StackIdErrors];
+  if (!map)
+    return 0;
+
+  std::vector<StackIdErrors> slots(ncpus_);
+  for (uint32_t site = 0; site < stackid_sites_.size(); site++)
+  {
+    int err = bpf_lookup_elem(map.value()->mapfd_, &site, slots.data());
+    if (err)
+    {
+      LOG(ERROR) << "failed to look up stack id error counts " << site << ": "
+                 << err;
+      return -1;
+    }
+
+    StackIdErrors total = {};
+    for (auto &slot : slots)
+    {
+      total.collisions += slot.collisions;
+      total.full += slot.full;
+      total.other += slot.other;
+    }
+    if (total.collisions + total.full + total.other == 0)
+      continue;
+
+    std::stringstream msg;
+    msg << "Failed to get " << total.collisions + total.full + total.other
+            << " stacks for " << stackid_sites_[site] << ": "
+            << total.collisions << " id collisions, " << total.full
+            << " with the stack map full, " << total.other << " other errors";
+    if (total.collisions || total.full)
+      msg << ". Consider raising BPFTRACE_STACK_MAP_SIZE (now "
+              << stack_max_ << ")"
+              << (stack_reuse_ids_ ? ""
+                                   : " or setting BPFTRACE_STACK_REUSE_IDS=1");
+    LOG(WARNING) << msg.str();
+  }
+
+  return 0;
+}
+
+// estimate the kernel memory used by a map once all its elements exist,
+// following the kernel's htab and array element layouts
+uint64_t BPFtrace::map_memory_estimate(IMap &map)
+{
+  auto round_up = [](uint64_t size) { return (size + 7) & ~7ULL; };
+  uint64_t value_size = round_up(map.value_size_);
+  uint64_t max_entries = map.max_entries_;
+
+  if (map.map_type_ == BPF_MAP_TYPE_ARRAY)
+    return max_entries * value_size;
+  if (map.map_type_ == BPF_MAP_TYPE_PERCPU_ARRAY)
+    return max_entries * value_size * ncpus_;
+  // pointers to the perf events
+  if (map.map_type_ == BPF_MAP_TYPE_PERF_EVENT_ARRAY)
+    return max_entries * 8;
+
+  // a power of 2 of preallocated buckets: a pointer, then the free list node,
+  // hash and number of frames of struct stack_map_bucket before the frames
+  if (map.map_type_ == BPF_MAP_TYPE_STACK_TRACE)
+  {
+    uint64_t buckets = 1;
+    while (buckets < max_entries)
+      buckets <<= 1;
+    return buckets * (8 + 16 + value_size);
+  }
+
+  // struct htab_elem header, then the key and the value (or a pointer to
+  // the per-CPU values)
+  uint64_t elem_size = 48 + round_up(map.key_size_);
+  if (map.is_per_cpu_type())
+    elem_size += 8 + value_size * ncpus_;
+  else
+    elem_size += value_size;
+  return max_entries * elem_size;
+}
+
+void BPFtrace::report_map_sizes()
+{
+  const uint64_t warn_limit = 1ULL << 30;
+  uint64_t prealloc_total = 0;
+  uint64_t dynamic_total = 0;
+
+  auto report = [&](IMap &map, const std::string &name) {
+    uint64_t size = map_memory_estimate(map);
+    bool prealloc = !(map.flags_ & BPF_F_NO_PREALLOC);
+    if (prealloc)
+      prealloc_total += size;
+    else
+      dynamic_total += size;
+
+    if (bt_verbose)
+    {
+      std::cerr << "map " << name << ": " << map.max_entries_ << " entries, "
+                << (prealloc ? "" : "up to ") << size << " bytes"
+                << (prealloc ? " preallocated" : "") << std::endl;
+    }
+  };
+
+  for (auto &map : maps)
+    report(*map, map->name_);
+  for (auto &map : maps.internal_maps())
+    report(*map.second, to_string(map.first));
+  // stack maps are sized by BPFTRACE_STACK_MAP_SIZE, and can be the largest
+  for (auto &map : maps.stack_maps())
+    if (map.second)
+      report(*map.second,
+             "stack (" + std::to_string(map.first.limit) + " frames)");
+
+  if (bt_verbose)
+  {
+    std::cerr << "maps: " << prealloc_total << " bytes preallocated";
+    if (dynamic_total)
+      std::cerr << ", up to " << dynamic_total << " bytes allocated on demand";
+    std::cerr << std::endl;
+  }
+
+  if (prealloc_total > warn_limit)
+  {
+    LOG(WARNING) << "maps will preallocate about " << (prealloc_total >> 20)
+                 << " MiB of kernel memory. Consider lowering "
+                    "BPFTRACE_MAP_KEYS_MAX, BPFTRACE_MAP_SIZES or "
+                    "BPFTRACE_STACK_MAP_SIZE, or using "
+                    "BPFTRACE_NO_PREALLOC_MAPS.";
+  }
+}
+
+// size of the keys stored in the BPF map
+size_t BPFtrace::map_key_size(IMap &map)
+{
+  if (map.type_.IsHistTy() || map.type_.IsLhistTy() ||
+      map.type_.IsLLhistTy() || map.type_.IsQuantilesTy() ||
+      map.type_.IsStatsTy() || map.type_.IsAvgTy())
+    // hist maps have 8 extra bytes for the bucket number
+    return map.key_.size() + 8;
+  return map.key_.size();
+}
+
+// count the elements of a map by walking its keys
+uint64_t BPFtrace::count_map_elems(IMap &map)
+{
+  std::vector<uint8_t> old_key;
+  try
+  {
+    old_key = find_empty_key(map, map_key_size(map));
+  }
+  catch (std::runtime_error &e)
+  {
+    LOG(ERROR) << "failed to get key for map '" << map.name_
+               << "': " << e.what();
+    return 0;
+  }
+  auto key(old_key);
+
+  uint64_t count = 0;
+  while (bpf_get_next_key(map.mapfd_, old_key.data(), key.data()) == 0)
+  {
+    count++;
+    old_key = key;
+  }
+  return count;
+}
+
 // clear a map
 int BPFtrace::clear_map(IMap &map)
 {
   std::vector<uint8_t> old_key;
   try
   {
-    if (map.type_.IsHistTy() || map.type_.IsLhistTy() ||
-        map.type_.IsStatsTy() || map.type_.IsAvgTy())
-      // hist maps have 8 extra bytes for the bucket number
-      old_key = find_empty_key(map, map.key_.size() + 8);
-    else
-      old_key = find_empty_key(map, map.key_.size());
+    old_key = find_empty_key(map, map_key_size(map));
   }
   catch (std::runtime_error &e)
   {
@@ -1380,12 +1646,7 @@ int BPFtrace::zero_map(IMap &map)
   std::vector<uint8_t> old_key;
   try
   {
-    if (map.type_.IsHistTy() || map.type_.IsLhistTy() ||
-        map.type_.IsStatsTy() || map.type_.IsAvgTy())
-      // hist maps have 8 extra bytes for the bucket number
-      old_key = find_empty_key(map, map.key_.size() + 8);
-    else
-      old_key = find_empty_key(map, map.key_.size());
+    old_key = find_empty_key(map, map_key_size(map));
   }
   catch (std::runtime_error &e)
   {
@@ -1462,6 +1723,8 @@ std::string BPFtrace::map_value_to_str(const SizedType &stype,
     return std::to_string(min_value(value, nvalues) / div);
   else if (stype.IsMaxTy())
     return std::to_string(max_value(value, nvalues) / div);
+  else if (stype.IsCountDistinctTy())
+    return std::to_string(count_distinct_value(value, nvalues) / div);
   else if (stype.IsProbeTy())
     return resolve_probe(read_data<uint64_t>(value.data()));
   else if (stype.IsTimestampTy())
@@ -1475,7 +1738,8 @@ std::string BPFtrace::map_value_to_str(const SizedType &stype,
 
 int BPFtrace::print_map(IMap &map, uint32_t top, uint32_t div)
 {
-  if (map.type_.IsHistTy() || map.type_.IsLhistTy())
+  if (map.type_.IsHistTy() || map.type_.IsLhistTy() ||
+      map.type_.IsLLhistTy() || map.type_.IsQuantilesTy())
     return print_map_hist(map, top, div);
   else if (map.type_.IsAvgTy() || map.type_.IsStatsTy())
     return print_map_stats(map, top, div);
@@ -1543,6 +1807,14 @@ int BPFtrace::print_map(IMap &map, uint32_t top, uint32_t div)
       return max_value(a.second, nvalues) < max_value(b.second, nvalues);
     });
   }
+  else if (map.type_.IsCountDistinctTy())
+  {
+    std::sort(values_by_key.begin(), values_by_key.end(), [&](auto &a, auto &b)
+    {
+      return count_distinct_value(a.second, nvalues) <
+             count_distinct_value(b.second, nvalues);
+    });
+  }
   else
   {
     sort_by_key(map.key_.args_, values_by_key);
@@ -1605,9 +1877,18 @@ int BPFtrace::print_map_hist(IMap &map, uint32_t top, uint32_t div)
       // New key - create a list of buckets for it
       if (map.type_.IsHistTy())
         values_by_key[key_prefix] = std::vector<uint64_t>(65);
+      else if (map.type_.IsLLhistTy())
+        values_by_key[key_prefix] = std::vector<uint64_t>(
+            loglinear_buckets(map.llbits));
+      else if (map.type_.IsQuantilesTy())
+        values_by_key[key_prefix] = std::vector<uint64_t>(
+            quantiles_buckets(map.llbits));
       else
         values_by_key[key_prefix] = std::vector<uint64_t>(1002);
     }
+    // quantiles() bucket numbers are signed, so shift them to be non-negative
+    if (map.type_.IsQuantilesTy())
+      bucket = quantiles_position(static_cast<int64_t>(bucket), map.llbits);
     values_by_key[key_prefix].at(bucket) = reduce_value<uint64_t>(value, nvalues);
 
     old_key = key;
@@ -1737,6 +2018,17 @@ uint64_t BPFtrace::max_value(const std::vector<uint8_t> &value, int nvalues)
   return max;
 }
 
+uint64_t BPFtrace::count_distinct_value(const std::vector<uint8_t> &value,
+                                        int nvalues)
+{
+  // each CPU has its own HyperLogLog registers, merge them before estimating
+  size_t nregisters = value.size() / nvalues;
+  std::vector<uint8_t> registers(nregisters);
+  for (int i = 0; i < nvalues; i++)
+    hll_merge(registers, value.data() + i * nregisters);
+  return hll_estimate(registers);
+}
+
 int64_t BPFtrace::min_value(const std::vector<uint8_t> &value, int nvalues)
 {
   int64_t val, max = 0, retval;
@@ -1791,14 +2083,17 @@ std::string BPFtrace::get_stack(uint64_t stackidpid, bool ustack, StackType stac
 {
   int32_t stackid = stackidpid & 0xffffffff;
   int pid = stackidpid >> 32;
+  if (stack_type.mode == StackMode::build_id)
+    return get_build_id_stack(stackid, pid, stack_type, indent);
   auto stack_trace = std::vector<uint64_t>(stack_type.limit);
   int err = bpf_lookup_elem(maps[stack_type].value()->mapfd_,
                             &stackid,
                             stack_trace.data());
   if (err)
   {
-    // ignore EFAULT errors: eg, kstack used but no kernel stack
-    if (stackid != -EFAULT)
+    // get_stackid() failures are counted and reported on exit, see
+    // print_stackid_errors()
+    if (stackid >= 0)
       LOG(ERROR) << "failed to look up stack id " << stackid << " (pid " << pid
                  << "): " << err;
     return "";
@@ -1825,7 +2120,55 @@ std::string BPFtrace::get_stack(uint64_t stackidpid, bool ustack, StackType stac
       case StackMode::perf:
         stack << "\t" << std::hex << addr << std::dec << " " << sym << std::endl;
         break;
+      case StackMode::build_id:
+        break; // handled by get_build_id_stack()
+    }
+  }
+
+  return stack.str();
+}
+
+std::string BPFtrace::get_build_id_stack(int32_t stackid,
+                                         int pid,
+                                         StackType stack_type,
+                                         int indent)
+{
+  auto stack_trace = std::vector<struct bpf_stack_build_id>(stack_type.limit);
+  int err = bpf_lookup_elem(maps[stack_type].value()->mapfd_,
+                            &stackid,
+                            stack_trace.data());
+  if (err)
+  {
+    if (stackid >= 0)
+      LOG(ERROR) << "failed to look up stack id " << stackid << " (pid " << pid
+                 << "): " << err;
+    return "";
+  }
+
+  std::ostringstream stack;
+  std::string padding(indent, ' ');
+
+  stack << "\n";
+  for (auto &frame : stack_trace)
+  {
+    if (frame.status == BPF_STACK_BUILD_ID_EMPTY)
+      break;
+    stack << padding;
+    if (frame.status == BPF_STACK_BUILD_ID_IP)
+    {
+      // the kernel could not read the build-id of this mapping
+      stack << resolve_usym(frame.ip, pid, true);
+    }
+    else if (build_id_symbolizer_)
+    {
+      stack << build_id_symbolizer_->resolve(
+          frame.build_id, frame.offset, true, false, demangle_cpp_symbols_);
+    }
+    else
+    {
+      stack << BuildIdSymbolizer::format(frame.build_id, frame.offset);
     }
+    stack << std::endl;
   }
 
   return stack.str();
@@ -5,7 +5,9 @@
 #include <memory>
 #include <optional>
 #include <set>
+#include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #include <unordered_map>
@@ -14,6 +16,8 @@
 #include "attached_probe.h"
 #include "bpffeature.h"
 #include "btf.h"
+#include "build_id_symbolizer.h"
+#include "cgroup_filter.h"
 #include "child.h"
 #include "map.h"
 #include "mapmanager.h"
@@ -34,7 +38,6 @@ struct symbol
   uint64_t address;
 };
 
-class BpfOrc;
 enum class DebugLevel;
 
 // globals
@@ -90,6 +93,10 @@ struct HelperErrorInfo
 
 using BPFTraceMap = std::vector<std::pair<std::vector<uint8_t>, std::vector<uint8_t>>>;
 
+// ELF section name -> (address, size) of the compiled BPF programs
+using ProgramSections =
+    std::map<std::string, std::tuple<uint8_t *, uintptr_t>>;
+
 class BPFtrace
 {
 public:
@@ -105,6 +112,11 @@ public:
   int poll_perf_events(bool drain = false, int timeout = 100);
   int finalize();
   int print_maps();
+  int print_dropped_events();
+  int print_stackid_errors();
+  void report_map_sizes();
+  // kernel memory used by a map once all its elements exist
+  uint64_t map_memory_estimate(IMap &map);
   int clear_map(IMap &map);
   int zero_map(IMap &map);
   int print_map(IMap &map, uint32_t top, uint32_t div);
@@ -113,6 +125,10 @@ public:
   };
   BPFTraceMap get_map(const std::string& name);
   std::string get_stack(uint64_t stackidpid, bool ustack, StackType stack_type, int indent=0);
+  std::string get_build_id_stack(int32_t stackid,
+                                 int pid,
+                                 StackType stack_type,
+                                 int indent = 0);
   std::string resolve_buf(char *buf, size_t size);
   std::string resolve_ksym(uintptr_t addr, bool show_offset=false);
   std::string resolve_usym(uintptr_t addr, int pid, bool show_offset=false, bool show_module=false);
@@ -137,7 +153,7 @@ public:
   void request_finalize();
   bool is_aslr_enabled(int pid);
 
-  BpfOrc* bpforc_ = nullptr;
+  const ProgramSections *sections_ = nullptr;
   int epollfd_ = -1;
   std::function<void(uint8_t*)> printf_callback_;
 
@@ -153,6 +169,8 @@ public:
   std::vector<std::tuple<std::string, std::vector<Field>>> printf_args_;
   std::vector<std::tuple<std::string, std::vector<Field>>> system_args_;
   std::vector<std::string> join_args_;
+  std::vector<std::string> sampling_sites_;
+  std::vector<std::string> stackid_sites_;
   std::vector<std::string> time_args_;
   std::vector<std::string> strftime_args_;
   std::vector<std::tuple<std::string, std::vector<Field>>> cat_args_;
@@ -167,6 +185,13 @@ public:
 
   uint64_t strlen_ = 64;
   uint64_t mapmax_ = 4096;
+  uint64_t stack_max_ = 4096;
+  bool stack_reuse_ids_ = false;
+  std::unordered_map<std::string, uint64_t> map_sizes_;
+  std::unordered_set<std::string> lru_maps_;
+  std::unordered_set<std::string> no_prealloc_maps_;
+  std::vector<pid_t> pid_filter_;
+  bool pid_filter_follow_forks_ = false;
   size_t cat_bytes_max_ = 10240;
   uint64_t max_probes_ = 512;
   uint64_t log_size_ = 1000000;
@@ -179,6 +204,11 @@ public:
   bool has_usdt_ = false;
   bool usdt_file_activation_ = false;
   int helper_check_level_ = 0;
+  // optimization level of the BPF programs, see CodegenLLVM::optimize
+  int opt_level_ = 3;
+  // set by codegen when the program embeds values that change across
+  // reboots, such as kernel addresses and cgroup ids
+  bool boot_specific_ = false;
   std::optional<struct timespec> boottime_;
 
   static void sort_by_key(
@@ -200,18 +230,24 @@ public:
   std::map<std::string, std::map<std::string, SizedType>> btf_ap_args_;
   std::unique_ptr<ChildProcBase> child_;
   std::unique_ptr<ProcMonBase> procmon_;
+  std::unique_ptr<CgroupFilter> cgroup_filter_;
+  std::unique_ptr<BuildIdSymbolizer> build_id_symbolizer_;
   pid_t pid(void) const
   {
     return procmon_ ? procmon_->pid() : 0;
   }
 
 protected:
+  friend class ProgramBundle;
+  friend class ProgramCache;
+  friend class ProgramSerializer;
+
   std::vector<Probe> probes_;
   std::vector<Probe> special_probes_;
 
 private:
   int run_special_probe(std::string name,
-                        const BpfOrc &bpforc,
+                        const ProgramSections &sections,
                         void (*trigger)(void));
   std::vector<std::unique_ptr<AttachedProbe>> attached_probes_;
   void* ksyms_{nullptr};
@@ -230,15 +266,19 @@ private:
       bool file_activation);
   std::vector<std::unique_ptr<AttachedProbe>> attach_probe(
       Probe &probe,
-      const BpfOrc &bpforc);
+      const ProgramSections &sections);
   int setup_perf_events();
   BPFTraceMap get_map(IMap &map);
   int print_map_hist(IMap &map, uint32_t top, uint32_t div);
+  static size_t map_key_size(IMap &map);
+  uint64_t count_map_elems(IMap &map);
   int print_map_stats(IMap &map, uint32_t top, uint32_t div);
   template <typename T>
   static T reduce_value(const std::vector<uint8_t> &value, int nvalues);
   static int64_t min_value(const std::vector<uint8_t> &value, int nvalues);
   static uint64_t max_value(const std::vector<uint8_t> &value, int nvalues);
+  static uint64_t count_distinct_value(const std::vector<uint8_t> &value,
+                                       int nvalues);
   static uint64_t read_address_from_output(std::string output);
   std::vector<uint8_t> find_empty_key(IMap &map, size_t size) const;
 };
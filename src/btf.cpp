@@ -5,9 +5,11 @@
 #include "log.h"
 #include "types.h"
 #include "utils.h"
+#include <algorithm>
 #include <cstring>
 #include <fcntl.h>
 #include <iostream>
+#include <limits>
 #include <linux/limits.h>
 #include <regex>
 #include <sys/stat.h>
@@ -158,7 +160,6 @@ BTF::BTF(void) : btf(nullptr), state(NODATA)
   if (btf)
   {
     libbpf_set_print(libbpf_print);
-    traceable_funcs_ = get_traceable_funcs();
     state = OK;
   }
   else if (bt_debug != DebugLevel::kNone)
@@ -208,12 +209,146 @@ static std::string full_type_str(const struct btf *btf, const struct btf_type *t
   return str;
 }
 
+// Prefix of the typedefs the kernel declares for the probe functions of raw
+// tracepoints: void (*)(void *__data, <the args of the tracepoint>)
+static const std::string RAW_TRACEPOINT_PREFIX = "btf_trace_";
+
 static std::string btf_type_str(const std::string& type)
 {
   return std::regex_replace(type, std::regex("^(struct )|(union )"), "");
 }
 
+const BTF::Index &BTF::index() const
+{
+  if (index_)
+    return *index_;
+
+  index_ = std::make_unique<Index>();
+  auto &idx = *index_;
+  __s32 id, max = (__s32)btf__get_nr_types(btf);
+  for (id = 1; id <= max; id++)
+  {
+    const struct btf_type *t = btf__type_by_id(btf, id);
+    if (!t->name_off)
+      continue;
+
+    // The first definition wins, as in a linear search
+    const char *name = btf_str(btf, t->name_off);
+    idx.names.emplace(name, id);
+    idx.full_names.emplace(full_type_str(btf, t), id);
+
+    if (btf_is_func(t))
+    {
+      idx.funcs.emplace(name, id);
+      idx.func_ids.push_back(id);
+    }
+    else if (btf_is_composite(t) || btf_is_enum(t))
+      idx.record_ids.push_back(id);
+    else if (btf_is_typedef(t) &&
+             !std::strncmp(name,
+                           RAW_TRACEPOINT_PREFIX.c_str(),
+                           RAW_TRACEPOINT_PREFIX.size()))
+      idx.raw_tracepoint_ids.push_back(id);
+
+    if (btf_is_enum(t))
+    {
+      const struct btf_enum *p = btf_enum(t);
+      for (int e = 0; e < btf_vlen(t); ++e, ++p)
+        idx.enum_values.emplace(btf_str(btf, p->name_off), id);
+    }
+  }
+  return idx;
+}
+
+static bool btf_type_is_modifier(const struct btf_type *t)
+{
+  // Some of them is not strictly a C modifier
+  // but they are grouped into the same bucket
+  // for BTF concern:
+  // A type (t) that refers to another
+  // type through t->type AND its size cannot
+  // be determined without following the t->type.
+  // ptr does not fall into this bucket
+  // because its size is always sizeof(void *).
+
+  switch (BTF_INFO_KIND(t->info))
+  {
+    case BTF_KIND_TYPEDEF:
+    case BTF_KIND_VOLATILE:
+    case BTF_KIND_CONST:
+    case BTF_KIND_RESTRICT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static __u32 btf_resolve_modifiers(const struct btf *btf, __u32 id)
+{
+  const struct btf_type *t = btf__type_by_id(btf, id);
+  while (t && btf_type_is_modifier(t))
+  {
+    id = t->type;
+    t = btf__type_by_id(btf, id);
+  }
+  return id;
+}
+
+// Append to `ids` the named structs and unions that the fields of `id` embed
+// by value, also as array elements, and that are neither `seen` nor `defined`.
+// Anonymous members are walked through since their fields belong to the
+// enclosing type. Pointed to types are not followed: btf_dump forward declares
+// them, and the ones a program dereferences are requested by name already.
+static void add_field_types(const struct btf *btf,
+                            __u32 id,
+                            const std::unordered_set<std::string> &defined,
+                            std::vector<bool> &seen,
+                            std::vector<__u32> &ids)
+{
+  const struct btf_type *t = btf__type_by_id(btf,
+                                             btf_resolve_modifiers(btf, id));
+  if (!t || !btf_is_composite(t))
+    return;
+
+  const struct btf_member *m = btf_members(t);
+  for (uint16_t i = 0; i < btf_vlen(t); i++, m++)
+  {
+    __u32 field_id = btf_resolve_modifiers(btf, m->type);
+    const struct btf_type *field = btf__type_by_id(btf, field_id);
+    while (field && btf_is_array(field))
+    {
+      field_id = btf_resolve_modifiers(btf, btf_array(field)->type);
+      field = btf__type_by_id(btf, field_id);
+    }
+    if (!field || !btf_is_composite(field))
+      continue;
+
+    if (!field->name_off)
+      add_field_types(btf, field_id, defined, seen, ids);
+    else if (!seen[field_id])
+    {
+      seen[field_id] = true;
+      if (defined.find(full_type_str(btf, field)) == defined.end())
+        ids.push_back(field_id);
+    }
+  }
+}
+
 std::string BTF::c_def(const std::unordered_set<std::string> &set) const
+{
+  return dump_types(set, nullptr);
+}
+
+std::string BTF::c_def_closure(
+    const std::unordered_set<std::string> &set,
+    const std::unordered_set<std::string> &defined) const
+{
+  return dump_types(set, &defined);
+}
+
+std::string BTF::dump_types(
+    const std::unordered_set<std::string> &set,
+    const std::unordered_set<std::string> *defined) const
 {
   if (!has_data())
     return std::string("");
@@ -233,42 +368,313 @@ std::string BTF::c_def(const std::unordered_set<std::string> &set) const
       return std::string("");
   }
 
-  std::unordered_set<std::string> myset(set);
-  __s32 id, max = (__s32) btf__get_nr_types(btf);
+  auto &idx = index();
+  std::vector<bool> seen(btf__get_nr_types(btf) + 1, false);
+  std::vector<__u32> ids;
 
-  for (id = 1; id <= max && myset.size(); id++)
+  auto add = [&](__u32 id) {
+    if (!seen[id])
+    {
+      seen[id] = true;
+      ids.push_back(id);
+    }
+  };
+  for (auto &name : set)
   {
-    const struct btf_type *t = btf__type_by_id(btf, id);
+    auto it = idx.full_names.find(name);
+    if (it != idx.full_names.end())
+      add(it->second);
     // Allow users to reference enum values by name to pull in entire enum defs
+    it = idx.enum_values.find(name);
+    if (it != idx.enum_values.end())
+      add(it->second);
+  }
+  // Dump in id order, like the definitions appear in BTF
+  std::sort(ids.begin(), ids.end());
+
+  // Closure of the types embedded by value, in the same traversal as the
+  // dump. btf_dump emits the dependencies of each type itself and never
+  // emits a type twice.
+  for (size_t i = 0; i < ids.size(); i++)
+  {
+    if (defined)
+      add_field_types(btf, ids[i], *defined, seen, ids);
+    btf_dump__dump_type(dump, ids[i]);
+  }
+
+  btf_dump__free(dump);
+  return ret;
+}
+
+// Name of a struct or union the way clang spells its canonical type: an
+// anonymous one is known by the typedef declaring it
+static std::string record_name(const struct btf *btf, __u32 id)
+{
+  std::string typedef_name;
+  const struct btf_type *t = btf__type_by_id(btf, id);
+  while (t && btf_type_is_modifier(t))
+  {
+    if (btf_is_typedef(t))
+      typedef_name = btf_str(btf, t->name_off);
+    t = btf__type_by_id(btf, t->type);
+  }
+  if (!t)
+    return "";
+  if (!t->name_off && !typedef_name.empty())
+    return typedef_name;
+  return full_type_str(btf, t);
+}
+
+// Same mapping as get_sized_type() in clang_parser.cpp
+static SizedType field_stype(const struct btf *btf, __u32 id)
+{
+  const struct btf_type *t = btf__type_by_id(btf,
+                                             btf_resolve_modifiers(btf, id));
+  if (!t)
+    return CreateNone();
+
+  if (btf_is_int(t))
+  {
+    if (t->size > 8)
+      return CreateNone();
+    // Plain char has the signedness of the target, as for clang
+    bool is_signed = !strcmp(btf_str(btf, t->name_off), "char")
+                         ? std::numeric_limits<char>::is_signed
+                         : btf_int_encoding(t) & BTF_INT_SIGNED;
+    return is_signed ? CreateInt(8 * t->size) : CreateUInt(8 * t->size);
+  }
+  if (btf_is_enum(t))
+    return CreateUInt(8 * t->size);
+  if (btf_is_composite(t))
+    return CreateRecord(t->size, record_name(btf, id));
+  if (btf_is_ptr(t))
+    return CreatePointer(field_stype(btf, t->type));
+  if (btf_is_array(t))
+  {
+    const struct btf_array *array = btf_array(t);
+    const struct btf_type *elem = btf__type_by_id(
+        btf, btf_resolve_modifiers(btf, array->type));
+    if (!elem)
+      return CreateNone();
+    if (btf_is_int(elem) && !strcmp(btf_str(btf, elem->name_off), "char"))
+      return CreateString(array->nelems);
+    // Only support one-dimensional arrays for now
+    if (btf_is_array(elem))
+      return CreateNone();
+    return CreateArray(array->nelems, field_stype(btf, array->type));
+  }
+  return CreateNone();
+}
+
+// Add the members of the struct or union `t`, starting `base` bits into
+// `record`, to its fields. Like clang's visitor, fields of anonymous members
+// belong to the enclosing named type. Structs, unions and enums embedded by
+// value are appended to `embedded`.
+static void add_fields(const struct btf *btf,
+                       const struct btf_type *t,
+                       __u32 base,
+                       Struct &record,
+                       std::vector<__u32> &embedded)
+{
+  const struct btf_member *m = btf_members(t);
+  for (uint16_t i = 0; i < btf_vlen(t); i++, m++)
+  {
+    const struct btf_type *type = btf__type_by_id(
+        btf, btf_resolve_modifiers(btf, m->type));
+    if (!type)
+      continue;
+
+    __u32 bit_offset = base + btf_member_bit_offset(t, i);
+    if (!m->name_off && btf_is_composite(type))
+    {
+      add_fields(btf, type, bit_offset, record, embedded);
+      continue;
+    }
+
+    // Bitfields are either sized in the member, or in an int type of their own
+    __u32 bit_size = btf_member_bitfield_size(t, i);
+    if (!bit_size && btf_is_int(type) &&
+        (btf_int_offset(type) || btf_int_bits(type) != 8 * type->size))
+    {
+      bit_size = btf_int_bits(type);
+      bit_offset += btf_int_offset(type);
+    }
+
+    Field field{};
+    field.type = field_stype(btf, m->type);
+    field.offset = bit_offset / 8;
+    field.is_bitfield = bit_size != 0;
+    if (field.is_bitfield)
+    {
+      field.bitfield.mask = (1ULL << bit_size) - 1;
+      field.bitfield.access_rshift = bit_offset % 8;
+      // Round up to nearest byte
+      field.bitfield.read_bytes = (bit_offset % 8 + bit_size + 7) / 8;
+    }
+    record.fields[btf_str(btf, m->name_off)] = field;
+
+    // btf_dump defines the types embedded by value, also in arrays
+    __u32 elem_id = m->type;
+    while (type && btf_is_array(type))
+    {
+      elem_id = btf_array(type)->type;
+      type = btf__type_by_id(btf, btf_resolve_modifiers(btf, elem_id));
+    }
+    if (type && (btf_is_composite(type) || btf_is_enum(type)))
+      embedded.push_back(elem_id);
+  }
+}
+
+// Add the structs, unions and enums in `ids`, and the ones they embed, to
+// `structs` and `enums`
+static void resolve_ids(const struct btf *btf,
+                        std::vector<__u32> &ids,
+                        std::map<std::string, Struct> &structs,
+                        std::map<std::string, uint64_t> &enums)
+{
+  std::vector<bool> seen(btf__get_nr_types(btf) + 1, false);
+  while (!ids.empty())
+  {
+    __u32 id = ids.back();
+    ids.pop_back();
+    __u32 type_id = btf_resolve_modifiers(btf, id);
+    const struct btf_type *t = btf__type_by_id(btf, type_id);
+    if (!t || seen[type_id])
+      continue;
+    seen[type_id] = true;
+
     if (btf_is_enum(t))
     {
       const struct btf_enum *p = btf_enum(t);
-      uint16_t vlen = btf_vlen(t);
-      for (int e = 0; e < vlen; ++e, ++p)
-      {
-        std::string str = btf_str(btf, p->name_off);
-        auto it = myset.find(str);
-        if (it != myset.end())
-        {
-          btf_dump__dump_type(dump, id);
-          myset.erase(it);
-          break;
-        }
-      }
+      for (int e = 0; e < btf_vlen(t); ++e, ++p)
+        enums[btf_str(btf, p->name_off)] = static_cast<int64_t>(p->val);
+    }
+    else if (btf_is_composite(t))
+    {
+      auto &record = structs[record_name(btf, id)];
+      record.size = t->size;
+      add_fields(btf, t, 0, record, ids);
     }
+  }
+}
+
+bool BTF::resolve_types(const std::unordered_set<std::string> &set,
+                        std::map<std::string, Struct> &structs,
+                        std::map<std::string, uint64_t> &enums) const
+{
+  if (!has_data())
+    return false;
+
+  auto &idx = index();
+  std::vector<__u32> ids;
+  for (auto &name : set)
+  {
+    auto it = idx.full_names.find(name);
+    if (it != idx.full_names.end())
+      ids.push_back(it->second);
+    it = idx.enum_values.find(name);
+    if (it != idx.enum_values.end())
+      ids.push_back(it->second);
+  }
+
+  resolve_ids(btf, ids, structs, enums);
+  return true;
+}
+
+// The prototype of the probe function of a btf_trace_<event> typedef
+static const struct btf_type *raw_tracepoint_proto(const struct btf *btf,
+                                                   __u32 id)
+{
+  const struct btf_type *t = btf__type_by_id(btf, id);
+  if (t && btf_is_typedef(t))
+    t = btf__type_by_id(btf, t->type);
+  if (t && btf_is_ptr(t))
+    t = btf__type_by_id(btf, t->type);
+  if (!t || !btf_is_func_proto(t) || btf_vlen(t) < 1)
+    return nullptr;
+  return t;
+}
 
-    std::string str = full_type_str(btf, t);
+static bool same_params(const struct btf_type *a, const struct btf_type *b)
+{
+  if (!a || !b || btf_vlen(a) != btf_vlen(b))
+    return false;
+  const struct btf_param *p = btf_params(a), *q = btf_params(b);
+  for (int i = 0; i < btf_vlen(a); i++)
+    if (p[i].type != q[i].type)
+      return false;
+  return true;
+}
 
-    auto it = myset.find(str);
-    if (it != myset.end())
+bool BTF::resolve_tracepoint(const std::string &event,
+                             const std::string &struct_name,
+                             std::map<std::string, Struct> &structs,
+                             std::map<std::string, uint64_t> &enums) const
+{
+  if (!has_data())
+    return false;
+
+  auto &idx = index();
+
+  // struct trace_event_raw_<event> is the record of the event class named
+  // <event>, which is not necessarily the class of event <event>. Every
+  // vmlinux event has a btf_trace_<event> typedef and every class a
+  // __bpf_trace_<class> probe function, both with the prototype of the class:
+  // only an event that is its own class is known to use the struct.
+  auto tp = idx.names.find(RAW_TRACEPOINT_PREFIX + event);
+  auto probe_func = idx.funcs.find("__bpf_trace_" + event);
+  if (tp == idx.names.end() || probe_func == idx.funcs.end())
+    return false;
+  const struct btf_type *func = btf__type_by_id(btf, probe_func->second);
+  if (!func ||
+      !same_params(raw_tracepoint_proto(btf, tp->second),
+                   raw_tracepoint_proto(btf, func->type)))
+    return false;
+
+  auto raw = idx.full_names.find("struct trace_event_raw_" + event);
+  auto entry = idx.full_names.find("struct trace_entry");
+  if (raw == idx.full_names.end() || entry == idx.full_names.end())
+    return false;
+  const struct btf_type *t = btf__type_by_id(btf, raw->second);
+  const struct btf_type *entry_t = btf__type_by_id(btf, entry->second);
+  if (!t || !entry_t || !btf_is_struct(t) || !btf_is_struct(entry_t))
+    return false;
+
+  // Name the fields as the format file does
+  Struct args;
+  std::vector<__u32> ids;
+  args.size = t->size;
+  add_fields(btf, t, 0, args, ids);
+  auto ent = args.fields.find("ent");
+  if (ent == args.fields.end() || !ent->second.type.IsRecordTy())
+    return false;
+  Struct common;
+  add_fields(btf, entry_t, 0, common, ids);
+  for (auto &field : common.fields)
+  {
+    field.second.offset += ent->second.offset;
+    args.fields["common_" + field.first] = field.second;
+  }
+  args.fields.erase(ent);
+  args.fields.erase("__data");
+
+  const std::string data_loc = "__data_loc_";
+  for (auto it = args.fields.begin(); it != args.fields.end();)
+  {
+    if (it->first.compare(0, data_loc.size(), data_loc) != 0)
     {
-      btf_dump__dump_type(dump, id);
-      myset.erase(it);
+      ++it;
+      continue;
     }
+    auto field = it->second;
+    field.type = CreateInt32();
+    args.fields["data_loc_" + it->first.substr(data_loc.size())] = field;
+    it = args.fields.erase(it);
   }
 
-  btf_dump__free(dump);
-  return ret;
+  resolve_ids(btf, ids, structs, enums);
+  structs[struct_name] = std::move(args);
+  return true;
 }
 
 std::string BTF::type_of(const std::string& name, const std::string& field)
@@ -276,12 +682,12 @@ std::string BTF::type_of(const std::string& name, const std::string& field)
   if (!has_data())
     return std::string("");
 
-  __s32 type_id = btf__find_by_name(btf, btf_type_str(name).c_str());
-
-  if (type_id < 0)
+  auto &names = index().names;
+  auto it = names.find(btf_type_str(name));
+  if (it == names.end())
     return std::string("");
 
-  const struct btf_type *type = btf__type_by_id(btf, type_id);
+  const struct btf_type *type = btf__type_by_id(btf, it->second);
   return type_of(type, field);
 }
 
@@ -338,28 +744,6 @@ std::string BTF::type_of(const btf_type *type, const std::string &field)
   return std::string("");
 }
 
-static bool btf_type_is_modifier(const struct btf_type *t)
-{
-  // Some of them is not strictly a C modifier
-  // but they are grouped into the same bucket
-  // for BTF concern:
-  // A type (t) that refers to another
-  // type through t->type AND its size cannot
-  // be determined without following the t->type.
-  // ptr does not fall into this bucket
-  // because its size is always sizeof(void *).
-
-  switch (BTF_INFO_KIND(t->info))
-  {
-    case BTF_KIND_TYPEDEF:
-    case BTF_KIND_VOLATILE:
-    case BTF_KIND_CONST:
-    case BTF_KIND_RESTRICT:
-      return true;
-    default:
-      return false;
-  }
-}
 
 const struct btf_type *BTF::btf_type_skip_modifiers(const struct btf_type *t)
 {
@@ -410,73 +794,96 @@ int BTF::resolve_args(const std::string &func,
   if (!has_data())
     throw std::runtime_error("BTF data not available");
 
-  __s32 id, max = (__s32)btf__get_nr_types(btf);
-  std::string name = func;
+  auto &funcs = index().funcs;
+  auto it = funcs.find(func);
+  if (it == funcs.end())
+    throw std::runtime_error("no BTF data for the function");
 
-  for (id = 1; id <= max; id++)
+  const struct btf_type *t = btf__type_by_id(btf, it->second);
+  t = btf__type_by_id(btf, t->type);
+  if (!btf_is_func_proto(t))
   {
-    const struct btf_type *t = btf__type_by_id(btf, id);
+    throw std::runtime_error("not a function");
+  }
 
-    if (!btf_is_func(t))
-      continue;
+  if (!is_traceable_func(func))
+  {
+    if (traceable_funcs_.empty())
+      throw std::runtime_error("could not read traceable functions from " +
+                               kprobe_path + " (is debugfs mounted?)");
+    else
+      throw std::runtime_error("function not traceable (probably it is "
+                               "inlined or marked as \"notrace\")");
+  }
 
-    const char *str = btf_str(btf, t->name_off);
+  const struct btf_param *p = btf_params(t);
+  __u16 vlen = btf_vlen(t);
+  if (vlen > arch::max_arg() + 1)
+  {
+    throw std::runtime_error("functions with more than 6 parameters are "
+                             "not supported.");
+  }
 
-    if (name != str)
-      continue;
+  int j = 0;
 
-    t = btf__type_by_id(btf, t->type);
-    if (!btf_is_func_proto(t))
+  for (; j < vlen; j++, p++)
+  {
+    const char *str = btf_str(btf, p->name_off);
+    if (!str)
     {
-      throw std::runtime_error("not a function");
+      throw std::runtime_error("failed to resolve arguments");
     }
 
-    if (!is_traceable_func(name))
-    {
-      if (traceable_funcs_.empty())
-        throw std::runtime_error("could not read traceable functions from " +
-                                 kprobe_path + " (is debugfs mounted?)");
-      else
-        throw std::runtime_error("function not traceable (probably it is "
-                                 "inlined or marked as \"notrace\")");
-    }
+    SizedType stype = get_stype(p->type);
+    stype.kfarg_idx = j;
+    stype.is_kfarg = true;
+    args.insert({ str, stype });
+  }
 
-    const struct btf_param *p = btf_params(t);
-    __u16 vlen = btf_vlen(t);
-    if (vlen > arch::max_arg() + 1)
-    {
-      throw std::runtime_error("functions with more than 6 parameters are "
-                               "not supported.");
-    }
+  if (ret)
+  {
+    SizedType stype = get_stype(t->type);
+    stype.kfarg_idx = j;
+    stype.is_kfarg = true;
+    args.insert({ "$retval", stype });
+  }
 
-    int j = 0;
+  return 0;
+}
 
-    for (; j < vlen; j++, p++)
-    {
-      str = btf_str(btf, p->name_off);
-      if (!str)
-      {
-        throw std::runtime_error("failed to resolve arguments");
-      }
+int BTF::resolve_raw_tracepoint_args(const std::string &event,
+                                     std::map<std::string, SizedType> &args)
+{
+  if (!has_data())
+    throw std::runtime_error("BTF data not available");
 
-      SizedType stype = get_stype(p->type);
-      stype.kfarg_idx = j;
-      stype.is_kfarg = true;
-      args.insert({ str, stype });
-    }
+  auto &names = index().names;
+  auto it = names.find(RAW_TRACEPOINT_PREFIX + event);
+  if (it == names.end())
+    throw std::runtime_error("no BTF data for the tracepoint");
+
+  const struct btf_type *t = raw_tracepoint_proto(btf, it->second);
+  if (!t)
+    throw std::runtime_error("not a tracepoint");
 
-    if (ret)
+  // Skip __data, the context of the probe function, which the program does
+  // not get: its context is an array of the remaining arguments
+  const struct btf_param *p = btf_params(t) + 1;
+  for (int j = 0; j < btf_vlen(t) - 1; j++, p++)
+  {
+    const char *str = btf_str(btf, p->name_off);
+    if (!str)
     {
-      SizedType stype = get_stype(t->type);
-      stype.kfarg_idx = j;
-      stype.is_kfarg = true;
-      args.insert({ "$retval", stype });
+      throw std::runtime_error("failed to resolve arguments");
     }
 
-    return 0;
+    SizedType stype = get_stype(p->type);
+    stype.kfarg_idx = j;
+    stype.is_kfarg = true;
+    args.insert({ str, stype });
   }
 
-  throw std::runtime_error("no BTF data for the function");
+  return 0;
 }
 
 static bool match_re(const std::string &probe, const std::regex &re)
@@ -498,7 +905,6 @@ std::unique_ptr<std::istream> BTF::get_funcs(std::regex *re,
                                              bool params,
                                              std::string prefix) const
 {
-  __s32 id, max = (__s32)btf__get_nr_types(btf);
   std::string type = std::string("");
   struct btf_dump_opts opts = {
     .ctx = &type,
@@ -517,13 +923,9 @@ std::unique_ptr<std::istream> BTF::get_funcs(std::regex *re,
     return nullptr;
   }
 
-  for (id = 1; id <= max; id++)
+  for (__u32 id : index().func_ids)
   {
     const struct btf_type *t = btf__type_by_id(btf, id);
-
-    if (!btf_is_func(t))
-      continue;
-
     const char *str = btf__name_by_offset(btf, t->name_off);
     std::string func_name = str;
 
@@ -593,14 +995,84 @@ std::unique_ptr<std::istream> BTF::get_funcs(std::regex *re,
 #endif
   }
 
-  if (id != (max + 1))
-    LOG(ERROR) << "BTF data inconsistency " << id << "," << max;
-
   btf_dump__free(dump);
 
   return std::make_unique<std::istringstream>(funcs);
 }
 
+std::unique_ptr<std::istream> BTF::get_raw_tracepoints(std::regex *re,
+                                                       bool params,
+                                                       std::string prefix) const
+{
+  std::string type = std::string("");
+  struct btf_dump_opts opts = {
+    .ctx = &type,
+  };
+  struct btf_dump *dump;
+  std::string events;
+  char err_buf[256];
+  int err;
+
+  dump = btf_dump__new(btf, nullptr, &opts, dump_printf);
+  err = libbpf_get_error(dump);
+  if (err)
+  {
+    libbpf_strerror(err, err_buf, sizeof(err_buf));
+    LOG(ERROR) << "BTF: failed to initialize dump (" << err_buf << ")";
+    return nullptr;
+  }
+
+  for (__u32 id : index().raw_tracepoint_ids)
+  {
+    const struct btf_type *t = btf__type_by_id(btf, id);
+    std::string event = btf__name_by_offset(btf, t->name_off) +
+                        RAW_TRACEPOINT_PREFIX.size();
+
+    t = raw_tracepoint_proto(btf, id);
+    if (!t)
+      continue;
+
+    if (re && !match_re(prefix + event, *re))
+      continue;
+
+    events += prefix + event + "\n";
+
+#ifdef HAVE_LIBBPF_BTF_DUMP_EMIT_TYPE_DECL
+
+    if (!params)
+      continue;
+
+    DECLARE_LIBBPF_OPTS(btf_dump_emit_type_decl_opts,
+                        decl_opts,
+                        .field_name = "",
+                        .indent_level = 0, );
+
+    const struct btf_param *p;
+    int j;
+
+    for (j = 1, p = btf_params(t) + 1; j < btf_vlen(t); j++, p++)
+    {
+      // set by dump_printf callback
+      type = std::string("");
+      const char *arg_name = btf__name_by_offset(btf, p->name_off);
+
+      err = btf_dump__emit_type_decl(dump, p->type, &decl_opts);
+      if (err)
+      {
+        LOG(ERROR) << "failed to dump argument: " << arg_name;
+        break;
+      }
+
+      events += "    " + type + " " + arg_name + ";\n";
+    }
+#endif
+  }
+
+  btf_dump__free(dump);
+
+  return std::make_unique<std::istringstream>(events);
+}
+
 void BTF::display_kfunc(std::regex *re, const bool retprobe = false) const
 {
   if (!has_data())
@@ -617,53 +1089,39 @@ void BTF::display_kfunc(std::regex *re, const bool retprobe = false) const
   }
 }
 
-void BTF::display_structs(std::regex *re) const
+void BTF::display_rawtracepoints(std::regex *re) const
 {
   if (!has_data())
     return;
 
-  std::unordered_set<std::string> struct_set;
-  __s32 id, max = (__s32)btf__get_nr_types(btf);
-  std::string type = std::string("");
-  struct btf_dump_opts opts = {
-    .ctx = &type,
-  };
-  struct btf_dump *dump;
-  char err_buf[256];
-  int err;
+  auto events = get_raw_tracepoints(re, bt_verbose, "rawtracepoint:");
+  if (!events)
+    return;
 
-  dump = btf_dump__new(btf, nullptr, &opts, dump_printf);
-  err = libbpf_get_error(dump);
-  if (err)
+  std::string event;
+  while (std::getline(*events, event))
   {
-    libbpf_strerror(err, err_buf, sizeof(err_buf));
-    LOG(ERROR) << "BTF: failed to initialize dump (" << err_buf << ")";
-    return;
+    std::cout << event << std::endl;
   }
+}
 
-  for (id = 1; id <= max; id++)
+void BTF::display_structs(std::regex *re) const
+{
+  if (!has_data())
+    return;
+
+  std::unordered_set<std::string> struct_set;
+  for (__u32 id : index().record_ids)
   {
     const struct btf_type *t = btf__type_by_id(btf, id);
-
-    if (!(btf_is_struct(t) || btf_is_union(t) || btf_is_enum(t)))
-      continue;
-
     const std::string name = full_type_str(btf, t);
 
-    if (name.find("(anon)") != std::string::npos)
-      continue;
-
     if (re && !match_re(name, *re))
       continue;
 
     struct_set.insert(name);
   }
 
-  if (id != (max + 1))
-    LOG(ERROR) << " BTF data inconsistency " << id << "," << max;
-
-  btf_dump__free(dump);
-
   if (struct_set.empty())
     return;
 
@@ -697,9 +1155,14 @@ std::unique_ptr<std::istream> BTF::kfunc(void) const
   return get_funcs(NULL, false, "");
 }
 
+std::unique_ptr<std::istream> BTF::rawtracepoints(void) const
+{
+  return get_raw_tracepoints(NULL, false, "");
+}
+
 bool BTF::is_traceable_func(const std::string &func_name) const
 {
-  return traceable_funcs_.find(func_name) != traceable_funcs_.end();
+  return traceable_funcs_.contains(func_name);
 }
 
 } // namespace bpftrace
@@ -717,6 +1180,31 @@ std::string BTF::c_def(const std::unordered_set<std::string>& set
   return std::string("");
 }
 
+std::string BTF::c_def_closure(
+    const std::unordered_set<std::string>& set __attribute__((__unused__)),
+    const std::unordered_set<std::string>& defined
+    __attribute__((__unused__))) const
+{
+  return std::string("");
+}
+
+bool BTF::resolve_types(
+    const std::unordered_set<std::string>& set __attribute__((__unused__)),
+    std::map<std::string, Struct>& structs __attribute__((__unused__)),
+    std::map<std::string, uint64_t>& enums __attribute__((__unused__))) const
+{
+  return false;
+}
+
+bool BTF::resolve_tracepoint(
+    const std::string& event __attribute__((__unused__)),
+    const std::string& struct_name __attribute__((__unused__)),
+    std::map<std::string, Struct>& structs __attribute__((__unused__)),
+    std::map<std::string, uint64_t>& enums __attribute__((__unused__))) const
+{
+  return false;
+}
+
 std::string BTF::type_of(const std::string& name __attribute__((__unused__)),
                          const std::string& field __attribute__((__unused__))) {
   return std::string("");
@@ -730,16 +1218,32 @@ int BTF::resolve_args(const std::string &func __attribute__((__unused__)),
   return -1;
 }
 
+int BTF::resolve_raw_tracepoint_args(
+    const std::string& event __attribute__((__unused__)),
+    std::map<std::string, SizedType>& args __attribute__((__unused__)))
+{
+  return -1;
+}
+
 void BTF::display_kfunc(std::regex* re __attribute__((__unused__)),
                         const bool retporbe __attribute__((__unused__))) const
 {
 }
 
+void BTF::display_rawtracepoints(std::regex* re __attribute__((__unused__))) const
+{
+}
+
 std::unique_ptr<std::istream> BTF::kfunc(void) const
 {
   return nullptr;
 }
 
+std::unique_ptr<std::istream> BTF::rawtracepoints(void) const
+{
+  return nullptr;
+}
+
 void BTF::display_structs(std::regex* re __attribute__((__unused__))) const
 {
 }
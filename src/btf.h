@@ -1,12 +1,17 @@
 #pragma once
 
+#include "struct.h"
+#include "traceable_funcs.h"
 #include "types.h"
 #include <linux/types.h>
 #include <map>
+#include <memory>
 #include <regex>
 #include <string>
 #include <unistd.h>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 struct btf;
 struct btf_type;
@@ -27,28 +32,86 @@ public:
 
   bool has_data(void) const;
   std::string c_def(const std::unordered_set<std::string>& set) const;
+  // Like c_def(), also defining the structs and unions that the fields of
+  // those types point to, transitively, unless they are in `defined`
+  std::string c_def_closure(
+      const std::unordered_set<std::string>& set,
+      const std::unordered_set<std::string>& defined) const;
+  // Fill `structs` with the layouts of the structs and unions in `set` and
+  // of the ones they embed, and `enums` with the values of the enums among
+  // them, as ClangParser would from the definitions c_def() generates.
+  // Returns false if there is no BTF data.
+  bool resolve_types(const std::unordered_set<std::string>& set,
+                     std::map<std::string, Struct>& structs,
+                     std::map<std::string, uint64_t>& enums) const;
+  // Fill structs[struct_name] with the args of tracepoint `event`, from the
+  // kernel's struct trace_event_raw_<event>, with the fields named as in its
+  // format file. Returns false unless BTF shows that the vmlinux event is its
+  // own class, e.g. for events sharing the struct of another class, syscalls
+  // or modules.
+  bool resolve_tracepoint(const std::string& event,
+                          const std::string& struct_name,
+                          std::map<std::string, Struct>& structs,
+                          std::map<std::string, uint64_t>& enums) const;
   std::string type_of(const std::string& name, const std::string& field);
   std::string type_of(const btf_type* type, const std::string& field);
   void display_kfunc(std::regex* re, const bool retfunc) const;
+  void display_rawtracepoints(std::regex* re) const;
   void display_structs(std::regex* re) const;
 
   std::unique_ptr<std::istream> kfunc(void) const;
+  std::unique_ptr<std::istream> rawtracepoints(void) const;
 
   int resolve_args(const std::string &func,
                    std::map<std::string, SizedType>& args,
                    bool ret);
+  // Like resolve_args(), from the prototype of the kernel's
+  // btf_trace_<event> typedef, without its leading context argument
+  int resolve_raw_tracepoint_args(const std::string& event,
+                                  std::map<std::string, SizedType>& args);
+
+  const TraceableFuncs& traceable_funcs() const
+  {
+    return traceable_funcs_;
+  }
 
 private:
+  // Name lookups into the BTF data, built on first use so that a plain scan
+  // over all type ids is done at most once per run.
+  struct Index
+  {
+    // bare name ("task_struct") -> first type id, like btf__find_by_name
+    std::unordered_map<std::string, __u32> names;
+    // name as written in C ("struct task_struct", "pid_t") -> first type id
+    std::unordered_map<std::string, __u32> full_names;
+    // enumerator -> id of its enum
+    std::unordered_map<std::string, __u32> enum_values;
+    // function name -> BTF_KIND_FUNC id
+    std::unordered_map<std::string, __u32> funcs;
+    // ids of functions and of named structs, unions and enums, in id order
+    std::vector<__u32> func_ids;
+    std::vector<__u32> record_ids;
+    // ids of the btf_trace_<event> typedefs of raw tracepoints, in id order
+    std::vector<__u32> raw_tracepoint_ids;
+  };
+  const Index& index() const;
+
+  std::string dump_types(const std::unordered_set<std::string>& set,
+                         const std::unordered_set<std::string>* defined) const;
   SizedType get_stype(__u32 id);
   const struct btf_type* btf_type_skip_modifiers(const struct btf_type* t);
   std::unique_ptr<std::istream> get_funcs(std::regex* re,
                                           bool params,
                                           std::string prefix) const;
+  std::unique_ptr<std::istream> get_raw_tracepoints(std::regex* re,
+                                                    bool params,
+                                                    std::string prefix) const;
   bool is_traceable_func(const std::string& func_name) const;
 
   struct btf* btf;
   enum state state = NODATA;
-  std::unordered_set<std::string> traceable_funcs_;
+  TraceableFuncs traceable_funcs_;
+  mutable std::unique_ptr<Index> index_;
 };
 
 inline bool BTF::has_data(void) const
@@ -0,0 +1,195 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <regex>
+#include <sstream>
+
+#include <linux/bpf.h>
+
+#include <bcc/bcc_elf.h>
+#include <bcc/bcc_syms.h>
+
+#include "build_id_symbolizer.h"
+#include "log.h"
+
+namespace bpftrace {
+
+namespace {
+bool is_elf(const std::string &path)
+{
+  const char elf_magic[] = { 0x7f, 'E', 'L', 'F' };
+  char magic[sizeof(elf_magic)] = {};
+  std::ifstream file(path, std::ios::binary);
+  return file.read(magic, sizeof(magic)) &&
+         std::memcmp(magic, elf_magic, sizeof(magic)) == 0;
+}
+
+bool parse_build_id(const std::string &hex, uint8_t *build_id)
+{
+  if (hex.size() != BPF_BUILD_ID_SIZE * 2)
+    return false;
+  for (size_t i = 0; i < BPF_BUILD_ID_SIZE; i++)
+  {
+    try
+    {
+      build_id[i] = std::stoul(hex.substr(i * 2, 2), nullptr, 16);
+    }
+    catch (const std::exception &)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+BuildIdSymbolizer::BuildIdSymbolizer(const std::vector<std::string> &dirs)
+    : dirs_(dirs), symcache_(bcc_buildsymcache_new())
+{
+}
+
+BuildIdSymbolizer::~BuildIdSymbolizer()
+{
+  if (symcache_)
+    bcc_free_buildsymcache(symcache_);
+}
+
+std::string BuildIdSymbolizer::format(const uint8_t *build_id, uint64_t offset)
+{
+  std::ostringstream frame;
+  frame << std::hex << std::setfill('0');
+  for (size_t i = 0; i < BPF_BUILD_ID_SIZE; i++)
+    frame << std::setw(2) << static_cast<unsigned>(build_id[i]);
+  frame << "+0x" << offset;
+  return frame.str();
+}
+
+bool BuildIdSymbolizer::load(const std::string &build_id)
+{
+  auto cached = modules_.find(build_id);
+  if (cached != modules_.end())
+    return !cached->second.empty();
+
+  std::string &module = modules_[build_id];
+  auto add_module = [&](const std::string &path) {
+    std::error_code ec;
+    if (std::filesystem::is_regular_file(path, ec) &&
+        bcc_buildsymcache_add_module(symcache_, path.c_str()) == 0)
+      module = path;
+    return !module.empty();
+  };
+
+  // debuginfo trees, e.g. /usr/lib/debug, index their files by build-id
+  std::string indexed = ".build-id/" + build_id.substr(0, 2) + "/" +
+                        build_id.substr(2);
+  for (auto &dir : dirs_)
+  {
+    if (add_module(dir + "/" + indexed + ".debug") ||
+        add_module(dir + "/" + indexed))
+      return true;
+  }
+
+  if (!scanned_)
+    scan();
+  auto scanned = scanned_files_.find(build_id);
+  return scanned != scanned_files_.end() && add_module(scanned->second);
+}
+
+void BuildIdSymbolizer::scan()
+{
+  scanned_ = true;
+  for (auto &dir : dirs_)
+  {
+    std::error_code ec;
+    for (auto it = std::filesystem::recursive_directory_iterator(
+             dir,
+             std::filesystem::directory_options::skip_permission_denied,
+             ec);
+         it != std::filesystem::recursive_directory_iterator();
+         it.increment(ec))
+    {
+      if (ec)
+        break;
+      std::string path = it->path().string();
+      if (!it->is_regular_file(ec) || !is_elf(path))
+        continue;
+      char build_id[BPF_BUILD_ID_SIZE * 2 + 1] = {};
+      if (bcc_elf_get_buildid(path.c_str(), build_id) == 0)
+        scanned_files_.emplace(build_id, path);
+    }
+    if (ec)
+      LOG(WARNING) << "Failed to scan " << dir
+                   << " for build-ids: " << ec.message();
+  }
+}
+
+std::string BuildIdSymbolizer::resolve(const uint8_t *build_id,
+                                       uint64_t offset,
+                                       bool show_offset,
+                                       bool show_module,
+                                       bool demangle)
+{
+  std::string unresolved = format(build_id, offset);
+  if (!symcache_ || !load(unresolved.substr(0, unresolved.find('+'))))
+    return unresolved;
+
+  struct bpf_stack_build_id frame = {};
+  frame.status = BPF_STACK_BUILD_ID_VALID;
+  std::memcpy(frame.build_id, build_id, BPF_BUILD_ID_SIZE);
+  frame.offset = offset;
+
+  struct bcc_symbol sym;
+  if (bcc_buildsymcache_resolve(symcache_, &frame, &sym) != 0)
+    return unresolved;
+
+  std::ostringstream symbol;
+  if (demangle && sym.demangle_name)
+    symbol << sym.demangle_name;
+  else
+    symbol << sym.name;
+  if (show_offset)
+    symbol << "+" << sym.offset;
+  if (show_module)
+    symbol << " (" << sym.module << ")";
+  bcc_symbol_free_demangle_name(&sym);
+  return symbol.str();
+}
+
+void BuildIdSymbolizer::symbolize(std::istream &in, std::ostream &out)
+{
+  static const std::regex frame_re("\\b([0-9a-f]{40})\\+0x([0-9a-f]+)\\b");
+  std::string line;
+  while (std::getline(in, line))
+  {
+    std::string result;
+    auto last = line.cbegin();
+    for (std::sregex_iterator it(line.begin(), line.end(), frame_re), end;
+         it != end;
+         ++it)
+    {
+      auto &match = *it;
+      result.append(last, match[0].first);
+      uint8_t build_id[BPF_BUILD_ID_SIZE];
+      uint64_t offset;
+      try
+      {
+        offset = std::stoull(match[2].str(), nullptr, 16);
+      }
+      catch (const std::exception &)
+      {
+        offset = 0;
+      }
+      if (parse_build_id(match[1].str(), build_id) &&
+          format(build_id, offset) == match[0].str())
+        result += resolve(build_id, offset, true, false, true);
+      else
+        result += match[0].str();
+      last = match[0].second;
+    }
+    result.append(last, line.cend());
+    out << result << std::endl;
+  }
+}
+
+} // namespace bpftrace
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bpftrace {
+
+// Resolves the (build-id, offset) frames of ustack(build_id) against the
+// binaries and debuginfo found in local directories. Directories are
+// searched using the .build-id/xx/yyyy[.debug] layout of debuginfo trees
+// first, and scanned for ELF files only when that fails. Loaded modules are
+// cached by build-id, so each file is read at most once.
+class BuildIdSymbolizer
+{
+public:
+  explicit BuildIdSymbolizer(const std::vector<std::string> &dirs);
+  ~BuildIdSymbolizer();
+
+  BuildIdSymbolizer(const BuildIdSymbolizer &) = delete;
+  BuildIdSymbolizer &operator=(const BuildIdSymbolizer &) = delete;
+  BuildIdSymbolizer(BuildIdSymbolizer &&) = delete;
+  BuildIdSymbolizer &operator=(BuildIdSymbolizer &&) = delete;
+
+  /**
+     "symbol+offset" of the frame, or its unresolved form as returned by
+     format() when no module with this build-id is found
+  */
+  std::string resolve(const uint8_t *build_id,
+                      uint64_t offset,
+                      bool show_offset,
+                      bool show_module,
+                      bool demangle);
+
+  /**
+     Copy in to out, resolving every frame printed in its unresolved form
+  */
+  void symbolize(std::istream &in, std::ostream &out);
+
+  /**
+     Unresolved form of a frame: "<hex build-id>+0x<offset>"
+  */
+  static std::string format(const uint8_t *build_id, uint64_t offset);
+
+private:
+  bool load(const std::string &build_id);
+  void scan();
+
+  std::vector<std::string> dirs_;
+  void *symcache_ = nullptr;
+  bool scanned_ = false;
+  // hex build-id -> file providing it, or "" if none was found
+  std::unordered_map<std::string, std::string> modules_;
+  // files found by scanning dirs_, by hex build-id
+  std::unordered_map<std::string, std::string> scanned_files_;
+};
+
+} // namespace bpftrace
@@ -0,0 +1,244 @@
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <glob.h>
+#include <stdexcept>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <bcc/libbpf.h>
+
+#include "cgroup_filter.h"
+#include "log.h"
+#include "resolve_cgroupid.h"
+#include "utils.h"
+
+namespace bpftrace {
+
+namespace {
+const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_DELETE_SELF |
+                            IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+std::string join_path(const std::string &dir, const std::string &name)
+{
+  if (dir == "/")
+    return dir + name;
+  return dir + "/" + name;
+}
+
+// directories matching a single path component in dir
+std::vector<std::string> match_component(const std::string &dir,
+                                         const std::string &component)
+{
+  std::vector<std::string> matches;
+  std::string path = join_path(dir, component);
+  if (!has_wildcard(component))
+  {
+    std::error_code ec;
+    if (std::filesystem::is_directory(path, ec))
+      matches.push_back(path);
+    return matches;
+  }
+
+  glob_t globbuf;
+  if (::glob(path.c_str(), GLOB_ONLYDIR | GLOB_NOSORT, nullptr, &globbuf) ==
+      0)
+  {
+    for (size_t i = 0; i < globbuf.gl_pathc; i++)
+    {
+      std::error_code ec;
+      if (std::filesystem::is_directory(globbuf.gl_pathv[i], ec))
+        matches.push_back(globbuf.gl_pathv[i]);
+    }
+  }
+  globfree(&globbuf);
+  return matches;
+}
+} // namespace
+
+CgroupFilter::CgroupFilter(const std::vector<std::string> &patterns)
+    : patterns_(patterns)
+{
+}
+
+CgroupFilter::~CgroupFilter()
+{
+  if (inotify_fd_ >= 0)
+    close(inotify_fd_);
+}
+
+std::set<std::string> CgroupFilter::match(const std::string &pattern,
+                                          std::set<std::string> &watch_dirs)
+{
+  auto components = split_string(pattern, '/', true);
+  std::vector<std::string> dirs = { pattern[0] == '/' ? "/" : "." };
+
+  // Directories above the first wildcard can't gain new matches, except
+  // for the parent of a plain path, in which the cgroup may be created
+  // later
+  bool wildcard = false;
+  for (size_t i = 0; i < components.size(); i++)
+  {
+    wildcard |= has_wildcard(components[i]);
+    if (wildcard || i == components.size() - 1)
+      watch_dirs.insert(dirs.begin(), dirs.end());
+
+    std::vector<std::string> next;
+    for (auto &dir : dirs)
+    {
+      auto matches = match_component(dir, components[i]);
+      next.insert(next.end(), matches.begin(), matches.end());
+    }
+    dirs = std::move(next);
+  }
+
+  std::set<std::string> result;
+  for (auto &dir : dirs)
+  {
+    result.insert(dir);
+    std::error_code ec;
+    for (auto it = std::filesystem::recursive_directory_iterator(
+             dir,
+             std::filesystem::directory_options::skip_permission_denied,
+             ec);
+         it != std::filesystem::recursive_directory_iterator();
+         it.increment(ec))
+    {
+      if (ec)
+        break;
+      if (it->is_directory(ec))
+        result.insert(it->path().string());
+    }
+  }
+  // descendants can be created in any of the matches
+  watch_dirs.insert(result.begin(), result.end());
+  return result;
+}
+
+void CgroupFilter::attach(int mapfd)
+{
+  mapfd_ = mapfd;
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ < 0)
+    throw std::runtime_error(std::string("Failed to initialize inotify: ") +
+                             strerror(errno));
+  sync();
+}
+
+void CgroupFilter::sync()
+{
+  // The events only tell that something changed, so drain them and match
+  // all patterns again. The watch of a removed directory is gone, even if a
+  // directory of the same name is created before this sync.
+  char buf[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t len;
+  while ((len = read(inotify_fd_, buf, sizeof(buf))) > 0)
+  {
+    const struct inotify_event *event;
+    for (char *p = buf; p < buf + len; p += sizeof(*event) + event->len)
+    {
+      event = reinterpret_cast<const struct inotify_event *>(p);
+      if (event->mask & (IN_IGNORED | IN_DELETE_SELF))
+        forget_watch(event->wd);
+    }
+  }
+
+  // Cgroups created in a directory before it is watched would be missed,
+  // so match again until no new directories need watching
+  std::map<uint64_t, std::string> ids;
+  bool new_watches = true;
+  while (new_watches)
+  {
+    std::set<std::string> watch_dirs;
+    ids.clear();
+    for (auto &pattern : patterns_)
+    {
+      for (auto &path : match(pattern, watch_dirs))
+      {
+        try
+        {
+          ids[bpftrace_linux::resolve_cgroupid(path)] = path;
+        }
+        catch (const std::runtime_error &)
+        {
+          // the cgroup was removed while matching
+        }
+      }
+    }
+
+    new_watches = false;
+    for (auto &dir : watch_dirs)
+    {
+      if (watched_.count(dir))
+        continue;
+      int wd = inotify_add_watch(inotify_fd_, dir.c_str(), WATCH_MASK);
+      if (wd < 0)
+      {
+        // a directory removed since it was matched needs no watch
+        if (errno != ENOENT && unwatchable_.insert(dir).second)
+          LOG(WARNING) << "Failed to watch " << dir
+                       << ", cgroups created in it will not be traced: "
+                       << strerror(errno);
+        continue;
+      }
+      watched_[dir] = wd;
+      new_watches = true;
+    }
+
+    // Directories that can no longer hold a match need no watch either
+    for (auto it = watched_.begin(); it != watched_.end();)
+    {
+      if (watch_dirs.count(it->first))
+      {
+        ++it;
+        continue;
+      }
+      int wd = it->second;
+      it = watched_.erase(it);
+      if (!watches(wd))
+        inotify_rm_watch(inotify_fd_, wd);
+    }
+  }
+
+  uint64_t traced = 1;
+  for (auto &id : ids)
+  {
+    uint64_t key = id.first;
+    if (ids_.find(key) == ids_.end() &&
+        bpf_update_elem(mapfd_, &key, &traced, 0) < 0)
+    {
+      LOG(WARNING) << "Failed to add cgroup " << id.second
+                   << " to the cgroup filter: " << strerror(errno);
+    }
+  }
+  for (auto &id : ids_)
+  {
+    uint64_t key = id.first;
+    if (ids.find(key) == ids.end())
+      bpf_delete_elem(mapfd_, &key);
+  }
+  ids_ = std::move(ids);
+}
+
+bool CgroupFilter::watches(int wd) const
+{
+  for (auto &watch : watched_)
+    if (watch.second == wd)
+      return true;
+  return false;
+}
+
+void CgroupFilter::forget_watch(int wd)
+{
+  // the same directory can be watched under several paths, with one wd
+  for (auto it = watched_.begin(); it != watched_.end();)
+  {
+    if (it->second == wd)
+      it = watched_.erase(it);
+    else
+      ++it;
+  }
+}
+
+} // namespace bpftrace
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace bpftrace {
+
+// Keeps a BPF map of cgroup ids in sync with the cgroups matching a list of
+// paths or globs. Matching cgroups are traced together with all of their
+// descendants. Cgroups created or removed later are picked up through inotify
+// watches on the directories they can appear in.
+class CgroupFilter
+{
+public:
+  explicit CgroupFilter(const std::vector<std::string> &patterns);
+  ~CgroupFilter();
+
+  CgroupFilter(const CgroupFilter &) = delete;
+  CgroupFilter &operator=(const CgroupFilter &) = delete;
+  CgroupFilter(CgroupFilter &&) = delete;
+  CgroupFilter &operator=(CgroupFilter &&) = delete;
+
+  /**
+     Start keeping mapfd in sync. Throws std::runtime_error if inotify is
+     not available.
+  */
+  void attach(int mapfd);
+
+  /**
+     Consume pending inotify events and update the map to the cgroups
+     currently matching
+  */
+  void sync();
+
+  /**
+     inotify file descriptor, readable when the map needs a sync()
+  */
+  int fd() const
+  {
+    return inotify_fd_;
+  }
+
+  size_t num_cgroups() const
+  {
+    return ids_.size();
+  }
+
+  /**
+     Directories matching pattern, including their descendants. The
+     directories a new match could be created in are added to watch_dirs.
+  */
+  static std::set<std::string> match(const std::string &pattern,
+                                     std::set<std::string> &watch_dirs);
+
+private:
+  bool watches(int wd) const;
+  // Drop the entries of a watch that the kernel removed
+  void forget_watch(int wd);
+
+  std::vector<std::string> patterns_;
+  int inotify_fd_ = -1;
+  int mapfd_ = -1;
+  std::map<uint64_t, std::string> ids_;
+  // watched directory -> inotify watch descriptor
+  std::map<std::string, int> watched_;
+  // directories that could not be watched, reported once
+  std::set<std::string> unwatchable_;
+};
+
+} // namespace bpftrace
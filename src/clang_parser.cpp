@@ -1,6 +1,11 @@
+#include <algorithm>
 #include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <regex>
+#include <sstream>
+#include <unistd.h>
 #include <vector>
 
 #include "llvm/Config/llvm-config.h"
@@ -11,6 +16,7 @@
 #include "field_analyser.h"
 #include "headers.h"
 #include "log.h"
+#include "program_serializer.h"
 #include "types.h"
 #include "utils.h"
 
@@ -71,6 +77,81 @@ std::vector<CXUnsavedFile> getTranslationUnitFiles(
 
   return files;
 }
+
+const std::string PCH_MAGIC = "bpftrace-pch";
+const char *const PCH_PREAMBLE = "/bpftrace/preamble.h";
+
+// Split the #include lines the C definitions start with from the rest, in
+// which they are blanked to keep the line numbers of diagnostics
+std::pair<std::string, std::string> split_preamble(const std::string &defs)
+{
+  std::string preamble, rest;
+  size_t pos = 0;
+  while (pos < defs.size())
+  {
+    size_t end = defs.find('\n', pos);
+    if (end == std::string::npos)
+      end = defs.size();
+    size_t first = defs.find_first_not_of(" \t", pos);
+    if (first < end && defs.compare(first, 8, "#include") != 0)
+      break;
+    preamble += defs.substr(pos, end - pos) + "\n";
+    rest += "\n";
+    pos = end + 1;
+  }
+  if (pos < defs.size())
+    rest += defs.substr(pos);
+  return { preamble, rest };
+}
+
+std::vector<const char *> without_includes(
+    const std::vector<const char *> &args)
+{
+  std::vector<const char *> result;
+  for (size_t i = 0; i < args.size(); i++)
+  {
+    if (std::strcmp(args[i], "-include") == 0 && i + 1 < args.size())
+      i++;
+    else
+      result.push_back(args[i]);
+  }
+  return result;
+}
+
+// true if the headers a precompiled header was built from, which are appended
+// to `files`, are unchanged
+bool pch_is_current(const std::string &pch,
+                    const std::string &deps,
+                    const std::string &key,
+                    std::vector<std::string> &files)
+{
+  if (access(deps.c_str(), F_OK) != 0 || access(pch.c_str(), F_OK) != 0)
+    return false;
+  // clang trusts the precompiled header as much as the headers themselves
+  if (!is_private_file(deps) || !is_private_file(pch))
+  {
+    LOG(WARNING) << "Ignoring precompiled header " << pch
+                 << ": not owned by the current user or writable by others";
+    return false;
+  }
+
+  std::ifstream in(deps, std::ios::binary);
+  try
+  {
+    // the file name is only a hash of the key
+    if (read_str(in) != PCH_MAGIC || read_str(in) != key)
+      return false;
+    std::vector<std::string> deps_files;
+    if (!check_file_versions(in, &deps_files))
+      return false;
+    files.insert(files.end(), deps_files.begin(), deps_files.end());
+  }
+  catch (const std::runtime_error &e)
+  {
+    return false;
+  }
+  return true;
+}
 } // namespace
 
 static std::string get_clang_string(CXString string)
@@ -80,6 +161,24 @@ static std::string get_clang_string(CXString string)
   return str;
 }
 
+// The files a translation unit included from disk. The in-memory ones are
+// generated by bpftrace or part of the script.
+static std::vector<std::string> disk_inclusions(CXTranslationUnit tu)
+{
+  std::vector<std::string> files;
+  clang_getInclusions(
+      tu,
+      [](CXFile file, CXSourceLocation *, unsigned, CXClientData data) {
+        auto files = static_cast<std::vector<std::string> *>(data);
+        auto name = get_clang_string(clang_getFileName(file));
+        if (name != PCH_PREAMBLE && name != "definitions.h" &&
+            name.rfind("/bpftrace/include/", 0) != 0)
+          files->push_back(name);
+      },
+      &files);
+  return files;
+}
+
 /*
  * is_anonymous
  *
@@ -332,7 +431,8 @@ static SizedType get_sized_type(CXType clang_type)
 
 ClangParser::ClangParserHandler::ClangParserHandler()
 {
-  index = clang_createIndex(1, 1);
+  // The declarations from precompiled headers are visited like the others
+  index = clang_createIndex(0, 1);
 }
 
 ClangParser::ClangParserHandler::~ClangParserHandler()
@@ -470,7 +570,7 @@ std::unordered_set<std::string> ClangParser::get_incomplete_types(
     const std::string &input,
     std::vector<CXUnsavedFile> &unsaved_files,
     const std::vector<const char *> &args,
-    const std::unordered_set<std::string> &complete_types)
+    std::unordered_set<std::string> &complete_types)
 {
   if (input.empty())
     return {};
@@ -513,11 +613,9 @@ std::unordered_set<std::string> ClangParser::get_incomplete_types(
 
   struct TypeData
   {
-    std::unordered_set<std::string> complete_types;
+    std::unordered_set<std::string> &complete_types;
     std::unordered_set<std::string> incomplete_types;
-  } type_data;
-  // Initialize to already defined types
-  type_data.complete_types = complete_types;
+  } type_data{ complete_types, {} };
 
   // Search for error messages of the form:
   //   unknown type name 'type_t'
@@ -572,8 +670,101 @@ std::unordered_set<std::string> ClangParser::get_incomplete_types(
   return type_data.incomplete_types;
 }
 
+std::string ClangParser::get_pch(const std::string &preamble,
+                                 std::vector<CXUnsavedFile> unsaved_files,
+                                 const std::vector<const char *> &args)
+{
+  std::ostringstream key;
+  write_str(key, PCH_MAGIC);
+  write_str(key, get_clang_string(clang_getClangVersion()));
+  write_str(key, preamble);
+  write_u64(key, args.size());
+  for (auto arg : args)
+    write_str(key, arg);
+  for (auto &header : getDefaultHeaders())
+    write_str(key, std::string(header.Contents, header.Length));
+
+  std::ostringstream name;
+  name << std::hex << std::setfill('0') << std::setw(16)
+       << std::hash<std::string>{}(key.str());
+  std::string pch = pch_dir_ + "/" + name.str() + ".pch";
+  std::string deps = pch_dir_ + "/" + name.str() + ".deps";
+  if (pch_is_current(pch, deps, key.str(), included_files_))
+    return pch;
+
+  unsaved_files.emplace_back(CXUnsavedFile{
+      .Filename = PCH_PREAMBLE,
+      .Contents = preamble.c_str(),
+      .Length = preamble.size(),
+  });
+  std::vector<const char *> pch_args = args;
+  pch_args.push_back("-x");
+  pch_args.push_back("c-header");
+
+  ClangParserHandler handler;
+  CXErrorCode error;
+  {
+    // Errors are reported by the regular parse
+    StderrSilencer silencer;
+    silencer.silence();
+    error = handler.parse_translation_unit(
+        PCH_PREAMBLE,
+        pch_args.data(),
+        pch_args.size(),
+        unsaved_files.data(),
+        unsaved_files.size(),
+        CXTranslationUnit_DetailedPreprocessingRecord |
+            CXTranslationUnit_Incomplete |
+            CXTranslationUnit_ForSerialization);
+  }
+  std::vector<std::string> diag_msgs;
+  if (error || !handler.check_diagnostics(preamble, diag_msgs, true))
+    return "";
+
+  // The in-memory headers are part of the key, so only the files read from
+  // disk are checked for changes
+  auto files = disk_inclusions(handler.get_translation_unit());
+  std::ostringstream entry;
+  write_str(entry, PCH_MAGIC);
+  write_str(entry, key.str());
+  if (!write_file_versions(entry, files))
+    return "";
+
+  // The header goes in place before the file declaring it current
+  auto translation_unit = handler.get_translation_unit();
+  bool saved = write_private_file(pch, [&](const std::string &path) {
+    return clang_saveTranslationUnit(translation_unit,
+                                     path.c_str(),
+                                     clang_defaultSaveOptions(
+                                         translation_unit)) ==
+           CXSaveError_None;
+  });
+  saved = saved && write_private_file(deps, [&](const std::string &path) {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out << entry.str();
+            out.close();
+            return !out.fail();
+          });
+  if (!saved)
+  {
+    LOG(WARNING) << "Failed to save the precompiled header to " << pch;
+    return "";
+  }
+  included_files_.insert(included_files_.end(), files.begin(), files.end());
+  return pch;
+}
+
 bool ClangParser::parse(ast::Program *program, BPFtrace &bpftrace, std::vector<std::string> extra_flags)
 {
+  included_files_.clear();
+
+  // Without C definitions to compile, the layouts of the types the program
+  // uses are read from BTF directly
+  if (program->c_definitions.empty() && bpftrace.btf_.has_data())
+    return bpftrace.btf_.resolve_types(bpftrace.btf_set_,
+                                       bpftrace.structs_,
+                                       bpftrace.enums_);
+
   auto input = "#include <__btf_generated_header.h>\n" + program->c_definitions;
 
   auto input_files = getTranslationUnitFiles(CXUnsavedFile{
@@ -616,38 +807,79 @@ bool ClangParser::parse(ast::Program *program, BPFtrace &bpftrace, std::vector<s
       .Length = btf_cdef.size(),
   });
 
-  ClangParserHandler handler;
-  bool check_additional_types = true;
-  while (check_additional_types && process_btf)
+  if (process_btf && bpftrace.btf_.has_data())
   {
+    // Types missing from the user's definitions can only be found by clang.
+    // The types they embed are then resolved in BTF directly, which spares
+    // reparsing the generated header until no new type shows up. The ones
+    // they only point to are forward declared.
+    std::unordered_set<std::string> defined_types = bpftrace.btf_set_;
     auto incomplete_types = get_incomplete_types(
-        input, input_files, args, bpftrace.btf_set_);
-    size_t types_cnt = bpftrace.btf_set_.size();
+        input, input_files, args, defined_types);
     bpftrace.btf_set_.insert(incomplete_types.cbegin(),
                              incomplete_types.cend());
+    btf_cdef = bpftrace.btf_.c_def_closure(bpftrace.btf_set_, defined_types);
 
-    // Update generated header with current BTF types
-    btf_cdef = bpftrace.btf_.c_def(bpftrace.btf_set_);
     input_files.back() = CXUnsavedFile{
       .Filename = "/bpftrace/include/__btf_generated_header.h",
       .Contents = btf_cdef.c_str(),
       .Length = btf_cdef.size(),
     };
+  }
 
-    // If additional BTF types were found, we need to repeat the process since
-    // that might have introduced some new unresolved typedefs.
-    check_additional_types = types_cnt != bpftrace.btf_set_.size();
+  // Parsing the headers the definitions start with dominates, in particular
+  // kernel headers, so they are precompiled once. The generated BTF header
+  // is specific to each program, which rules it out when processing BTF.
+  std::string pch, preamble, rest;
+  std::vector<const char *> parse_args = args;
+  if (!pch_dir_.empty() && !process_btf)
+  {
+    std::tie(preamble, rest) = split_preamble(program->c_definitions);
+    pch = get_pch(preamble, input_files, args);
+    if (!pch.empty())
+    {
+      input = "#include <__btf_generated_header.h>\n" + rest;
+      input_files.front().Contents = input.c_str();
+      input_files.front().Length = input.size();
+      // clang checks the files the header was built from to be unchanged
+      input_files.emplace_back(CXUnsavedFile{
+          .Filename = PCH_PREAMBLE,
+          .Contents = preamble.c_str(),
+          .Length = preamble.size(),
+      });
+      // the forced includes are part of the precompiled header
+      parse_args = without_includes(args);
+      parse_args.push_back("-include-pch");
+      parse_args.push_back(pch.c_str());
+    }
   }
 
+  auto handler = std::make_unique<ClangParserHandler>();
   CXErrorCode error;
-  error = handler.parse_translation_unit(
+  error = handler->parse_translation_unit(
       "definitions.h",
-      args.data(),
-      args.size(),
+      parse_args.data(),
+      parse_args.size(),
       input_files.data(),
       input_files.size(),
       CXTranslationUnit_DetailedPreprocessingRecord);
 
+  if (error && !pch.empty())
+  {
+    // An unusable precompiled header only costs the time it would save
+    input = "#include <__btf_generated_header.h>\n" + program->c_definitions;
+    input_files.front().Contents = input.c_str();
+    input_files.front().Length = input.size();
+    handler = std::make_unique<ClangParserHandler>();
+    error = handler->parse_translation_unit(
+        "definitions.h",
+        args.data(),
+        args.size(),
+        input_files.data(),
+        input_files.size(),
+        CXTranslationUnit_DetailedPreprocessingRecord);
+  }
+
   if (error)
   {
     if (bt_debug == DebugLevel::kFullDebug) {
@@ -658,7 +890,7 @@ bool ClangParser::parse(ast::Program *program, BPFtrace &bpftrace, std::vector<s
   }
 
   std::vector<std::string> error_msgs;
-  if (!handler.check_diagnostics(input, error_msgs, true))
+  if (!handler->check_diagnostics(input, error_msgs, true))
   {
     for (auto &msg : error_msgs)
     {
@@ -671,7 +903,14 @@ bool ClangParser::parse(ast::Program *program, BPFtrace &bpftrace, std::vector<s
     return false;
   }
 
-  CXCursor cursor = handler.get_translation_unit_cursor();
+  for (auto &file : disk_inclusions(handler->get_translation_unit()))
+  {
+    if (std::find(included_files_.begin(), included_files_.end(), file) ==
+        included_files_.end())
+      included_files_.push_back(file);
+  }
+
+  CXCursor cursor = handler->get_translation_unit_cursor();
   return visit_children(cursor, bpftrace);
 }
 
@@ -20,7 +20,29 @@ public:
              BPFtrace &bpftrace,
              std::vector<std::string> extra_flags = {});
 
+  /*
+   * Keep the headers included at the top of the C definitions precompiled in
+   * dir, to be reused by later runs with the same flags and headers.
+   */
+  void set_pch_dir(const std::string &dir)
+  {
+    pch_dir_ = dir;
+  }
+
+  /*
+   * The files read from disk by parse(), such as the headers the C
+   * definitions include, directly, through -include or through a
+   * precompiled header.
+   */
+  const std::vector<std::string> &included_files() const
+  {
+    return included_files_;
+  }
+
 private:
+  std::string pch_dir_;
+  std::vector<std::string> included_files_;
+
   bool visit_children(CXCursor &cursor, BPFtrace &bpftrace);
   /*
    * The user might have written some struct definitions that rely on types
@@ -29,7 +51,8 @@ private:
    *
    * This method will pull out any forward-declared / incomplete struct
    * and typedef definitions and return the types (in string form) of
-   * the unresolved types.
+   * the unresolved types. The types defined in the input are added to
+   * complete_types.
    *
    * Note that this method does not report "errors". This is because the user
    * could have typo'd and actually referenced a non-existent type. Put
@@ -39,7 +62,17 @@ private:
       const std::string &input,
       std::vector<CXUnsavedFile> &unsaved_files,
       const std::vector<const char *> &args,
-      const std::unordered_set<std::string> &complete_types);
+      std::unordered_set<std::string> &complete_types);
+
+  /*
+   * Return the path of a precompiled header for preamble, building it if the
+   * cached one is missing or any of the headers it was built from changed.
+   * Return an empty string if it cannot be built, e.g. on errors in the
+   * headers, which are then reported by the regular parse.
+   */
+  std::string get_pch(const std::string &preamble,
+                      std::vector<CXUnsavedFile> unsaved_files,
+                      const std::vector<const char *> &args);
 
   static std::optional<std::string> get_unknown_type(
       const std::string &diagnostic_msg);
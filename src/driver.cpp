@@ -1,6 +1,7 @@
 #include <iostream>
 
 #include "ast/attachpoint_parser.h"
+#include "ast/pid_filter_fork.h"
 #include "driver.h"
 #include "log.h"
 
@@ -39,7 +40,19 @@ int Driver::parse()
   // Reset source location info on every pass
   loc.initialize();
   yy_scan_string(Log::get().get_source().c_str(), scanner_);
-  parser_->parse();
+  auto arena = std::make_unique<ast::Arena>();
+  auto *previous_root = root_.get();
+  {
+    ast::Arena::Scope scope(*arena);
+    parser_->parse();
+  }
+  if (root_ && root_.get() != previous_root)
+    root_->arena = std::move(arena);
+
+  // --follow-forks adds its probe to every new tree, before the analysers
+  if (root_ && root_.get() != previous_root &&
+      bpftrace_.pid_filter_follow_forks_)
+    ast::add_pid_filter_fork_probe(*root_);
 
   ast::AttachPointParser ap_parser(root_.get(), bpftrace_, out_);
   if (ap_parser.parse())
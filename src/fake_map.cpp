@@ -10,7 +10,9 @@ FakeMap::FakeMap(const std::string &name,
                  int min __attribute__((unused)),
                  int max __attribute__((unused)),
                  int step __attribute__((unused)),
-                 int max_entries __attribute__((unused)))
+                 int max_entries __attribute__((unused)),
+                 bool lru __attribute__((unused)),
+                 bool no_prealloc __attribute__((unused)))
 {
   name_ = name;
   mapfd_ = next_mapfd_++;
@@ -19,13 +21,16 @@ FakeMap::FakeMap(const std::string &name,
 FakeMap::FakeMap(const std::string &name,
                  const SizedType &type __attribute__((unused)),
                  const MapKey &key __attribute__((unused)),
-                 int max_entries __attribute__((unused)))
+                 int max_entries __attribute__((unused)),
+                 bool lru __attribute__((unused)),
+                 bool no_prealloc __attribute__((unused)))
 {
   name_ = name;
   mapfd_ = next_mapfd_++;
 }
 
-FakeMap::FakeMap(const SizedType &type __attribute__((unused)))
+FakeMap::FakeMap(const SizedType &type __attribute__((unused)),
+                 int max_entries __attribute__((unused)))
 {
   mapfd_ = next_mapfd_++;
 }
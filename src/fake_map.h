@@ -10,8 +10,10 @@ public:
   FakeMap(const std::string &name,
           const SizedType &type,
           const MapKey &key,
-          int max_entries = 0);
-  FakeMap(const SizedType &type);
+          int max_entries = 0,
+          bool lru = false,
+          bool no_prealloc = false);
+  FakeMap(const SizedType &type, int max_entries);
   FakeMap(enum bpf_map_type map_type);
   FakeMap(const std::string &name,
           const SizedType &type,
@@ -19,7 +21,9 @@ public:
           int min,
           int max,
           int step,
-          int max_entries);
+          int max_entries,
+          bool lru = false,
+          bool no_prealloc = false);
 
   static int next_mapfd_;
 };
@@ -22,11 +22,21 @@ public:
   SizedType type_;
   MapKey key_;
   enum bpf_map_type map_type_;
+  int key_size_ = 0;
+  int value_size_ = 0;
+  int max_entries_ = 0;
+  int flags_ = 0;
   bool is_per_cpu_type()
   {
     return map_type_ == BPF_MAP_TYPE_PERCPU_HASH ||
+           map_type_ == BPF_MAP_TYPE_LRU_PERCPU_HASH ||
            map_type_ == BPF_MAP_TYPE_PERCPU_ARRAY;
   }
+  bool is_lru_type()
+  {
+    return map_type_ == BPF_MAP_TYPE_LRU_HASH ||
+           map_type_ == BPF_MAP_TYPE_LRU_PERCPU_HASH;
+  }
 
   // unique id of this map. Used by (bpf) runtime to reference
   // this map
@@ -35,6 +45,9 @@ public:
   int lqmin;
   int lqmax;
   int lqstep;
+  // used by llhist() and quantiles(): log2 of the number of sub-buckets per
+  // power of 2
+  int llbits = 0;
 };
 
 } // namespace bpftrace
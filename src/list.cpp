@@ -226,6 +226,43 @@ static void list_tracepoints(const std::string& search, const std::regex& re)
   }
 }
 
+static void list_rawtracepoints(const BPFtrace& bpftrace,
+                                const std::string& search,
+                                std::regex& re)
+{
+  if (bpftrace.btf_.has_data())
+  {
+    bpftrace.btf_.display_rawtracepoints(search.empty() ? nullptr : &re);
+    return;
+  }
+
+  // Without BTF, list the raw tracepoints of the events in tracefs
+  std::vector<std::string> cats;
+  list_dir(tp_path, cats);
+  for (const std::string& cat : cats)
+  {
+    if (cat == "." || cat == ".." || cat == "enable" || cat == "filter")
+      continue;
+    std::vector<std::string> events;
+    list_dir(tp_path + "/" + cat, events);
+    for (const std::string& event : events)
+    {
+      if (event == "." || event == ".." || event == "enable" ||
+          event == "filter")
+        continue;
+      std::string probe = "rawtracepoint:" + event;
+
+      if (!search.empty())
+      {
+        if (search_probe(probe, re))
+          continue;
+      }
+
+      std::cout << probe << std::endl;
+    }
+  }
+}
+
 static void list_kprobes(const std::string& search,
                          const std::regex& re,
                          const bool retprobe = false)
@@ -325,6 +362,10 @@ void list_probes(const BPFtrace& bpftrace, const std::string& search_input)
   if (list_all || probe_name == "tracepoint")
     list_tracepoints(search, re);
 
+  // raw tracepoints
+  if (list_all || probe_name == "rawtracepoint")
+    list_rawtracepoints(bpftrace, search, re);
+
   // kprobes
   if (list_all || probe_name == "kprobe" || probe_name == "kretprobe")
     list_kprobes(search, re, probe_name == "kretprobe");
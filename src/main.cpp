@@ -11,8 +11,8 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "bpf_object.h"
 #include "bpffeature.h"
-#include "bpforc.h"
 #include "bpftrace.h"
 #include "child.h"
 #include "clang_parser.h"
@@ -25,6 +25,8 @@
 #include "output.h"
 #include "printer.h"
 #include "procmon.h"
+#include "program_bundle.h"
+#include "program_cache.h"
 #include "semantic_analyser.h"
 #include "tracepoint_format_parser.h"
 
@@ -46,6 +48,7 @@ void usage()
   std::cerr << "    bpftrace [options] filename" << std::endl;
   std::cerr << "    bpftrace [options] - <stdin input>" << std::endl;
   std::cerr << "    bpftrace [options] -e 'program'" << std::endl;
+  std::cerr << "    bpftrace [options] --run-bundle FILE" << std::endl;
   std::cerr << std::endl;
   std::cerr << "OPTIONS:" << std::endl;
   std::cerr << "    -B MODE        output buffering mode ('full', 'none')" << std::endl;
@@ -59,13 +62,26 @@ void usage()
   std::cerr << "    -I DIR         add the directory to the include search path" << std::endl;
   std::cerr << "    --include FILE add an #include file before preprocessing" << std::endl;
   std::cerr << "    -l [search]    list probes" << std::endl;
-  std::cerr << "    -p PID         enable USDT probes on PID" << std::endl;
+  std::cerr << "    -p PID         enable USDT probes on PID and only trace PID" << std::endl;
+  std::cerr << "    --pids PID,... only trace the listed PIDs" << std::endl;
+  std::cerr << "    --follow-forks also trace the children forked by the traced PIDs" << std::endl;
+  std::cerr << "    --cgroups PATH,..." << std::endl;
+  std::cerr << "                   only trace the cgroups matching the paths or globs, and their descendants" << std::endl;
+  std::cerr << "    --symbolize DIR,..." << std::endl;
+  std::cerr << "                   resolve the build-id frames read from stdin with the binaries in DIRs" << std::endl;
+  std::cerr << "    --emit-bundle FILE" << std::endl;
+  std::cerr << "                   compile the program into FILE instead of running it" << std::endl;
+  std::cerr << "    --run-bundle FILE" << std::endl;
+  std::cerr << "                   run the program compiled into FILE by --emit-bundle" << std::endl;
+  std::cerr << "    --allow-bundle-mismatch" << std::endl;
+  std::cerr << "                   run a bundle compiled for another kernel or versions of the traced binaries" << std::endl;
   std::cerr << "    -c 'CMD'       run CMD and enable USDT probes on resulting process" << std::endl;
   std::cerr << "    --usdt-file-activation" << std::endl;
   std::cerr << "                   activate usdt semaphores based on file path" << std::endl;
   std::cerr << "    --unsafe       allow unsafe builtin functions" << std::endl;
   std::cerr << "    -v             verbose messages" << std::endl;
   std::cerr << "    --info         Print information about kernel BPF support" << std::endl;
+  std::cerr << "    -O LEVEL       optimization level of the BPF programs, 0 to 3 [default: 3]" << std::endl;
   std::cerr << "    -k             emit a warning when a bpf helper returns an error (except read functions)" << std::endl;
   std::cerr << "    -kk            check all bpf helper functions" << std::endl;
   std::cerr << "    -V, --version  bpftrace version" << std::endl;
@@ -75,6 +91,11 @@ void usage()
   std::cerr << "    BPFTRACE_STRLEN             [default: 64] bytes on BPF stack per str()" << std::endl;
   std::cerr << "    BPFTRACE_NO_CPP_DEMANGLE    [default: 0] disable C++ symbol demangling" << std::endl;
   std::cerr << "    BPFTRACE_MAP_KEYS_MAX       [default: 4096] max keys in a map" << std::endl;
+  std::cerr << "    BPFTRACE_MAP_SIZES          [default: none] max keys of individual maps, e.g. @a=1024,@b=16" << std::endl;
+  std::cerr << "    BPFTRACE_STACK_MAP_SIZE     [default: 4096] max stacks in a stack map" << std::endl;
+  std::cerr << "    BPFTRACE_STACK_REUSE_IDS    [default: 0] replace the stored stack when a new stack gets the same id" << std::endl;
+  std::cerr << "    BPFTRACE_LRU_MAPS           [default: none] comma separated maps that evict least recently used keys when full" << std::endl;
+  std::cerr << "    BPFTRACE_NO_PREALLOC_MAPS   [default: none] comma separated maps that allocate keys on demand" << std::endl;
   std::cerr << "    BPFTRACE_CAT_BYTES_MAX      [default: 10k] maximum bytes read by cat builtin" << std::endl;
   std::cerr << "    BPFTRACE_MAX_PROBES         [default: 512] max number of probes" << std::endl;
   std::cerr << "    BPFTRACE_LOG_SIZE           [default: 1000000] log size in bytes" << std::endl;
@@ -83,6 +104,8 @@ void usage()
   std::cerr << "    BPFTRACE_CACHE_USER_SYMBOLS [default: auto] enable user symbol cache" << std::endl;
   std::cerr << "    BPFTRACE_VMLINUX            [default: none] vmlinux path used for kernel symbol resolution" << std::endl;
   std::cerr << "    BPFTRACE_BTF                [default: none] BTF file" << std::endl;
+  std::cerr << "    BPFTRACE_BUILD_ID_DIRS      [default: none] comma separated directories used to resolve ustack(build_id) frames" << std::endl;
+  std::cerr << "    BPFTRACE_CACHE_DIR          [default: none] directory caching compiled programs across runs" << std::endl;
   std::cerr << std::endl;
   std::cerr << "EXAMPLES:" << std::endl;
   std::cerr << "bpftrace -l '*sleep*'" << std::endl;
@@ -252,21 +275,79 @@ static std::optional<struct timespec> get_boottime()
   return ret;
 }
 
+static bool is_map_name(const std::string &name)
+{
+  return name.size() > 1 && name[0] == '@';
+}
+
+// Reads a comma separated list of map names, e.g. "@a,@b"
+static bool get_map_names_env_var(const std::string &str,
+                                  std::unordered_set<std::string> &dest)
+{
+  if (const char *env_p = std::getenv(str.c_str()))
+  {
+    for (auto &name : split_string(env_p, ',', true))
+    {
+      if (!is_map_name(name))
+      {
+        LOG(ERROR) << "Env var '" << str << "' did not contain a valid list "
+                   << "of map names (e.g. @a,@b): '" << name << "'";
+        return false;
+      }
+      dest.insert(name);
+    }
+  }
+  return true;
+}
+
+// Reads a comma separated list of map names with a value, e.g. "@a=1,@b=2"
+static bool get_map_values_env_var(
+    const std::string &str,
+    std::unordered_map<std::string, uint64_t> &dest)
+{
+  if (const char *env_p = std::getenv(str.c_str()))
+  {
+    for (auto &entry : split_string(env_p, ',', true))
+    {
+      auto parts = split_string(entry, '=');
+      uint64_t value;
+      std::istringstream stringstream(parts.size() == 2 ? parts[1] : "");
+      if (parts.size() != 2 || !is_map_name(parts[0]) ||
+          !(stringstream >> value) || !stringstream.eof() || value == 0 ||
+          value > static_cast<uint64_t>(std::numeric_limits<int32_t>::max()))
+      {
+        LOG(ERROR) << "Env var '" << str << "' did not contain a valid list "
+                   << "of map sizes (e.g. @a=1024,@b=16): '" << entry << "'";
+        return false;
+      }
+      dest[parts[0]] = value;
+    }
+  }
+  return true;
+}
+
 int main(int argc, char *argv[])
 {
   int err;
   std::string pid_str;
+  std::string pids_str;
+  bool follow_forks = false;
+  std::vector<std::string> cgroup_patterns;
+  std::vector<std::string> symbolize_dirs;
   std::string cmd_str;
   bool listing = false;
   bool safe_mode = true;
   bool force_btf = false;
   bool usdt_file_activation = false;
   int helper_check_level = 0;
+  int opt_level = 3;
   std::string script, search, file_name, output_file, output_format, output_elf;
+  std::string output_bundle, run_bundle;
+  bool allow_bundle_mismatch = false;
   OutputBufferConfig obc = OutputBufferConfig::UNSET;
   int c;
 
-  const char* const short_options = "dbB:f:e:hlp:vc:Vo:I:k";
+  const char* const short_options = "dbB:f:e:hlp:vc:Vo:I:kO:";
   option long_options[] = {
     option{ "help", no_argument, nullptr, 'h' },
     option{ "version", no_argument, nullptr, 'V' },
@@ -277,6 +358,13 @@ int main(int argc, char *argv[])
     option{ "info", no_argument, nullptr, 2000 },
     option{ "emit-elf", required_argument, nullptr, 2001 },
     option{ "no-warnings", no_argument, nullptr, 2002 },
+    option{ "pids", required_argument, nullptr, 2003 },
+    option{ "follow-forks", no_argument, nullptr, 2004 },
+    option{ "cgroups", required_argument, nullptr, 2005 },
+    option{ "symbolize", required_argument, nullptr, 2006 },
+    option{ "emit-bundle", required_argument, nullptr, 2007 },
+    option{ "run-bundle", required_argument, nullptr, 2008 },
+    option{ "allow-bundle-mismatch", no_argument, nullptr, 2009 },
     option{ nullptr, 0, nullptr, 0 }, // Must be last
   };
   std::vector<std::string> include_dirs;
@@ -297,6 +385,29 @@ int main(int argc, char *argv[])
       case 2002: // --no-warnings
         DISABLE_LOG(WARNING);
         break;
+      case 2003: // --pids
+        pids_str = optarg;
+        break;
+      case 2004: // --follow-forks
+        follow_forks = true;
+        break;
+      case 2005: // --cgroups
+        for (auto &pattern : split_string(optarg, ',', true))
+          cgroup_patterns.push_back(pattern);
+        break;
+      case 2006: // --symbolize
+        for (auto &dir : split_string(optarg, ',', true))
+          symbolize_dirs.push_back(dir);
+        break;
+      case 2007: // --emit-bundle
+        output_bundle = optarg;
+        break;
+      case 2008: // --run-bundle
+        run_bundle = optarg;
+        break;
+      case 2009: // --allow-bundle-mismatch
+        allow_bundle_mismatch = true;
+        break;
       case 'o':
         output_file = optarg;
         break;
@@ -322,6 +433,14 @@ int main(int argc, char *argv[])
           return 1;
         }
         break;
+      case 'O':
+        if (std::strlen(optarg) != 1 || optarg[0] < '0' || optarg[0] > '3')
+        {
+          LOG(ERROR) << "USAGE: -O must be 0, 1, 2 or 3.";
+          return 1;
+        }
+        opt_level = optarg[0] - '0';
+        break;
       case 'f':
         output_format = optarg;
         break;
@@ -372,6 +491,14 @@ int main(int argc, char *argv[])
     }
   }
 
+  if (!symbolize_dirs.empty())
+  {
+    // offline symbolization of saved ustack(build_id) output
+    BuildIdSymbolizer symbolizer(symbolize_dirs);
+    symbolizer.symbolize(std::cin, std::cout);
+    return 0;
+  }
+
   if (argc == 1) {
     usage();
     return 1;
@@ -391,6 +518,23 @@ int main(int argc, char *argv[])
     return 1;
   }
 
+  if (follow_forks && pid_str.empty() && pids_str.empty())
+  {
+    LOG(ERROR) << "USAGE: --follow-forks requires -p or --pids.";
+    return 1;
+  }
+
+  // the code of a bundle does not depend on the host, so it can be neither
+  // tied to processes or cgroups nor compiled again
+  if (!run_bundle.empty() &&
+      (!script.empty() || optind != argc || !output_elf.empty() ||
+       !output_bundle.empty() || !cmd_str.empty() || !pid_str.empty() ||
+       !pids_str.empty() || !cgroup_patterns.empty()))
+  {
+    LOG(ERROR) << "USAGE: --run-bundle only takes output and runtime options.";
+    return 1;
+  }
+
   std::ostream * os = &std::cout;
   std::ofstream outputstream;
   if (!output_file.empty()) {
@@ -436,6 +580,7 @@ int main(int argc, char *argv[])
   bpftrace.safe_mode_ = safe_mode;
   bpftrace.force_btf_ = force_btf;
   bpftrace.helper_check_level_ = helper_check_level;
+  bpftrace.opt_level_ = opt_level;
   bpftrace.boottime_ = get_boottime();
 
   if (!pid_str.empty())
@@ -449,7 +594,24 @@ int main(int argc, char *argv[])
       LOG(ERROR) << e.what();
       return 1;
     }
+    bpftrace.pid_filter_.push_back(bpftrace.procmon_->pid());
+  }
+
+  for (auto &pid : split_string(pids_str, ',', true))
+  {
+    try
+    {
+      bpftrace.pid_filter_.push_back(parse_pid(pid));
+    }
+    catch (const std::exception &e)
+    {
+      LOG(ERROR) << "--pids: " << e.what();
+      return 1;
+    }
   }
+  bpftrace.pid_filter_follow_forks_ = follow_forks;
+  if (!cgroup_patterns.empty())
+    bpftrace.cgroup_filter_ = std::make_unique<CgroupFilter>(cgroup_patterns);
 
   // Listing probes
   if (listing)
@@ -467,7 +629,11 @@ int main(int argc, char *argv[])
     return 0;
   }
 
-  if (script.empty())
+  if (!run_bundle.empty())
+  {
+    // the program and its positional parameters are in the bundle
+  }
+  else if (script.empty())
   {
     // Script file
     if (argv[optind] == nullptr)
@@ -521,9 +687,12 @@ int main(int argc, char *argv[])
     optind++;
   }
 
-  err = driver.parse();
-  if (err)
-    return err;
+  if (run_bundle.empty())
+  {
+    err = driver.parse();
+    if (err)
+      return err;
+  }
 
   if (!is_root())
     return 1;
@@ -535,10 +704,13 @@ int main(int argc, char *argv[])
     return 1;
   }
 
-  ast::FieldAnalyser fields(driver.root_.get(), bpftrace);
-  err = fields.analyse();
-  if (err)
-    return err;
+  if (run_bundle.empty())
+  {
+    ast::FieldAnalyser fields(driver.root_.get(), bpftrace);
+    err = fields.analyse();
+    if (err)
+      return err;
+  }
 
   // FIXME (mmarchini): maybe we don't want to always enforce an infinite
   // rlimit?
@@ -584,6 +756,34 @@ int main(int argc, char *argv[])
   if (!get_uint64_env_var("BPFTRACE_MAP_KEYS_MAX", bpftrace.mapmax_))
     return 1;
 
+  if (!get_uint64_env_var("BPFTRACE_STACK_MAP_SIZE", bpftrace.stack_max_))
+    return 1;
+
+  if (const char *env_p = std::getenv("BPFTRACE_STACK_REUSE_IDS"))
+  {
+    std::string s(env_p);
+    if (s == "1")
+      bpftrace.stack_reuse_ids_ = true;
+    else if (s == "0")
+      bpftrace.stack_reuse_ids_ = false;
+    else
+    {
+      LOG(ERROR) << "Env var 'BPFTRACE_STACK_REUSE_IDS' did not contain a "
+                    "valid value (0 or 1).";
+      return 1;
+    }
+  }
+
+  if (!get_map_values_env_var("BPFTRACE_MAP_SIZES", bpftrace.map_sizes_))
+    return 1;
+
+  if (!get_map_names_env_var("BPFTRACE_LRU_MAPS", bpftrace.lru_maps_))
+    return 1;
+
+  if (!get_map_names_env_var("BPFTRACE_NO_PREALLOC_MAPS",
+                             bpftrace.no_prealloc_maps_))
+    return 1;
+
   if (!get_uint64_env_var("BPFTRACE_MAX_PROBES", bpftrace.max_probes_))
     return 1;
 
@@ -642,132 +842,205 @@ int main(int argc, char *argv[])
                                    !bpftrace.is_aslr_enabled(-1);
   }
 
+  if (const char *env_p = std::getenv("BPFTRACE_BUILD_ID_DIRS"))
+  {
+    auto dirs = split_string(env_p, ',', true);
+    if (!dirs.empty())
+      bpftrace.build_id_symbolizer_ = std::make_unique<BuildIdSymbolizer>(
+          dirs);
+  }
+
   if (!cmd_str.empty())
     bpftrace.cmd_ = cmd_str;
 
-  if (TracepointFormatParser::parse(driver.root_.get(), bpftrace) == false)
-    return 1;
-
-  if (bt_debug != DebugLevel::kNone)
+  // -c runs embed the pid of the child in the program and debug runs print
+  // its IR, so they are always compiled
+  std::unique_ptr<ProgramCache> cache;
+  const char *cache_dir = std::getenv("BPFTRACE_CACHE_DIR");
+  if (cache_dir && *cache_dir && cmd_str.empty() && output_elf.empty() &&
+      output_bundle.empty() && run_bundle.empty() &&
+      bt_debug == DebugLevel::kNone)
   {
-    std::cout << "\nAST\n";
-    std::cout << "-------------------\n";
-    ast::Printer p(std::cout);
-    driver.root_->accept(p);
-    std::cout << std::endl;
+    std::vector<std::string> options = { BPFTRACE_VERSION };
+    for (auto &dir : include_dirs)
+    {
+      options.push_back("-I");
+      options.push_back(dir);
+    }
+    for (auto &file : include_files)
+    {
+      options.push_back("--include");
+      options.push_back(file);
+    }
+    cache = std::make_unique<ProgramCache>(cache_dir, bpftrace, options);
   }
 
-  ClangParser clang;
-  std::vector<std::string> extra_flags;
+  std::unique_ptr<BpfObject> bpf_object;
+  ProgramBundle bundle(bpftrace);
+  if (!run_bundle.empty())
   {
-    struct utsname utsname;
-    uname(&utsname);
-    std::string ksrc, kobj;
-    auto kdirs = get_kernel_dirs(utsname);
-    ksrc = std::get<0>(kdirs);
-    kobj = std::get<1>(kdirs);
-
-    if (ksrc != "")
-      extra_flags = get_kernel_cflags(utsname.machine, ksrc, kobj);
+    try
+    {
+      bundle.load(run_bundle, allow_bundle_mismatch);
+    }
+    catch (const std::runtime_error &e)
+    {
+      LOG(ERROR) << "--run-bundle: " << e.what();
+      return 1;
+    }
+    bpftrace.report_map_sizes();
+    bpftrace.sections_ = &bundle.sections();
   }
-  extra_flags.push_back("-include");
-  extra_flags.push_back(CLANG_WORKAROUNDS_H);
-
-  for (auto dir : include_dirs)
+  else if (cache && cache->load())
   {
-    extra_flags.push_back("-I");
-    extra_flags.push_back(dir);
+    bpftrace.report_map_sizes();
+    bpftrace.sections_ = &cache->sections();
   }
-  for (auto file : include_files)
+  else
   {
-    extra_flags.push_back("-include");
-    extra_flags.push_back(file);
-  }
+    if (TracepointFormatParser::parse(driver.root_.get(), bpftrace) == false)
+      return 1;
 
-  // NOTE(mmarchini): if there are no C definitions, clang parser won't run to
-  // avoid issues in some versions. Since we're including files in the command
-  // line, we want to force parsing, so we make sure C definitions are not
-  // empty before going to clang parser stage.
-  if (!include_files.empty() && driver.root_->c_definitions.empty())
-    driver.root_->c_definitions = "#define __BPFTRACE_DUMMY__";
+    if (bt_debug != DebugLevel::kNone)
+    {
+      std::cout << "\nAST\n";
+      std::cout << "-------------------\n";
+      ast::Printer p(std::cout);
+      driver.root_->accept(p);
+      std::cout << std::endl;
+    }
 
-  if (!clang.parse(driver.root_.get(), bpftrace, extra_flags))
-    return 1;
+    ClangParser clang;
+    if (cache_dir && *cache_dir)
+      clang.set_pch_dir(cache_dir);
+    std::vector<std::string> extra_flags;
+    {
+      struct utsname utsname;
+      uname(&utsname);
+      std::string ksrc, kobj;
+      auto kdirs = get_kernel_dirs(utsname);
+      ksrc = std::get<0>(kdirs);
+      kobj = std::get<1>(kdirs);
+
+      if (ksrc != "")
+        extra_flags = get_kernel_cflags(utsname.machine, ksrc, kobj);
+    }
+    extra_flags.push_back("-include");
+    extra_flags.push_back(CLANG_WORKAROUNDS_H);
 
-  err = driver.parse();
-  if (err)
-    return err;
+    for (auto dir : include_dirs)
+    {
+      extra_flags.push_back("-I");
+      extra_flags.push_back(dir);
+    }
+    for (auto file : include_files)
+    {
+      extra_flags.push_back("-include");
+      extra_flags.push_back(file);
+    }
 
-  ast::SemanticAnalyser semantics(
-      driver.root_.get(), bpftrace, bpftrace.feature_, !cmd_str.empty());
-  err = semantics.analyse();
-  if (err)
-    return err;
+    // NOTE(mmarchini): if there are no C definitions, clang parser won't run to
+    // avoid issues in some versions. Since we're including files in the command
+    // line, we want to force parsing, so we make sure C definitions are not
+    // empty before going to clang parser stage.
+    if (!include_files.empty() && driver.root_->c_definitions.empty())
+      driver.root_->c_definitions = "#define __BPFTRACE_DUMMY__";
 
-  if (bt_debug != DebugLevel::kNone)
-  {
-    std::cout << "\nAST after semantic analysis\n";
-    std::cout << "-------------------\n";
-    ast::Printer p(std::cout, true);
-    driver.root_->accept(p);
-    std::cout << std::endl;
-  }
+    if (!clang.parse(driver.root_.get(), bpftrace, extra_flags))
+      return 1;
 
-  err = semantics.create_maps(bt_debug != DebugLevel::kNone);
-  if (err)
-    return err;
+    err = driver.parse();
+    if (err)
+      return err;
 
-  if (!cmd_str.empty())
-  {
-    try
-    {
-      bpftrace.child_ = std::make_unique<ChildProc>(cmd_str);
-    }
-    catch (const std::runtime_error& e)
+    ast::SemanticAnalyser semantics(
+        driver.root_.get(), bpftrace, bpftrace.feature_, !cmd_str.empty());
+    err = semantics.analyse();
+    if (err)
+      return err;
+
+    if (bt_debug != DebugLevel::kNone)
     {
-      LOG(ERROR) << "Failed to fork child: " << e.what();
-      return -1;
+      std::cout << "\nAST after semantic analysis\n";
+      std::cout << "-------------------\n";
+      ast::Printer p(std::cout, true);
+      driver.root_->accept(p);
+      std::cout << std::endl;
     }
-  }
 
-  ast::CodegenLLVM llvm(driver.root_.get(), bpftrace);
-  std::unique_ptr<BpfOrc> bpforc;
-  try
-  {
-    llvm.generate_ir();
-    if (bt_debug == DebugLevel::kFullDebug)
+    err = semantics.create_maps(bt_debug != DebugLevel::kNone);
+    if (err)
+      return err;
+    bpftrace.report_map_sizes();
+
+    if (!cmd_str.empty())
     {
-      std::cout << "Before optimization\n";
-      std::cout << "-------------------\n\n";
-      llvm.DumpIR();
+      try
+      {
+        bpftrace.child_ = std::make_unique<ChildProc>(cmd_str);
+      }
+      catch (const std::runtime_error& e)
+      {
+        LOG(ERROR) << "Failed to fork child: " << e.what();
+        return -1;
+      }
     }
 
-    llvm.optimize();
-    if (bt_debug != DebugLevel::kNone)
+    ast::CodegenLLVM llvm(driver.root_.get(), bpftrace);
+    try
     {
+      llvm.generate_ir();
       if (bt_debug == DebugLevel::kFullDebug)
       {
-        std::cout << "\nAfter optimization\n";
-        std::cout << "------------------\n\n";
+        std::cout << "Before optimization\n";
+        std::cout << "-------------------\n\n";
+        llvm.DumpIR();
+      }
+
+      llvm.optimize();
+      if (bt_debug != DebugLevel::kNone)
+      {
+        if (bt_debug == DebugLevel::kFullDebug)
+        {
+          std::cout << "\nAfter optimization\n";
+          std::cout << "------------------\n\n";
+        }
+        llvm.DumpIR();
+      }
+      if (!output_elf.empty())
+      {
+        llvm.emit_elf(output_elf);
+        return 0;
       }
-      llvm.DumpIR();
+      bpf_object = llvm.emit();
+      bpftrace.sections_ = &bpf_object->sections_;
+    }
+    catch (const std::system_error& ex)
+    {
+      LOG(ERROR) << "failed to write elf: " << ex.what();
+      return 1;
     }
-    if (!output_elf.empty())
+    catch (const std::exception& ex)
     {
-      llvm.emit_elf(output_elf);
+      LOG(ERROR) << "Failed to compile: " << ex.what();
+      return 1;
+    }
+
+    if (!output_bundle.empty())
+    {
+      try
+      {
+        bundle.save(output_bundle, bpf_object->sections_);
+      }
+      catch (const std::runtime_error &e)
+      {
+        LOG(ERROR) << "--emit-bundle: " << e.what();
+        return 1;
+      }
       return 0;
     }
-    bpforc = llvm.emit();
-  }
-  catch (const std::system_error& ex)
-  {
-    LOG(ERROR) << "failed to write elf: " << ex.what();
-    return 1;
-  }
-  catch (const std::exception& ex)
-  {
-    LOG(ERROR) << "Failed to compile: " << ex.what();
-    return 1;
+    if (cache)
+      cache->store(bpf_object->sections_, clang.included_files());
   }
 
   if (bt_debug != DebugLevel::kNone)
@@ -799,7 +1072,6 @@ int main(int argc, char *argv[])
   else
     bpftrace.out_->attached_probes(num_probes);
 
-  bpftrace.bpforc_ = bpforc.get();
   err = bpftrace.run();
   if (err)
     return err;
@@ -812,6 +1084,10 @@ int main(int argc, char *argv[])
   std::cout << "\n\n";
 
   err = bpftrace.print_maps();
+  if (!err)
+    err = bpftrace.print_dropped_events();
+  if (!err)
+    err = bpftrace.print_stackid_errors();
 
   if (bt_verbose && bpftrace.child_)
   {
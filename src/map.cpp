@@ -21,7 +21,15 @@ int Map::create_map(enum bpf_map_type map_type, const char *name, int key_size,
 #endif
 }
 
-Map::Map(const std::string &name, const SizedType &type, const MapKey &key, int min, int max, int step, int max_entries)
+Map::Map(const std::string &name,
+         const SizedType &type,
+         const MapKey &key,
+         int min,
+         int max,
+         int step,
+         int max_entries,
+         bool lru,
+         bool no_prealloc)
 {
   name_ = name;
   type_ = type;
@@ -32,7 +40,8 @@ Map::Map(const std::string &name, const SizedType &type, const MapKey &key, int
   lqstep = step;
 
   int key_size = key.size();
-  if (type.IsHistTy() || type.IsLhistTy() || type.IsAvgTy() || type.IsStatsTy())
+  if (type.IsHistTy() || type.IsLhistTy() || type.IsLLhistTy() ||
+      type.IsQuantilesTy() || type.IsAvgTy() || type.IsStatsTy())
     key_size += 8;
   if (key_size == 0)
     key_size = 8;
@@ -43,9 +52,10 @@ Map::Map(const std::string &name, const SizedType &type, const MapKey &key, int
     max_entries = 1;
     key_size = 4;
   }
-  else if ((type.IsHistTy() || type.IsLhistTy() || type.IsCountTy() ||
-            type.IsSumTy() || type.IsMinTy() || type.IsMaxTy() ||
-            type.IsAvgTy() || type.IsStatsTy()) &&
+  else if ((type.IsHistTy() || type.IsLhistTy() || type.IsLLhistTy() ||
+            type.IsQuantilesTy() || type.IsCountTy() ||
+            type.IsCountDistinctTy() || type.IsSumTy() || type.IsMinTy() ||
+            type.IsMaxTy() || type.IsAvgTy() || type.IsStatsTy()) &&
            (LINUX_VERSION_CODE >= KERNEL_VERSION(4, 6, 0)))
   {
       map_type_ = BPF_MAP_TYPE_PERCPU_HASH;
@@ -56,11 +66,33 @@ Map::Map(const std::string &name, const SizedType &type, const MapKey &key, int
     max_entries = 1;
     key_size = 4;
   }
+  else if (type.IsSamplingTy() || type.IsStackIdErrorsTy())
+  {
+    // one slot per sample(), ratelimit(), kstack or ustack call site
+    map_type_ = BPF_MAP_TYPE_PERCPU_ARRAY;
+    key_size = 4;
+  }
   else
     map_type_ = BPF_MAP_TYPE_HASH;
 
+  // LRU maps evict the least recently used key instead of failing updates
+  // when they are full
+  if (lru && map_type_ == BPF_MAP_TYPE_PERCPU_HASH)
+    map_type_ = BPF_MAP_TYPE_LRU_PERCPU_HASH;
+  else if (lru && map_type_ == BPF_MAP_TYPE_HASH)
+    map_type_ = BPF_MAP_TYPE_LRU_HASH;
+
   int value_size = type.size;
   int flags = 0;
+  // LRU and array maps are always preallocated
+  if (no_prealloc && (map_type_ == BPF_MAP_TYPE_HASH ||
+                      map_type_ == BPF_MAP_TYPE_PERCPU_HASH))
+    flags |= BPF_F_NO_PREALLOC;
+
+  key_size_ = key_size;
+  value_size_ = value_size;
+  max_entries_ = max_entries;
+  flags_ = flags;
   mapfd_ = create_map(map_type_, name.c_str(), key_size, value_size, max_entries, flags);
   if (mapfd_ < 0)
   {
@@ -69,7 +101,7 @@ Map::Map(const std::string &name, const SizedType &type, const MapKey &key, int
   }
 }
 
-Map::Map(const SizedType &type) {
+Map::Map(const SizedType &type, int max_entries) {
 #ifdef DEBUG
   // TODO (mmarchini): replace with DCHECK
   if (!type.IsStack()) {
@@ -81,15 +113,25 @@ Map::Map(const SizedType &type) {
   int key_size = 4;
   int value_size = sizeof(uintptr_t) * type.stack_type.limit;
   std::string name = "stack";
-  int max_entries = 4096;
   int flags = 0;
-  enum bpf_map_type map_type = BPF_MAP_TYPE_STACK_TRACE;
+  if (type.stack_type.mode == StackMode::build_id)
+  {
+    // each frame is a (build-id, offset) pair instead of an address
+    value_size = sizeof(struct bpf_stack_build_id) * type.stack_type.limit;
+    flags = BPF_F_STACK_BUILD_ID;
+  }
+  map_type_ = BPF_MAP_TYPE_STACK_TRACE;
+  key_size_ = key_size;
+  value_size_ = value_size;
+  max_entries_ = max_entries;
+  flags_ = flags;
 
-  mapfd_ = create_map(map_type, name.c_str(), key_size, value_size, max_entries, flags);
+  mapfd_ = create_map(map_type_, name.c_str(), key_size, value_size, max_entries, flags);
   if (mapfd_ < 0)
   {
     LOG(ERROR)
-        << "failed to create stack id map\n"
+        << "failed to create stack id map with " << max_entries
+        << " entries\n"
         // TODO (mmarchini): Check perf_event_max_stack in the semantic_analyzer
         << "This might have happened because kernel.perf_event_max_stack "
         << "is smaller than " << type.stack_type.limit
@@ -98,6 +140,32 @@ Map::Map(const SizedType &type) {
   }
 }
 
+Map::Map(const std::string &name,
+         const SizedType &type,
+         const MapKey &key,
+         enum bpf_map_type map_type,
+         int key_size,
+         int value_size,
+         int max_entries,
+         int flags)
+{
+  name_ = name;
+  type_ = type;
+  key_ = key;
+  map_type_ = map_type;
+  key_size_ = key_size;
+  value_size_ = value_size;
+  max_entries_ = max_entries;
+  flags_ = flags;
+  mapfd_ = create_map(
+      map_type_, name.c_str(), key_size, value_size, max_entries, flags);
+  if (mapfd_ < 0)
+  {
+    LOG(ERROR) << "failed to create map: '" << name_
+               << "': " << strerror(errno);
+  }
+}
+
 Map::Map(enum bpf_map_type map_type)
 {
   int key_size, value_size, max_entries, flags;
@@ -223,6 +291,14 @@ std::string to_string(MapManager::Type t)
       return "join";
     case MapManager::Type::Elapsed:
       return "elapsed";
+    case MapManager::Type::Sampling:
+      return "sampling";
+    case MapManager::Type::StackIdErrors:
+      return "stackid_errors";
+    case MapManager::Type::PidFilter:
+      return "pid_filter";
+    case MapManager::Type::CgroupFilter:
+      return "cgroup_filter";
   }
   return {}; // unreached
 }
@@ -10,16 +10,29 @@ public:
   Map(const std::string &name,
       const SizedType &type,
       const MapKey &key,
-      int max_entries)
-      : Map(name, type, key, 0, 0, 0, max_entries){};
+      int max_entries,
+      bool lru = false,
+      bool no_prealloc = false)
+      : Map(name, type, key, 0, 0, 0, max_entries, lru, no_prealloc){};
   Map(const std::string &name,
       const SizedType &type,
       const MapKey &key,
       int min,
       int max,
       int step,
-      int max_entries);
-  Map(const SizedType &type);
+      int max_entries,
+      bool lru = false,
+      bool no_prealloc = false);
+  Map(const SizedType &type, int max_entries);
+  // recreates a map from the attributes of a previously created one
+  Map(const std::string &name,
+      const SizedType &type,
+      const MapKey &key,
+      enum bpf_map_type map_type,
+      int key_size,
+      int value_size,
+      int max_entries,
+      int flags);
   Map(enum bpf_map_type map_type);
   virtual ~Map() override;
 
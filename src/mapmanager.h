@@ -59,6 +59,10 @@ public:
     PerfEvent,
     Join,
     Elapsed,
+    Sampling,
+    StackIdErrors,
+    PidFilter,
+    CgroupFilter,
   };
 
   void Set(Type t, std::unique_ptr<IMap> map);
@@ -84,6 +88,19 @@ public:
     return stackid_maps_.size();
   };
 
+  /**
+     Iterate over internal and stack maps. Stack map entries may be null.
+  */
+  const std::unordered_map<Type, std::unique_ptr<IMap>> &internal_maps() const
+  {
+    return maps_by_type_;
+  };
+  const std::unordered_map<StackType, std::unique_ptr<IMap>> &stack_maps()
+      const
+  {
+    return stackid_maps_;
+  };
+
 private:
   std::vector<std::unique_ptr<IMap>> maps_by_id_;
   std::unordered_map<std::string, IMap *> maps_by_name_;
@@ -1,7 +1,10 @@
 #include "output.h"
 #include "bpftrace.h"
+#include "sketch.h"
 #include "utils.h"
 
+#include <cmath>
+
 namespace bpftrace {
 
 namespace {
@@ -11,6 +14,14 @@ bool is_quoted_type(const SizedType &ty)
          ty.IsInetTy() || ty.IsUsernameTy() || ty.IsStringTy() ||
          ty.IsBufferTy() || ty.IsProbeTy();
 }
+
+// Percentiles summarised for llhist() and quantiles() maps
+const std::vector<std::pair<std::string, double>> SUMMARY_PERCENTILES = {
+  { "p50", 50.0 },
+  { "p90", 90.0 },
+  { "p99", 99.0 },
+  { "p99.9", 99.9 },
+};
 } // namespace
 
 std::ostream& operator<<(std::ostream& out, MessageType type) {
@@ -20,6 +31,7 @@ std::ostream& operator<<(std::ostream& out, MessageType type) {
       out << "value";
       break;
     case MessageType::hist: out << "hist"; break;
+    case MessageType::quantiles: out << "quantiles"; break;
     case MessageType::stats: out << "stats"; break;
     case MessageType::printf: out << "printf"; break;
     case MessageType::time: out << "time"; break;
@@ -28,6 +40,7 @@ std::ostream& operator<<(std::ostream& out, MessageType type) {
     case MessageType::syscall: out << "syscall"; break;
     case MessageType::attached_probes: out << "attached_probes"; break;
     case MessageType::lost_events: out << "lost_events"; break;
+    case MessageType::dropped_events: out << "dropped_events"; break;
     default: out << "?";
   }
   return out;
@@ -91,6 +104,27 @@ std::string TextOutput::lhist_index_label(int number)
   return label.str();
 }
 
+std::string TextOutput::llhist_index_label(uint64_t number)
+{
+  const std::vector<std::pair<int, char>> suffixes = {
+    { 40, 'T' }, { 30, 'G' }, { 20, 'M' }, { 10, 'K' }
+  };
+
+  std::ostringstream label;
+  for (auto &suffix : suffixes)
+  {
+    uint64_t unit = 1ULL << suffix.first;
+    if (number != 0 && number % unit == 0)
+    {
+      label << number / unit << suffix.second;
+      return label.str();
+    }
+  }
+
+  label << number;
+  return label.str();
+}
+
 void Output::hist_prepare(const std::vector<uint64_t> &values, int &min_index, int &max_index, int &max_value) const
 {
   min_index = -1;
@@ -147,6 +181,29 @@ void Output::lhist_prepare(const std::vector<uint64_t> &values, int min, int max
   }
 }
 
+int Output::llhist_percentile_index(const std::vector<uint64_t> &values,
+                                    double percentile)
+{
+  uint64_t total = 0;
+  for (auto v : values)
+    total += v;
+  if (total == 0)
+    return -1;
+
+  uint64_t rank = std::ceil(total * percentile / 100.0);
+  if (rank == 0)
+    rank = 1;
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < values.size(); i++)
+  {
+    seen += values.at(i);
+    if (seen >= rank)
+      return i;
+  }
+  return values.size() - 1;
+}
+
 void TextOutput::map(BPFtrace &bpftrace, IMap &map, uint32_t top, uint32_t div,
                      const std::vector<std::pair<std::vector<uint8_t>, std::vector<uint8_t>>> &values_by_key) const
 {
@@ -248,6 +305,79 @@ void TextOutput::lhist(const std::vector<uint64_t> &values, int min, int max, in
   }
 }
 
+void TextOutput::llhist(const std::vector<uint64_t> &values,
+                        int bits,
+                        uint32_t div) const
+{
+  int min_index, max_index, max_value;
+  hist_prepare(values, min_index, max_index, max_value);
+  if (max_index == -1)
+    return;
+
+  for (int i = min_index; i <= max_index; i++)
+  {
+    std::ostringstream header;
+    if (i == 0)
+    {
+      header << "(..., 0)";
+    }
+    else
+    {
+      uint64_t low, high;
+      loglinear_bounds(bits, i, low, high);
+      if (low == high)
+        header << "[" << llhist_index_label(low) << "]";
+      else
+        header << "[" << llhist_index_label(low) << ", "
+               << llhist_index_label(high + 1) << ")";
+    }
+
+    int max_width = 52;
+    int bar_width = values.at(i)/(float)max_value*max_width;
+    std::string bar(bar_width, '@');
+
+    out_ << std::setw(16) << std::left << header.str()
+         << std::setw(8) << std::right << (values.at(i) / div)
+         << " |" << std::setw(max_width) << std::left << bar << "|"
+         << std::endl;
+  }
+
+  bool first = true;
+  for (auto &percentile : SUMMARY_PERCENTILES)
+  {
+    int index = llhist_percentile_index(values, percentile.second);
+    if (!first)
+      out_ << ", ";
+    first = false;
+
+    out_ << percentile.first << ": ";
+    if (index == 0)
+    {
+      out_ << "< 0";
+    }
+    else
+    {
+      uint64_t low, high;
+      loglinear_bounds(bits, index, low, high);
+      out_ << high;
+    }
+  }
+  out_ << std::endl;
+}
+
+void TextOutput::quantiles(const std::vector<uint64_t> &values,
+                           int bits,
+                           uint32_t div) const
+{
+  out_ << "count " << quantiles_count(values);
+  for (auto &percentile : SUMMARY_PERCENTILES)
+  {
+    out_ << ", " << percentile.first << " "
+         << quantiles_estimate(values, bits, percentile.second / 100.0) / div;
+  }
+  out_ << std::endl;
+}
+
 void TextOutput::map_hist(BPFtrace &bpftrace, IMap &map, uint32_t top, uint32_t div,
                           const std::map<std::vector<uint8_t>, std::vector<uint64_t>> &values_by_key,
                           const std::vector<std::pair<std::vector<uint8_t>, uint64_t>> &total_counts_by_key) const
@@ -261,10 +391,21 @@ void TextOutput::map_hist(BPFtrace &bpftrace, IMap &map, uint32_t top, uint32_t
     if (top && values_by_key.size() > top && i++ < (values_by_key.size() - top))
       continue;
 
+    if (map.type_.IsQuantilesTy())
+    {
+      // a sketch summary fits on one line
+      out_ << map.name_ << map.key_.argument_value_list_str(bpftrace, key)
+           << ": ";
+      quantiles(value, map.llbits, div);
+      continue;
+    }
+
     out_ << map.name_ << map.key_.argument_value_list_str(bpftrace, key) << ": " << std::endl;
 
     if (map.type_.IsHistTy())
       hist(value, div);
+    else if (map.type_.IsLLhistTy())
+      llhist(value, map.llbits, div);
     else
       lhist(value, map.lqmin, map.lqmax, map.lqstep);
 
@@ -333,6 +474,12 @@ void TextOutput::lost_events(uint64_t lost) const
   out_ << "Lost " << lost << " events" << std::endl;
 }
 
+void TextOutput::dropped_events(const std::string &site,
+                                uint64_t dropped) const
+{
+  out_ << "Dropped " << dropped << " events at " << site << std::endl;
+}
+
 void TextOutput::attached_probes(uint64_t num_probes) const
 {
   if (num_probes == 1)
@@ -536,6 +683,73 @@ void JsonOutput::lhist(const std::vector<uint64_t> &values, int min, int max, in
   out_ << "]";
 }
 
+void JsonOutput::llhist(const std::vector<uint64_t> &values,
+                        int bits,
+                        uint32_t div) const
+{
+  int min_index, max_index, max_value;
+  hist_prepare(values, min_index, max_index, max_value);
+  if (max_index == -1)
+    return;
+
+  out_ << "{\"buckets\": [";
+  for (int i = min_index; i <= max_index; i++)
+  {
+    if (i > min_index)
+      out_ << ", ";
+
+    out_ << "{";
+    if (i == 0)
+    {
+      out_ << "\"max\": -1, ";
+    }
+    else
+    {
+      uint64_t low, high;
+      loglinear_bounds(bits, i, low, high);
+      out_ << "\"min\": " << low << ", \"max\": " << high << ", ";
+    }
+    out_ << "\"count\": " << values.at(i) / div;
+    out_ << "}";
+  }
+  out_ << "], \"percentiles\": {";
+
+  bool first = true;
+  for (auto &percentile : SUMMARY_PERCENTILES)
+  {
+    int index = llhist_percentile_index(values, percentile.second);
+    if (!first)
+      out_ << ", ";
+    first = false;
+
+    out_ << "\"" << percentile.first << "\": ";
+    if (index == 0)
+    {
+      out_ << -1;
+    }
+    else
+    {
+      uint64_t low, high;
+      loglinear_bounds(bits, index, low, high);
+      out_ << high;
+    }
+  }
+  out_ << "}}";
+}
+
+void JsonOutput::quantiles(const std::vector<uint64_t> &values,
+                           int bits,
+                           uint32_t div) const
+{
+  out_ << "{\"count\": " << quantiles_count(values);
+  for (auto &percentile : SUMMARY_PERCENTILES)
+  {
+    out_ << ", \"" << percentile.first << "\": "
+         << quantiles_estimate(values, bits, percentile.second / 100.0) / div;
+  }
+  out_ << "}";
+}
+
 void JsonOutput::map_hist(BPFtrace &bpftrace, IMap &map, uint32_t top, uint32_t div,
                           const std::map<std::vector<uint8_t>, std::vector<uint64_t>> &values_by_key,
                           const std::vector<std::pair<std::vector<uint8_t>, uint64_t>> &total_counts_by_key) const
@@ -543,7 +757,9 @@ void JsonOutput::map_hist(BPFtrace &bpftrace, IMap &map, uint32_t top, uint32_t
   if (total_counts_by_key.empty())
     return;
 
-  out_ << "{\"type\": \"" << MessageType::hist << "\", \"data\": {";
+  auto type = map.type_.IsQuantilesTy() ? MessageType::quantiles
+                                        : MessageType::hist;
+  out_ << "{\"type\": \"" << type << "\", \"data\": {";
   out_ << "\"" << json_escape(map.name_) << "\": ";
   if (map.key_.size() > 0) // check if this map has keys
     out_ << "{";
@@ -567,6 +783,10 @@ void JsonOutput::map_hist(BPFtrace &bpftrace, IMap &map, uint32_t top, uint32_t
 
     if (map.type_.IsHistTy())
       hist(value, div);
+    else if (map.type_.IsLLhistTy())
+      llhist(value, map.llbits, div);
+    else if (map.type_.IsQuantilesTy())
+      quantiles(value, map.llbits, div);
     else
       lhist(value, map.lqmin, map.lqmax, map.lqstep);
 
@@ -672,6 +892,14 @@ void JsonOutput::lost_events(uint64_t lost) const
   message(MessageType::lost_events, "events", lost);
 }
 
+void JsonOutput::dropped_events(const std::string &site,
+                                uint64_t dropped) const
+{
+  out_ << "{\"type\": \"" << MessageType::dropped_events
+       << "\", \"data\": {\"site\": \"" << json_escape(site)
+       << "\", \"events\": " << dropped << "}}" << std::endl;
+}
+
 void JsonOutput::attached_probes(uint64_t num_probes) const
 {
   message(MessageType::attached_probes, "probes", num_probes);
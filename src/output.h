@@ -16,6 +16,7 @@ enum class MessageType
   map,
   value,
   hist,
+  quantiles,
   stats,
   printf,
   time,
@@ -23,7 +24,8 @@ enum class MessageType
   join,
   syscall,
   attached_probes,
-  lost_events
+  lost_events,
+  dropped_events
 };
 
 std::ostream& operator<<(std::ostream& out, MessageType type);
@@ -57,6 +59,8 @@ public:
 
   virtual void message(MessageType type, const std::string& msg, bool nl = true) const = 0;
   virtual void lost_events(uint64_t lost) const = 0;
+  virtual void dropped_events(const std::string &site,
+                              uint64_t dropped) const = 0;
   virtual void attached_probes(uint64_t num_probes) const = 0;
 
 protected:
@@ -64,6 +68,8 @@ protected:
   std::ostream &err_;
   void hist_prepare(const std::vector<uint64_t> &values, int &min_index, int &max_index, int &max_value) const;
   void lhist_prepare(const std::vector<uint64_t> &values, int min, int max, int step, int &max_index, int &max_value, int &buckets, int &start_value, int &end_value) const;
+  static int llhist_percentile_index(const std::vector<uint64_t> &values,
+                                     double percentile);
 };
 
 class TextOutput : public Output {
@@ -89,13 +95,22 @@ public:
 
   void message(MessageType type, const std::string& msg, bool nl = true) const override;
   void lost_events(uint64_t lost) const override;
+  void dropped_events(const std::string &site,
+                      uint64_t dropped) const override;
   void attached_probes(uint64_t num_probes) const override;
 
 private:
   static std::string hist_index_label(int power);
   static std::string lhist_index_label(int number);
+  static std::string llhist_index_label(uint64_t number);
   void hist(const std::vector<uint64_t> &values, uint32_t div) const;
   void lhist(const std::vector<uint64_t> &values, int min, int max, int step) const;
+  void llhist(const std::vector<uint64_t> &values,
+              int bits,
+              uint32_t div) const;
+  void quantiles(const std::vector<uint64_t> &values,
+                 int bits,
+                 uint32_t div) const;
   std::string tuple_to_str(BPFtrace &bpftrace,
                            const SizedType &ty,
                            const std::vector<uint8_t> &value) const;
@@ -125,6 +140,8 @@ public:
   void message(MessageType type, const std::string& msg, bool nl = true) const override;
   void message(MessageType type, const std::string& field, uint64_t value) const;
   void lost_events(uint64_t lost) const override;
+  void dropped_events(const std::string &site,
+                      uint64_t dropped) const override;
   void attached_probes(uint64_t num_probes) const override;
 
 private:
@@ -135,6 +152,12 @@ private:
              int min,
              int max,
              int step) const;
+  void llhist(const std::vector<uint64_t> &values,
+              int bits,
+              uint32_t div) const;
+  void quantiles(const std::vector<uint64_t> &values,
+                 int bits,
+                 uint32_t div) const;
   std::string tuple_to_str(BPFtrace &bpftrace,
                            const SizedType &ty,
                            const std::vector<uint8_t> &value) const;
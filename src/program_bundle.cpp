@@ -0,0 +1,263 @@
+#include <cerrno>
+#include <cstring>
+#include <elf.h>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <sys/utsname.h>
+
+#include "log.h"
+#include "program_bundle.h"
+
+namespace bpftrace {
+
+namespace {
+const std::string METADATA_SECTION = ".bpftrace";
+const std::string SHSTRTAB_SECTION = ".shstrtab";
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+const unsigned char ELF_DATA = ELFDATA2LSB;
+#else
+const unsigned char ELF_DATA = ELFDATA2MSB;
+#endif
+
+std::string kernel_release()
+{
+  struct utsname utsname;
+  uname(&utsname);
+  return utsname.release;
+}
+
+// The binaries whose symbols and USDT notes the probes were resolved from
+std::vector<std::string> traced_binaries(const std::vector<Probe> &probes)
+{
+  std::set<std::string> binaries;
+  for (auto &probe : probes)
+    if ((probe.type == ProbeType::uprobe ||
+         probe.type == ProbeType::uretprobe ||
+         probe.type == ProbeType::usdt) &&
+        !probe.path.empty())
+      binaries.insert(probe.path);
+  return std::vector<std::string>(binaries.begin(), binaries.end());
+}
+
+size_t align8(size_t offset)
+{
+  return (offset + 7) & ~size_t(7);
+}
+
+// (name, contents) of the sections of an ELF object, in file order
+using ElfSections = std::vector<std::pair<std::string, std::string>>;
+
+void write_elf(std::ostream &out, const ElfSections &sections)
+{
+  std::string shstrtab(1, '\0');
+  std::vector<Elf64_Shdr> shdrs(1); // SHN_UNDEF
+  std::string data;
+  auto add_section = [&](const std::string &name,
+                         const std::string &contents,
+                         Elf64_Word type,
+                         Elf64_Xword flags) {
+    Elf64_Shdr shdr = {};
+    shdr.sh_name = shstrtab.size();
+    shdr.sh_type = type;
+    shdr.sh_flags = flags;
+    shdr.sh_addralign = 8;
+    data.resize(align8(data.size()));
+    shdr.sh_offset = sizeof(Elf64_Ehdr) + data.size();
+    shdr.sh_size = contents.size();
+    shdrs.push_back(shdr);
+    shstrtab += name + '\0';
+    data += contents;
+  };
+
+  for (auto &section : sections)
+  {
+    Elf64_Xword flags = SHF_ALLOC;
+    if (section.first.rfind("s_", 0) == 0)
+      flags |= SHF_EXECINSTR;
+    else if (section.first == METADATA_SECTION)
+      flags = 0;
+    add_section(section.first, section.second, SHT_PROGBITS, flags);
+  }
+  // .shstrtab names itself
+  size_t shstrndx = shdrs.size();
+  add_section(SHSTRTAB_SECTION,
+              shstrtab + SHSTRTAB_SECTION + '\0',
+              SHT_STRTAB,
+              0);
+  data.resize(align8(data.size()));
+
+  Elf64_Ehdr ehdr = {};
+  std::memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+  ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+  ehdr.e_ident[EI_DATA] = ELF_DATA;
+  ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+  ehdr.e_ident[EI_OSABI] = ELFOSABI_NONE;
+  ehdr.e_type = ET_REL;
+  ehdr.e_machine = EM_BPF;
+  ehdr.e_version = EV_CURRENT;
+  ehdr.e_shoff = sizeof(Elf64_Ehdr) + data.size();
+  ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+  ehdr.e_shentsize = sizeof(Elf64_Shdr);
+  ehdr.e_shnum = shdrs.size();
+  ehdr.e_shstrndx = shstrndx;
+
+  out.write(reinterpret_cast<const char *>(&ehdr), sizeof(ehdr));
+  out.write(data.data(), data.size());
+  out.write(reinterpret_cast<const char *>(shdrs.data()),
+            shdrs.size() * sizeof(Elf64_Shdr));
+}
+
+ElfSections read_elf(const std::string &elf)
+{
+  auto invalid = [](const std::string &what) {
+    return std::runtime_error("not a bpftrace bundle: " + what);
+  };
+
+  Elf64_Ehdr ehdr;
+  if (elf.size() < sizeof(ehdr))
+    throw invalid("truncated ELF header");
+  std::memcpy(&ehdr, elf.data(), sizeof(ehdr));
+  if (std::memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0)
+    throw invalid("not an ELF file");
+  if (ehdr.e_ident[EI_CLASS] != ELFCLASS64 ||
+      ehdr.e_ident[EI_DATA] != ELF_DATA)
+    throw invalid("ELF class or byte order of another architecture");
+  if (ehdr.e_machine != EM_BPF)
+    throw invalid("not a BPF object");
+  if (ehdr.e_shentsize != sizeof(Elf64_Shdr) || ehdr.e_shoff > elf.size() ||
+      ehdr.e_shnum > (elf.size() - ehdr.e_shoff) / sizeof(Elf64_Shdr) ||
+      ehdr.e_shstrndx >= ehdr.e_shnum)
+    throw invalid("invalid section headers");
+
+  std::vector<Elf64_Shdr> shdrs(ehdr.e_shnum);
+  std::memcpy(shdrs.data(),
+              elf.data() + ehdr.e_shoff,
+              shdrs.size() * sizeof(Elf64_Shdr));
+  auto contents = [&](const Elf64_Shdr &shdr) {
+    if (shdr.sh_offset > elf.size() ||
+        shdr.sh_size > elf.size() - shdr.sh_offset)
+      throw invalid("section out of bounds");
+    return elf.substr(shdr.sh_offset, shdr.sh_size);
+  };
+
+  std::string shstrtab = contents(shdrs[ehdr.e_shstrndx]);
+  ElfSections sections;
+  for (size_t i = 1; i < shdrs.size(); i++)
+  {
+    if (i == ehdr.e_shstrndx || shdrs[i].sh_type != SHT_PROGBITS)
+      continue;
+    size_t end = shstrtab.find('\0', shdrs[i].sh_name);
+    if (shdrs[i].sh_name >= shstrtab.size() || end == std::string::npos)
+      throw invalid("invalid section name");
+    sections.emplace_back(
+        shstrtab.substr(shdrs[i].sh_name, end - shdrs[i].sh_name),
+        contents(shdrs[i]));
+  }
+  return sections;
+}
+} // namespace
+
+void ProgramBundle::save(const std::string &path,
+                         const ProgramSections &sections) const
+{
+  if (bpftrace_.boot_specific_)
+    throw std::runtime_error(
+        "the values of kaddr() and cgroupid() are only valid until reboot");
+  if (!bpftrace_.pid_filter_.empty() || bpftrace_.cgroup_filter_ ||
+      bpftrace_.child_)
+    throw std::runtime_error(
+        "programs filtering processes or cgroups cannot be bundled");
+
+  std::ostringstream metadata;
+  write_str(metadata, kernel_release());
+  write_u64(metadata, bpftrace_.safe_mode_);
+  if (!write_file_versions(metadata, traced_binaries(bpftrace_.probes_)))
+    throw std::runtime_error("failed to read the traced binaries");
+  serializer_.save(metadata, {});
+
+  ElfSections elf_sections;
+  for (auto &section : sections)
+  {
+    auto &[addr, size] = section.second;
+    elf_sections.emplace_back(
+        section.first,
+        std::string(reinterpret_cast<const char *>(addr), size));
+  }
+  elf_sections.emplace_back(METADATA_SECTION, metadata.str());
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  write_elf(out, elf_sections);
+  out.close();
+  if (out.fail())
+    throw std::runtime_error("failed to write " + path + ": " +
+                             std::strerror(errno));
+}
+
+void ProgramBundle::load(const std::string &path, bool allow_mismatch)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (file.fail())
+    throw std::runtime_error("failed to open " + path + ": " +
+                             std::strerror(errno));
+  std::stringstream elf;
+  elf << file.rdbuf();
+
+  std::string metadata;
+  bool has_metadata = false;
+  ProgramSections sections;
+  auto elf_sections = read_elf(elf.str());
+  for (auto &section : elf_sections)
+  {
+    if (section.first == METADATA_SECTION)
+    {
+      metadata = section.second;
+      has_metadata = true;
+      continue;
+    }
+    auto &contents = section.second;
+    sections[section.first] = std::make_tuple(
+        reinterpret_cast<uint8_t *>(contents.data()), contents.size());
+  }
+  if (!has_metadata)
+    throw std::runtime_error("not a bpftrace bundle: no " + METADATA_SECTION +
+                             " section");
+
+  std::istringstream in(metadata);
+  auto release = read_str(in);
+  bool safe_mode = read_u64(in);
+  if (!safe_mode && bpftrace_.safe_mode_)
+    throw std::runtime_error(
+        "the bundle was compiled with --unsafe, run it with --unsafe");
+  if (release != kernel_release())
+  {
+    if (!allow_mismatch)
+      throw std::runtime_error("the bundle was compiled for kernel " +
+                               release + ", not " + kernel_release() +
+                               " (run it anyway with --allow-bundle-mismatch)");
+    LOG(WARNING) << "The bundle was compiled for kernel " << release
+                 << ", it may not load on " << kernel_release();
+  }
+
+  // The probes' offsets and USDT arguments were read from these binaries
+  std::vector<std::string> binaries;
+  if (!check_file_versions(in, &binaries))
+  {
+    std::string list;
+    for (auto &binary : binaries)
+      list += (list.empty() ? "" : ", ") + binary;
+    if (!allow_mismatch)
+      throw std::runtime_error(
+          "the traced binaries (" + list +
+          ") changed since the bundle was compiled (run it anyway with "
+          "--allow-bundle-mismatch)");
+    LOG(WARNING) << "The traced binaries (" << list
+                 << ") changed since the bundle was compiled";
+  }
+
+  serializer_.load(in, sections);
+}
+
+} // namespace bpftrace
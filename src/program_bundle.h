@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+
+#include "bpftrace.h"
+#include "program_serializer.h"
+
+namespace bpftrace {
+
+// Ahead-of-time compiled program, deployable without the front end and code
+// generator.
+//
+// A bundle is an ELF object for EM_BPF holding one section per BPF program,
+// named as by the code generator ("s_<probe>_<index>"), and a .bpftrace
+// section with everything else needed to run them: the kernel release and
+// safety mode it was compiled for, the versions of the binaries traced by its
+// uprobes and USDT probes, then the ProgramSerializer format with the maps,
+// probes and async event tables, and no sections of its own.
+//
+// Bundles cannot be tied to the processes or cgroups of the host that built
+// them, nor embed boot specific values (see BPFtrace::boot_specific_).
+class ProgramBundle
+{
+public:
+  explicit ProgramBundle(BPFtrace &bpftrace)
+      : bpftrace_(bpftrace), serializer_(bpftrace)
+  {
+  }
+
+  ProgramBundle(const ProgramBundle &) = delete;
+  ProgramBundle &operator=(const ProgramBundle &) = delete;
+  ProgramBundle(ProgramBundle &&) = delete;
+  ProgramBundle &operator=(ProgramBundle &&) = delete;
+
+  /**
+     Write the program compiled into BPFtrace. Throws std::runtime_error if
+     it cannot be bundled or written.
+  */
+  void save(const std::string &path, const ProgramSections &sections) const;
+
+  /**
+     Restore a bundle into BPFtrace and create its maps. Throws
+     std::runtime_error if the bundle is malformed or cannot be deployed, or
+     if it was compiled for another kernel release or versions of the traced
+     binaries, unless allow_mismatch is set.
+  */
+  void load(const std::string &path, bool allow_mismatch = false);
+
+  /**
+     Sections of the loaded program, valid as long as this object
+  */
+  const ProgramSections &sections() const
+  {
+    return serializer_.sections();
+  }
+
+private:
+  BPFtrace &bpftrace_;
+  ProgramSerializer serializer_;
+};
+
+} // namespace bpftrace
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "program_cache.h"
+#include "utils.h"
+
+namespace bpftrace {
+
+namespace {
+const std::string MAGIC = "bpftrace-cache";
+
+std::string read_file(const std::string &path)
+{
+  std::ifstream file(path, std::ios::binary);
+  std::stringstream buf;
+  buf << file.rdbuf();
+  return buf.str();
+}
+
+std::string boot_id()
+{
+  std::string id = read_file("/proc/sys/kernel/random/boot_id");
+  id.erase(std::remove(id.begin(), id.end(), '\n'), id.end());
+  return id;
+}
+
+// Identity of the kernel BTF, which types and kfunc arguments come from
+std::string btf_id()
+{
+  const char *path = std::getenv("BPFTRACE_BTF");
+  std::string btf = read_file(path ? path : "/sys/kernel/btf/vmlinux");
+  return std::to_string(btf.size()) + ":" +
+         std::to_string(std::hash<std::string>{}(btf));
+}
+
+std::vector<std::string> sorted_names(
+    const std::unordered_set<std::string> &names)
+{
+  std::vector<std::string> sorted(names.begin(), names.end());
+  std::sort(sorted.begin(), sorted.end());
+  return sorted;
+}
+} // namespace
+
+ProgramCache::ProgramCache(const std::string &dir,
+                           BPFtrace &bpftrace,
+                           const std::vector<std::string> &options)
+    : bpftrace_(bpftrace), serializer_(bpftrace)
+{
+  std::ostringstream key;
+  write_str(key, Log::get().get_source());
+  write_u64(key, bpftrace.num_params());
+  for (size_t i = 1; i <= bpftrace.num_params(); i++)
+    write_str(key, bpftrace.get_param(i, true));
+  write_u64(key, options.size());
+  for (auto &option : options)
+    write_str(key, option);
+
+  write_u64(key, bpftrace.strlen_);
+  write_u64(key, bpftrace.mapmax_);
+  write_u64(key, bpftrace.stack_max_);
+  write_u64(key, bpftrace.stack_reuse_ids_);
+  std::map<std::string, uint64_t> map_sizes(bpftrace.map_sizes_.begin(),
+                                             bpftrace.map_sizes_.end());
+  write_u64(key, map_sizes.size());
+  for (auto &map_size : map_sizes)
+  {
+    write_str(key, map_size.first);
+    write_u64(key, map_size.second);
+  }
+  auto lru_maps = sorted_names(bpftrace.lru_maps_);
+  write_u64(key, lru_maps.size());
+  for (auto &map_name : lru_maps)
+    write_str(key, map_name);
+  auto no_prealloc_maps = sorted_names(bpftrace.no_prealloc_maps_);
+  write_u64(key, no_prealloc_maps.size());
+  for (auto &map_name : no_prealloc_maps)
+    write_str(key, map_name);
+  write_u64(key, bpftrace.pid_filter_.size());
+  for (auto pid : bpftrace.pid_filter_)
+    write_u64(key, pid);
+  write_u64(key, bpftrace.pid_filter_follow_forks_);
+  write_u64(key, bpftrace.cgroup_filter_ != nullptr);
+  write_u64(key, bpftrace.cat_bytes_max_);
+  write_u64(key, bpftrace.log_size_);
+  write_u64(key, bpftrace.safe_mode_);
+  write_u64(key, bpftrace.force_btf_);
+  write_u64(key, bpftrace.usdt_file_activation_);
+  write_u64(key, bpftrace.helper_check_level_);
+  write_u64(key, bpftrace.opt_level_);
+  write_u64(key, bpftrace.join_argnum_);
+  write_u64(key, bpftrace.join_argsize_);
+
+  struct utsname utsname;
+  uname(&utsname);
+  write_str(key, utsname.machine);
+  write_str(key, utsname.release);
+  write_str(key, utsname.version);
+  write_str(key, btf_id());
+
+  key_ = key.str();
+  std::ostringstream name;
+  name << std::hex << std::setfill('0') << std::setw(16)
+       << std::hash<std::string>{}(key_);
+  path_ = dir + "/" + name.str() + ".btc";
+}
+
+bool ProgramCache::load()
+{
+  if (access(path_.c_str(), F_OK) != 0)
+    return false;
+  // the cached programs are loaded into the kernel as they are
+  if (!is_private_file(path_))
+  {
+    LOG(WARNING) << "Ignoring cached program " << path_
+                 << ": not owned by the current user or writable by others";
+    return false;
+  }
+
+  std::ifstream in(path_, std::ios::binary);
+  try
+  {
+    // the file name is only a hash of the key
+    if (read_str(in) != MAGIC || read_str(in) != key_)
+      return false;
+
+    if (!check_file_versions(in))
+      return false;
+    auto saved_boot_id = read_str(in);
+    if (!saved_boot_id.empty() && saved_boot_id != boot_id())
+      return false;
+
+    serializer_.load(in);
+  }
+  catch (const std::runtime_error &e)
+  {
+    LOG(WARNING) << "Ignoring cached program " << path_ << ": " << e.what();
+    return false;
+  }
+  return true;
+}
+
+void ProgramCache::store(const ProgramSections &sections,
+                         const std::vector<std::string> &files)
+{
+  std::vector<std::string> deps = files;
+  for (auto &probe : bpftrace_.probes_)
+  {
+    if ((probe.type == ProbeType::uprobe ||
+         probe.type == ProbeType::uretprobe || probe.type == ProbeType::usdt) &&
+        std::find(deps.begin(), deps.end(), probe.path) == deps.end())
+      deps.push_back(probe.path);
+  }
+
+  std::ostringstream entry;
+  write_str(entry, MAGIC);
+  write_str(entry, key_);
+  if (!write_file_versions(entry, deps))
+    return;
+  write_str(entry, bpftrace_.boot_specific_ ? boot_id() : "");
+  serializer_.save(entry, sections);
+
+  bool saved = write_private_file(path_, [&](const std::string &path) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << entry.str();
+    out.close();
+    return !out.fail();
+  });
+  if (!saved)
+    LOG(WARNING) << "Failed to save the compiled program to " << path_;
+}
+
+} // namespace bpftrace
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "bpftrace.h"
+#include "program_serializer.h"
+
+namespace bpftrace {
+
+// On-disk cache of compiled programs, so that running the same script again
+// skips clang, semantic analysis and code generation.
+//
+// Entries are keyed by everything the generated code depends on: the script,
+// the positional parameters, the knobs set in BPFtrace, the command line
+// options passed as `options`, the kernel release and its BTF. An entry also
+// records the files it was compiled against, such as the traced binaries, and
+// is discarded once one of them changes, or after a reboot if the program
+// embeds boot specific values.
+class ProgramCache
+{
+public:
+  ProgramCache(const std::string &dir,
+               BPFtrace &bpftrace,
+               const std::vector<std::string> &options);
+
+  ProgramCache(const ProgramCache &) = delete;
+  ProgramCache &operator=(const ProgramCache &) = delete;
+  ProgramCache(ProgramCache &&) = delete;
+  ProgramCache &operator=(ProgramCache &&) = delete;
+
+  /**
+     Restore the cached program into BPFtrace. Returns false, leaving
+     BPFtrace untouched, if there is no usable entry or its maps cannot be
+     created.
+  */
+  bool load();
+
+  /**
+     Save the program just compiled into BPFtrace. `files` are the
+     included files it was compiled with. Failures are only warned about.
+  */
+  void store(const ProgramSections &sections,
+             const std::vector<std::string> &files);
+
+  /**
+     Sections of the loaded program, valid as long as this object
+  */
+  const ProgramSections &sections() const
+  {
+    return serializer_.sections();
+  }
+
+  const std::string &path() const
+  {
+    return path_;
+  }
+
+private:
+  BPFtrace &bpftrace_;
+  ProgramSerializer serializer_;
+  std::string key_;
+  std::string path_;
+};
+
+} // namespace bpftrace
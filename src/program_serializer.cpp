@@ -0,0 +1,540 @@
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <linux/bpf.h>
+
+#include "map.h"
+#include "program_serializer.h"
+#include "utils.h"
+
+namespace bpftrace {
+
+namespace {
+const std::string MAGIC = "bpftrace-program";
+const uint64_t FORMAT_VERSION = 1;
+
+enum class MapKind
+{
+  named,
+  internal,
+  stack,
+};
+
+// attributes of a saved map, see write_map()
+struct SavedMap
+{
+  MapKind kind;
+  MapManager::Type internal_type;
+  std::string name;
+  SizedType type;
+  MapKey key;
+  enum bpf_map_type map_type;
+  int key_size;
+  int value_size;
+  int max_entries;
+  int flags;
+  int lqmin;
+  int lqmax;
+  int lqstep;
+  int llbits;
+  int fd;
+};
+
+void write_int(std::ostream &out, int64_t value)
+{
+  write_u64(out, static_cast<uint64_t>(value));
+}
+
+int64_t read_int(std::istream &in)
+{
+  return static_cast<int64_t>(read_u64(in));
+}
+
+void write_strs(std::ostream &out, const std::vector<std::string> &strs)
+{
+  write_u64(out, strs.size());
+  for (auto &str : strs)
+    write_str(out, str);
+}
+
+std::vector<std::string> read_strs(std::istream &in)
+{
+  std::vector<std::string> strs(read_u64(in));
+  for (auto &str : strs)
+    str = read_str(in);
+  return strs;
+}
+
+void write_probe(std::ostream &out, const Probe &probe)
+{
+  write_u64(out, static_cast<uint64_t>(probe.type));
+  write_str(out, probe.path);
+  write_str(out, probe.attach_point);
+  write_str(out, probe.orig_name);
+  write_str(out, probe.name);
+  write_str(out, probe.ns);
+  write_u64(out, probe.loc);
+  write_int(out, probe.usdt_location_idx);
+  write_u64(out, probe.log_size);
+  write_int(out, probe.index);
+  write_int(out, probe.freq);
+  write_int(out, probe.pid);
+  write_u64(out, probe.len);
+  write_str(out, probe.mode);
+  write_u64(out, probe.address);
+  write_u64(out, probe.func_offset);
+}
+
+Probe read_probe(std::istream &in)
+{
+  Probe probe;
+  probe.type = static_cast<ProbeType>(read_u64(in));
+  probe.path = read_str(in);
+  probe.attach_point = read_str(in);
+  probe.orig_name = read_str(in);
+  probe.name = read_str(in);
+  probe.ns = read_str(in);
+  probe.loc = read_u64(in);
+  probe.usdt_location_idx = read_int(in);
+  probe.log_size = read_u64(in);
+  probe.index = read_int(in);
+  probe.freq = read_int(in);
+  probe.pid = read_int(in);
+  probe.len = read_u64(in);
+  probe.mode = read_str(in);
+  probe.address = read_u64(in);
+  probe.func_offset = read_u64(in);
+  return probe;
+}
+
+void write_location(std::ostream &out, const location &loc)
+{
+  write_int(out, loc.begin.line);
+  write_int(out, loc.begin.column);
+  write_int(out, loc.end.line);
+  write_int(out, loc.end.column);
+}
+
+location read_location(std::istream &in)
+{
+  location loc;
+  loc.begin.line = read_int(in);
+  loc.begin.column = read_int(in);
+  loc.end.line = read_int(in);
+  loc.end.column = read_int(in);
+  return loc;
+}
+
+// Point the map loads of a program at the recreated maps
+void relocate_map_fds(std::vector<uint8_t> &code,
+                      const std::unordered_map<int, int> &fds)
+{
+  size_t count = code.size() / sizeof(struct bpf_insn);
+  for (size_t i = 0; i < count; i++)
+  {
+    struct bpf_insn insn;
+    std::memcpy(&insn, code.data() + i * sizeof(insn), sizeof(insn));
+    if (insn.code != (BPF_LD | BPF_DW | BPF_IMM))
+      continue;
+
+    // 64-bit immediate loads span two instructions
+    if (insn.src_reg == BPF_PSEUDO_MAP_FD)
+    {
+      auto fd = fds.find(insn.imm);
+      if (fd == fds.end())
+        throw std::runtime_error("program uses unknown map fd " +
+                                 std::to_string(insn.imm));
+      insn.imm = fd->second;
+      std::memcpy(code.data() + i * sizeof(insn), &insn, sizeof(insn));
+    }
+    i++;
+  }
+}
+} // namespace
+
+void write_u64(std::ostream &out, uint64_t value)
+{
+  out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void write_str(std::ostream &out, const std::string &value)
+{
+  write_u64(out, value.size());
+  out.write(value.data(), value.size());
+}
+
+uint64_t read_u64(std::istream &in)
+{
+  uint64_t value;
+  if (!in.read(reinterpret_cast<char *>(&value), sizeof(value)))
+    throw std::runtime_error("unexpected end of input");
+  return value;
+}
+
+std::string read_str(std::istream &in)
+{
+  uint64_t size = read_u64(in);
+  if (size > std::numeric_limits<uint32_t>::max())
+    throw std::runtime_error("invalid string size " + std::to_string(size));
+  std::string value(size, '\0');
+  if (!in.read(value.data(), size))
+    throw std::runtime_error("unexpected end of input");
+  return value;
+}
+
+bool write_file_versions(std::ostream &out,
+                         const std::vector<std::string> &files)
+{
+  write_u64(out, files.size());
+  for (auto &file : files)
+  {
+    uint64_t size = 0, mtime = 0;
+    if (!file_version(file, size, mtime))
+      return false;
+    write_str(out, file);
+    write_u64(out, size);
+    write_u64(out, mtime);
+  }
+  return true;
+}
+
+bool check_file_versions(std::istream &in, std::vector<std::string> *files)
+{
+  bool current = true;
+  for (uint64_t n = read_u64(in); n > 0; n--)
+  {
+    auto file = read_str(in);
+    uint64_t saved_size = read_u64(in);
+    uint64_t saved_mtime = read_u64(in);
+    uint64_t size, mtime;
+    if (!file_version(file, size, mtime) || size != saved_size ||
+        mtime != saved_mtime)
+      current = false;
+    if (files)
+      files->push_back(std::move(file));
+  }
+  return current;
+}
+
+void ProgramSerializer::write_type(std::ostream &out, const SizedType &type)
+{
+  write_u64(out, static_cast<uint64_t>(type.type));
+  write_u64(out, type.size);
+  write_u64(out, type.stack_type.limit);
+  write_u64(out, static_cast<uint64_t>(type.stack_type.mode));
+  write_u64(out, type.is_internal);
+  write_u64(out, type.is_tparg);
+  write_u64(out, type.is_kfarg);
+  write_int(out, type.kfarg_idx);
+  write_u64(out, type.tuple_elems.size());
+  for (auto &elem : type.tuple_elems)
+    write_type(out, elem);
+  write_u64(out, type.is_signed_);
+  write_u64(out, type.element_type_ != nullptr);
+  if (type.element_type_)
+    write_type(out, *type.element_type_);
+  write_u64(out, type.IsArrayTy() ? type.num_elements_ : 0);
+  write_str(out, type.name_);
+  write_u64(out, type.ctx_);
+  write_u64(out, static_cast<uint64_t>(type.as_));
+  write_int(out, type.IsIntTy() ? type.size_bits : 0);
+}
+
+SizedType ProgramSerializer::read_type(std::istream &in)
+{
+  SizedType type;
+  type.type = static_cast<Type>(read_u64(in));
+  type.size = read_u64(in);
+  type.stack_type.limit = read_u64(in);
+  type.stack_type.mode = static_cast<StackMode>(read_u64(in));
+  type.is_internal = read_u64(in);
+  type.is_tparg = read_u64(in);
+  type.is_kfarg = read_u64(in);
+  type.kfarg_idx = read_int(in);
+  type.tuple_elems.resize(read_u64(in));
+  for (auto &elem : type.tuple_elems)
+    elem = read_type(in);
+  type.is_signed_ = read_u64(in);
+  if (read_u64(in))
+    type.element_type_ = std::make_shared<SizedType>(read_type(in));
+  type.num_elements_ = read_u64(in);
+  type.name_ = read_str(in);
+  type.ctx_ = read_u64(in);
+  type.as_ = static_cast<AddrSpace>(read_u64(in));
+  type.size_bits = read_int(in);
+  return type;
+}
+
+void ProgramSerializer::save(std::ostream &out,
+                             const ProgramSections &sections) const
+{
+  write_str(out, MAGIC);
+  write_u64(out, FORMAT_VERSION);
+
+  auto write_fields = [&out](const std::vector<Field> &fields) {
+    write_u64(out, fields.size());
+    for (auto &field : fields)
+    {
+      write_type(out, field.type);
+      write_int(out, field.offset);
+      write_u64(out, field.is_bitfield);
+      write_u64(out, field.bitfield.read_bytes);
+      write_u64(out, field.bitfield.access_rshift);
+      write_u64(out, field.bitfield.mask);
+    }
+  };
+  auto write_args =
+      [&](const std::vector<std::tuple<std::string, std::vector<Field>>>
+              &args) {
+        write_u64(out, args.size());
+        for (auto &arg : args)
+        {
+          write_str(out, std::get<0>(arg));
+          write_fields(std::get<1>(arg));
+        }
+      };
+  auto write_map = [&out](MapKind kind,
+                          MapManager::Type internal_type,
+                          const IMap &map) {
+    write_u64(out, static_cast<uint64_t>(kind));
+    write_u64(out, static_cast<uint64_t>(internal_type));
+    write_str(out, map.name_);
+    write_type(out, map.type_);
+    write_u64(out, map.key_.args_.size());
+    for (auto &arg : map.key_.args_)
+      write_type(out, arg);
+    write_u64(out, map.map_type_);
+    write_int(out, map.key_size_);
+    write_int(out, map.value_size_);
+    write_int(out, map.max_entries_);
+    write_int(out, map.flags_);
+    write_int(out, map.lqmin);
+    write_int(out, map.lqmax);
+    write_int(out, map.lqstep);
+    write_int(out, map.llbits);
+    write_int(out, map.mapfd_);
+  };
+
+  // named maps are saved in id order, so that they get the same ids back
+  auto &maps = bpftrace_.maps;
+  std::vector<std::pair<StackType, IMap *>> stack_maps;
+  for (auto &stack_map : maps.stack_maps())
+    if (stack_map.second)
+      stack_maps.emplace_back(stack_map.first, stack_map.second.get());
+  write_u64(out,
+            (maps.end() - maps.begin()) + maps.internal_maps().size() +
+                stack_maps.size());
+  for (auto &map : maps)
+    write_map(MapKind::named, MapManager::Type::PerfEvent, *map);
+  for (auto &map : maps.internal_maps())
+    write_map(MapKind::internal, map.first, *map.second);
+  for (auto &map : stack_maps)
+    write_map(MapKind::stack, MapManager::Type::PerfEvent, *map.second);
+
+  write_u64(out, bpftrace_.probes_.size());
+  for (auto &probe : bpftrace_.probes_)
+    write_probe(out, probe);
+  write_u64(out, bpftrace_.special_probes_.size());
+  for (auto &probe : bpftrace_.special_probes_)
+    write_probe(out, probe);
+  write_strs(out, bpftrace_.probe_ids_);
+  write_u64(out, bpftrace_.has_usdt_);
+
+  write_args(bpftrace_.printf_args_);
+  write_args(bpftrace_.system_args_);
+  write_args(bpftrace_.cat_args_);
+  write_strs(out, bpftrace_.join_args_);
+  write_strs(out, bpftrace_.time_args_);
+  write_strs(out, bpftrace_.strftime_args_);
+  write_strs(out, bpftrace_.sampling_sites_);
+  write_strs(out, bpftrace_.stackid_sites_);
+  write_u64(out, bpftrace_.non_map_print_args_.size());
+  for (auto &arg : bpftrace_.non_map_print_args_)
+    write_type(out, arg);
+  write_u64(out, bpftrace_.helper_error_info_.size());
+  for (auto &info : bpftrace_.helper_error_info_)
+  {
+    write_int(out, info.first);
+    write_int(out, info.second.func_id);
+    write_location(out, info.second.loc);
+  }
+
+  write_u64(out, sections.size());
+  for (auto &section : sections)
+  {
+    write_str(out, section.first);
+    auto &[addr, size] = section.second;
+    write_str(out, std::string(reinterpret_cast<const char *>(addr), size));
+  }
+}
+
+void ProgramSerializer::load(std::istream &in,
+                             const ProgramSections &sections)
+{
+  if (read_str(in) != MAGIC)
+    throw std::runtime_error("not a compiled bpftrace program");
+  uint64_t version = read_u64(in);
+  if (version != FORMAT_VERSION)
+    throw std::runtime_error("unsupported format version " +
+                             std::to_string(version));
+
+  auto read_fields = [&in]() {
+    std::vector<Field> fields(read_u64(in));
+    for (auto &field : fields)
+    {
+      field.type = read_type(in);
+      field.offset = read_int(in);
+      field.is_bitfield = read_u64(in);
+      field.bitfield.read_bytes = read_u64(in);
+      field.bitfield.access_rshift = read_u64(in);
+      field.bitfield.mask = read_u64(in);
+    }
+    return fields;
+  };
+  auto read_args = [&]() {
+    std::vector<std::tuple<std::string, std::vector<Field>>> args(
+        read_u64(in));
+    for (auto &arg : args)
+    {
+      std::get<0>(arg) = read_str(in);
+      std::get<1>(arg) = read_fields();
+    }
+    return args;
+  };
+
+  std::vector<SavedMap> saved_maps(read_u64(in));
+  for (auto &map : saved_maps)
+  {
+    map.kind = static_cast<MapKind>(read_u64(in));
+    map.internal_type = static_cast<MapManager::Type>(read_u64(in));
+    map.name = read_str(in);
+    map.type = read_type(in);
+    map.key.args_.resize(read_u64(in));
+    for (auto &arg : map.key.args_)
+      arg = read_type(in);
+    map.map_type = static_cast<enum bpf_map_type>(read_u64(in));
+    map.key_size = read_int(in);
+    map.value_size = read_int(in);
+    map.max_entries = read_int(in);
+    map.flags = read_int(in);
+    map.lqmin = read_int(in);
+    map.lqmax = read_int(in);
+    map.lqstep = read_int(in);
+    map.llbits = read_int(in);
+    map.fd = read_int(in);
+  }
+
+  std::vector<Probe> probes(read_u64(in));
+  for (auto &probe : probes)
+    probe = read_probe(in);
+  std::vector<Probe> special_probes(read_u64(in));
+  for (auto &probe : special_probes)
+    probe = read_probe(in);
+  auto probe_ids = read_strs(in);
+  bool has_usdt = read_u64(in);
+
+  auto printf_args = read_args();
+  auto system_args = read_args();
+  auto cat_args = read_args();
+  auto join_args = read_strs(in);
+  auto time_args = read_strs(in);
+  auto strftime_args = read_strs(in);
+  auto sampling_sites = read_strs(in);
+  auto stackid_sites = read_strs(in);
+  std::vector<SizedType> non_map_print_args(read_u64(in));
+  for (auto &arg : non_map_print_args)
+    arg = read_type(in);
+  std::unordered_map<int64_t, HelperErrorInfo> helper_error_info;
+  for (uint64_t n = read_u64(in); n > 0; n--)
+  {
+    int64_t error_id = read_int(in);
+    auto &info = helper_error_info[error_id];
+    info.func_id = read_int(in);
+    info.loc = read_location(in);
+  }
+
+  std::map<std::string, std::vector<uint8_t>> code;
+  for (uint64_t n = read_u64(in); n > 0; n--)
+  {
+    auto name = read_str(in);
+    auto bytes = read_str(in);
+    code[name].assign(bytes.begin(), bytes.end());
+  }
+  for (auto &section : sections)
+  {
+    auto &[addr, size] = section.second;
+    code[section.first].assign(addr, addr + size);
+  }
+
+  // The input is valid, recreate the maps
+  std::vector<std::unique_ptr<IMap>> maps;
+  std::unordered_map<int, int> fds;
+  for (auto &saved : saved_maps)
+  {
+    std::unique_ptr<Map> map;
+    if (saved.kind == MapKind::stack)
+      map = std::make_unique<Map>(saved.type, saved.max_entries);
+    else if (saved.kind == MapKind::internal &&
+             saved.internal_type == MapManager::Type::PerfEvent)
+      map = std::make_unique<Map>(BPF_MAP_TYPE_PERF_EVENT_ARRAY);
+    else
+      map = std::make_unique<Map>(saved.name,
+                                  saved.type,
+                                  saved.key,
+                                  saved.map_type,
+                                  saved.key_size,
+                                  saved.value_size,
+                                  saved.max_entries,
+                                  saved.flags);
+    if (map->mapfd_ < 0)
+      throw std::runtime_error("Creation of the required BPF maps has failed");
+    map->lqmin = saved.lqmin;
+    map->lqmax = saved.lqmax;
+    map->lqstep = saved.lqstep;
+    map->llbits = saved.llbits;
+    fds[saved.fd] = map->mapfd_;
+    maps.push_back(std::move(map));
+  }
+
+  for (auto &section : code)
+  {
+    if (section.first.rfind("s_", 0) == 0)
+      relocate_map_fds(section.second, fds);
+  }
+
+  for (size_t i = 0; i < maps.size(); i++)
+  {
+    auto &saved = saved_maps[i];
+    if (saved.kind == MapKind::named)
+      bpftrace_.maps.Add(std::move(maps[i]));
+    else if (saved.kind == MapKind::internal)
+      bpftrace_.maps.Set(saved.internal_type, std::move(maps[i]));
+    else
+      bpftrace_.maps.Set(saved.type.stack_type, std::move(maps[i]));
+  }
+
+  bpftrace_.probes_ = std::move(probes);
+  bpftrace_.special_probes_ = std::move(special_probes);
+  bpftrace_.probe_ids_ = std::move(probe_ids);
+  bpftrace_.has_usdt_ = has_usdt;
+  bpftrace_.printf_args_ = std::move(printf_args);
+  bpftrace_.system_args_ = std::move(system_args);
+  bpftrace_.cat_args_ = std::move(cat_args);
+  bpftrace_.join_args_ = std::move(join_args);
+  bpftrace_.time_args_ = std::move(time_args);
+  bpftrace_.strftime_args_ = std::move(strftime_args);
+  bpftrace_.sampling_sites_ = std::move(sampling_sites);
+  bpftrace_.stackid_sites_ = std::move(stackid_sites);
+  bpftrace_.non_map_print_args_ = std::move(non_map_print_args);
+  bpftrace_.helper_error_info_ = std::move(helper_error_info);
+
+  code_ = std::move(code);
+  sections_.clear();
+  for (auto &section : code_)
+    sections_[section.first] = std::make_tuple(section.second.data(),
+                                               section.second.size());
+}
+
+} // namespace bpftrace
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "bpftrace.h"
+
+namespace bpftrace {
+
+// Saves a compiled program together with the BPFtrace state needed to deploy
+// it: the maps, the probes and the tables used to handle async events.
+// Loading it back recreates the maps and rewrites the map fds embedded in the
+// programs, so neither the front end nor the code generator have to run.
+//
+// The format is the native byte order of the host that wrote it.
+class ProgramSerializer
+{
+public:
+  explicit ProgramSerializer(BPFtrace &bpftrace) : bpftrace_(bpftrace)
+  {
+  }
+
+  ProgramSerializer(const ProgramSerializer &) = delete;
+  ProgramSerializer &operator=(const ProgramSerializer &) = delete;
+  ProgramSerializer(ProgramSerializer &&) = delete;
+  ProgramSerializer &operator=(ProgramSerializer &&) = delete;
+
+  void save(std::ostream &out, const ProgramSections &sections) const;
+
+  /**
+     Restore a program written by save(). `sections` are added to the ones
+     read from the input, for programs stored elsewhere. Nothing is changed
+     in BPFtrace when the input is malformed. Throws std::runtime_error if
+     the input is malformed or the maps cannot be created.
+  */
+  void load(std::istream &in, const ProgramSections &sections = {});
+
+  /**
+     Sections of the loaded program, valid as long as this object
+  */
+  const ProgramSections &sections() const
+  {
+    return sections_;
+  }
+
+private:
+  static void write_type(std::ostream &out, const SizedType &type);
+  static SizedType read_type(std::istream &in);
+
+  BPFtrace &bpftrace_;
+  std::map<std::string, std::vector<uint8_t>> code_;
+  ProgramSections sections_;
+};
+
+/**
+   Length-prefixed primitives of the format, in native byte order. The
+   readers throw std::runtime_error on truncated input.
+*/
+void write_u64(std::ostream &out, uint64_t value);
+void write_str(std::ostream &out, const std::string &value);
+uint64_t read_u64(std::istream &in);
+std::string read_str(std::istream &in);
+
+/**
+   Record the size and modification time of `files`, which the data written
+   next was derived from. Returns false if one of them cannot be read.
+*/
+bool write_file_versions(std::ostream &out,
+                         const std::vector<std::string> &files);
+
+/**
+   Check the files recorded by write_file_versions to be unchanged. Their
+   names are appended to `files` if given.
+*/
+bool check_file_versions(std::istream &in,
+                         std::vector<std::string> *files = nullptr);
+
+} // namespace bpftrace
@@ -0,0 +1,181 @@
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+#include "sketch.h"
+
+namespace bpftrace {
+
+size_t loglinear_buckets(int bits)
+{
+  // 2^(bits+1) exact buckets, (63 - bits) power-of-2 ranges of 2^bits
+  // sub-buckets above them, plus the less-than-zero bucket
+  return (static_cast<size_t>(65 - bits) << bits) + 1;
+}
+
+uint64_t loglinear_index(int64_t value, int bits)
+{
+  if (value < 0)
+    return 0;
+
+  uint64_t n = value;
+  if (n < (2ULL << bits))
+    return n + 1;
+
+  uint64_t exp = 63 - __builtin_clzll(n) - bits;
+  return (exp << bits) + (n >> exp) + 1;
+}
+
+void loglinear_bounds(int bits, uint64_t index, uint64_t &low, uint64_t &high)
+{
+  // Index 0 is for values less than 0 and is not passed in here
+  uint64_t bucket = index - 1;
+  if (bucket < (2ULL << bits))
+  {
+    low = high = bucket;
+    return;
+  }
+
+  uint64_t shift = (bucket >> bits) - 1;
+  uint64_t mantissa = bucket - (shift << bits);
+  low = mantissa << shift;
+  high = ((mantissa + 1) << shift) - 1;
+}
+
+size_t quantiles_buckets(int bits)
+{
+  // Keys range from -(loglinear_buckets - 1) to (loglinear_buckets - 1)
+  return 2 * loglinear_buckets(bits) - 1;
+}
+
+size_t quantiles_position(int64_t key, int bits)
+{
+  return key + loglinear_buckets(bits) - 1;
+}
+
+int64_t quantiles_key(uint64_t value, bool is_signed, int bits)
+{
+  // Magnitudes above INT64_MAX, of INT64_MIN or of unsigned values, are
+  // counted in the top bucket, so that every key is a bucket index
+  const int64_t max = std::numeric_limits<int64_t>::max();
+  if (!is_signed)
+    return loglinear_index(value > static_cast<uint64_t>(max) ? max : value,
+                           bits);
+
+  int64_t n = static_cast<int64_t>(value);
+  if (n >= 0)
+    return loglinear_index(n, bits);
+  int64_t magnitude = n == std::numeric_limits<int64_t>::min() ? max : -n;
+  return -static_cast<int64_t>(loglinear_index(magnitude, bits));
+}
+
+int64_t quantiles_value(size_t position, int bits)
+{
+  int64_t key = position - (loglinear_buckets(bits) - 1);
+  if (key == 0)
+    // Never used by quantiles_key()
+    return 0;
+
+  uint64_t low, high;
+  loglinear_bounds(bits, std::abs(key), low, high);
+
+  // The harmonic mean of the bucket bounds has the same relative error to
+  // both of them
+  double estimate = low;
+  if (low != high)
+    estimate = 2.0 * low * (high + 1.0) / (low + high + 1.0);
+
+  int64_t value = std::numeric_limits<int64_t>::max();
+  if (estimate < value)
+    value = std::llround(estimate);
+  return key < 0 ? -value : value;
+}
+
+uint64_t quantiles_count(const std::vector<uint64_t> &counts)
+{
+  uint64_t total = 0;
+  for (auto count : counts)
+    total += count;
+  return total;
+}
+
+int64_t quantiles_estimate(const std::vector<uint64_t> &counts,
+                           int bits,
+                           double quantile)
+{
+  uint64_t total = quantiles_count(counts);
+  if (total == 0)
+    return 0;
+
+  // The estimate is taken from the bucket holding the value at rank
+  // floor(quantile * (total - 1)) in sorted order
+  uint64_t rank = quantile * (total - 1);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < counts.size(); i++)
+  {
+    seen += counts.at(i);
+    if (seen > rank)
+      return quantiles_value(i, bits);
+  }
+  return quantiles_value(counts.size() - 1, bits);
+}
+
+double quantiles_accuracy(int bits)
+{
+  // Buckets are at most (1 + 2^-bits) times wider than their lower bound
+  return 1.0 / ((2 << bits) + 1);
+}
+
+uint64_t hll_hash(uint64_t value)
+{
+  // splitmix64 finaliser
+  value += 0x9e3779b97f4a7c15ULL;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+  return value ^ (value >> 31);
+}
+
+void hll_add(std::vector<uint8_t> &registers, uint64_t hash)
+{
+  int precision = __builtin_ctzll(registers.size());
+  uint64_t index = hash >> (64 - precision);
+  // The guard bit caps the rank when the remaining bits are all zero
+  uint64_t rest = (hash << precision) | (1ULL << (precision - 1));
+  uint8_t rank = __builtin_clzll(rest) + 1;
+  if (rank > registers.at(index))
+    registers.at(index) = rank;
+}
+
+void hll_merge(std::vector<uint8_t> &registers, const uint8_t *other)
+{
+  for (size_t i = 0; i < registers.size(); i++)
+  {
+    if (other[i] > registers.at(i))
+      registers.at(i) = other[i];
+  }
+}
+
+uint64_t hll_estimate(const std::vector<uint8_t> &registers)
+{
+  double m = registers.size();
+  double sum = 0;
+  size_t zeros = 0;
+  for (auto reg : registers)
+  {
+    sum += std::ldexp(1.0, -reg);
+    if (reg == 0)
+      zeros++;
+  }
+
+  double alpha = 0.7213 / (1 + 1.079 / m);
+  double estimate = alpha * m * m / sum;
+
+  // Small cardinalities are better estimated by linear counting of the
+  // registers that are still empty
+  if (estimate <= 2.5 * m && zeros > 0)
+    estimate = m * std::log(m / zeros);
+
+  return std::llround(estimate);
+}
+
+} // namespace bpftrace
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bpftrace {
+
+/*
+ * Log-linear bucketing shared by llhist() and quantiles().
+ *
+ * Every power-of-2 range is split into 2^bits linear sub-buckets. Index 0 is
+ * for values less than 0, values below 2^(bits+1) get an exact bucket of
+ * their own at index value+1. The BPF side is generated by
+ * CodegenLLVM::createLogLinearFunction and must stay in sync with
+ * loglinear_index().
+ */
+size_t loglinear_buckets(int bits);
+uint64_t loglinear_index(int64_t value, int bits);
+void loglinear_bounds(int bits, uint64_t index, uint64_t &low, uint64_t &high);
+
+/*
+ * quantiles() sketches store positive values under their log-linear index and
+ * negative values under the negated index of their magnitude, see
+ * quantiles_key(), which the BPF side generated in CodegenLLVM must match.
+ * User space keeps a sketch as a vector of counts, see quantiles_position().
+ */
+int64_t quantiles_key(uint64_t value, bool is_signed, int bits);
+size_t quantiles_buckets(int bits);
+size_t quantiles_position(int64_t key, int bits);
+int64_t quantiles_value(size_t position, int bits);
+uint64_t quantiles_count(const std::vector<uint64_t> &counts);
+int64_t quantiles_estimate(const std::vector<uint64_t> &counts,
+                           int bits,
+                           double quantile);
+double quantiles_accuracy(int bits);
+
+/*
+ * count_distinct() keeps a HyperLogLog sketch of one byte registers per map
+ * key. Values are hashed with hll_hash(), the top bits of the hash select a
+ * register and the register keeps the highest rank seen, see hll_add(). The
+ * BPF side is generated by CodegenLLVM and must stay in sync with these.
+ * Sketches are merged by taking the maximum of each register.
+ */
+uint64_t hll_hash(uint64_t value);
+void hll_add(std::vector<uint8_t> &registers, uint64_t hash);
+void hll_merge(std::vector<uint8_t> &registers, const uint8_t *other);
+uint64_t hll_estimate(const std::vector<uint8_t> &registers);
+
+} // namespace bpftrace
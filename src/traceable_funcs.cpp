@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+
+#include "list.h"
+#include "log.h"
+#include "traceable_funcs.h"
+
+namespace bpftrace {
+
+namespace {
+// The function name at the start of a line, without the module
+std::string_view func_name(std::string_view line)
+{
+  return line.substr(0, line.find_first_of(" \n"));
+}
+} // namespace
+
+void TraceableFuncs::load() const
+{
+  if (loaded_)
+    return;
+  loaded_ = true;
+
+  // Try to get the list of functions from BPFTRACE_AVAILABLE_FUNCTIONS_TEST env
+  const char *path = std::getenv("BPFTRACE_AVAILABLE_FUNCTIONS_TEST");
+
+  // Use kprobe list as default
+  if (!path)
+    path = kprobe_path.c_str();
+
+  std::ifstream available_funs(path);
+  if (available_funs.fail())
+  {
+    if (bt_debug != DebugLevel::kNone)
+    {
+      std::cerr << "Error while reading traceable functions from "
+                << kprobe_path << ": " << strerror(errno);
+    }
+    return;
+  }
+
+  std::stringstream buf;
+  buf << available_funs.rdbuf();
+  std::string file = buf.str();
+
+  std::vector<std::string_view> lines;
+  std::string_view rest(file);
+  while (!rest.empty())
+  {
+    size_t end = rest.find('\n');
+    auto line = rest.substr(0, end);
+    if (!line.empty())
+      lines.push_back(line);
+    rest.remove_prefix(end == std::string_view::npos ? rest.size() : end + 1);
+  }
+  std::sort(lines.begin(), lines.end(), [](auto a, auto b) {
+    auto name_a = func_name(a), name_b = func_name(b);
+    return name_a != name_b ? name_a < name_b : a < b;
+  });
+
+  arena_.reserve(file.size() + 1);
+  offsets_.reserve(lines.size());
+  for (auto line : lines)
+  {
+    offsets_.push_back(arena_.size());
+    arena_.append(line);
+    arena_.push_back('\n');
+  }
+}
+
+bool TraceableFuncs::contains(const std::string &func) const
+{
+  load();
+  auto name_at = [this](uint32_t offset) {
+    return func_name(std::string_view(arena_).substr(offset));
+  };
+  auto it = std::lower_bound(offsets_.begin(),
+                             offsets_.end(),
+                             func,
+                             [&](uint32_t offset, const std::string &name) {
+                               return name_at(offset) < name;
+                             });
+  return it != offsets_.end() && name_at(*it) == func;
+}
+
+bool TraceableFuncs::empty() const
+{
+  load();
+  return offsets_.empty();
+}
+
+std::unique_ptr<std::istream> TraceableFuncs::lines() const
+{
+  load();
+  return std::make_unique<std::istringstream>(arena_);
+}
+
+} // namespace bpftrace
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bpftrace {
+
+// Kernel functions that can be traced, as listed by available_filter_functions
+// ("func" or "func [module]" per line).
+//
+// The file lists tens of thousands of functions, so it is only read on first
+// use and kept as one buffer of lines sorted by function name, plus the offset
+// of each line, rather than as a set of strings.
+class TraceableFuncs
+{
+public:
+  /**
+     True if `func` is listed, whatever its module
+  */
+  bool contains(const std::string &func) const;
+
+  /**
+     True if the list could not be read or is empty
+  */
+  bool empty() const;
+
+  /**
+     The lines of the list, for wildcard matching
+  */
+  std::unique_ptr<std::istream> lines() const;
+
+private:
+  void load() const;
+
+  mutable bool loaded_ = false;
+  mutable std::string arena_;
+  mutable std::vector<uint32_t> offsets_;
+};
+
+} // namespace bpftrace
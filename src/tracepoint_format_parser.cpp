@@ -1,7 +1,9 @@
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <glob.h>
 #include <iostream>
+#include <unistd.h>
 
 #include "ast.h"
 #include "bpftrace.h"
@@ -13,6 +15,16 @@ namespace bpftrace {
 
 std::set<std::string> TracepointFormatParser::struct_list;
 
+// Where the format files are, tracefs unless a test points
+// BPFTRACE_TRACEPOINT_EVENTS_TEST at a directory of its own
+static std::string events_dir()
+{
+  const char *dir = std::getenv("BPFTRACE_TRACEPOINT_EVENTS_TEST");
+  if (dir)
+    return std::string(dir) + "/";
+  return "/sys/kernel/debug/tracing/events/";
+}
+
 bool TracepointFormatParser::parse(ast::Program *program, BPFtrace &bpftrace)
 {
   std::vector<ast::Probe*> probes_with_tracepoint;
@@ -27,6 +39,7 @@ bool TracepointFormatParser::parse(ast::Program *program, BPFtrace &bpftrace)
     return true;
 
   ast::TracepointArgsVisitor n{};
+  std::string events = events_dir();
   if (!bpftrace.btf_.has_data())
     program->c_definitions += "#include <linux/types.h>\n";
   for (ast::Probe *probe : probes_with_tracepoint)
@@ -39,7 +52,7 @@ bool TracepointFormatParser::parse(ast::Program *program, BPFtrace &bpftrace)
       {
         std::string &category = ap->target;
         std::string &event_name = ap->func;
-        std::string format_file_path = "/sys/kernel/debug/tracing/events/" + category + "/" + event_name + "/format";
+        std::string format_file_path = events + category + "/" + event_name + "/format";
         glob_t glob_result;
 
         if (has_wildcard(category) || has_wildcard(event_name))
@@ -75,32 +88,22 @@ bool TracepointFormatParser::parse(ast::Program *program, BPFtrace &bpftrace)
 
           for (size_t i = 0; i < glob_result.gl_pathc; ++i) {
             std::string filename(glob_result.gl_pathv[i]);
-            std::ifstream format_file(filename);
-            std::string prefix("/sys/kernel/debug/tracing/events/");
-            size_t pos = prefix.length();
+            size_t pos = events.length();
             std::string real_category = filename.substr(
                 pos, filename.find('/', pos) - pos);
-            pos = prefix.length() + real_category.length() + 1;
+            pos = events.length() + real_category.length() + 1;
             std::string real_event = filename.substr(
                 pos, filename.length() - std::string("/format").length() - pos);
 
-            // Check to avoid adding the same struct more than once to definitions
-            std::string struct_name = get_struct_name(real_category,
-                                                      real_event);
-            if (!TracepointFormatParser::struct_list.count(struct_name))
-            {
-              program->c_definitions += get_tracepoint_struct(
-                  format_file, real_category, real_event, bpftrace);
-              TracepointFormatParser::struct_list.insert(struct_name);
-            }
+            define_struct(
+                program, bpftrace, real_category, real_event, filename);
           }
           globfree(&glob_result);
         }
         else
         {
           // single tracepoint
-          std::ifstream format_file(format_file_path.c_str());
-          if (format_file.fail())
+          if (access(format_file_path.c_str(), R_OK) != 0)
           {
             // Errno might get clobbered by LOG().
             int saved_errno = errno;
@@ -122,11 +125,8 @@ bool TracepointFormatParser::parse(ast::Program *program, BPFtrace &bpftrace)
           if (!probe->need_tp_args_structs)
             continue;
 
-          // Check to avoid adding the same struct more than once to definitions
-          std::string struct_name = get_struct_name(category, event_name);
-          if (TracepointFormatParser::struct_list.insert(struct_name).second)
-            program->c_definitions += get_tracepoint_struct(
-                format_file, category, event_name, bpftrace);
+          define_struct(
+              program, bpftrace, category, event_name, format_file_path);
         }
       }
     }
@@ -134,6 +134,27 @@ bool TracepointFormatParser::parse(ast::Program *program, BPFtrace &bpftrace)
   return true;
 }
 
+void TracepointFormatParser::define_struct(ast::Program *program,
+                                           BPFtrace &bpftrace,
+                                           const std::string &category,
+                                           const std::string &event_name,
+                                           const std::string &format_file_path)
+{
+  // Check to avoid adding the same struct more than once to definitions
+  std::string struct_name = get_struct_name(category, event_name);
+  if (!struct_list.insert(struct_name).second)
+    return;
+
+  // The kernel's own struct needs neither the format file nor clang
+  if (bpftrace.btf_.resolve_tracepoint(
+          event_name, struct_name, bpftrace.structs_, bpftrace.enums_))
+    return;
+
+  std::ifstream format_file(format_file_path);
+  program->c_definitions += get_tracepoint_struct(
+      format_file, category, event_name, bpftrace);
+}
+
 std::string TracepointFormatParser::get_struct_name(const std::string &category, const std::string &event_name)
 {
   return "struct _tracepoint_" + category + "_" + event_name;
@@ -157,6 +157,12 @@ private:
                                  BPFtrace &bpftrace);
   static std::string adjust_integer_types(const std::string &field_type,
                                           int size);
+  // Define the args struct of a tracepoint, from BTF when possible
+  static void define_struct(ast::Program *program,
+                            BPFtrace &bpftrace,
+                            const std::string &category,
+                            const std::string &event_name,
+                            const std::string &format_file_path);
   static std::set<std::string> struct_list;
 
 protected:
@@ -152,7 +152,10 @@ std::string typestr(Type t)
     case Type::record:   return "record";   break;
     case Type::hist:     return "hist";     break;
     case Type::lhist:    return "lhist";    break;
+    case Type::llhist:   return "llhist";   break;
+    case Type::quantiles:return "quantiles";break;
     case Type::count:    return "count";    break;
+    case Type::count_distinct: return "count_distinct"; break;
     case Type::sum:      return "sum";      break;
     case Type::min:      return "min";      break;
     case Type::max:      return "max";      break;
@@ -164,6 +167,8 @@ std::string typestr(Type t)
     case Type::ksym:     return "ksym";     break;
     case Type::usym:     return "usym";     break;
     case Type::join:     return "join";     break;
+    case Type::sampling: return "sampling"; break;
+    case Type::stackid_errors: return "stackid_errors"; break;
     case Type::probe:    return "probe";    break;
     case Type::username: return "username"; break;
     case Type::inet:     return "inet";     break;
@@ -228,6 +233,7 @@ std::string probetypeName(ProbeType t)
     case ProbeType::watchpoint:  return "watchpoint";  break;
     case ProbeType::kfunc:       return "kfunc";       break;
     case ProbeType::kretfunc:    return "kretfunc";    break;
+    case ProbeType::rawtracepoint: return "rawtracepoint"; break;
   }
 
   return {}; // unreached
@@ -373,6 +379,12 @@ SizedType CreateCount(bool is_signed)
   return SizedType(Type::count, 8, is_signed);
 }
 
+SizedType CreateCountDistinct()
+{
+  // one byte per HyperLogLog register
+  return SizedType(Type::count_distinct, 1 << HLL_PRECISION);
+}
+
 SizedType CreateAvg(bool is_signed)
 {
   return SizedType(Type::avg, 8, is_signed);
@@ -405,6 +417,16 @@ SizedType CreateLhist()
   return SizedType(Type::lhist, 8);
 }
 
+SizedType CreateLLhist()
+{
+  return SizedType(Type::llhist, 8);
+}
+
+SizedType CreateQuantiles()
+{
+  return SizedType(Type::quantiles, 8);
+}
+
 SizedType CreateHist()
 {
   return SizedType(Type::hist, 8);
@@ -425,6 +447,16 @@ SizedType CreateJoin(size_t argnum, size_t argsize)
   return SizedType(Type::join, 8 + 8 + argnum * argsize);
 }
 
+SizedType CreateSampling()
+{
+  return SizedType(Type::sampling, sizeof(SamplingSlot));
+}
+
+SizedType CreateStackIdErrors()
+{
+  return SizedType(Type::stackid_errors, sizeof(StackIdErrors));
+}
+
 SizedType CreateBuffer(size_t size)
 {
   return SizedType(Type::buffer, size);
@@ -15,6 +15,32 @@ const int MAX_STACK_SIZE = 1024;
 const int DEFAULT_STACK_SIZE = 127;
 const int STRING_SIZE = 64;
 const int COMM_SIZE = 16;
+// llhist() and quantiles() precision, as log2 of the number of sub-buckets
+// per power of 2
+const int LLHIST_DEFAULT_BITS = 2;
+const int QUANTILES_DEFAULT_BITS = 4;
+const int LOGLINEAR_MAX_BITS = 6;
+// count_distinct() HyperLogLog precision, as log2 of the number of registers
+const int HLL_PRECISION = 8;
+// largest sample() ratio and ratelimit() events per second
+const int64_t SAMPLING_MAX_RATE = 1000000000;
+
+// sample() and ratelimit() state of a call site, kept per CPU. ratelimit()
+// tokens are counted in nanoseconds' worth of refill, see codegen.
+struct SamplingSlot
+{
+  uint64_t dropped;
+  uint64_t last_ns;
+  uint64_t tokens;
+};
+
+// get_stackid() failures of a kstack or ustack call site, kept per CPU
+struct StackIdErrors
+{
+  uint64_t collisions; // -EEXIST: another stack hashed to the same id
+  uint64_t full;       // -ENOMEM: the stack map has no free entry
+  uint64_t other;      // e.g. -EFAULT: no stack to walk
+};
 
 enum class Type
 {
@@ -25,7 +51,10 @@ enum class Type
   record, // struct/union, as struct is a protected keyword
   hist,
   lhist,
+  llhist,
+  quantiles,
   count,
+  count_distinct,
   sum,
   min,
   max,
@@ -37,6 +66,8 @@ enum class Type
   ksym,
   usym,
   join,
+  sampling,
+  stackid_errors,
   probe,
   username,
   inet,
@@ -62,6 +93,7 @@ enum class StackMode
 {
   bpftrace,
   perf,
+  build_id,
 };
 
 struct StackType
@@ -97,6 +129,8 @@ public:
   std::vector<SizedType> tuple_elems;
 
 private:
+  friend class ProgramSerializer;
+
   bool is_signed_ = false;
   std::shared_ptr<SizedType> element_type_; // for "container" and pointer
                                             // (like) types
@@ -203,10 +237,22 @@ public:
   {
     return type == Type::lhist;
   };
+  bool IsLLhistTy(void) const
+  {
+    return type == Type::llhist;
+  };
+  bool IsQuantilesTy(void) const
+  {
+    return type == Type::quantiles;
+  };
   bool IsCountTy(void) const
   {
     return type == Type::count;
   };
+  bool IsCountDistinctTy(void) const
+  {
+    return type == Type::count_distinct;
+  };
   bool IsSumTy(void) const
   {
     return type == Type::sum;
@@ -251,6 +297,14 @@ public:
   bool IsJoinTy(void) const
   {
     return type == Type::join;
+  }
+  bool IsSamplingTy(void) const
+  {
+    return type == Type::sampling;
+  };
+  bool IsStackIdErrorsTy(void) const
+  {
+    return type == Type::stackid_errors;
   };
   bool IsProbeTy(void) const
   {
@@ -333,16 +387,21 @@ SizedType CreateMin(bool is_signed);
 SizedType CreateMax(bool is_signed);
 SizedType CreateSum(bool is_signed);
 SizedType CreateCount(bool is_signed);
+SizedType CreateCountDistinct();
 SizedType CreateAvg(bool is_signed);
 SizedType CreateStats(bool is_signed);
 SizedType CreateProbe();
 SizedType CreateUsername();
 SizedType CreateInet(size_t size);
 SizedType CreateLhist();
+SizedType CreateLLhist();
+SizedType CreateQuantiles();
 SizedType CreateHist();
 SizedType CreateUSym();
 SizedType CreateKSym();
 SizedType CreateJoin(size_t argnum, size_t argsize);
+SizedType CreateSampling();
+SizedType CreateStackIdErrors();
 SizedType CreateBuffer(size_t size);
 SizedType CreateTimestamp();
 
@@ -364,6 +423,7 @@ enum class ProbeType
   watchpoint,
   kfunc,
   kretfunc,
+  rawtracepoint,
 };
 
 std::ostream &operator<<(std::ostream &os, ProbeType type);
@@ -392,6 +452,7 @@ const std::vector<ProbeItem> PROBE_LIST =
   { "watchpoint", "w", ProbeType::watchpoint },
   { "kfunc", "f", ProbeType::kfunc },
   { "kretfunc", "fr", ProbeType::kretfunc },
+  { "rawtracepoint", "rt", ProbeType::rawtracepoint },
 };
 
 ProbeType probetype(const std::string &type);
@@ -463,6 +524,8 @@ struct hash<bpftrace::StackType>
         return std::hash<std::string>()("bpftrace#" + to_string(obj.limit));
       case bpftrace::StackMode::perf:
         return std::hash<std::string>()("perf#" + to_string(obj.limit));
+      case bpftrace::StackMode::build_id:
+        return std::hash<std::string>()("build_id#" + to_string(obj.limit));
     }
 
     return {}; // unreached
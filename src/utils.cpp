@@ -17,7 +17,6 @@
 #include <tuple>
 #include <unistd.h>
 
-#include "list.h"
 #include "log.h"
 #include "utils.h"
 #include <bcc/bcc_elf.h>
@@ -295,6 +294,43 @@ bool is_dir(const std::string& path)
   return S_ISDIR(buf.st_mode);
 }
 
+bool file_version(const std::string &path, uint64_t &size, uint64_t &mtime)
+{
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+    return false;
+  size = st.st_size;
+  mtime = st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+  return true;
+}
+
+bool is_private_file(const std::string &path)
+{
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && st.st_uid == geteuid() &&
+         !(st.st_mode & (S_IWGRP | S_IWOTH));
+}
+
+bool write_private_file(const std::string &path,
+                        const std::function<bool(const std::string &)> &write)
+{
+  std::string tmp = path + "." + std::to_string(getpid());
+  std::error_code ec;
+  std::filesystem::create_directories(
+      std::filesystem::path(path).parent_path(), ec);
+  if (write(tmp))
+  {
+    std::filesystem::permissions(tmp,
+                                 std::filesystem::perms::owner_read |
+                                     std::filesystem::perms::owner_write,
+                                 ec);
+    if (!ec && std::rename(tmp.c_str(), path.c_str()) == 0)
+      return true;
+  }
+  std::remove(tmp.c_str());
+  return false;
+}
+
 namespace {
   struct KernelHeaderTmpDir {
     KernelHeaderTmpDir(const std::string& prefix) : path{prefix + "XXXXXX"}
@@ -760,33 +796,6 @@ std::string hex_format_buffer(const char *buf, size_t size)
   return std::string(s);
 }
 
-std::unordered_set<std::string> get_traceable_funcs()
-{
-  // Try to get the list of functions from BPFTRACE_AVAILABLE_FUNCTIONS_TEST env
-  const char *path = std::getenv("BPFTRACE_AVAILABLE_FUNCTIONS_TEST");
-
-  // Use kprobe list as default
-  if (!path)
-    path = kprobe_path.c_str();
-
-  std::ifstream available_funs(path);
-  if (available_funs.fail())
-  {
-    if (bt_debug != DebugLevel::kNone)
-    {
-      std::cerr << "Error while reading traceable functions from "
-                << kprobe_path << ": " << strerror(errno);
-    }
-    return {};
-  }
-
-  std::unordered_set<std::string> result;
-  std::string line;
-  while (std::getline(available_funs, line))
-    result.insert(line);
-  return result;
-}
-
 uint64_t parse_exponent(const char *str)
 {
   char *e_offset;
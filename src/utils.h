@@ -2,6 +2,7 @@
 
 #include <csignal>
 #include <cstring>
+#include <functional>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -130,12 +131,19 @@ bool wildcard_match(const std::string &str,
 std::vector<int> get_online_cpus();
 std::vector<int> get_possible_cpus();
 bool is_dir(const std::string &path);
+// size and modification time, in nanoseconds, of a file
+bool file_version(const std::string &path, uint64_t &size, uint64_t &mtime);
+// true if the file is owned by the current user and not writable by others
+bool is_private_file(const std::string &path);
+// Write a private copy of path with `write` and move it in place, so that
+// concurrent runs never read a partial one
+bool write_private_file(const std::string &path,
+                        const std::function<bool(const std::string &)> &write);
 std::tuple<std::string, std::string> get_kernel_dirs(
     const struct utsname &utsname);
 std::vector<std::string> get_kernel_cflags(const char *uname_machine,
                                            const std::string &ksrc,
                                            const std::string &kobj);
-std::unordered_set<std::string> get_traceable_funcs();
 const std::string &is_deprecated(const std::string &str);
 bool is_unsafe_func(const std::string &func_name);
 bool is_compile_time_func(const std::string &func_name);
@@ -5,8 +5,10 @@ namespace bpftrace {
 namespace test {
 namespace ast {
 
+using bpftrace::ast::Arena;
 using bpftrace::ast::AttachPoint;
 using bpftrace::ast::AttachPointList;
+using bpftrace::ast::Integer;
 using bpftrace::ast::Probe;
 
 TEST(ast, probe_name_special)
@@ -167,6 +169,36 @@ TEST(ast, attach_point_name)
   EXPECT_EQ(ap3->name("readline"), "uprobe:/bin/sh:readline");
 }
 
+TEST(ast, arena)
+{
+  Arena arena;
+  std::unique_ptr<Integer> a, b;
+  {
+    Arena::Scope scope(arena);
+    EXPECT_EQ(Arena::current(), &arena);
+    a = std::make_unique<Integer>(1);
+    b = std::make_unique<Integer>(2);
+  }
+  EXPECT_EQ(Arena::current(), nullptr);
+  auto c = std::make_unique<Integer>(3);
+
+  // Allocated next to each other
+  auto distance = reinterpret_cast<char *>(b.get()) -
+                  reinterpret_cast<char *>(a.get());
+  EXPECT_GT(distance, 0);
+  EXPECT_LE(distance, 2 * static_cast<ssize_t>(sizeof(Integer)));
+  EXPECT_EQ(a->n, 1);
+  EXPECT_EQ(b->n, 2);
+  EXPECT_EQ(c->n, 3);
+
+  // Oversized allocations don't disturb the chunk in use
+  void *big = arena.allocate(1024 * 1024);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(big) % alignof(std::max_align_t), 0U);
+  void *small = arena.allocate(8);
+  EXPECT_LT(reinterpret_cast<char *>(small) - reinterpret_cast<char *>(b.get()),
+            256);
+}
+
 } // namespace ast
 } // namespace test
 } // namespace bpftrace
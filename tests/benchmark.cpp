@@ -0,0 +1,377 @@
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <fstream>
+#include <linux/bpf.h>
+#include <sstream>
+
+#include "bpf_object.h"
+#include "btf.h"
+#include "codegen_llvm.h"
+#include "driver.h"
+#include "fake_map.h"
+#include "mocks.h"
+#include "semantic_analyser.h"
+#include "tracepoint_format_parser.h"
+
+// Front end and code generator run on generated scripts of increasing size,
+// with the mocks of the unit tests, so no root or kernel is needed. Each
+// benchmark reports the complexity of its stage in the number of probes,
+// which should stay linear.
+//
+// The BTF benchmarks use the BTF of the running kernel (or BPFTRACE_BTF) and
+// its available_filter_functions, so they are skipped without root.
+
+namespace bpftrace {
+namespace test {
+namespace benchmark {
+
+using ::benchmark::State;
+
+// Probes using maps, variables, control flow and async events
+static std::string generate_script(int num_probes)
+{
+  std::ostringstream script;
+  for (int i = 0; i < num_probes; i++)
+  {
+    script << "kprobe:f_" << i << " /pid > " << i << "/ {\n"
+           << "  @count_" << i << "[comm, tid] = count();\n"
+           << "  $x = arg0 + " << i << ";\n"
+           << "  if ($x > 100) { @hist_" << i << " = hist($x); }\n"
+           << "  else { @sum_" << i << " += $x; }\n"
+           << "  printf(\"%d %s\\n\", $x, str(arg1));\n"
+           << "}\n";
+  }
+  return script.str();
+}
+
+// Each probe reads a map assigned by a probe further down, which analysis
+// only resolves on a later pass
+static std::string generate_late_maps_script(int num_probes)
+{
+  std::ostringstream script;
+  for (int i = 0; i < num_probes / 2; i++)
+    script << "kprobe:f { @a_" << i << " = @b_" << i << "; }\n";
+  for (int i = 0; i < num_probes / 2; i++)
+    script << "kprobe:g { @b_" << i << " = \"" << i << "\"; }\n";
+  return script.str();
+}
+
+// Tracepoints with args, one format file each
+static std::string generate_tracepoint_script(int num_probes)
+{
+  std::ostringstream script;
+  for (int i = 0; i < num_probes; i++)
+    script << "tracepoint:bench:event_" << i << " { @[args->fd] = count(); }\n";
+  return script.str();
+}
+
+static std::string tracepoint_format(int index)
+{
+  std::ostringstream format;
+  format << "name: event_" << index << "\n"
+         << "ID: " << 1000 + index << "\n"
+         << "format:\n"
+         << "\tfield:unsigned short common_type;\toffset:0;\tsize:2;\tsigned:0;\n"
+         << "\tfield:unsigned char common_flags;\toffset:2;\tsize:1;\tsigned:0;\n"
+         << "\tfield:unsigned char common_preempt_count;\toffset:3;\tsize:1;\tsigned:0;\n"
+         << "\tfield:int common_pid;\toffset:4;\tsize:4;\tsigned:1;\n"
+         << "\n"
+         << "\tfield:int __syscall_nr;\toffset:8;\tsize:4;\tsigned:1;\n"
+         << "\tfield:unsigned int fd;\toffset:16;\tsize:8;\tsigned:0;\n"
+         << "\tfield:char * buf;\toffset:24;\tsize:8;\tsigned:0;\n"
+         << "\tfield:size_t count;\toffset:32;\tsize:8;\tsigned:0;\n"
+         << "\n"
+         << "print fmt: \"fd: 0x%08lx\", ((unsigned long)(REC->fd))\n";
+  return format.str();
+}
+
+// A directory of format files for TracepointFormatParser::parse to read
+// instead of tracefs, one per event of generate_tracepoint_script
+class EventsDir
+{
+public:
+  explicit EventsDir(int num_events)
+  {
+    char dir[] = "/tmp/bpftrace-bench-events-XXXXXX";
+    if (!mkdtemp(dir))
+      return;
+    dir_ = dir;
+    for (int i = 0; i < num_events; i++)
+    {
+      std::string path = dir_ + "/bench/event_" + std::to_string(i);
+      std::filesystem::create_directories(path);
+      std::ofstream(path + "/format") << tracepoint_format(i);
+    }
+    setenv("BPFTRACE_TRACEPOINT_EVENTS_TEST", dir_.c_str(), true);
+  }
+
+  ~EventsDir()
+  {
+    unsetenv("BPFTRACE_TRACEPOINT_EVENTS_TEST");
+    if (!dir_.empty())
+      std::filesystem::remove_all(dir_);
+  }
+
+  bool ok() const
+  {
+    return !dir_.empty();
+  }
+
+private:
+  std::string dir_;
+};
+
+// Parse the script, and run semantic analysis and create the maps if
+// analyse is set. Errors abort the benchmark.
+static bool prepare(State &state,
+                    Driver &driver,
+                    BPFtrace &bpftrace,
+                    const std::string &script,
+                    bool analyse)
+{
+  if (driver.parse_str(script))
+  {
+    state.SkipWithError("parsing failed");
+    return false;
+  }
+  if (!analyse)
+    return true;
+
+  MockBPFfeature feature;
+  ast::SemanticAnalyser semantics(driver.root_.get(), bpftrace, feature);
+  if (semantics.analyse() || semantics.create_maps(true))
+  {
+    state.SkipWithError("semantic analysis failed");
+    return false;
+  }
+  return true;
+}
+
+static void BM_parse(State &state)
+{
+  auto script = generate_script(state.range(0));
+  for (auto _ : state)
+  {
+    auto bpftrace = get_mock_bpftrace();
+    Driver driver(*bpftrace);
+    if (!prepare(state, driver, *bpftrace, script, false))
+      break;
+  }
+  state.SetComplexityN(state.range(0));
+  state.SetBytesProcessed(state.iterations() * script.size());
+}
+BENCHMARK(BM_parse)->RangeMultiplier(4)->Range(16, 4096)->Complexity();
+
+static void BM_tracepoint_format_parser(State &state)
+{
+  auto script = generate_tracepoint_script(state.range(0));
+  EventsDir events(state.range(0));
+  if (!events.ok())
+  {
+    state.SkipWithError("could not create the format files");
+    return;
+  }
+
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    auto bpftrace = get_mock_bpftrace();
+    Driver driver(*bpftrace);
+    if (!prepare(state, driver, *bpftrace, script, false))
+      break;
+    TracepointFormatParser::clear_struct_list();
+    state.ResumeTiming();
+
+    if (!TracepointFormatParser::parse(driver.root_.get(), *bpftrace))
+    {
+      state.SkipWithError("tracepoint format parsing failed");
+      break;
+    }
+  }
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_tracepoint_format_parser)
+    ->RangeMultiplier(4)
+    ->Range(16, 4096)
+    ->Complexity();
+
+static void semantic_analyser(State &state, const std::string &script)
+{
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    auto bpftrace = get_mock_bpftrace();
+    Driver driver(*bpftrace);
+    if (!prepare(state, driver, *bpftrace, script, false))
+      break;
+    MockBPFfeature feature;
+    std::ostringstream out;
+    ast::SemanticAnalyser semantics(driver.root_.get(),
+                                    *bpftrace,
+                                    feature,
+                                    out);
+    state.ResumeTiming();
+
+    if (semantics.analyse())
+    {
+      state.SkipWithError(out.str().c_str());
+      break;
+    }
+  }
+  state.SetComplexityN(state.range(0));
+}
+
+static void BM_semantic_analyser(State &state)
+{
+  semantic_analyser(state, generate_script(state.range(0)));
+}
+BENCHMARK(BM_semantic_analyser)
+    ->RangeMultiplier(4)
+    ->Range(16, 4096)
+    ->Complexity();
+
+static void BM_semantic_analyser_late_maps(State &state)
+{
+  semantic_analyser(state, generate_late_maps_script(state.range(0)));
+}
+BENCHMARK(BM_semantic_analyser_late_maps)
+    ->RangeMultiplier(4)
+    ->Range(16, 4096)
+    ->Complexity();
+
+static void BM_generate_ir(State &state)
+{
+  auto script = generate_script(state.range(0));
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    auto bpftrace = get_mock_bpftrace();
+    Driver driver(*bpftrace);
+    FakeMap::next_mapfd_ = 1;
+    if (!prepare(state, driver, *bpftrace, script, true))
+      break;
+    state.ResumeTiming();
+
+    ast::CodegenLLVM codegen(driver.root_.get(), *bpftrace);
+    codegen.generate_ir();
+  }
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_generate_ir)
+    ->RangeMultiplier(4)
+    ->Range(16, 1024)
+    ->Complexity()
+    ->Unit(::benchmark::kMillisecond);
+
+// Optimization and emission at each -O level, with the size of the result
+static void BM_optimize_and_emit(State &state)
+{
+  auto script = generate_script(state.range(0));
+  size_t insns = 0;
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    auto bpftrace = get_mock_bpftrace();
+    bpftrace->opt_level_ = state.range(1);
+    Driver driver(*bpftrace);
+    FakeMap::next_mapfd_ = 1;
+    if (!prepare(state, driver, *bpftrace, script, true))
+      break;
+    ast::CodegenLLVM codegen(driver.root_.get(), *bpftrace);
+    codegen.generate_ir();
+    state.ResumeTiming();
+
+    codegen.optimize();
+    auto object = codegen.emit();
+
+    insns = 0;
+    for (auto &section : object->sections_)
+      insns += std::get<1>(section.second) / sizeof(struct bpf_insn);
+  }
+  state.counters["bpf_insns"] = insns;
+  state.counters["bpf_insns_per_probe"] = double(insns) / state.range(0);
+}
+BENCHMARK(BM_optimize_and_emit)
+    ->ArgsProduct({ { 16, 64, 256 }, { 0, 1, 2, 3 } })
+    ->ArgNames({ "probes", "O" })
+    ->Unit(::benchmark::kMillisecond);
+
+#ifdef HAVE_LIBBPF_BTF_DUMP
+
+// Up to num_funcs kfuncs of the kernel, in BTF id order
+static std::vector<std::string> kfunc_names(const BTF &btf, size_t num_funcs)
+{
+  std::vector<std::string> names;
+  auto funcs = btf.kfunc();
+  std::string name;
+  while (names.size() < num_funcs && funcs && std::getline(*funcs, name))
+    names.push_back(name);
+  return names;
+}
+
+// The first lookup in a newly opened BTF, which builds the name indexes
+static void BM_btf_index(State &state)
+{
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    auto btf = std::make_unique<BTF>();
+    if (!btf->has_data())
+    {
+      state.SkipWithError("no kernel BTF");
+      break;
+    }
+    state.ResumeTiming();
+
+    ::benchmark::DoNotOptimize(btf->type_of("struct task_struct", "pid"));
+
+    state.PauseTiming();
+    btf.reset();
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(BM_btf_index)->Unit(::benchmark::kMillisecond);
+
+// Resolving the args of kfunc probes once the indexes exist, which should
+// stay linear in the number of probes
+static void BM_btf_resolve_args(State &state)
+{
+  BTF btf;
+  auto names = kfunc_names(btf, state.range(0));
+  if (names.size() < static_cast<size_t>(state.range(0)))
+  {
+    state.SkipWithError("not enough traceable kfuncs (no BTF or not root?)");
+    return;
+  }
+
+  for (auto _ : state)
+  {
+    for (auto &name : names)
+    {
+      std::map<std::string, SizedType> args;
+      try
+      {
+        btf.resolve_args(name, args, true);
+      }
+      catch (const std::runtime_error &)
+      {
+        // functions with unsupported arguments are rejected the same way
+      }
+      ::benchmark::DoNotOptimize(args);
+    }
+  }
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_btf_resolve_args)
+    ->RangeMultiplier(4)
+    ->Range(16, 4096)
+    ->Complexity();
+
+#endif // HAVE_LIBBPF_BTF_DUMP
+
+} // namespace benchmark
+} // namespace test
+} // namespace bpftrace
+
+BENCHMARK_MAIN();
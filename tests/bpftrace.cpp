@@ -76,6 +76,14 @@ void check_tracepoint(Probe &p, const std::string &target, const std::string &fu
   EXPECT_EQ("tracepoint:" + target + ":" + func, p.name);
 }
 
+void check_rawtracepoint(Probe &p, const std::string &event, const std::string &orig_name)
+{
+  EXPECT_EQ(ProbeType::rawtracepoint, p.type);
+  EXPECT_EQ(event, p.attach_point);
+  EXPECT_EQ(orig_name, p.orig_name);
+  EXPECT_EQ("rawtracepoint:" + event, p.name);
+}
+
 void check_profile(Probe &p, const std::string &unit, int freq, const std::string &orig_name)
 {
   EXPECT_EQ(ProbeType::profile, p.type);
@@ -724,6 +732,26 @@ TEST(bpftrace, add_probes_tracepoint_wildcard)
   check_tracepoint(bpftrace->get_probes().at(1), "sched", "sched_two", probe_orig_name);
 }
 
+TEST(bpftrace, add_probes_rawtracepoint)
+{
+  auto a = std::make_unique<ast::AttachPoint>("");
+  a->provider = "rawtracepoint";
+  a->func = "sched_switch";
+  auto attach_points = std::make_unique<ast::AttachPointList>();
+  attach_points->emplace_back(std::move(a));
+  ast::Probe probe(std::move(attach_points), nullptr, nullptr);
+
+  StrictMock<MockBPFtrace> bpftrace;
+
+  ASSERT_EQ(0, bpftrace.add_probe(probe));
+  ASSERT_EQ(1U, bpftrace.get_probes().size());
+  ASSERT_EQ(0U, bpftrace.get_special_probes().size());
+
+  check_rawtracepoint(bpftrace.get_probes().at(0),
+                      "sched_switch",
+                      "rawtracepoint:sched_switch");
+}
+
 TEST(bpftrace, add_probes_tracepoint_category_wildcard)
 {
   auto a = std::make_unique<ast::AttachPoint>("");
@@ -1075,6 +1103,94 @@ TEST(bpftrace, sort_by_key_int_str)
   EXPECT_THAT(values_by_key, ContainerEq(expected_values));
 }
 
+// A map with the given layout, as created by Map, for the size estimates
+static std::unique_ptr<IMap> sized_map(enum bpf_map_type map_type,
+                                       int key_size,
+                                       int value_size,
+                                       int max_entries,
+                                       int flags = 0)
+{
+  auto map = std::make_unique<IMap>();
+  map->map_type_ = map_type;
+  map->key_size_ = key_size;
+  map->value_size_ = value_size;
+  map->max_entries_ = max_entries;
+  map->flags_ = flags;
+  return map;
+}
+
+TEST(bpftrace, map_memory_estimate_stack)
+{
+  MockBPFtrace bpftrace;
+
+  // 127 frames, in a power of 2 of buckets of 24 bytes before the frames
+  auto map = sized_map(BPF_MAP_TYPE_STACK_TRACE, 4, 127 * 8, 4096);
+  EXPECT_EQ(bpftrace.map_memory_estimate(*map), 4096U * (24 + 127 * 8));
+  map->max_entries_ = 3000;
+  EXPECT_EQ(bpftrace.map_memory_estimate(*map), 4096U * (24 + 127 * 8));
+  map->max_entries_ = 4097;
+  EXPECT_EQ(bpftrace.map_memory_estimate(*map), 8192U * (24 + 127 * 8));
+}
+
+TEST(bpftrace, map_memory_estimate_hash)
+{
+  MockBPFtrace bpftrace;
+
+  // 48 bytes of htab_elem, then the key and value rounded up to 8 bytes
+  auto map = sized_map(BPF_MAP_TYPE_HASH, 8, 8, 4096);
+  EXPECT_EQ(bpftrace.map_memory_estimate(*map), 4096U * (48 + 8 + 8));
+  map = sized_map(BPF_MAP_TYPE_HASH, 12, 20, 100);
+  EXPECT_EQ(bpftrace.map_memory_estimate(*map), 100U * (48 + 16 + 24));
+  map = sized_map(BPF_MAP_TYPE_LRU_HASH, 8, 8, 4096);
+  EXPECT_EQ(bpftrace.map_memory_estimate(*map), 4096U * (48 + 8 + 8));
+  // not preallocated maps are estimated as if full
+  map = sized_map(BPF_MAP_TYPE_HASH, 8, 8, 4096, BPF_F_NO_PREALLOC);
+  EXPECT_EQ(bpftrace.map_memory_estimate(*map), 4096U * (48 + 8 + 8));
+}
+
+TEST(bpftrace, map_memory_estimate_percpu)
+{
+  MockBPFtrace bpftrace;
+  uint64_t ncpus = get_possible_cpus().size();
+
+  // the element holds a pointer to one value per possible CPU
+  auto map = sized_map(BPF_MAP_TYPE_PERCPU_HASH, 8, 8, 4096);
+  EXPECT_EQ(bpftrace.map_memory_estimate(*map),
+            4096U * (48 + 8 + 8 + 8 * ncpus));
+  map = sized_map(BPF_MAP_TYPE_LRU_PERCPU_HASH, 4, 12, 10);
+  EXPECT_EQ(bpftrace.map_memory_estimate(*map),
+            10U * (48 + 8 + 8 + 16 * ncpus));
+  map = sized_map(BPF_MAP_TYPE_PERCPU_ARRAY, 4, 12, 10);
+  EXPECT_EQ(bpftrace.map_memory_estimate(*map), 10U * 16 * ncpus);
+}
+
+TEST(bpftrace, map_memory_estimate_array)
+{
+  MockBPFtrace bpftrace;
+
+  // arrays only hold their values, rounded up to 8 bytes
+  auto map = sized_map(BPF_MAP_TYPE_ARRAY, 4, 8, 1);
+  EXPECT_EQ(bpftrace.map_memory_estimate(*map), 8U);
+  map = sized_map(BPF_MAP_TYPE_ARRAY, 4, 13, 100);
+  EXPECT_EQ(bpftrace.map_memory_estimate(*map), 100U * 16);
+  // and perf event arrays a pointer per entry
+  map = sized_map(BPF_MAP_TYPE_PERF_EVENT_ARRAY, 4, 4, 64);
+  EXPECT_EQ(bpftrace.map_memory_estimate(*map), 64U * 8);
+}
+
+TEST(bpftrace, report_map_sizes_stack_maps)
+{
+  MockBPFtrace bpftrace;
+  bpftrace.maps.Set(StackType(),
+                    sized_map(BPF_MAP_TYPE_STACK_TRACE, 4, 127 * 8, 1 << 20));
+
+  ::testing::internal::CaptureStderr();
+  bpftrace.report_map_sizes();
+  std::string err = ::testing::internal::GetCapturedStderr();
+  EXPECT_NE(err.find("maps will preallocate about 1040 MiB"),
+            std::string::npos);
+}
+
 #ifdef HAVE_LIBBPF_BTF_DUMP
 
 #include "btf_common.h"
@@ -1114,6 +1230,26 @@ TEST_F(bpftrace_btf, add_probes_kfunc)
               "kretfunc:func_1");
 }
 
+TEST_F(bpftrace_btf, add_probes_rawtracepoint_wildcard)
+{
+  auto a = std::make_unique<ast::AttachPoint>("");
+  a->provider = "rawtracepoint";
+  a->func = "sam*";
+  a->need_expansion = true;
+  auto attach_points = std::make_unique<ast::AttachPointList>();
+  attach_points->emplace_back(std::move(a));
+  ast::Probe probe(std::move(attach_points), nullptr, nullptr);
+
+  StrictMock<MockBPFtrace> bpftrace;
+
+  ASSERT_EQ(0, bpftrace.add_probe(probe));
+  ASSERT_EQ(1U, bpftrace.get_probes().size());
+
+  check_rawtracepoint(bpftrace.get_probes().at(0),
+                      "sample",
+                      "rawtracepoint:sam*");
+}
+
 #endif // HAVE_LIBBPF_BTF_DUMP
 
 } // namespace bpftrace
@@ -0,0 +1,144 @@
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <elf.h>
+#include <fstream>
+#include <iterator>
+#include <linux/bpf.h>
+#include <sstream>
+#include <vector>
+
+#include "build_id_symbolizer.h"
+
+namespace bpftrace {
+namespace test {
+namespace build_id_symbolizer {
+
+const uint8_t build_id[] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd,
+                             0xef, 0x00, 0x11, 0x22, 0x33, 0x44, 0x55,
+                             0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb };
+
+TEST(build_id_symbolizer, format)
+{
+  EXPECT_EQ(BuildIdSymbolizer::format(build_id, 0x1a2b),
+            "0123456789abcdef00112233445566778899aabb+0x1a2b");
+}
+
+TEST(build_id_symbolizer, unresolved)
+{
+  BuildIdSymbolizer symbolizer({ "/nonexistent" });
+  EXPECT_EQ(symbolizer.resolve(build_id, 0x10, true, false, true),
+            "0123456789abcdef00112233445566778899aabb+0x10");
+}
+
+TEST(build_id_symbolizer, symbolize_passthrough)
+{
+  BuildIdSymbolizer symbolizer({ "/nonexistent" });
+  std::string text = "@[\n"
+                     "    0123456789abcdef00112233445566778899aabb+0x10\n"
+                     "    0x7f0011223344\n"
+                     "]: 3\n";
+  std::istringstream in(text);
+  std::ostringstream out;
+  symbolizer.symbolize(in, out);
+  EXPECT_EQ(out.str(), text);
+}
+
+// The build-id of an ELF file, and the file offset of one of its symbols,
+// as a build-id stack frame for it would hold them
+struct ElfFrame
+{
+  std::vector<uint8_t> build_id;
+  uint64_t offset = 0;
+};
+
+static bool read_elf_frame(const std::string &path,
+                           const std::string &symbol,
+                           ElfFrame &frame)
+{
+  std::ifstream file(path, std::ios::binary);
+  std::vector<char> elf((std::istreambuf_iterator<char>(file)),
+                        std::istreambuf_iterator<char>());
+  if (elf.size() < sizeof(Elf64_Ehdr))
+    return false;
+  auto *ehdr = reinterpret_cast<const Elf64_Ehdr *>(elf.data());
+  auto *shdrs = reinterpret_cast<const Elf64_Shdr *>(elf.data() +
+                                                     ehdr->e_shoff);
+  auto *phdrs = reinterpret_cast<const Elf64_Phdr *>(elf.data() +
+                                                     ehdr->e_phoff);
+
+  uint64_t address = 0;
+  for (int i = 0; i < ehdr->e_shnum; i++)
+  {
+    auto &shdr = shdrs[i];
+    const char *data = elf.data() + shdr.sh_offset;
+    if (shdr.sh_type == SHT_NOTE)
+    {
+      // Notes are a header, a name and a descriptor, each 4 bytes aligned
+      for (uint64_t pos = 0; pos + sizeof(Elf64_Nhdr) <= shdr.sh_size;)
+      {
+        auto *nhdr = reinterpret_cast<const Elf64_Nhdr *>(data + pos);
+        const char *name = data + pos + sizeof(Elf64_Nhdr);
+        const char *desc = name + ((nhdr->n_namesz + 3) & ~3);
+        if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == 4 &&
+            !std::memcmp(name, "GNU", 4))
+          frame.build_id.assign(desc, desc + nhdr->n_descsz);
+        pos += sizeof(Elf64_Nhdr) + ((nhdr->n_namesz + 3) & ~3) +
+               ((nhdr->n_descsz + 3) & ~3);
+      }
+    }
+    else if (shdr.sh_type == SHT_SYMTAB)
+    {
+      const char *strtab = elf.data() + shdrs[shdr.sh_link].sh_offset;
+      auto *syms = reinterpret_cast<const Elf64_Sym *>(data);
+      for (uint64_t j = 0; j < shdr.sh_size / sizeof(Elf64_Sym); j++)
+        if (symbol == strtab + syms[j].st_name)
+          address = syms[j].st_value;
+    }
+  }
+
+  for (int i = 0; i < ehdr->e_phnum && address; i++)
+  {
+    auto &phdr = phdrs[i];
+    if (phdr.p_type == PT_LOAD && address >= phdr.p_vaddr &&
+        address < phdr.p_vaddr + phdr.p_filesz)
+    {
+      frame.offset = address - phdr.p_vaddr + phdr.p_offset;
+      return !frame.build_id.empty();
+    }
+  }
+  return false;
+}
+
+TEST(build_id_symbolizer, resolve_testprog)
+{
+  ElfFrame frame;
+  ASSERT_TRUE(read_elf_frame(TEST_TESTPROGS_LOCATION "uprobe_test",
+                             "function1",
+                             frame));
+  ASSERT_EQ(frame.build_id.size(), static_cast<size_t>(BPF_BUILD_ID_SIZE));
+
+  // Found by scanning the directory for the build-id
+  BuildIdSymbolizer symbolizer({ TEST_TESTPROGS_LOCATION });
+  EXPECT_EQ(symbolizer.resolve(
+                frame.build_id.data(), frame.offset, true, false, true),
+            "function1+0");
+  EXPECT_EQ(symbolizer.resolve(
+                frame.build_id.data(), frame.offset + 4, true, false, true),
+            "function1+4");
+  EXPECT_EQ(symbolizer.resolve(
+                frame.build_id.data(), frame.offset + 4, false, false, true),
+            "function1");
+
+  std::istringstream in("    " +
+                        BuildIdSymbolizer::format(frame.build_id.data(),
+                                                  frame.offset + 4) +
+                        "\n");
+  std::ostringstream out;
+  symbolizer.symbolize(in, out);
+  EXPECT_EQ(out.str(), "    function1+4\n");
+}
+
+} // namespace build_id_symbolizer
+} // namespace test
+} // namespace bpftrace
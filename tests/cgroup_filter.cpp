@@ -0,0 +1,110 @@
+#include "gtest/gtest.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <poll.h>
+
+#include "cgroup_filter.h"
+
+namespace bpftrace {
+namespace test {
+namespace cgroup_filter {
+
+class cgroup_filter : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    char tmpl[] = "/tmp/bpftrace-cgroup-filter-XXXXXX";
+    ASSERT_NE(mkdtemp(tmpl), nullptr);
+    root_ = tmpl;
+    for (auto dir : { "kubepods/pod-a/ctr-1",
+                      "kubepods/pod-a/ctr-2",
+                      "kubepods/pod-b/ctr-1",
+                      "system/sshd" })
+      std::filesystem::create_directories(root_ + "/" + dir);
+  }
+
+  void TearDown() override
+  {
+    std::filesystem::remove_all(root_);
+  }
+
+  std::set<std::string> paths(std::initializer_list<std::string> dirs)
+  {
+    std::set<std::string> ret;
+    for (auto &dir : dirs)
+      ret.insert(root_ + "/" + dir);
+    return ret;
+  }
+
+  std::string root_;
+};
+
+TEST_F(cgroup_filter, plain_path)
+{
+  std::set<std::string> watch;
+  EXPECT_EQ(CgroupFilter::match(root_ + "/system/sshd", watch),
+            paths({ "system/sshd" }));
+  EXPECT_EQ(watch, paths({ "system", "system/sshd" }));
+}
+
+TEST_F(cgroup_filter, descendants)
+{
+  std::set<std::string> watch;
+  EXPECT_EQ(CgroupFilter::match(root_ + "/kubepods/pod-a", watch),
+            paths({ "kubepods/pod-a",
+                    "kubepods/pod-a/ctr-1",
+                    "kubepods/pod-a/ctr-2" }));
+}
+
+TEST_F(cgroup_filter, glob)
+{
+  std::set<std::string> watch;
+  EXPECT_EQ(CgroupFilter::match(root_ + "/kubepods/pod-*/ctr-1", watch),
+            paths({ "kubepods/pod-a/ctr-1", "kubepods/pod-b/ctr-1" }));
+  // new pods and containers may appear in any of these
+  EXPECT_EQ(watch,
+            paths({ "kubepods",
+                    "kubepods/pod-a",
+                    "kubepods/pod-b",
+                    "kubepods/pod-a/ctr-1",
+                    "kubepods/pod-b/ctr-1" }));
+}
+
+TEST_F(cgroup_filter, no_match)
+{
+  std::set<std::string> watch;
+  EXPECT_TRUE(CgroupFilter::match(root_ + "/kubepods/pod-c", watch).empty());
+  EXPECT_EQ(watch, paths({ "kubepods" }));
+  EXPECT_TRUE(CgroupFilter::match(root_ + "/missing/*", watch).empty());
+}
+
+// Whether inotify has events for the filter
+static bool has_events(const CgroupFilter &filter)
+{
+  struct pollfd pfd = { filter.fd(), POLLIN, 0 };
+  return poll(&pfd, 1, 0) > 0;
+}
+
+TEST_F(cgroup_filter, watch_recreated_directory)
+{
+  CgroupFilter filter({ root_ + "/kubepods/pod-*" });
+  filter.attach(-1);
+  EXPECT_FALSE(has_events(filter));
+
+  // Removed and created again before the filter syncs: the new directory
+  // needs a watch of its own
+  std::filesystem::remove_all(root_ + "/kubepods/pod-b");
+  std::filesystem::create_directories(root_ + "/kubepods/pod-b/ctr-3");
+  EXPECT_TRUE(has_events(filter));
+  filter.sync();
+  EXPECT_FALSE(has_events(filter));
+
+  std::filesystem::create_directories(root_ + "/kubepods/pod-b/ctr-4");
+  EXPECT_TRUE(has_events(filter));
+}
+
+} // namespace cgroup_filter
+} // namespace test
+} // namespace bpftrace
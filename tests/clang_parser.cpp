@@ -4,7 +4,12 @@
 #include "bpftrace.h"
 #include "struct.h"
 #include "field_analyser.h"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <limits>
 
 namespace bpftrace {
 namespace test {
@@ -13,7 +18,8 @@ namespace clang_parser {
 using StructMap = std::map<std::string, Struct>;
 
 static void parse(const std::string &input, BPFtrace &bpftrace, bool result = true,
-                  const std::string& probe = "kprobe:sys_read { 1 }")
+                  const std::string& probe = "kprobe:sys_read { 1 }",
+                  const std::string& pch_dir = "")
 {
   auto extended_input = input + probe;
   Driver driver(bpftrace);
@@ -23,6 +29,8 @@ static void parse(const std::string &input, BPFtrace &bpftrace, bool result = tr
   EXPECT_EQ(fields.analyse(), 0);
 
   ClangParser clang;
+  if (!pch_dir.empty())
+    clang.set_pch_dir(pch_dir);
   ASSERT_EQ(clang.parse(driver.root_.get(), bpftrace), result);
 }
 
@@ -676,6 +684,141 @@ TEST(clang_parser, btf_unresolved_typedef)
   EXPECT_EQ(structs["struct Foo"].fields["x"].type.size, 8U);
   EXPECT_EQ(structs["struct Foo"].fields["x"].offset, 0);
 }
+
+TEST_F(clang_parser_btf, btf_pointee_closure)
+{
+  // Bar -> Foo3 -> (Foo1 *, const volatile Foo2 * restrict)
+  // The pointees of Foo3 are only forward declared
+  BPFtrace bpftrace;
+  bpftrace.force_btf_ = true;
+  parse("struct Bar { struct Foo3 *foo3; };", bpftrace);
+
+  StructMap &structs = bpftrace.structs_;
+
+  ASSERT_EQ(structs.count("struct Bar"), 1U);
+  ASSERT_EQ(structs.count("struct Foo3"), 1U);
+  EXPECT_EQ(structs["struct Foo3"].fields.size(), 2U);
+  EXPECT_EQ(structs.count("struct Foo2"), 0U);
+  EXPECT_EQ(structs.count("struct Foo1"), 0U);
+
+  std::string cdef = bpftrace.btf_.c_def_closure({ "struct Foo3" }, {});
+  EXPECT_NE(cdef.find("struct Foo3 {"), std::string::npos);
+  EXPECT_NE(cdef.find("struct Foo1;"), std::string::npos);
+  EXPECT_NE(cdef.find("struct Foo2;"), std::string::npos);
+  EXPECT_EQ(cdef.find("struct Foo1 {"), std::string::npos);
+  EXPECT_EQ(cdef.find("struct Foo2 {"), std::string::npos);
+
+  // Foo2 embeds Foo1 by value
+  cdef = bpftrace.btf_.c_def_closure({ "struct Foo2" }, {});
+  EXPECT_NE(cdef.find("struct Foo2 {"), std::string::npos);
+  EXPECT_NE(cdef.find("struct Foo1 {"), std::string::npos);
+}
+
+TEST_F(clang_parser_btf, btf_pointee_closure_user_defined)
+{
+  // The user's Foo2 must not be redefined from BTF, and the pointees of Foo3
+  // are still only forward declared
+  BPFtrace bpftrace;
+  bpftrace.force_btf_ = true;
+  parse("struct Foo2 { int x; };\n"
+        "struct Bar { struct Foo3 *foo3; };",
+        bpftrace);
+
+  StructMap &structs = bpftrace.structs_;
+
+  ASSERT_EQ(structs.count("struct Foo2"), 1U);
+  EXPECT_EQ(structs["struct Foo2"].fields.size(), 1U);
+  EXPECT_EQ(structs["struct Foo2"].fields.count("x"), 1U);
+  ASSERT_EQ(structs.count("struct Foo3"), 1U);
+  EXPECT_EQ(structs.count("struct Foo1"), 0U);
+
+  std::string cdef = bpftrace.btf_.c_def_closure({ "struct Foo3" },
+                                                 { "struct Foo2" });
+  EXPECT_NE(cdef.find("struct Foo3 {"), std::string::npos);
+  EXPECT_NE(cdef.find("struct Foo1;"), std::string::npos);
+}
+
+TEST_F(clang_parser_btf, btf_resolve_types_bitfields)
+{
+  BPFtrace bpftrace;
+  std::map<std::string, Struct> structs;
+  std::map<std::string, uint64_t> enums;
+  ASSERT_TRUE(bpftrace.btf_.resolve_types({ "struct Foo4" }, structs, enums));
+
+  ASSERT_EQ(structs.count("struct Foo4"), 1U);
+  auto &foo4 = structs["struct Foo4"];
+  EXPECT_EQ(foo4.size, 8);
+  ASSERT_EQ(foo4.fields.size(), 6U);
+
+  // a: bits 0-2
+  EXPECT_TRUE(foo4.fields["a"].is_bitfield);
+  EXPECT_EQ(foo4.fields["a"].offset, 0);
+  EXPECT_EQ(foo4.fields["a"].bitfield.access_rshift, 0U);
+  EXPECT_EQ(foo4.fields["a"].bitfield.mask, 0x7U);
+  EXPECT_EQ(foo4.fields["a"].bitfield.read_bytes, 1U);
+
+  // b: bits 3-11, across a byte boundary
+  EXPECT_TRUE(foo4.fields["b"].is_bitfield);
+  EXPECT_EQ(foo4.fields["b"].offset, 0);
+  EXPECT_EQ(foo4.fields["b"].bitfield.access_rshift, 3U);
+  EXPECT_EQ(foo4.fields["b"].bitfield.mask, 0x1ffU);
+  EXPECT_EQ(foo4.fields["b"].bitfield.read_bytes, 2U);
+
+  // c: bits 12-21, read from the second byte
+  EXPECT_TRUE(foo4.fields["c"].is_bitfield);
+  EXPECT_EQ(foo4.fields["c"].offset, 1);
+  EXPECT_EQ(foo4.fields["c"].bitfield.access_rshift, 4U);
+  EXPECT_EQ(foo4.fields["c"].bitfield.mask, 0x3ffU);
+  EXPECT_EQ(foo4.fields["c"].bitfield.read_bytes, 2U);
+
+  EXPECT_FALSE(foo4.fields["d"].is_bitfield);
+  EXPECT_EQ(foo4.fields["d"].offset, 3);
+  EXPECT_EQ(foo4.fields["e"].offset, 4);
+  EXPECT_EQ(foo4.fields["f"].offset, 5);
+}
+
+TEST_F(clang_parser_btf, btf_resolve_types_char_signedness)
+{
+  BPFtrace bpftrace;
+  std::map<std::string, Struct> structs;
+  std::map<std::string, uint64_t> enums;
+  ASSERT_TRUE(bpftrace.btf_.resolve_types({ "struct Foo4" }, structs, enums));
+
+  // BTF has no signedness for plain char, it follows the target like clang
+  auto &fields = structs["struct Foo4"].fields;
+  EXPECT_EQ(fields["d"].type,
+            std::numeric_limits<char>::is_signed ? CreateInt8()
+                                                 : CreateUInt8());
+  EXPECT_EQ(fields["e"].type, CreateUInt8());
+  EXPECT_EQ(fields["f"].type, CreateInt8());
+  EXPECT_TRUE(fields["c"].type.IsSigned());
+  EXPECT_FALSE(fields["b"].type.IsSigned());
+}
+
+TEST_F(clang_parser_btf, btf_resolve_types_anonymous_typedef)
+{
+  BPFtrace bpftrace;
+  std::map<std::string, Struct> structs;
+  std::map<std::string, uint64_t> enums;
+  ASSERT_TRUE(bpftrace.btf_.resolve_types({ "struct Foo5" }, structs, enums));
+
+  // The anonymous struct is known by its typedef, as clang names it
+  ASSERT_EQ(structs.size(), 2U);
+  ASSERT_EQ(structs.count("struct Foo5"), 1U);
+  ASSERT_EQ(structs.count("anon_t"), 1U);
+
+  auto &a = structs["struct Foo5"].fields["a"];
+  EXPECT_TRUE(a.type.IsRecordTy());
+  EXPECT_EQ(a.type.GetName(), "anon_t");
+  EXPECT_EQ(structs["anon_t"].size, 4);
+  ASSERT_EQ(structs["anon_t"].fields.count("x"), 1U);
+  EXPECT_EQ(structs["anon_t"].fields["x"].type, CreateInt32());
+
+  // and can be asked for by that name
+  structs.clear();
+  ASSERT_TRUE(bpftrace.btf_.resolve_types({ "anon_t" }, structs, enums));
+  EXPECT_EQ(structs.count("anon_t"), 1U);
+}
 #endif // HAVE_LIBBPF_BTF_DUMP
 
 TEST(clang_parser, struct_typedef)
@@ -737,6 +880,69 @@ TEST(clang_parser, struct_qualifiers)
   EXPECT_EQ(SB.fields["a2"].type.GetName(), "struct a");
 }
 
+TEST(clang_parser, precompiled_header)
+{
+  char dir[] = "/tmp/bpftrace-test-pch-XXXXXX";
+  ASSERT_NE(mkdtemp(dir), nullptr);
+  std::string header = std::string(dir) + "/foo.h";
+  std::string pch_dir = std::string(dir) + "/cache";
+  std::ofstream(header) << "#define FOO 42\nstruct foo { int x; };\n";
+
+  std::string defs = "#include \"" + header + "\"\n"
+                     "struct bar { struct foo f; long y; };\n";
+  for (int i = 0; i < 2; i++)
+  {
+    BPFtrace bpftrace;
+    parse(defs, bpftrace, true, "kprobe:sys_read { 1 }", pch_dir);
+    StructMap &structs = bpftrace.structs_;
+    ASSERT_EQ(structs.count("struct foo"), 1U);
+    ASSERT_EQ(structs.count("struct bar"), 1U);
+    EXPECT_EQ(structs["struct bar"].size, 16);
+    EXPECT_EQ(structs["struct bar"].fields["y"].offset, 8);
+    EXPECT_EQ(bpftrace.macros_["FOO"], "42");
+  }
+  size_t pchs = 0;
+  for (auto &entry : std::filesystem::directory_iterator(pch_dir))
+    pchs += entry.path().extension() == ".pch";
+  EXPECT_EQ(pchs, 1U);
+
+  // a modified header replaces the precompiled one
+  std::ofstream(header) << "#define FOO 43\nstruct foo { long x; };\n";
+  BPFtrace bpftrace;
+  parse(defs, bpftrace, true, "kprobe:sys_read { 1 }", pch_dir);
+  EXPECT_EQ(bpftrace.structs_["struct bar"].size, 16);
+  EXPECT_EQ(bpftrace.structs_["struct foo"].size, 8);
+  EXPECT_EQ(bpftrace.macros_["FOO"], "43");
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST(clang_parser, included_files)
+{
+  char dir[] = "/tmp/bpftrace-test-includes-XXXXXX";
+  ASSERT_NE(mkdtemp(dir), nullptr);
+  std::string header = std::string(dir) + "/foo.h";
+  std::string nested = std::string(dir) + "/bar.h";
+  std::ofstream(nested) << "struct bar { int x; };\n";
+  std::ofstream(header) << "#include \"bar.h\"\nstruct foo { int x; };\n";
+
+  BPFtrace bpftrace;
+  Driver driver(bpftrace);
+  ASSERT_EQ(driver.parse_str("#include \"" + header +
+                             "\"\nkprobe:sys_read { 1 }"),
+            0);
+  ClangParser clang;
+  ASSERT_TRUE(clang.parse(driver.root_.get(), bpftrace));
+
+  auto &files = clang.included_files();
+  EXPECT_NE(std::find(files.begin(), files.end(), header), files.end());
+  EXPECT_NE(std::find(files.begin(), files.end(), nested), files.end());
+  for (auto &file : files)
+    EXPECT_NE(file.rfind("/bpftrace/include/", 0), 0U);
+
+  std::filesystem::remove_all(dir);
+}
+
 } // namespace clang_parser
 } // namespace test
 } // namespace bpftrace
@@ -36,7 +36,7 @@ TEST(codegen, call_kstack_mapids)
   ast::CodegenLLVM codegen(driver.root_.get(), bpftrace);
   codegen.compile();
 
-  ASSERT_EQ(FakeMap::next_mapfd_, 7);
+  ASSERT_EQ(FakeMap::next_mapfd_, 8);
   ASSERT_EQ(bpftrace.maps.CountStackTypes(), 2U);
 
   StackType stack_type;
@@ -67,7 +67,7 @@ TEST(codegen, call_kstack_modes_mapids)
   ast::CodegenLLVM codegen(driver.root_.get(), bpftrace);
   codegen.compile();
 
-  ASSERT_EQ(FakeMap::next_mapfd_, 7);
+  ASSERT_EQ(FakeMap::next_mapfd_, 8);
   ASSERT_EQ(bpftrace.maps.CountStackTypes(), 2U);
 
   StackType stack_type;
@@ -0,0 +1,17 @@
+#include "common.h"
+
+namespace bpftrace {
+namespace test {
+namespace codegen {
+
+// Unsigned values above INT64_MAX are counted in the top bucket
+TEST(codegen, call_quantiles_unsigned)
+{
+  test("kprobe:f { @x = quantiles(arg0) }",
+
+       NAME);
+}
+
+} // namespace codegen
+} // namespace test
+} // namespace bpftrace
@@ -6,8 +6,8 @@
 #include "gtest/gtest.h"
 
 #include "../mocks.h"
+#include "bpf_object.h"
 #include "bpffeature.h"
-#include "bpforc.h"
 #include "bpftrace.h"
 #include "clang_parser.h"
 #include "codegen_llvm.h"
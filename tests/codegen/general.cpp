@@ -1,7 +1,10 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
-#include "bpforc.h"
+#include <cstring>
+#include <linux/bpf.h>
+
+#include "bpf_object.h"
 #include "bpftrace.h"
 #include "clang_parser.h"
 #include "codegen_llvm.h"
@@ -49,12 +52,24 @@ TEST(codegen, populate_sections)
   ASSERT_EQ(semantics.analyse(), 0);
   std::stringstream out;
   ast::CodegenLLVM codegen(driver.root_.get(), bpftrace);
-  auto bpforc = codegen.compile();
+  auto bpf_object = codegen.compile();
 
   // Check sections are populated
-  EXPECT_EQ(bpforc->sections_.size(), 2U);
-  EXPECT_EQ(bpforc->sections_.count("s_kprobe:foo_1"), 1U);
-  EXPECT_EQ(bpforc->sections_.count("s_kprobe:bar_1"), 1U);
+  auto &sections = bpf_object->sections_;
+  EXPECT_EQ(sections.size(), 2U);
+  EXPECT_EQ(sections.count("s_kprobe:foo_1"), 1U);
+  EXPECT_EQ(sections.count("s_kprobe:bar_1"), 1U);
+
+  // and hold whole programs, ending with an exit
+  for (auto &section : sections)
+  {
+    auto &[addr, size] = section.second;
+    ASSERT_GT(size, 0U);
+    ASSERT_EQ(size % sizeof(struct bpf_insn), 0U);
+    struct bpf_insn last;
+    std::memcpy(&last, addr + size - sizeof(last), sizeof(last));
+    EXPECT_EQ(last.code, BPF_JMP | BPF_EXIT);
+  }
 }
 
 TEST(codegen, printf_offsets)
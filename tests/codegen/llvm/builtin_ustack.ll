@@ -10,23 +10,52 @@ define i64 @"kprobe:f"(i8*) section "s_kprobe:f_1" {
 entry:
   %"@x_val" = alloca i64
   %"@x_key" = alloca i64
+  %stackid_errors_key = alloca i32
   %pseudo = call i64 @llvm.bpf.pseudo(i64 1, i64 2)
   %get_stackid = call i64 inttoptr (i64 27 to i64 (i8*, i64, i64)*)(i8* %0, i64 %pseudo, i64 256)
-  %get_pid_tgid = call i64 inttoptr (i64 14 to i64 ()*)()
-  %1 = shl i64 %get_pid_tgid, 32
-  %2 = or i64 %get_stackid, %1
-  %3 = bitcast i64* %"@x_key" to i8*
+  %1 = trunc i64 %get_stackid to i32
+  %2 = icmp sge i32 %1, 0
+  br i1 %2, label %get_stackid_merge, label %get_stackid_failure
+
+get_stackid_failure:                              ; preds = %entry
+  %3 = bitcast i32* %stackid_errors_key to i8*
   call void @llvm.lifetime.start.p0i8(i64 -1, i8* %3)
+  store i32 0, i32* %stackid_errors_key
+  %pseudo1 = call i64 @llvm.bpf.pseudo(i64 1, i64 3)
+  %lookup_elem = call i8* inttoptr (i64 1 to i8* (i64, i32*)*)(i64 %pseudo1, i32* %stackid_errors_key)
+  %4 = bitcast i32* %stackid_errors_key to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %4)
+  %5 = icmp ne i8* %lookup_elem, null
+  br i1 %5, label %get_stackid_count, label %get_stackid_merge
+
+get_stackid_count:                                ; preds = %get_stackid_failure
+  %6 = bitcast i8* %lookup_elem to i64*
+  %7 = icmp eq i32 %1, -17
+  %8 = icmp eq i32 %1, -12
+  %9 = select i1 %8, i64 1, i64 2
+  %10 = select i1 %7, i64 0, i64 %9
+  %11 = getelementptr i64, i64* %6, i64 %10
+  %12 = load i64, i64* %11
+  %13 = add i64 %12, 1
+  store i64 %13, i64* %11
+  br label %get_stackid_merge
+
+get_stackid_merge:                                ; preds = %get_stackid_count, %get_stackid_failure, %entry
+  %get_pid_tgid = call i64 inttoptr (i64 14 to i64 ()*)()
+  %14 = shl i64 %get_pid_tgid, 32
+  %15 = or i64 %get_stackid, %14
+  %16 = bitcast i64* %"@x_key" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %16)
   store i64 0, i64* %"@x_key"
-  %4 = bitcast i64* %"@x_val" to i8*
-  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %4)
-  store i64 %2, i64* %"@x_val"
-  %pseudo1 = call i64 @llvm.bpf.pseudo(i64 1, i64 1)
-  %update_elem = call i64 inttoptr (i64 2 to i64 (i64, i64*, i64*, i64)*)(i64 %pseudo1, i64* %"@x_key", i64* %"@x_val", i64 0)
-  %5 = bitcast i64* %"@x_key" to i8*
-  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %5)
-  %6 = bitcast i64* %"@x_val" to i8*
-  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %6)
+  %17 = bitcast i64* %"@x_val" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %17)
+  store i64 %15, i64* %"@x_val"
+  %pseudo2 = call i64 @llvm.bpf.pseudo(i64 1, i64 1)
+  %update_elem = call i64 inttoptr (i64 2 to i64 (i64, i64*, i64*, i64)*)(i64 %pseudo2, i64* %"@x_key", i64* %"@x_val", i64 0)
+  %18 = bitcast i64* %"@x_key" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %18)
+  %19 = bitcast i64* %"@x_val" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %19)
   ret i64 0
 }
 
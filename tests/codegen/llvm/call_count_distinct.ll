@@ -0,0 +1,180 @@
+; ModuleID = 'bpftrace'
+source_filename = "bpftrace"
+target datalayout = "e-m:e-p:64:64-i64:64-n32:64-S128"
+target triple = "bpf-pc-linux"
+
+; Function Attrs: nounwind
+declare i64 @llvm.bpf.pseudo(i64, i64) #0
+
+define i64 @"kprobe:f"(i8*) section "s_kprobe:f_1" {
+entry:
+  %"@x_init" = alloca [256 x i8]
+  %lookup_elem_ptr = alloca i8*
+  %"@x_key" = alloca i64
+  %get_pid_tgid = call i64 inttoptr (i64 14 to i64 ()*)()
+  %1 = lshr i64 %get_pid_tgid, 32
+  %hll_hash = call i64 @hll_hash(i64 %1)
+  %2 = lshr i64 %hll_hash, 56
+  %3 = shl i64 %hll_hash, 8
+  %4 = or i64 %3, 128
+  %log2 = call i64 @log2(i64 %4)
+  %5 = sub i64 66, %log2
+  %6 = icmp slt i64 %4, 0
+  %7 = select i1 %6, i64 1, i64 %5
+  %8 = bitcast i64* %"@x_key" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %8)
+  store i64 0, i64* %"@x_key"
+  %pseudo = call i64 @llvm.bpf.pseudo(i64 1, i64 1)
+  %lookup_elem = call i8* inttoptr (i64 1 to i8* (i64, i64*)*)(i64 %pseudo, i64* %"@x_key")
+  %9 = bitcast i8** %lookup_elem_ptr to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %9)
+  store i8* %lookup_elem, i8** %lookup_elem_ptr
+  %map_lookup_cond = icmp ne i8* %lookup_elem, null
+  br i1 %map_lookup_cond, label %lookup_init_merge, label %lookup_init
+
+lookup_init:                                      ; preds = %entry
+  %10 = bitcast [256 x i8]* %"@x_init" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %10)
+  %11 = bitcast [256 x i8]* %"@x_init" to i8*
+  call void @llvm.memset.p0i8.i64(i8* align 1 %11, i8 0, i64 256, i1 false)
+  %pseudo1 = call i64 @llvm.bpf.pseudo(i64 1, i64 1)
+  %update_elem = call i64 inttoptr (i64 2 to i64 (i64, i64*, [256 x i8]*, i64)*)(i64 %pseudo1, i64* %"@x_key", [256 x i8]* %"@x_init", i64 0)
+  %12 = bitcast [256 x i8]* %"@x_init" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %12)
+  %pseudo2 = call i64 @llvm.bpf.pseudo(i64 1, i64 1)
+  %lookup_elem3 = call i8* inttoptr (i64 1 to i8* (i64, i64*)*)(i64 %pseudo2, i64* %"@x_key")
+  store i8* %lookup_elem3, i8** %lookup_elem_ptr
+  br label %lookup_init_merge
+
+lookup_init_merge:                                ; preds = %lookup_init, %entry
+  %13 = load i8*, i8** %lookup_elem_ptr
+  %14 = bitcast i8** %lookup_elem_ptr to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %14)
+  %15 = bitcast i64* %"@x_key" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %15)
+  %16 = icmp ne i8* %13, null
+  br i1 %16, label %count_distinct.found, label %count_distinct.done
+
+count_distinct.found:                             ; preds = %lookup_init_merge
+  %17 = getelementptr i8, i8* %13, i64 %2
+  %18 = load i8, i8* %17
+  %19 = zext i8 %18 to i64
+  %20 = icmp ugt i64 %7, %19
+  br i1 %20, label %count_distinct.greater, label %count_distinct.done
+
+count_distinct.greater:                           ; preds = %count_distinct.found
+  %21 = trunc i64 %7 to i8
+  store i8 %21, i8* %17
+  br label %count_distinct.done
+
+count_distinct.done:                              ; preds = %count_distinct.greater, %count_distinct.found, %lookup_init_merge
+  ret i64 0
+}
+
+; Function Attrs: alwaysinline
+define internal i64 @hll_hash(i64) #1 section "helpers" {
+entry:
+  %1 = add i64 %0, -7046029254386353131
+  %2 = lshr i64 %1, 30
+  %3 = xor i64 %1, %2
+  %4 = mul i64 %3, -4658895280553007687
+  %5 = lshr i64 %4, 27
+  %6 = xor i64 %4, %5
+  %7 = mul i64 %6, -7723592293110705685
+  %8 = lshr i64 %7, 31
+  %9 = xor i64 %7, %8
+  ret i64 %9
+}
+
+; Function Attrs: alwaysinline
+define internal i64 @log2(i64) #1 section "helpers" {
+entry:
+  %1 = alloca i64
+  %2 = alloca i64
+  %3 = bitcast i64* %2 to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %3)
+  store i64 %0, i64* %2
+  %4 = bitcast i64* %1 to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %4)
+  store i64 0, i64* %1
+  %5 = load i64, i64* %2
+  %6 = icmp slt i64 %5, 0
+  br i1 %6, label %hist.is_less_than_zero, label %hist.is_not_less_than_zero
+
+hist.is_less_than_zero:                           ; preds = %entry
+  %7 = load i64, i64* %1
+  ret i64 %7
+
+hist.is_not_less_than_zero:                       ; preds = %entry
+  %8 = load i64, i64* %2
+  %9 = icmp eq i64 %8, 0
+  br i1 %9, label %hist.is_zero, label %hist.is_not_zero
+
+hist.is_zero:                                     ; preds = %hist.is_not_less_than_zero
+  store i64 1, i64* %1
+  %10 = load i64, i64* %1
+  ret i64 %10
+
+hist.is_not_zero:                                 ; preds = %hist.is_not_less_than_zero
+  store i64 2, i64* %1
+  %11 = load i64, i64* %2
+  %12 = icmp sge i64 %11, 65536
+  %13 = zext i1 %12 to i64
+  %14 = shl i64 %13, 4
+  %15 = lshr i64 %11, %14
+  store i64 %15, i64* %2
+  %16 = load i64, i64* %1
+  %17 = add i64 %16, %14
+  store i64 %17, i64* %1
+  %18 = load i64, i64* %2
+  %19 = icmp sge i64 %18, 256
+  %20 = zext i1 %19 to i64
+  %21 = shl i64 %20, 3
+  %22 = lshr i64 %18, %21
+  store i64 %22, i64* %2
+  %23 = load i64, i64* %1
+  %24 = add i64 %23, %21
+  store i64 %24, i64* %1
+  %25 = load i64, i64* %2
+  %26 = icmp sge i64 %25, 16
+  %27 = zext i1 %26 to i64
+  %28 = shl i64 %27, 2
+  %29 = lshr i64 %25, %28
+  store i64 %29, i64* %2
+  %30 = load i64, i64* %1
+  %31 = add i64 %30, %28
+  store i64 %31, i64* %1
+  %32 = load i64, i64* %2
+  %33 = icmp sge i64 %32, 4
+  %34 = zext i1 %33 to i64
+  %35 = shl i64 %34, 1
+  %36 = lshr i64 %32, %35
+  store i64 %36, i64* %2
+  %37 = load i64, i64* %1
+  %38 = add i64 %37, %35
+  store i64 %38, i64* %1
+  %39 = load i64, i64* %2
+  %40 = icmp sge i64 %39, 2
+  %41 = zext i1 %40 to i64
+  %42 = shl i64 %41, 0
+  %43 = lshr i64 %39, %42
+  store i64 %43, i64* %2
+  %44 = load i64, i64* %1
+  %45 = add i64 %44, %42
+  store i64 %45, i64* %1
+  %46 = load i64, i64* %1
+  ret i64 %46
+}
+
+; Function Attrs: argmemonly nounwind
+declare void @llvm.lifetime.start.p0i8(i64, i8* nocapture) #2
+
+; Function Attrs: argmemonly nounwind
+declare void @llvm.memset.p0i8.i64(i8* nocapture writeonly, i8, i64, i1) #2
+
+; Function Attrs: argmemonly nounwind
+declare void @llvm.lifetime.end.p0i8(i64, i8* nocapture) #2
+
+attributes #0 = { nounwind }
+attributes #1 = { alwaysinline }
+attributes #2 = { argmemonly nounwind }
@@ -10,36 +10,94 @@ define i64 @"kprobe:f"(i8*) section "s_kprobe:f_1" {
 entry:
   %"@y_val" = alloca i64
   %"@y_key" = alloca i64
+  %stackid_errors_key8 = alloca i32
   %"@x_val" = alloca i64
   %"@x_key" = alloca i64
+  %stackid_errors_key = alloca i32
   %pseudo = call i64 @llvm.bpf.pseudo(i64 1, i64 4)
   %get_stackid = call i64 inttoptr (i64 27 to i64 (i8*, i64, i64)*)(i8* %0, i64 %pseudo, i64 0)
-  %1 = bitcast i64* %"@x_key" to i8*
-  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %1)
+  %1 = trunc i64 %get_stackid to i32
+  %2 = icmp sge i32 %1, 0
+  br i1 %2, label %get_stackid_merge, label %get_stackid_failure
+
+get_stackid_failure:                              ; preds = %entry
+  %3 = bitcast i32* %stackid_errors_key to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %3)
+  store i32 0, i32* %stackid_errors_key
+  %pseudo1 = call i64 @llvm.bpf.pseudo(i64 1, i64 5)
+  %lookup_elem = call i8* inttoptr (i64 1 to i8* (i64, i32*)*)(i64 %pseudo1, i32* %stackid_errors_key)
+  %4 = bitcast i32* %stackid_errors_key to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %4)
+  %5 = icmp ne i8* %lookup_elem, null
+  br i1 %5, label %get_stackid_count, label %get_stackid_merge
+
+get_stackid_count:                                ; preds = %get_stackid_failure
+  %6 = bitcast i8* %lookup_elem to i64*
+  %7 = icmp eq i32 %1, -17
+  %8 = icmp eq i32 %1, -12
+  %9 = select i1 %8, i64 1, i64 2
+  %10 = select i1 %7, i64 0, i64 %9
+  %11 = getelementptr i64, i64* %6, i64 %10
+  %12 = load i64, i64* %11
+  %13 = add i64 %12, 1
+  store i64 %13, i64* %11
+  br label %get_stackid_merge
+
+get_stackid_merge:                                ; preds = %get_stackid_count, %get_stackid_failure, %entry
+  %14 = bitcast i64* %"@x_key" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %14)
   store i64 0, i64* %"@x_key"
-  %2 = bitcast i64* %"@x_val" to i8*
-  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %2)
+  %15 = bitcast i64* %"@x_val" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %15)
   store i64 %get_stackid, i64* %"@x_val"
-  %pseudo1 = call i64 @llvm.bpf.pseudo(i64 1, i64 1)
-  %update_elem = call i64 inttoptr (i64 2 to i64 (i64, i64*, i64*, i64)*)(i64 %pseudo1, i64* %"@x_key", i64* %"@x_val", i64 0)
-  %3 = bitcast i64* %"@x_key" to i8*
-  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %3)
-  %4 = bitcast i64* %"@x_val" to i8*
-  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %4)
-  %pseudo2 = call i64 @llvm.bpf.pseudo(i64 1, i64 3)
-  %get_stackid3 = call i64 inttoptr (i64 27 to i64 (i8*, i64, i64)*)(i8* %0, i64 %pseudo2, i64 0)
-  %5 = bitcast i64* %"@y_key" to i8*
-  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %5)
+  %pseudo2 = call i64 @llvm.bpf.pseudo(i64 1, i64 1)
+  %update_elem = call i64 inttoptr (i64 2 to i64 (i64, i64*, i64*, i64)*)(i64 %pseudo2, i64* %"@x_key", i64* %"@x_val", i64 0)
+  %16 = bitcast i64* %"@x_key" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %16)
+  %17 = bitcast i64* %"@x_val" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %17)
+  %pseudo3 = call i64 @llvm.bpf.pseudo(i64 1, i64 3)
+  %get_stackid4 = call i64 inttoptr (i64 27 to i64 (i8*, i64, i64)*)(i8* %0, i64 %pseudo3, i64 0)
+  %18 = trunc i64 %get_stackid4 to i32
+  %19 = icmp sge i32 %18, 0
+  br i1 %19, label %get_stackid_merge7, label %get_stackid_failure5
+
+get_stackid_failure5:                             ; preds = %get_stackid_merge
+  %20 = bitcast i32* %stackid_errors_key8 to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %20)
+  store i32 1, i32* %stackid_errors_key8
+  %pseudo9 = call i64 @llvm.bpf.pseudo(i64 1, i64 5)
+  %lookup_elem10 = call i8* inttoptr (i64 1 to i8* (i64, i32*)*)(i64 %pseudo9, i32* %stackid_errors_key8)
+  %21 = bitcast i32* %stackid_errors_key8 to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %21)
+  %22 = icmp ne i8* %lookup_elem10, null
+  br i1 %22, label %get_stackid_count6, label %get_stackid_merge7
+
+get_stackid_count6:                               ; preds = %get_stackid_failure5
+  %23 = bitcast i8* %lookup_elem10 to i64*
+  %24 = icmp eq i32 %18, -17
+  %25 = icmp eq i32 %18, -12
+  %26 = select i1 %25, i64 1, i64 2
+  %27 = select i1 %24, i64 0, i64 %26
+  %28 = getelementptr i64, i64* %23, i64 %27
+  %29 = load i64, i64* %28
+  %30 = add i64 %29, 1
+  store i64 %30, i64* %28
+  br label %get_stackid_merge7
+
+get_stackid_merge7:                               ; preds = %get_stackid_count6, %get_stackid_failure5, %get_stackid_merge
+  %31 = bitcast i64* %"@y_key" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %31)
   store i64 0, i64* %"@y_key"
-  %6 = bitcast i64* %"@y_val" to i8*
-  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %6)
-  store i64 %get_stackid3, i64* %"@y_val"
-  %pseudo4 = call i64 @llvm.bpf.pseudo(i64 1, i64 2)
-  %update_elem5 = call i64 inttoptr (i64 2 to i64 (i64, i64*, i64*, i64)*)(i64 %pseudo4, i64* %"@y_key", i64* %"@y_val", i64 0)
-  %7 = bitcast i64* %"@y_key" to i8*
-  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %7)
-  %8 = bitcast i64* %"@y_val" to i8*
-  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %8)
+  %32 = bitcast i64* %"@y_val" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %32)
+  store i64 %get_stackid4, i64* %"@y_val"
+  %pseudo11 = call i64 @llvm.bpf.pseudo(i64 1, i64 2)
+  %update_elem12 = call i64 inttoptr (i64 2 to i64 (i64, i64*, i64*, i64)*)(i64 %pseudo11, i64* %"@y_key", i64* %"@y_val", i64 0)
+  %33 = bitcast i64* %"@y_key" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %33)
+  %34 = bitcast i64* %"@y_val" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %34)
   ret i64 0
 }
 
@@ -0,0 +1,167 @@
+; ModuleID = 'bpftrace'
+source_filename = "bpftrace"
+target datalayout = "e-m:e-p:64:64-i64:64-n32:64-S128"
+target triple = "bpf-pc-linux"
+
+; Function Attrs: nounwind
+declare i64 @llvm.bpf.pseudo(i64, i64) #0
+
+define i64 @"kprobe:f"(i8*) section "s_kprobe:f_1" {
+entry:
+  %"@x_val" = alloca i64
+  %lookup_elem_val = alloca i64
+  %"@x_key" = alloca i64
+  %get_pid_tgid = call i64 inttoptr (i64 14 to i64 ()*)()
+  %1 = lshr i64 %get_pid_tgid, 32
+  %loglinear = call i64 @loglinear(i64 %1, i64 3)
+  %2 = bitcast i64* %"@x_key" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %2)
+  store i64 %loglinear, i64* %"@x_key"
+  %pseudo = call i64 @llvm.bpf.pseudo(i64 1, i64 1)
+  %lookup_elem = call i8* inttoptr (i64 1 to i8* (i64, i64*)*)(i64 %pseudo, i64* %"@x_key")
+  %3 = bitcast i64* %lookup_elem_val to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %3)
+  %map_lookup_cond = icmp ne i8* %lookup_elem, null
+  br i1 %map_lookup_cond, label %lookup_success, label %lookup_failure
+
+lookup_success:                                   ; preds = %entry
+  %cast = bitcast i8* %lookup_elem to i64*
+  %4 = load i64, i64* %cast
+  store i64 %4, i64* %lookup_elem_val
+  br label %lookup_merge
+
+lookup_failure:                                   ; preds = %entry
+  store i64 0, i64* %lookup_elem_val
+  br label %lookup_merge
+
+lookup_merge:                                     ; preds = %lookup_failure, %lookup_success
+  %5 = load i64, i64* %lookup_elem_val
+  %6 = bitcast i64* %lookup_elem_val to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %6)
+  %7 = bitcast i64* %"@x_val" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %7)
+  %8 = add i64 %5, 1
+  store i64 %8, i64* %"@x_val"
+  %pseudo1 = call i64 @llvm.bpf.pseudo(i64 1, i64 1)
+  %update_elem = call i64 inttoptr (i64 2 to i64 (i64, i64*, i64*, i64)*)(i64 %pseudo1, i64* %"@x_key", i64* %"@x_val", i64 0)
+  %9 = bitcast i64* %"@x_key" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %9)
+  %10 = bitcast i64* %"@x_val" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %10)
+  ret i64 0
+}
+
+; Function Attrs: alwaysinline
+define internal i64 @loglinear(i64, i64) #1 section "helpers" {
+entry:
+  %2 = alloca i64
+  %3 = alloca i64
+  %4 = alloca i64
+  %5 = alloca i64
+  %6 = bitcast i64* %5 to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %6)
+  %7 = bitcast i64* %4 to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %7)
+  %8 = bitcast i64* %3 to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %8)
+  %9 = bitcast i64* %2 to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %9)
+  store i64 %0, i64* %5
+  store i64 %1, i64* %4
+  %10 = load i64, i64* %5
+  %11 = icmp slt i64 %10, 0
+  br i1 %11, label %llhist.is_less_than_zero, label %llhist.is_not_less_than_zero
+
+llhist.is_less_than_zero:                         ; preds = %entry
+  ret i64 0
+
+llhist.is_not_less_than_zero:                     ; preds = %entry
+  %12 = load i64, i64* %5
+  %13 = load i64, i64* %4
+  %14 = shl i64 2, %13
+  %15 = icmp ult i64 %12, %14
+  br i1 %15, label %llhist.is_exact, label %llhist.is_not_exact
+
+llhist.is_exact:                                  ; preds = %llhist.is_not_less_than_zero
+  %16 = load i64, i64* %5
+  %17 = add i64 %16, 1
+  ret i64 %17
+
+llhist.is_not_exact:                              ; preds = %llhist.is_not_less_than_zero
+  %18 = load i64, i64* %5
+  store i64 %18, i64* %3
+  store i64 0, i64* %2
+  %19 = load i64, i64* %3
+  %20 = icmp uge i64 %19, 4294967296
+  %21 = zext i1 %20 to i64
+  %22 = shl i64 %21, 5
+  %23 = lshr i64 %19, %22
+  store i64 %23, i64* %3
+  %24 = load i64, i64* %2
+  %25 = add i64 %24, %22
+  store i64 %25, i64* %2
+  %26 = load i64, i64* %3
+  %27 = icmp uge i64 %26, 65536
+  %28 = zext i1 %27 to i64
+  %29 = shl i64 %28, 4
+  %30 = lshr i64 %26, %29
+  store i64 %30, i64* %3
+  %31 = load i64, i64* %2
+  %32 = add i64 %31, %29
+  store i64 %32, i64* %2
+  %33 = load i64, i64* %3
+  %34 = icmp uge i64 %33, 256
+  %35 = zext i1 %34 to i64
+  %36 = shl i64 %35, 3
+  %37 = lshr i64 %33, %36
+  store i64 %37, i64* %3
+  %38 = load i64, i64* %2
+  %39 = add i64 %38, %36
+  store i64 %39, i64* %2
+  %40 = load i64, i64* %3
+  %41 = icmp uge i64 %40, 16
+  %42 = zext i1 %41 to i64
+  %43 = shl i64 %42, 2
+  %44 = lshr i64 %40, %43
+  store i64 %44, i64* %3
+  %45 = load i64, i64* %2
+  %46 = add i64 %45, %43
+  store i64 %46, i64* %2
+  %47 = load i64, i64* %3
+  %48 = icmp uge i64 %47, 4
+  %49 = zext i1 %48 to i64
+  %50 = shl i64 %49, 1
+  %51 = lshr i64 %47, %50
+  store i64 %51, i64* %3
+  %52 = load i64, i64* %2
+  %53 = add i64 %52, %50
+  store i64 %53, i64* %2
+  %54 = load i64, i64* %3
+  %55 = icmp uge i64 %54, 2
+  %56 = zext i1 %55 to i64
+  %57 = shl i64 %56, 0
+  %58 = lshr i64 %54, %57
+  store i64 %58, i64* %3
+  %59 = load i64, i64* %2
+  %60 = add i64 %59, %57
+  store i64 %60, i64* %2
+  %61 = load i64, i64* %5
+  %62 = load i64, i64* %4
+  %63 = load i64, i64* %2
+  %64 = sub i64 %63, %62
+  %65 = lshr i64 %61, %64
+  %66 = shl i64 %64, %62
+  %67 = add i64 %66, %65
+  %68 = add i64 %67, 1
+  ret i64 %68
+}
+
+; Function Attrs: argmemonly nounwind
+declare void @llvm.lifetime.start.p0i8(i64, i8* nocapture) #2
+
+; Function Attrs: argmemonly nounwind
+declare void @llvm.lifetime.end.p0i8(i64, i8* nocapture) #2
+
+attributes #0 = { nounwind }
+attributes #1 = { alwaysinline }
+attributes #2 = { argmemonly nounwind }
@@ -0,0 +1,113 @@
+; ModuleID = 'bpftrace'
+source_filename = "bpftrace"
+target datalayout = "e-m:e-p:64:64-i64:64-n32:64-S128"
+target triple = "bpf-pc-linux"
+
+; Function Attrs: nounwind
+declare i64 @llvm.bpf.pseudo(i64, i64) #0
+
+define i64 @"kprobe:f"(i8*) section "s_kprobe:f_1" {
+entry:
+  %"@x_val" = alloca i64
+  %lookup_elem_val = alloca i64
+  %"@x_key" = alloca i64
+  %ratelimit_result = alloca i64
+  %sampling_key = alloca i32
+  %1 = bitcast i32* %sampling_key to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %1)
+  store i32 0, i32* %sampling_key
+  %pseudo = call i64 @llvm.bpf.pseudo(i64 1, i64 2)
+  %lookup_elem = call i8* inttoptr (i64 1 to i8* (i64, i32*)*)(i64 %pseudo, i32* %sampling_key)
+  %2 = bitcast i32* %sampling_key to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %2)
+  %3 = bitcast i64* %ratelimit_result to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %3)
+  store i64 1, i64* %ratelimit_result
+  %4 = icmp ne i8* %lookup_elem, null
+  br i1 %4, label %ratelimit.found, label %ratelimit.done
+
+pred_false:                                       ; preds = %ratelimit.done
+  ret i64 0
+
+pred_true:                                        ; preds = %ratelimit.done
+  %5 = bitcast i64* %"@x_key" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %5)
+  store i64 0, i64* %"@x_key"
+  %pseudo1 = call i64 @llvm.bpf.pseudo(i64 1, i64 1)
+  %lookup_elem2 = call i8* inttoptr (i64 1 to i8* (i64, i64*)*)(i64 %pseudo1, i64* %"@x_key")
+  %6 = bitcast i64* %lookup_elem_val to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %6)
+  %map_lookup_cond = icmp ne i8* %lookup_elem2, null
+  br i1 %map_lookup_cond, label %lookup_success, label %lookup_failure
+
+ratelimit.found:                                  ; preds = %entry
+  %7 = bitcast i8* %lookup_elem to i64*
+  %8 = getelementptr i64, i64* %7, i64 0
+  %9 = getelementptr i64, i64* %7, i64 1
+  %10 = getelementptr i64, i64* %7, i64 2
+  %get_ns = call i64 inttoptr (i64 5 to i64 ()*)()
+  %11 = load i64, i64* %9
+  %12 = sub i64 %get_ns, %11
+  %13 = icmp ugt i64 %12, 1000000000
+  %14 = select i1 %13, i64 1000000000, i64 %12
+  %15 = mul i64 %14, 10
+  %16 = load i64, i64* %10
+  %17 = add i64 %16, %15
+  %18 = icmp ugt i64 %17, 10000000000
+  %19 = select i1 %18, i64 10000000000, i64 %17
+  %ratelimit_keep = icmp uge i64 %19, 1000000000
+  %20 = sub i64 %19, 1000000000
+  %21 = select i1 %ratelimit_keep, i64 %20, i64 %19
+  store i64 %get_ns, i64* %9
+  store i64 %21, i64* %10
+  %22 = xor i1 %ratelimit_keep, true
+  %23 = zext i1 %22 to i64
+  %24 = load i64, i64* %8
+  %25 = add i64 %24, %23
+  store i64 %25, i64* %8
+  %26 = zext i1 %ratelimit_keep to i64
+  store i64 %26, i64* %ratelimit_result
+  br label %ratelimit.done
+
+ratelimit.done:                                   ; preds = %ratelimit.found, %entry
+  %27 = load i64, i64* %ratelimit_result
+  %28 = bitcast i64* %ratelimit_result to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %28)
+  %predcond = icmp eq i64 %27, 0
+  br i1 %predcond, label %pred_false, label %pred_true
+
+lookup_success:                                   ; preds = %pred_true
+  %cast = bitcast i8* %lookup_elem2 to i64*
+  %29 = load i64, i64* %cast
+  store i64 %29, i64* %lookup_elem_val
+  br label %lookup_merge
+
+lookup_failure:                                   ; preds = %pred_true
+  store i64 0, i64* %lookup_elem_val
+  br label %lookup_merge
+
+lookup_merge:                                     ; preds = %lookup_failure, %lookup_success
+  %30 = load i64, i64* %lookup_elem_val
+  %31 = bitcast i64* %lookup_elem_val to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %31)
+  %32 = bitcast i64* %"@x_val" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %32)
+  %33 = add i64 %30, 1
+  store i64 %33, i64* %"@x_val"
+  %pseudo3 = call i64 @llvm.bpf.pseudo(i64 1, i64 1)
+  %update_elem = call i64 inttoptr (i64 2 to i64 (i64, i64*, i64*, i64)*)(i64 %pseudo3, i64* %"@x_key", i64* %"@x_val", i64 0)
+  %34 = bitcast i64* %"@x_key" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %34)
+  %35 = bitcast i64* %"@x_val" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %35)
+  ret i64 0
+}
+
+; Function Attrs: argmemonly nounwind
+declare void @llvm.lifetime.start.p0i8(i64, i8* nocapture) #1
+
+; Function Attrs: argmemonly nounwind
+declare void @llvm.lifetime.end.p0i8(i64, i8* nocapture) #1
+
+attributes #0 = { nounwind }
+attributes #1 = { argmemonly nounwind }
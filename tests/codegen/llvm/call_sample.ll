@@ -0,0 +1,99 @@
+; ModuleID = 'bpftrace'
+source_filename = "bpftrace"
+target datalayout = "e-m:e-p:64:64-i64:64-n32:64-S128"
+target triple = "bpf-pc-linux"
+
+; Function Attrs: nounwind
+declare i64 @llvm.bpf.pseudo(i64, i64) #0
+
+define i64 @"kprobe:f"(i8*) section "s_kprobe:f_1" {
+entry:
+  %"@x_val" = alloca i64
+  %lookup_elem_val = alloca i64
+  %"@x_key" = alloca i64
+  %sample_result = alloca i64
+  %sampling_key = alloca i32
+  %1 = bitcast i32* %sampling_key to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %1)
+  store i32 0, i32* %sampling_key
+  %pseudo = call i64 @llvm.bpf.pseudo(i64 1, i64 2)
+  %lookup_elem = call i8* inttoptr (i64 1 to i8* (i64, i32*)*)(i64 %pseudo, i32* %sampling_key)
+  %2 = bitcast i32* %sampling_key to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %2)
+  %3 = bitcast i64* %sample_result to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %3)
+  store i64 1, i64* %sample_result
+  %4 = icmp ne i8* %lookup_elem, null
+  br i1 %4, label %sample.found, label %sample.done
+
+pred_false:                                       ; preds = %sample.done
+  ret i64 0
+
+pred_true:                                        ; preds = %sample.done
+  %5 = bitcast i64* %"@x_key" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %5)
+  store i64 0, i64* %"@x_key"
+  %pseudo1 = call i64 @llvm.bpf.pseudo(i64 1, i64 1)
+  %lookup_elem2 = call i8* inttoptr (i64 1 to i8* (i64, i64*)*)(i64 %pseudo1, i64* %"@x_key")
+  %6 = bitcast i64* %lookup_elem_val to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %6)
+  %map_lookup_cond = icmp ne i8* %lookup_elem2, null
+  br i1 %map_lookup_cond, label %lookup_success, label %lookup_failure
+
+sample.found:                                     ; preds = %entry
+  %7 = bitcast i8* %lookup_elem to i64*
+  %8 = getelementptr i64, i64* %7, i64 0
+  %get_random = call i64 inttoptr (i64 7 to i64 ()*)()
+  %9 = urem i64 %get_random, 10
+  %sample_keep = icmp eq i64 %9, 0
+  %10 = xor i1 %sample_keep, true
+  %11 = zext i1 %10 to i64
+  %12 = load i64, i64* %8
+  %13 = add i64 %12, %11
+  store i64 %13, i64* %8
+  %14 = zext i1 %sample_keep to i64
+  store i64 %14, i64* %sample_result
+  br label %sample.done
+
+sample.done:                                      ; preds = %sample.found, %entry
+  %15 = load i64, i64* %sample_result
+  %16 = bitcast i64* %sample_result to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %16)
+  %predcond = icmp eq i64 %15, 0
+  br i1 %predcond, label %pred_false, label %pred_true
+
+lookup_success:                                   ; preds = %pred_true
+  %cast = bitcast i8* %lookup_elem2 to i64*
+  %17 = load i64, i64* %cast
+  store i64 %17, i64* %lookup_elem_val
+  br label %lookup_merge
+
+lookup_failure:                                   ; preds = %pred_true
+  store i64 0, i64* %lookup_elem_val
+  br label %lookup_merge
+
+lookup_merge:                                     ; preds = %lookup_failure, %lookup_success
+  %18 = load i64, i64* %lookup_elem_val
+  %19 = bitcast i64* %lookup_elem_val to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %19)
+  %20 = bitcast i64* %"@x_val" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %20)
+  %21 = add i64 %18, 1
+  store i64 %21, i64* %"@x_val"
+  %pseudo3 = call i64 @llvm.bpf.pseudo(i64 1, i64 1)
+  %update_elem = call i64 inttoptr (i64 2 to i64 (i64, i64*, i64*, i64)*)(i64 %pseudo3, i64* %"@x_key", i64* %"@x_val", i64 0)
+  %22 = bitcast i64* %"@x_key" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %22)
+  %23 = bitcast i64* %"@x_val" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %23)
+  ret i64 0
+}
+
+; Function Attrs: argmemonly nounwind
+declare void @llvm.lifetime.start.p0i8(i64, i8* nocapture) #1
+
+; Function Attrs: argmemonly nounwind
+declare void @llvm.lifetime.end.p0i8(i64, i8* nocapture) #1
+
+attributes #0 = { nounwind }
+attributes #1 = { argmemonly nounwind }
@@ -10,42 +10,100 @@ define i64 @"kprobe:f"(i8*) section "s_kprobe:f_1" {
 entry:
   %"@y_val" = alloca i64
   %"@y_key" = alloca i64
+  %stackid_errors_key8 = alloca i32
   %"@x_val" = alloca i64
   %"@x_key" = alloca i64
+  %stackid_errors_key = alloca i32
   %pseudo = call i64 @llvm.bpf.pseudo(i64 1, i64 4)
   %get_stackid = call i64 inttoptr (i64 27 to i64 (i8*, i64, i64)*)(i8* %0, i64 %pseudo, i64 256)
-  %get_pid_tgid = call i64 inttoptr (i64 14 to i64 ()*)()
-  %1 = shl i64 %get_pid_tgid, 32
-  %2 = or i64 %get_stackid, %1
-  %3 = bitcast i64* %"@x_key" to i8*
+  %1 = trunc i64 %get_stackid to i32
+  %2 = icmp sge i32 %1, 0
+  br i1 %2, label %get_stackid_merge, label %get_stackid_failure
+
+get_stackid_failure:                              ; preds = %entry
+  %3 = bitcast i32* %stackid_errors_key to i8*
   call void @llvm.lifetime.start.p0i8(i64 -1, i8* %3)
+  store i32 0, i32* %stackid_errors_key
+  %pseudo1 = call i64 @llvm.bpf.pseudo(i64 1, i64 5)
+  %lookup_elem = call i8* inttoptr (i64 1 to i8* (i64, i32*)*)(i64 %pseudo1, i32* %stackid_errors_key)
+  %4 = bitcast i32* %stackid_errors_key to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %4)
+  %5 = icmp ne i8* %lookup_elem, null
+  br i1 %5, label %get_stackid_count, label %get_stackid_merge
+
+get_stackid_count:                                ; preds = %get_stackid_failure
+  %6 = bitcast i8* %lookup_elem to i64*
+  %7 = icmp eq i32 %1, -17
+  %8 = icmp eq i32 %1, -12
+  %9 = select i1 %8, i64 1, i64 2
+  %10 = select i1 %7, i64 0, i64 %9
+  %11 = getelementptr i64, i64* %6, i64 %10
+  %12 = load i64, i64* %11
+  %13 = add i64 %12, 1
+  store i64 %13, i64* %11
+  br label %get_stackid_merge
+
+get_stackid_merge:                                ; preds = %get_stackid_count, %get_stackid_failure, %entry
+  %get_pid_tgid = call i64 inttoptr (i64 14 to i64 ()*)()
+  %14 = shl i64 %get_pid_tgid, 32
+  %15 = or i64 %get_stackid, %14
+  %16 = bitcast i64* %"@x_key" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %16)
   store i64 0, i64* %"@x_key"
-  %4 = bitcast i64* %"@x_val" to i8*
-  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %4)
-  store i64 %2, i64* %"@x_val"
-  %pseudo1 = call i64 @llvm.bpf.pseudo(i64 1, i64 1)
-  %update_elem = call i64 inttoptr (i64 2 to i64 (i64, i64*, i64*, i64)*)(i64 %pseudo1, i64* %"@x_key", i64* %"@x_val", i64 0)
-  %5 = bitcast i64* %"@x_key" to i8*
-  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %5)
-  %6 = bitcast i64* %"@x_val" to i8*
-  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %6)
-  %pseudo2 = call i64 @llvm.bpf.pseudo(i64 1, i64 3)
-  %get_stackid3 = call i64 inttoptr (i64 27 to i64 (i8*, i64, i64)*)(i8* %0, i64 %pseudo2, i64 256)
-  %get_pid_tgid4 = call i64 inttoptr (i64 14 to i64 ()*)()
-  %7 = shl i64 %get_pid_tgid4, 32
-  %8 = or i64 %get_stackid3, %7
-  %9 = bitcast i64* %"@y_key" to i8*
-  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %9)
+  %17 = bitcast i64* %"@x_val" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %17)
+  store i64 %15, i64* %"@x_val"
+  %pseudo2 = call i64 @llvm.bpf.pseudo(i64 1, i64 1)
+  %update_elem = call i64 inttoptr (i64 2 to i64 (i64, i64*, i64*, i64)*)(i64 %pseudo2, i64* %"@x_key", i64* %"@x_val", i64 0)
+  %18 = bitcast i64* %"@x_key" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %18)
+  %19 = bitcast i64* %"@x_val" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %19)
+  %pseudo3 = call i64 @llvm.bpf.pseudo(i64 1, i64 3)
+  %get_stackid4 = call i64 inttoptr (i64 27 to i64 (i8*, i64, i64)*)(i8* %0, i64 %pseudo3, i64 256)
+  %20 = trunc i64 %get_stackid4 to i32
+  %21 = icmp sge i32 %20, 0
+  br i1 %21, label %get_stackid_merge7, label %get_stackid_failure5
+
+get_stackid_failure5:                             ; preds = %get_stackid_merge
+  %22 = bitcast i32* %stackid_errors_key8 to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %22)
+  store i32 1, i32* %stackid_errors_key8
+  %pseudo9 = call i64 @llvm.bpf.pseudo(i64 1, i64 5)
+  %lookup_elem10 = call i8* inttoptr (i64 1 to i8* (i64, i32*)*)(i64 %pseudo9, i32* %stackid_errors_key8)
+  %23 = bitcast i32* %stackid_errors_key8 to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %23)
+  %24 = icmp ne i8* %lookup_elem10, null
+  br i1 %24, label %get_stackid_count6, label %get_stackid_merge7
+
+get_stackid_count6:                               ; preds = %get_stackid_failure5
+  %25 = bitcast i8* %lookup_elem10 to i64*
+  %26 = icmp eq i32 %20, -17
+  %27 = icmp eq i32 %20, -12
+  %28 = select i1 %27, i64 1, i64 2
+  %29 = select i1 %26, i64 0, i64 %28
+  %30 = getelementptr i64, i64* %25, i64 %29
+  %31 = load i64, i64* %30
+  %32 = add i64 %31, 1
+  store i64 %32, i64* %30
+  br label %get_stackid_merge7
+
+get_stackid_merge7:                               ; preds = %get_stackid_count6, %get_stackid_failure5, %get_stackid_merge
+  %get_pid_tgid11 = call i64 inttoptr (i64 14 to i64 ()*)()
+  %33 = shl i64 %get_pid_tgid11, 32
+  %34 = or i64 %get_stackid4, %33
+  %35 = bitcast i64* %"@y_key" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %35)
   store i64 0, i64* %"@y_key"
-  %10 = bitcast i64* %"@y_val" to i8*
-  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %10)
-  store i64 %8, i64* %"@y_val"
-  %pseudo5 = call i64 @llvm.bpf.pseudo(i64 1, i64 2)
-  %update_elem6 = call i64 inttoptr (i64 2 to i64 (i64, i64*, i64*, i64)*)(i64 %pseudo5, i64* %"@y_key", i64* %"@y_val", i64 0)
-  %11 = bitcast i64* %"@y_key" to i8*
-  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %11)
-  %12 = bitcast i64* %"@y_val" to i8*
-  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %12)
+  %36 = bitcast i64* %"@y_val" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %36)
+  store i64 %34, i64* %"@y_val"
+  %pseudo12 = call i64 @llvm.bpf.pseudo(i64 1, i64 2)
+  %update_elem13 = call i64 inttoptr (i64 2 to i64 (i64, i64*, i64*, i64)*)(i64 %pseudo12, i64* %"@y_key", i64* %"@y_val", i64 0)
+  %37 = bitcast i64* %"@y_key" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %37)
+  %38 = bitcast i64* %"@y_val" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %38)
   ret i64 0
 }
 
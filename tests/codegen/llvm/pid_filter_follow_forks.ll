@@ -0,0 +1,93 @@
+; ModuleID = 'bpftrace'
+source_filename = "bpftrace"
+target datalayout = "e-m:e-p:64:64-i64:64-n32:64-S128"
+target triple = "bpf-pc-linux"
+
+; Function Attrs: nounwind
+declare i64 @llvm.bpf.pseudo(i64, i64) #0
+
+define i64 @"kprobe:f"(i8*) section "s_kprobe:f_1" {
+entry:
+  %"@x_val" = alloca i64
+  %"@x_key" = alloca i64
+  %pid_filter_key = alloca i64
+  %get_pid_tgid = call i64 inttoptr (i64 14 to i64 ()*)()
+  %1 = lshr i64 %get_pid_tgid, 32
+  %2 = bitcast i64* %pid_filter_key to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %2)
+  store i64 %1, i64* %pid_filter_key
+  %pseudo = call i64 @llvm.bpf.pseudo(i64 1, i64 2)
+  %lookup_elem = call i8* inttoptr (i64 1 to i8* (i64, i64*)*)(i64 %pseudo, i64* %pid_filter_key)
+  %3 = bitcast i64* %pid_filter_key to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %3)
+  %pid_filter_cond = icmp ne i8* %lookup_elem, null
+  br i1 %pid_filter_cond, label %pid_filter_true, label %pid_filter_false
+
+pid_filter_false:                                 ; preds = %entry
+  ret i64 0
+
+pid_filter_true:                                  ; preds = %entry
+  %4 = bitcast i64* %"@x_key" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %4)
+  store i64 0, i64* %"@x_key"
+  %5 = bitcast i64* %"@x_val" to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %5)
+  store i64 1, i64* %"@x_val"
+  %pseudo1 = call i64 @llvm.bpf.pseudo(i64 1, i64 1)
+  %update_elem = call i64 inttoptr (i64 2 to i64 (i64, i64*, i64*, i64)*)(i64 %pseudo1, i64* %"@x_key", i64* %"@x_val", i64 0)
+  %6 = bitcast i64* %"@x_key" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %6)
+  %7 = bitcast i64* %"@x_val" to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %7)
+  ret i64 0
+}
+
+; Function Attrs: argmemonly nounwind
+declare void @llvm.lifetime.start.p0i8(i64, i8* nocapture) #1
+
+; Function Attrs: argmemonly nounwind
+declare void @llvm.lifetime.end.p0i8(i64, i8* nocapture) #1
+
+define i64 @"tracepoint:sched:sched_process_fork"(i8*) section "s_tracepoint:sched:sched_process_fork_1" {
+entry:
+  %pid_filter_val = alloca i64
+  %pid_filter_key1 = alloca i64
+  %pid_filter_key = alloca i64
+  %get_pid_tgid = call i64 inttoptr (i64 14 to i64 ()*)()
+  %1 = lshr i64 %get_pid_tgid, 32
+  %2 = bitcast i64* %pid_filter_key to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %2)
+  store i64 %1, i64* %pid_filter_key
+  %pseudo = call i64 @llvm.bpf.pseudo(i64 1, i64 2)
+  %lookup_elem = call i8* inttoptr (i64 1 to i8* (i64, i64*)*)(i64 %pseudo, i64* %pid_filter_key)
+  %3 = bitcast i64* %pid_filter_key to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %3)
+  %pid_filter_cond = icmp ne i8* %lookup_elem, null
+  br i1 %pid_filter_cond, label %pid_filter_true, label %pid_filter_false
+
+pid_filter_false:                                 ; preds = %entry
+  ret i64 0
+
+pid_filter_true:                                  ; preds = %entry
+  %4 = ptrtoint i8* %0 to i64
+  %5 = add i64 %4, 44
+  %6 = inttoptr i64 %5 to i32*
+  %7 = load volatile i32, i32* %6
+  %8 = sext i32 %7 to i64
+  %9 = bitcast i64* %pid_filter_key1 to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %9)
+  store i64 %8, i64* %pid_filter_key1
+  %10 = bitcast i64* %pid_filter_val to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %10)
+  store i64 1, i64* %pid_filter_val
+  %pseudo2 = call i64 @llvm.bpf.pseudo(i64 1, i64 2)
+  %update_elem = call i64 inttoptr (i64 2 to i64 (i64, i64*, i64*, i64)*)(i64 %pseudo2, i64* %pid_filter_key1, i64* %pid_filter_val, i64 0)
+  %11 = bitcast i64* %pid_filter_key1 to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %11)
+  %12 = bitcast i64* %pid_filter_val to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %12)
+  ret i64 0
+}
+
+attributes #0 = { nounwind }
+attributes #1 = { argmemonly nounwind }
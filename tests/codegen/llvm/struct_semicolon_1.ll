@@ -10,6 +10,7 @@ declare i64 @llvm.bpf.pseudo(i64, i64) #0
 
 define i64 @"kprobe:f"(i8*) section "s_kprobe:f_1" {
 entry:
+  %stackid_errors_key = alloca i32
   %printf_args = alloca %printf_t
   %1 = bitcast %printf_t* %printf_args to i8*
   call void @llvm.lifetime.start.p0i8(i64 -1, i8* %1)
@@ -19,16 +20,44 @@ entry:
   store i64 0, i64* %3
   %pseudo = call i64 @llvm.bpf.pseudo(i64 1, i64 1)
   %get_stackid = call i64 inttoptr (i64 27 to i64 (i8*, i64, i64)*)(i8* %0, i64 %pseudo, i64 256)
-  %get_pid_tgid = call i64 inttoptr (i64 14 to i64 ()*)()
-  %4 = shl i64 %get_pid_tgid, 32
-  %5 = or i64 %get_stackid, %4
-  %6 = getelementptr %printf_t, %printf_t* %printf_args, i32 0, i32 1
-  store i64 %5, i64* %6
+  %4 = trunc i64 %get_stackid to i32
+  %5 = icmp sge i32 %4, 0
+  br i1 %5, label %get_stackid_merge, label %get_stackid_failure
+
+get_stackid_failure:                              ; preds = %entry
+  %6 = bitcast i32* %stackid_errors_key to i8*
+  call void @llvm.lifetime.start.p0i8(i64 -1, i8* %6)
+  store i32 0, i32* %stackid_errors_key
   %pseudo1 = call i64 @llvm.bpf.pseudo(i64 1, i64 2)
-  %get_cpu_id = call i64 inttoptr (i64 8 to i64 ()*)()
-  %perf_event_output = call i64 inttoptr (i64 25 to i64 (i8*, i64, i64, %printf_t*, i64)*)(i8* %0, i64 %pseudo1, i64 %get_cpu_id, %printf_t* %printf_args, i64 16)
-  %7 = bitcast %printf_t* %printf_args to i8*
+  %lookup_elem = call i8* inttoptr (i64 1 to i8* (i64, i32*)*)(i64 %pseudo1, i32* %stackid_errors_key)
+  %7 = bitcast i32* %stackid_errors_key to i8*
   call void @llvm.lifetime.end.p0i8(i64 -1, i8* %7)
+  %8 = icmp ne i8* %lookup_elem, null
+  br i1 %8, label %get_stackid_count, label %get_stackid_merge
+
+get_stackid_count:                                ; preds = %get_stackid_failure
+  %9 = bitcast i8* %lookup_elem to i64*
+  %10 = icmp eq i32 %4, -17
+  %11 = icmp eq i32 %4, -12
+  %12 = select i1 %11, i64 1, i64 2
+  %13 = select i1 %10, i64 0, i64 %12
+  %14 = getelementptr i64, i64* %9, i64 %13
+  %15 = load i64, i64* %14
+  %16 = add i64 %15, 1
+  store i64 %16, i64* %14
+  br label %get_stackid_merge
+
+get_stackid_merge:                                ; preds = %get_stackid_count, %get_stackid_failure, %entry
+  %get_pid_tgid = call i64 inttoptr (i64 14 to i64 ()*)()
+  %17 = shl i64 %get_pid_tgid, 32
+  %18 = or i64 %get_stackid, %17
+  %19 = getelementptr %printf_t, %printf_t* %printf_args, i32 0, i32 1
+  store i64 %18, i64* %19
+  %pseudo2 = call i64 @llvm.bpf.pseudo(i64 1, i64 3)
+  %get_cpu_id = call i64 inttoptr (i64 8 to i64 ()*)()
+  %perf_event_output = call i64 inttoptr (i64 25 to i64 (i8*, i64, i64, %printf_t*, i64)*)(i8* %0, i64 %pseudo2, i64 %get_cpu_id, %printf_t* %printf_args, i64 16)
+  %20 = bitcast %printf_t* %printf_args to i8*
+  call void @llvm.lifetime.end.p0i8(i64 -1, i8* %20)
   ret i64 0
 }
 
@@ -0,0 +1,18 @@
+#include "common.h"
+
+namespace bpftrace {
+namespace test {
+namespace codegen {
+
+// LRU maps only differ in their type, they are updated like hash maps
+TEST(codegen, map_lru)
+{
+  BPFtrace bpftrace;
+  bpftrace.lru_maps_ = { "@x", "@y" };
+
+  test(bpftrace, "kprobe:f { @x[pid] = count(); @y[tid] = 1 }", NAME);
+}
+
+} // namespace codegen
+} // namespace test
+} // namespace bpftrace
@@ -0,0 +1,70 @@
+#include "common.h"
+
+namespace bpftrace {
+namespace test {
+namespace codegen {
+
+static const std::string OPTIMIZE_INPUT =
+    "kprobe:f { @a[comm] = count(); @b = hist(arg0) }"
+    "kprobe:g { printf(\"%d %s\\n\", pid, str(arg1)) }"
+    "kretprobe:h { @c[tid] = sum(retval) }"
+    "kprobe:i /pid > 100/ { @d = lhist(arg2, 0, 100, 10) }";
+
+// The contents of the sections of a program compiled at -O<level>, with the
+// programs optimized on up to max_threads threads
+static std::map<std::string, std::string> optimized_sections(
+    const std::string &input,
+    int level,
+    unsigned int max_threads)
+{
+  BPFtrace bpftrace;
+  bpftrace.opt_level_ = level;
+  Driver driver(bpftrace);
+  FakeMap::next_mapfd_ = 1;
+
+  EXPECT_EQ(driver.parse_str(input), 0);
+
+  ClangParser clang;
+  clang.parse(driver.root_.get(), bpftrace);
+
+  MockBPFfeature feature;
+  ast::SemanticAnalyser semantics(driver.root_.get(), bpftrace, feature);
+  EXPECT_EQ(semantics.analyse(), 0);
+  EXPECT_EQ(semantics.create_maps(true), 0);
+
+  ast::CodegenLLVM codegen(driver.root_.get(), bpftrace);
+  codegen.generate_ir();
+  codegen.optimize(max_threads);
+  auto object = codegen.emit();
+
+  std::map<std::string, std::string> sections;
+  for (auto &section : object->sections_)
+    sections[section.first] = std::string(
+        reinterpret_cast<const char *>(std::get<0>(section.second)),
+        std::get<1>(section.second));
+  return sections;
+}
+
+TEST(codegen, optimize_parallel)
+{
+  auto serial = optimized_sections(OPTIMIZE_INPUT, 3, 1);
+  EXPECT_EQ(serial.count("s_kprobe:f_1"), 1U);
+  EXPECT_EQ(serial.count("s_kprobe:i_1"), 1U);
+
+  EXPECT_EQ(optimized_sections(OPTIMIZE_INPUT, 3, 2), serial);
+  EXPECT_EQ(optimized_sections(OPTIMIZE_INPUT, 3, 4), serial);
+}
+
+TEST(codegen, optimize_levels)
+{
+  for (int level = 0; level <= 3; level++)
+  {
+    auto sections = optimized_sections(OPTIMIZE_INPUT, level, 1);
+    EXPECT_EQ(sections.count("s_kprobe:f_1"), 1U) << "-O" << level;
+    EXPECT_EQ(sections.count("s_kretprobe:h_1"), 1U) << "-O" << level;
+  }
+}
+
+} // namespace codegen
+} // namespace test
+} // namespace bpftrace
@@ -0,0 +1,37 @@
+#include "../mocks.h"
+#include "common.h"
+
+namespace bpftrace {
+namespace test {
+namespace codegen {
+
+TEST(codegen, pid_filter_follow_forks)
+{
+  auto bpftrace = get_mock_bpftrace();
+  ON_CALL(*bpftrace,
+          get_symbols_from_file("/sys/kernel/debug/tracing/available_events"))
+      .WillByDefault([](const std::string &) {
+        return std::make_unique<std::istringstream>(
+            "sched:sched_process_fork\n");
+      });
+  bpftrace->pid_filter_ = { 1234, 1240 };
+  bpftrace->pid_filter_follow_forks_ = true;
+  // child_pid follows the common fields, parent_comm, parent_pid and
+  // child_comm
+  bpftrace->structs_["struct _tracepoint_sched_sched_process_fork"] = Struct{
+    .size = 48,
+    .fields = { { "child_pid",
+                  Field{
+                      .type = CreateInt32(),
+                      .offset = 44,
+                      .is_bitfield = false,
+                      .bitfield = {},
+                  } } },
+  };
+
+  test(*bpftrace, "kprobe:f { @x = 1 }", NAME);
+}
+
+} // namespace codegen
+} // namespace test
+} // namespace bpftrace
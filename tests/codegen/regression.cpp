@@ -1,7 +1,7 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
-#include "bpforc.h"
+#include "bpf_object.h"
 #include "bpftrace.h"
 #include "clang_parser.h"
 #include "codegen_llvm.h"
@@ -25,6 +25,58 @@
 //
 //  struct Foo3 foo3;
 //
+//  typedef unsigned int u32;
+//
+//  struct trace_entry {
+//    unsigned short type;
+//    unsigned char  flags;
+//    unsigned char  preempt_count;
+//    int            pid;
+//  };
+//
+//  struct trace_event_raw_sample {
+//    struct trace_entry ent;
+//    char               comm[16];
+//    int                pid;
+//    u32                __data_loc_name;
+//    char               __data[0];
+//  };
+//
+//  struct trace_event_raw_sample sample;
+//
+//  typedef void (*btf_trace_sample)(void *__data, struct Foo1 *foo1, int a);
+//
+//  static void __bpf_trace_sample(void *__data, struct Foo1 *foo1, int a)
+//  {
+//  }
+//
+//  struct trace_event_raw_orphan {
+//    struct trace_entry ent;
+//    int                x;
+//    char               __data[0];
+//  };
+//
+//  struct trace_event_raw_orphan orphan;
+//
+//  typedef void (*btf_trace_orphan)(void *__data, struct Foo1 *foo1, int a);
+//
+//  struct Foo4 {
+//    unsigned int  a : 3;
+//    unsigned int  b : 9;
+//    int           c : 10;
+//    char          d;
+//    unsigned char e;
+//    signed char   f;
+//  };
+//
+//  typedef struct {
+//    int x;
+//  } anon_t;
+//
+//  struct Foo5 {
+//    anon_t a;
+//  };
+//
 //  struct Foo3 *func_1(int a, struct Foo1 *foo1, struct Foo2 *foo2)
 //  {
 //    return 0;
@@ -64,8 +116,8 @@
 //  $ xxd -i data > data.h
 
 unsigned char btf_data[] = {
-  0x9f, 0xeb, 0x01, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xbc,
-  0x01, 0x00, 0x00, 0xbc, 0x01, 0x00, 0x00, 0x50, 0x00, 0x00, 0x00, 0x01, 0x00,
+  0x9f, 0xeb, 0x01, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xdc,
+  0x03, 0x00, 0x00, 0xdc, 0x03, 0x00, 0x00, 0x76, 0x01, 0x00, 0x00, 0x01, 0x00,
   0x00, 0x00, 0x03, 0x00, 0x00, 0x04, 0x10, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00,
   0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x12, 0x00, 0x00, 0x00,
   0x03, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x04,
@@ -100,13 +152,77 @@ unsigned char btf_data[] = {
   0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x1d, 0x00,
   0x00, 0x00, 0x0b, 0x00, 0x00, 0x00, 0x22, 0x00, 0x00, 0x00, 0x0f, 0x00, 0x00,
   0x00, 0x27, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x15, 0x00, 0x00, 0x00,
-  0x00, 0x46, 0x6f, 0x6f, 0x31, 0x00, 0x46, 0x6f, 0x6f, 0x32, 0x00, 0x46, 0x6f,
-  0x6f, 0x33, 0x00, 0x61, 0x00, 0x62, 0x00, 0x63, 0x00, 0x63, 0x68, 0x61, 0x72,
-  0x00, 0x66, 0x00, 0x66, 0x6f, 0x6f, 0x31, 0x00, 0x66, 0x6f, 0x6f, 0x32, 0x00,
-  0x66, 0x75, 0x6e, 0x63, 0x5f, 0x31, 0x00, 0x66, 0x75, 0x6e, 0x63, 0x5f, 0x32,
-  0x00, 0x66, 0x75, 0x6e, 0x63, 0x5f, 0x33, 0x00, 0x67, 0x00, 0x69, 0x6e, 0x74,
-  0x00, 0x6c, 0x6f, 0x6e, 0x67, 0x20, 0x69, 0x6e, 0x74, 0x00, 0x6d, 0x61, 0x69,
-  0x6e, 0x00
+  0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x00, 0x00, 0x00, 0x10,
+  0x00, 0x00, 0x00, 0x5f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0x00,
+  0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x6d, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x01, 0x04, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x7a, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x08, 0x19, 0x00, 0x00, 0x00, 0x7e, 0x00, 0x00, 0x00, 0x04,
+  0x00, 0x00, 0x04, 0x08, 0x00, 0x00, 0x00, 0x8a, 0x00, 0x00, 0x00, 0x17, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x8f, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00,
+  0x00, 0x10, 0x00, 0x00, 0x00, 0x95, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00,
+  0x18, 0x00, 0x00, 0x00, 0xa3, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x20,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00,
+  0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00,
+  0x03, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xa7,
+  0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x04, 0x20, 0x00, 0x00, 0x00, 0xbe, 0x00,
+  0x00, 0x00, 0x1b, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc2, 0x00, 0x00,
+  0x00, 0x1c, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0xc7, 0x00, 0x00, 0x00,
+  0x02, 0x00, 0x00, 0x00, 0xc0, 0x00, 0x00, 0x00, 0xcb, 0x00, 0x00, 0x00, 0x1a,
+  0x00, 0x00, 0x00, 0xe0, 0x00, 0x00, 0x00, 0xdb, 0x00, 0x00, 0x00, 0x1d, 0x00,
+  0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x0d,
+  0x00, 0x00, 0x00, 0x00, 0xe2, 0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00, 0xe9,
+  0x00, 0x00, 0x00, 0x0b, 0x00, 0x00, 0x00, 0xee, 0x00, 0x00, 0x00, 0x02, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x20, 0x00, 0x00,
+  0x00, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x21, 0x00, 0x00, 0x00,
+  0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x20, 0x00, 0x00, 0x00, 0x14,
+  0x01, 0x00, 0x00, 0x03, 0x00, 0x00, 0x04, 0x0c, 0x00, 0x00, 0x00, 0x2b, 0x01,
+  0x00, 0x00, 0x1b, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2f, 0x01, 0x00,
+  0x00, 0x02, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x31, 0x01, 0x00, 0x00,
+  0x1d, 0x00, 0x00, 0x00, 0x60, 0x00, 0x00, 0x00, 0x38, 0x01, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x08, 0x21, 0x00, 0x00, 0x00, 0x49, 0x01, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x01, 0x55, 0x01, 0x00,
+  0x00, 0x06, 0x00, 0x00, 0x84, 0x08, 0x00, 0x00, 0x00, 0x5a, 0x01, 0x00, 0x00,
+  0x19, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x5c, 0x01, 0x00, 0x00, 0x19,
+  0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x09, 0x5e, 0x01, 0x00, 0x00, 0x02, 0x00,
+  0x00, 0x00, 0x0c, 0x00, 0x00, 0x0a, 0x60, 0x01, 0x00, 0x00, 0x03, 0x00, 0x00,
+  0x00, 0x18, 0x00, 0x00, 0x00, 0x62, 0x01, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00,
+  0x20, 0x00, 0x00, 0x00, 0x64, 0x01, 0x00, 0x00, 0x26, 0x00, 0x00, 0x00, 0x28,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x04, 0x04, 0x00,
+  0x00, 0x00, 0x66, 0x01, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x68, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x28, 0x00, 0x00, 0x00,
+  0x6f, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x04, 0x04, 0x00, 0x00, 0x00, 0x74,
+  0x01, 0x00, 0x00, 0x29, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46,
+  0x6f, 0x6f, 0x31, 0x00, 0x46, 0x6f, 0x6f, 0x32, 0x00, 0x46, 0x6f, 0x6f, 0x33,
+  0x00, 0x61, 0x00, 0x62, 0x00, 0x63, 0x00, 0x63, 0x68, 0x61, 0x72, 0x00, 0x66,
+  0x00, 0x66, 0x6f, 0x6f, 0x31, 0x00, 0x66, 0x6f, 0x6f, 0x32, 0x00, 0x66, 0x75,
+  0x6e, 0x63, 0x5f, 0x31, 0x00, 0x66, 0x75, 0x6e, 0x63, 0x5f, 0x32, 0x00, 0x66,
+  0x75, 0x6e, 0x63, 0x5f, 0x33, 0x00, 0x67, 0x00, 0x69, 0x6e, 0x74, 0x00, 0x6c,
+  0x6f, 0x6e, 0x67, 0x20, 0x69, 0x6e, 0x74, 0x00, 0x6d, 0x61, 0x69, 0x6e, 0x00,
+  0x75, 0x6e, 0x73, 0x69, 0x67, 0x6e, 0x65, 0x64, 0x20, 0x73, 0x68, 0x6f, 0x72,
+  0x74, 0x00, 0x75, 0x6e, 0x73, 0x69, 0x67, 0x6e, 0x65, 0x64, 0x20, 0x63, 0x68,
+  0x61, 0x72, 0x00, 0x75, 0x6e, 0x73, 0x69, 0x67, 0x6e, 0x65, 0x64, 0x20, 0x69,
+  0x6e, 0x74, 0x00, 0x75, 0x33, 0x32, 0x00, 0x74, 0x72, 0x61, 0x63, 0x65, 0x5f,
+  0x65, 0x6e, 0x74, 0x72, 0x79, 0x00, 0x74, 0x79, 0x70, 0x65, 0x00, 0x66, 0x6c,
+  0x61, 0x67, 0x73, 0x00, 0x70, 0x72, 0x65, 0x65, 0x6d, 0x70, 0x74, 0x5f, 0x63,
+  0x6f, 0x75, 0x6e, 0x74, 0x00, 0x70, 0x69, 0x64, 0x00, 0x74, 0x72, 0x61, 0x63,
+  0x65, 0x5f, 0x65, 0x76, 0x65, 0x6e, 0x74, 0x5f, 0x72, 0x61, 0x77, 0x5f, 0x73,
+  0x61, 0x6d, 0x70, 0x6c, 0x65, 0x00, 0x65, 0x6e, 0x74, 0x00, 0x63, 0x6f, 0x6d,
+  0x6d, 0x00, 0x70, 0x69, 0x64, 0x00, 0x5f, 0x5f, 0x64, 0x61, 0x74, 0x61, 0x5f,
+  0x6c, 0x6f, 0x63, 0x5f, 0x6e, 0x61, 0x6d, 0x65, 0x00, 0x5f, 0x5f, 0x64, 0x61,
+  0x74, 0x61, 0x00, 0x5f, 0x5f, 0x64, 0x61, 0x74, 0x61, 0x00, 0x66, 0x6f, 0x6f,
+  0x31, 0x00, 0x61, 0x00, 0x62, 0x74, 0x66, 0x5f, 0x74, 0x72, 0x61, 0x63, 0x65,
+  0x5f, 0x73, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x00, 0x5f, 0x5f, 0x62, 0x70, 0x66,
+  0x5f, 0x74, 0x72, 0x61, 0x63, 0x65, 0x5f, 0x73, 0x61, 0x6d, 0x70, 0x6c, 0x65,
+  0x00, 0x74, 0x72, 0x61, 0x63, 0x65, 0x5f, 0x65, 0x76, 0x65, 0x6e, 0x74, 0x5f,
+  0x72, 0x61, 0x77, 0x5f, 0x6f, 0x72, 0x70, 0x68, 0x61, 0x6e, 0x00, 0x65, 0x6e,
+  0x74, 0x00, 0x78, 0x00, 0x5f, 0x5f, 0x64, 0x61, 0x74, 0x61, 0x00, 0x62, 0x74,
+  0x66, 0x5f, 0x74, 0x72, 0x61, 0x63, 0x65, 0x5f, 0x6f, 0x72, 0x70, 0x68, 0x61,
+  0x6e, 0x00, 0x73, 0x69, 0x67, 0x6e, 0x65, 0x64, 0x20, 0x63, 0x68, 0x61, 0x72,
+  0x00, 0x46, 0x6f, 0x6f, 0x34, 0x00, 0x61, 0x00, 0x62, 0x00, 0x63, 0x00, 0x64,
+  0x00, 0x65, 0x00, 0x66, 0x00, 0x78, 0x00, 0x61, 0x6e, 0x6f, 0x6e, 0x5f, 0x74,
+  0x00, 0x46, 0x6f, 0x6f, 0x35, 0x00, 0x61, 0x00
 };
 
 unsigned int btf_data_len = sizeof(btf_data) / sizeof(btf_data[0]);
@@ -67,7 +67,10 @@ public:
     has_get_current_cgroup_id_ = std::make_optional<bool>(has_features);
     has_override_return_ = std::make_optional<bool>(has_features);
     prog_kfunc_ = std::make_optional<bool>(has_features);
+    prog_raw_tracepoint_ = std::make_optional<bool>(has_features);
     has_loop_ = std::make_optional<bool>(has_features);
+    map_lru_hash_ = std::make_optional<bool>(has_features);
+    map_lru_percpu_hash_ = std::make_optional<bool>(has_features);
   };
 };
 
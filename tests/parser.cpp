@@ -1054,6 +1054,21 @@ TEST(Parser, tracepoint_probe)
   test_parse_failure("tracepoint { 1 }");
 }
 
+TEST(Parser, rawtracepoint_probe)
+{
+  test("rawtracepoint:sched_switch { 1 }",
+       "Program\n"
+       " rawtracepoint:sched_switch\n"
+       "  int: 1\n");
+  test("rt:sched_switch { 1 }",
+       "Program\n"
+       " rawtracepoint:sched_switch\n"
+       "  int: 1\n");
+
+  test_parse_failure("rawtracepoint:sched:sched_switch { 1 }");
+  test_parse_failure("rawtracepoint { 1 }");
+}
+
 TEST(Parser, profile_probe)
 {
   test("profile:ms:997 { 1 }",
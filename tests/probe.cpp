@@ -1,4 +1,4 @@
-#include "bpforc.h"
+#include "bpf_object.h"
 #include "bpftrace.h"
 #include "clang_parser.h"
 #include "codegen_llvm.h"
@@ -77,6 +77,7 @@ TEST_F(probe_btf, short_name)
 {
   compare_bytecode("kfunc:func_1 { 1 }", "f:func_1 { 1 }");
   compare_bytecode("kretfunc:func_1 { 1 }", "fr:func_1 { 1 }");
+  compare_bytecode("rawtracepoint:sample { 1 }", "rt:sample { 1 }");
 }
 
 #endif // HAVE_LIBBPF_BTF_DUMP
@@ -0,0 +1,146 @@
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+
+#include <linux/bpf.h>
+
+#include "bpftrace.h"
+#include "program_bundle.h"
+
+namespace bpftrace {
+namespace test {
+namespace program_bundle {
+
+class BPFtraceWithProbes : public BPFtrace
+{
+public:
+  void push_probe(const Probe &probe)
+  {
+    probes_.push_back(probe);
+  }
+};
+
+class program_bundle : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    char path[] = "/tmp/bpftrace-test-bundle-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    path_ = path;
+
+    // exit
+    struct bpf_insn insn = {};
+    insn.code = BPF_JMP | BPF_EXIT;
+    code_.resize(sizeof(insn));
+    std::memcpy(code_.data(), &insn, sizeof(insn));
+    sections_["s_kprobe:f_1"] = std::make_tuple(code_.data(), code_.size());
+  }
+
+  void TearDown() override
+  {
+    std::remove(path_.c_str());
+  }
+
+  std::string path_;
+  std::vector<uint8_t> code_;
+  ProgramSections sections_;
+};
+
+TEST_F(program_bundle, round_trip)
+{
+  BPFtrace saved;
+  saved.join_args_.push_back(",");
+  saved.time_args_.push_back("%H:%M:%S\n");
+  ProgramBundle(saved).save(path_, sections_);
+
+  BPFtrace loaded;
+  ProgramBundle bundle(loaded);
+  bundle.load(path_);
+  EXPECT_EQ(loaded.join_args_, saved.join_args_);
+  EXPECT_EQ(loaded.time_args_, saved.time_args_);
+
+  auto &sections = bundle.sections();
+  ASSERT_EQ(sections.size(), 1U);
+  ASSERT_EQ(sections.count("s_kprobe:f_1"), 1U);
+  auto &[addr, size] = sections.at("s_kprobe:f_1");
+  ASSERT_EQ(size, code_.size());
+  EXPECT_EQ(std::memcmp(addr, code_.data(), size), 0);
+}
+
+TEST_F(program_bundle, not_elf)
+{
+  std::ofstream(path_) << "kprobe:f { exit() }";
+  BPFtrace bpftrace;
+  EXPECT_THROW(ProgramBundle(bpftrace).load(path_), std::runtime_error);
+}
+
+TEST_F(program_bundle, truncated)
+{
+  BPFtrace saved;
+  ProgramBundle(saved).save(path_, sections_);
+  std::string data;
+  {
+    std::ifstream in(path_, std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(in), {});
+  }
+  std::ofstream(path_, std::ios::binary) << data.substr(0, data.size() - 8);
+
+  BPFtrace loaded;
+  EXPECT_THROW(ProgramBundle(loaded).load(path_), std::runtime_error);
+}
+
+TEST_F(program_bundle, unsafe_in_safe_mode)
+{
+  BPFtrace saved;
+  saved.safe_mode_ = false;
+  ProgramBundle(saved).save(path_, sections_);
+
+  BPFtrace loaded;
+  loaded.safe_mode_ = true;
+  EXPECT_THROW(ProgramBundle(loaded).load(path_), std::runtime_error);
+  loaded.safe_mode_ = false;
+  EXPECT_NO_THROW(ProgramBundle(loaded).load(path_));
+}
+
+TEST_F(program_bundle, traced_binary_changed)
+{
+  char binary[] = "/tmp/bpftrace-test-binary-XXXXXX";
+  int fd = mkstemp(binary);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  std::ofstream(binary) << "v1";
+
+  BPFtraceWithProbes saved;
+  Probe probe;
+  probe.type = ProbeType::uprobe;
+  probe.path = binary;
+  saved.push_probe(probe);
+  ProgramBundle(saved).save(path_, sections_);
+
+  BPFtrace loaded;
+  EXPECT_NO_THROW(ProgramBundle(loaded).load(path_));
+
+  std::ofstream(binary) << "v2 with other offsets";
+  EXPECT_THROW(ProgramBundle(loaded).load(path_), std::runtime_error);
+  EXPECT_NO_THROW(ProgramBundle(loaded).load(path_, true));
+
+  std::remove(binary);
+}
+
+TEST_F(program_bundle, boot_specific)
+{
+  BPFtrace bpftrace;
+  bpftrace.boot_specific_ = true;
+  EXPECT_THROW(ProgramBundle(bpftrace).save(path_, sections_),
+               std::runtime_error);
+}
+
+} // namespace program_bundle
+} // namespace test
+} // namespace bpftrace
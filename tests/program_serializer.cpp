@@ -0,0 +1,136 @@
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include <linux/bpf.h>
+
+#include "bpftrace.h"
+#include "program_serializer.h"
+
+namespace bpftrace {
+namespace test {
+namespace program_serializer {
+
+// r1 = imm64; exit
+std::vector<uint8_t> make_code(uint8_t src_reg, int32_t imm)
+{
+  struct bpf_insn insns[3] = {};
+  insns[0].code = BPF_LD | BPF_DW | BPF_IMM;
+  insns[0].dst_reg = 1;
+  insns[0].src_reg = src_reg;
+  insns[0].imm = imm;
+  insns[2].code = BPF_JMP | BPF_EXIT;
+  std::vector<uint8_t> code(sizeof(insns));
+  std::memcpy(code.data(), insns, sizeof(insns));
+  return code;
+}
+
+std::string save(BPFtrace &bpftrace, std::vector<uint8_t> &code)
+{
+  ProgramSections sections;
+  sections["s_kprobe:f_1"] = std::make_tuple(code.data(), code.size());
+  std::ostringstream out;
+  ProgramSerializer(bpftrace).save(out, sections);
+  return out.str();
+}
+
+TEST(program_serializer, round_trip)
+{
+  BPFtrace saved;
+  Field field = { .type = CreateInt64(), .offset = 8, .is_bitfield = false };
+  saved.printf_args_.emplace_back("%d\n", std::vector<Field>{ field });
+  saved.time_args_.push_back("%H:%M:%S\n");
+  saved.stackid_sites_.push_back("kstack in kprobe:f");
+  saved.non_map_print_args_.push_back(CreateString(64));
+  location loc;
+  loc.begin.line = 2;
+  loc.begin.column = 3;
+  saved.helper_error_info_[0] = { .func_id = 1, .loc = loc };
+  auto code = make_code(0, 42);
+
+  std::istringstream in(save(saved, code));
+  BPFtrace loaded;
+  ProgramSerializer serializer(loaded);
+  serializer.load(in);
+
+  ASSERT_EQ(loaded.printf_args_.size(), 1U);
+  EXPECT_EQ(std::get<0>(loaded.printf_args_[0]), "%d\n");
+  auto &fields = std::get<1>(loaded.printf_args_[0]);
+  ASSERT_EQ(fields.size(), 1U);
+  EXPECT_EQ(fields[0].type, CreateInt64());
+  EXPECT_EQ(fields[0].offset, 8);
+  EXPECT_EQ(loaded.time_args_, saved.time_args_);
+  EXPECT_EQ(loaded.stackid_sites_, saved.stackid_sites_);
+  EXPECT_EQ(loaded.non_map_print_args_, saved.non_map_print_args_);
+  ASSERT_EQ(loaded.helper_error_info_.count(0), 1U);
+  EXPECT_EQ(loaded.helper_error_info_[0].func_id, 1);
+  EXPECT_EQ(loaded.helper_error_info_[0].loc.begin.line, 2);
+  EXPECT_EQ(loaded.helper_error_info_[0].loc.begin.column, 3);
+
+  auto &sections = serializer.sections();
+  ASSERT_EQ(sections.count("s_kprobe:f_1"), 1U);
+  auto &[addr, size] = sections.at("s_kprobe:f_1");
+  ASSERT_EQ(size, code.size());
+  EXPECT_EQ(std::memcmp(addr, code.data(), size), 0);
+}
+
+TEST(program_serializer, unknown_map_fd)
+{
+  BPFtrace saved;
+  saved.join_args_.push_back(",");
+  auto code = make_code(BPF_PSEUDO_MAP_FD, 3);
+
+  std::istringstream in(save(saved, code));
+  BPFtrace loaded;
+  ProgramSerializer serializer(loaded);
+  EXPECT_THROW(serializer.load(in), std::runtime_error);
+  EXPECT_TRUE(loaded.join_args_.empty());
+  EXPECT_TRUE(serializer.sections().empty());
+}
+
+TEST(program_serializer, truncated)
+{
+  BPFtrace saved;
+  auto code = make_code(0, 0);
+  std::string data = save(saved, code);
+
+  for (size_t size : { size_t(0), size_t(8), data.size() - 1 })
+  {
+    std::istringstream in(data.substr(0, size));
+    BPFtrace loaded;
+    EXPECT_THROW(ProgramSerializer(loaded).load(in), std::runtime_error);
+  }
+}
+
+TEST(program_serializer, file_versions)
+{
+  char dir[] = "/tmp/bpftrace-test-versions-XXXXXX";
+  ASSERT_NE(mkdtemp(dir), nullptr);
+  std::string file = std::string(dir) + "/foo.h";
+  std::ofstream(file) << "struct foo { int x; };\n";
+
+  std::ostringstream out;
+  ASSERT_TRUE(write_file_versions(out, { file }));
+  EXPECT_FALSE(write_file_versions(out, { std::string(dir) + "/missing" }));
+
+  std::vector<std::string> files;
+  std::istringstream in(out.str());
+  EXPECT_TRUE(check_file_versions(in, &files));
+  EXPECT_EQ(files, std::vector<std::string>{ file });
+
+  std::ofstream(file) << "struct foo { long x; };\n";
+  std::istringstream changed(out.str());
+  EXPECT_FALSE(check_file_versions(changed));
+
+  std::filesystem::remove(file);
+  std::istringstream removed(out.str());
+  EXPECT_FALSE(check_file_versions(removed));
+  std::filesystem::remove_all(dir);
+}
+
+} // namespace program_serializer
+} // namespace test
+} // namespace bpftrace
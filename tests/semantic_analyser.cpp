@@ -176,6 +176,9 @@ TEST(semantic_analyser, builtin_functions)
   // Each function should also get its own test case for more thorough testing
   test("kprobe:f { @x = hist(123) }", 0);
   test("kprobe:f { @x = lhist(123, 0, 123, 1) }", 0);
+  test("kprobe:f { @x = llhist(123) }", 0);
+  test("kprobe:f { @x = quantiles(123) }", 0);
+  test("kprobe:f { @x = count_distinct(pid) }", 0);
   test("kprobe:f { @x = count() }", 0);
   test("kprobe:f { @x = sum(pid) }", 0);
   test("kprobe:f { @x = min(pid) }", 0);
@@ -213,6 +216,27 @@ TEST(semantic_analyser, undefined_map)
   test("kprobe:f / @mymap1 == 1234 / { 1234; @mymap1 = @mymap2; }", 10);
 }
 
+TEST(semantic_analyser, maps_assigned_by_later_probes)
+{
+  test("kprobe:f { @a = @b; } kprobe:g { @b = @c; } kprobe:h { @c = 1; }", 0);
+  test("kprobe:f { $x = @a; @a = 1; @b = $x; }", 0);
+
+  // Many probes, each depending on a map assigned further down
+  std::string prog;
+  for (int i = 0; i < 500; i++)
+    prog += "kprobe:f { @a" + std::to_string(i) + " = @b" + std::to_string(i) +
+            "; }";
+  for (int i = 0; i < 500; i++)
+    prog += "kprobe:g { @b" + std::to_string(i) + " = \"" +
+            std::to_string(i) + "\"; }";
+  BPFtrace bpftrace;
+  Driver driver(bpftrace);
+  test(driver, prog, 0);
+  auto &stmts = driver.root_->probes->at(0)->stmts;
+  auto assignment = static_cast<ast::AssignMapStatement *>(stmts->at(0).get());
+  EXPECT_TRUE(assignment->map->type.IsStringTy());
+}
+
 TEST(semantic_analyser, consistent_map_values)
 {
   test("kprobe:f { @x = 0; @x = 1; }", 0);
@@ -367,6 +391,41 @@ TEST(semantic_analyser, call_lhist)
   test("kprobe:f { lhist() ? 0 : 1; }", 1);
 }
 
+TEST(semantic_analyser, call_llhist)
+{
+  test("kprobe:f { @ = llhist(5); }", 0);
+  test("kprobe:f { @ = llhist(5, 4); }", 0);
+  test("kprobe:f { @ = llhist(5, 0); }", 0);
+  test("kprobe:f { @ = llhist(); }", 1);
+  test("kprobe:f { @ = llhist(5, 4, 1); }", 1);
+  test("kprobe:f { @ = llhist(5, pid); }", 1);
+  test("kprobe:f { @ = llhist(\"str\"); }", 10);
+  test("kprobe:f { @ = llhist(5, 7); }", 10);
+  test("kprobe:f { @ = llhist(5, 2); @ = llhist(6, 3); }", 10);
+  test("kprobe:f { @ = llhist(5); @ = llhist(6, 2); }", 0);
+  test("kprobe:f { llhist(5); }", 1);
+  test("kprobe:f { $x = llhist(5); }", 1);
+  test("kprobe:f { @[llhist(5)] = 1; }", 1);
+}
+
+TEST(semantic_analyser, call_quantiles)
+{
+  test("kprobe:f { @ = quantiles(5); }", 0);
+  test("kprobe:f { @ = quantiles(-5, 6); }", 0);
+  test("kprobe:f { @ = quantiles(5, 0); }", 0);
+  test("kprobe:f { @ = quantiles(); }", 1);
+  test("kprobe:f { @ = quantiles(5, 4, 1); }", 1);
+  test("kprobe:f { @ = quantiles(5, pid); }", 1);
+  test("kprobe:f { @ = quantiles(\"str\"); }", 10);
+  test("kprobe:f { @ = quantiles(5, 7); }", 10);
+  test("kprobe:f { @ = quantiles(5, 2); @ = quantiles(6, 3); }", 10);
+  test("kprobe:f { @ = quantiles(5); @ = quantiles(6, 4); }", 0);
+  test("kprobe:f { @ = quantiles(5); @ = quantiles(6, 2); }", 10);
+  test("kprobe:f { quantiles(5); }", 1);
+  test("kprobe:f { $x = quantiles(5); }", 1);
+  test("kprobe:f { @[quantiles(5)] = 1; }", 1);
+}
+
 TEST(semantic_analyser, call_count)
 {
   test("kprobe:f { @x = count(); }", 0);
@@ -378,6 +437,52 @@ TEST(semantic_analyser, call_count)
   test("kprobe:f { count() ? 0 : 1; }", 1);
 }
 
+TEST(semantic_analyser, call_count_distinct)
+{
+  test("kprobe:f { @x = count_distinct(pid); }", 0);
+  test("kprobe:f { @x[comm] = count_distinct(tid); }", 0);
+  test("kprobe:f { @x = count_distinct(comm); }", 0);
+  test("kprobe:f { @x = count_distinct(str(arg0)); }", 0);
+  test("kprobe:f { @x = count_distinct(); }", 1);
+  test("kprobe:f { @x = count_distinct(pid, tid); }", 1);
+  test("kprobe:f { @x = count_distinct(kstack); }", 10);
+  test("kprobe:f { count_distinct(pid); }", 1);
+  test("kprobe:f { $x = count_distinct(pid); }", 1);
+  test("kprobe:f { @[count_distinct(pid)] = 1; }", 1);
+  test("kprobe:f { @x = count_distinct(pid); print(@x); clear(@x); }", 0);
+  test("kprobe:f { @x = count_distinct(pid); zero(@x); }", 0);
+  test("kprobe:f { @x[1] = count_distinct(pid); delete(@x[1]); }", 0);
+  test("kprobe:f { @x = count_distinct(pid); $y = @x; }", 10);
+  test("kprobe:f { @x = count_distinct(pid); printf(\"%d\", @x); }", 10);
+  test("kprobe:f { @x = count_distinct(pid); if (@x) { 123 } }", 10);
+  test("kprobe:f { @x = count_distinct(pid); @y[@x] = 1; }", 10);
+  test("kprobe:f { @x = count_distinct(pid); @y[1] = 1; delete(@y[@x]); }",
+       10);
+}
+
+TEST(semantic_analyser, call_sample)
+{
+  test("kprobe:f /sample(100)/ { @x = count(); }", 0);
+  test("kprobe:f { if (sample(10)) { @x = count(); } }", 0);
+  test("kprobe:f { @x = sample(1); }", 0);
+  test("kprobe:f /sample(0)/ { }", 1);
+  test("kprobe:f /sample(-1)/ { }", 1);
+  test("kprobe:f /sample(10000000000)/ { }", 1);
+  test("kprobe:f /sample()/ { }", 1);
+  test("kprobe:f /sample(10, 20)/ { }", 1);
+  test("kprobe:f /sample(pid)/ { }", 1);
+  test("kprobe:f /sample(\"10\")/ { }", 1);
+}
+
+TEST(semantic_analyser, call_ratelimit)
+{
+  test("kprobe:f /ratelimit(1000)/ { @x = count(); }", 0);
+  test("kprobe:f /sample(10) && ratelimit(5)/ { @x = count(); }", 0);
+  test("kprobe:f /ratelimit(0)/ { }", 1);
+  test("kprobe:f /ratelimit()/ { }", 1);
+  test("kprobe:f /ratelimit(pid)/ { }", 1);
+}
+
 TEST(semantic_analyser, call_sum)
 {
   test("kprobe:f { @x = sum(123); }", 0);
@@ -765,6 +870,8 @@ TEST(semantic_analyser, call_stack)
   test("kprobe:f { ustack(3) }", 0);
   test("kprobe:f { kstack(perf, 3) }", 0);
   test("kprobe:f { ustack(perf, 3) }", 0);
+  test("kprobe:f { ustack(build_id) }", 0);
+  test("kprobe:f { ustack(build_id, 3) }", 0);
 
   // Wrong arguments
   test("kprobe:f { kstack(3, perf) }", 10);
@@ -779,6 +886,7 @@ TEST(semantic_analyser, call_stack)
   test("kprobe:f { ustack(perf, \"str\") }", 10);
   test("kprobe:f { kstack(\"str\", 3) }", 10);
   test("kprobe:f { ustack(\"str\", 3) }", 10);
+  test("kprobe:f { kstack(build_id) }", 10);
 
   // Non-literals
   test("kprobe:f { @x = perf; kstack(@x) }", 10);
@@ -791,6 +899,21 @@ TEST(semantic_analyser, call_stack)
   test("kprobe:f { @x = 3; ustack(perf, @x) }", 10);
 }
 
+TEST(semantic_analyser, call_stack_sites)
+{
+  // One site per stack, however many passes analysis takes: @b is only
+  // typed after a first pass over kprobe:f
+  auto bpftrace = get_mock_bpftrace();
+  test(*bpftrace,
+       "kprobe:f { @a = @b; @s[kstack(3)] = count(); @u = ustack(perf) }"
+       "kprobe:g { @b = 1; @k = kstack }",
+       0);
+  EXPECT_EQ(bpftrace->stackid_sites_,
+            std::vector<std::string>({ "kstack() in kprobe:f",
+                                       "ustack() in kprobe:f",
+                                       "kstack in kprobe:g" }));
+}
+
 TEST(semantic_analyser, map_reassignment)
 {
   test("kprobe:f { @x = 1; @x = 2; }", 0);
@@ -1865,6 +1988,51 @@ TEST(semantic_analyser, call_kptr_uptr)
   test("k:f { $a = uptr(arg0); }", 10);
 }
 
+// Result of creating the maps of input with lru_maps as BPFTRACE_LRU_MAPS,
+// with what was logged in log
+static int create_lru_maps(const std::string &input,
+                           const std::unordered_set<std::string> &lru_maps,
+                           bool has_lru,
+                           std::string &log)
+{
+  auto bpftrace = get_mock_bpftrace();
+  bpftrace->lru_maps_ = lru_maps;
+  Driver driver(*bpftrace);
+  EXPECT_EQ(driver.parse_str(input), 0);
+
+  MockBPFfeature feature(has_lru);
+  ast::SemanticAnalyser semantics(driver.root_.get(), *bpftrace, feature);
+  EXPECT_EQ(semantics.analyse(), 0);
+
+  ::testing::internal::CaptureStderr();
+  int result = semantics.create_maps(true);
+  log = ::testing::internal::GetCapturedStderr();
+  return result;
+}
+
+TEST(semantic_analyser, lru_maps)
+{
+  std::string log;
+  EXPECT_EQ(create_lru_maps("kprobe:f { @x[pid] = count(); @y[tid] = 1 }",
+                            { "@x", "@y" },
+                            true,
+                            log),
+            0);
+  EXPECT_EQ(log, "");
+
+  EXPECT_EQ(create_lru_maps(
+                "kprobe:f { @x[pid] = count(); }", { "@x", "@z" }, true, log),
+            0);
+  EXPECT_THAT(log,
+              HasSubstr("BPFTRACE_LRU_MAPS: map @z is not used by the "
+                        "program"));
+
+  EXPECT_EQ(create_lru_maps(
+                "kprobe:f { @x[pid] = count(); }", { "@x" }, false, log),
+            1);
+  EXPECT_THAT(log, HasSubstr("LRU maps are not supported by the kernel"));
+}
+
 #ifdef HAVE_LIBBPF_BTF_DUMP
 
 #include "btf_common.h"
@@ -1906,6 +2074,22 @@ TEST_F(semantic_analyser_btf, short_name)
 {
   test("f:func_1 { 1 }", 0);
   test("fr:func_1 { 1 }", 0);
+  test("rt:sample { 1 }", 0);
+}
+
+TEST_F(semantic_analyser_btf, rawtracepoint)
+{
+  test("rawtracepoint:sample { $x = arg0; $y = arg1; }", 0);
+  test("rawtracepoint:sample { $x = args->a; $y = args->foo1->c; }", 0);
+  // sample has 2 arguments
+  test("rawtracepoint:sample { $x = arg2; }", 1);
+  test("rawtracepoint:sample { $x = args->b; }", 1);
+  test("rawtracepoint:sample { $x = args; }", 1);
+  test("rawtracepoint:sample { $x = retval; }", 1);
+  test("rawtracepoint:sam* { $x = args->a; }", 0);
+  // aaa has no BTF arguments, which only matters once args is used
+  test("rawtracepoint:aaa { $x = arg0; }", 0);
+  test("rawtracepoint:aaa { $x = args->a; }", 1, true, false, 1);
 }
 
 #endif // HAVE_LIBBPF_BTF_DUMP
@@ -0,0 +1,238 @@
+#include "sketch.h"
+#include "types.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <random>
+
+namespace bpftrace {
+namespace test {
+namespace sketch {
+
+// Build the counts user space would read back from a quantiles() map
+static std::vector<uint64_t> make_sketch(const std::vector<int64_t> &values,
+                                         int bits)
+{
+  std::vector<uint64_t> counts(quantiles_buckets(bits));
+  for (auto value : values)
+    counts.at(quantiles_position(quantiles_key(value, true, bits), bits))++;
+  return counts;
+}
+
+static void check_quantiles(std::vector<int64_t> values, int bits)
+{
+  auto counts = make_sketch(values, bits);
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ(quantiles_count(counts), values.size());
+
+  for (double q : { 0.0, 0.01, 0.25, 0.5, 0.9, 0.99, 0.999, 1.0 })
+  {
+    int64_t exact = values.at(q * (values.size() - 1));
+    int64_t estimate = quantiles_estimate(counts, bits, q);
+    double error = std::abs(static_cast<double>(estimate) - exact);
+    EXPECT_LE(error, quantiles_accuracy(bits) * std::abs(exact) + 1)
+        << "q=" << q << " bits=" << bits << " exact=" << exact
+        << " estimate=" << estimate;
+  }
+}
+
+TEST(sketch, loglinear_index_bounds)
+{
+  for (int bits = 0; bits <= 6; bits++)
+  {
+    EXPECT_EQ(loglinear_index(-1, bits), 0);
+    EXPECT_EQ(loglinear_index(std::numeric_limits<int64_t>::min(), bits), 0);
+    EXPECT_LT(loglinear_index(std::numeric_limits<int64_t>::max(), bits),
+              loglinear_buckets(bits));
+
+    std::vector<int64_t> values = { 0, 1, 2, 3, 7, 8, 100, 1000, 65535 };
+    for (int shift = 20; shift < 63; shift += 7)
+    {
+      values.push_back((1LL << shift) - 1);
+      values.push_back(1LL << shift);
+      values.push_back((1LL << shift) + 12345);
+    }
+    values.push_back(std::numeric_limits<int64_t>::max());
+
+    for (auto value : values)
+    {
+      uint64_t low, high;
+      loglinear_bounds(bits, loglinear_index(value, bits), low, high);
+      EXPECT_LE(low, static_cast<uint64_t>(value));
+      EXPECT_GE(high, static_cast<uint64_t>(value));
+    }
+  }
+}
+
+TEST(sketch, loglinear_index_monotonic)
+{
+  for (int bits = 0; bits <= 6; bits++)
+  {
+    uint64_t prev = 0;
+    for (int64_t value = 0; value < 100000; value++)
+    {
+      uint64_t index = loglinear_index(value, bits);
+      EXPECT_GE(index, prev);
+      EXPECT_LE(index, prev + 1);
+      prev = index;
+    }
+  }
+}
+
+TEST(sketch, quantiles_exact_small_values)
+{
+  std::vector<int64_t> values;
+  for (int64_t i = -15; i <= 15; i++)
+    values.push_back(i);
+  auto counts = make_sketch(values, 3);
+
+  EXPECT_EQ(quantiles_estimate(counts, 3, 0.0), -15);
+  EXPECT_EQ(quantiles_estimate(counts, 3, 0.5), 0);
+  EXPECT_EQ(quantiles_estimate(counts, 3, 1.0), 15);
+}
+
+TEST(sketch, quantiles_extreme_values)
+{
+  const int64_t max = std::numeric_limits<int64_t>::max();
+  const int64_t min = std::numeric_limits<int64_t>::min();
+  for (int bits = 0; bits <= 6; bits++)
+  {
+    // Unsigned values above INT64_MAX share its top bucket
+    int64_t top = quantiles_key(max, true, bits);
+    EXPECT_EQ(quantiles_key(static_cast<uint64_t>(-1), false, bits), top);
+    EXPECT_EQ(quantiles_key(1ULL << 63, false, bits), top);
+    EXPECT_EQ(quantiles_key(max, false, bits), top);
+    // and INT64_MIN the bottom one
+    EXPECT_EQ(quantiles_key(min, true, bits), -top);
+    EXPECT_NE(quantiles_key(0, true, bits), 0);
+
+    std::vector<uint64_t> counts(quantiles_buckets(bits));
+    counts.at(quantiles_position(
+        quantiles_key(static_cast<uint64_t>(-1), false, bits), bits))++;
+    int64_t estimate = quantiles_estimate(counts, bits, 0.5);
+    EXPECT_NEAR(static_cast<double>(estimate) / max,
+                1.0,
+                quantiles_accuracy(bits) + 1e-9);
+
+    counts.assign(quantiles_buckets(bits), 0);
+    counts.at(quantiles_position(quantiles_key(min, true, bits), bits))++;
+    estimate = quantiles_estimate(counts, bits, 0.5);
+    EXPECT_NEAR(static_cast<double>(estimate) / max,
+                -1.0,
+                quantiles_accuracy(bits) + 1e-9);
+  }
+}
+
+TEST(sketch, quantiles_empty)
+{
+  std::vector<uint64_t> counts(quantiles_buckets(4));
+  EXPECT_EQ(quantiles_count(counts), 0);
+  EXPECT_EQ(quantiles_estimate(counts, 4, 0.5), 0);
+}
+
+TEST(sketch, quantiles_uniform)
+{
+  std::mt19937_64 gen(1);
+  std::uniform_int_distribution<int64_t> dist(0, 1000000);
+  std::vector<int64_t> values;
+  for (int i = 0; i < 20000; i++)
+    values.push_back(dist(gen));
+
+  for (int bits = 0; bits <= 6; bits++)
+    check_quantiles(values, bits);
+}
+
+TEST(sketch, quantiles_exponential)
+{
+  std::mt19937_64 gen(2);
+  std::exponential_distribution<double> dist(1.0 / 50000);
+  std::vector<int64_t> values;
+  for (int i = 0; i < 20000; i++)
+    values.push_back(dist(gen));
+
+  for (int bits = 0; bits <= 6; bits++)
+    check_quantiles(values, bits);
+}
+
+TEST(sketch, quantiles_lognormal_signed)
+{
+  std::mt19937_64 gen(3);
+  std::lognormal_distribution<double> dist(10.0, 3.0);
+  std::bernoulli_distribution negative(0.3);
+  std::vector<int64_t> values;
+  for (int i = 0; i < 20000; i++)
+  {
+    int64_t value = std::min(dist(gen), 1e15);
+    values.push_back(negative(gen) ? -value : value);
+  }
+
+  for (int bits = 0; bits <= 6; bits++)
+    check_quantiles(values, bits);
+}
+
+static uint64_t count_distinct(uint64_t n, uint64_t repeat)
+{
+  std::vector<uint8_t> registers(1 << HLL_PRECISION);
+  for (uint64_t r = 0; r < repeat; r++)
+  {
+    for (uint64_t i = 0; i < n; i++)
+      hll_add(registers, hll_hash(i * 7919));
+  }
+  return hll_estimate(registers);
+}
+
+TEST(sketch, hll_empty)
+{
+  std::vector<uint8_t> registers(1 << HLL_PRECISION);
+  EXPECT_EQ(hll_estimate(registers), 0);
+}
+
+TEST(sketch, hll_accuracy)
+{
+  // three times the standard error of 1.04/sqrt(registers)
+  double error = 3 * 1.04 / std::sqrt(1 << HLL_PRECISION);
+  for (uint64_t n : { 1, 10, 100, 1000, 10000, 100000, 1000000 })
+  {
+    double estimate = count_distinct(n, 1);
+    EXPECT_LE(std::abs(estimate - n), error * n) << "n=" << n;
+  }
+}
+
+TEST(sketch, hll_duplicates)
+{
+  EXPECT_EQ(count_distinct(1, 1), count_distinct(1, 10));
+  EXPECT_EQ(count_distinct(5000, 1), count_distinct(5000, 3));
+}
+
+TEST(sketch, hll_merge)
+{
+  // per-CPU sketches merged in user space match a single sketch
+  const int ncpus = 4;
+  std::vector<uint8_t> single(1 << HLL_PRECISION);
+  std::vector<uint8_t> percpu(ncpus << HLL_PRECISION);
+  for (uint64_t i = 0; i < 50000; i++)
+  {
+    uint64_t hash = hll_hash(i);
+    hll_add(single, hash);
+
+    std::vector<uint8_t> cpu(percpu.begin() + ((i % ncpus) << HLL_PRECISION),
+                             percpu.begin() +
+                                 ((i % ncpus + 1) << HLL_PRECISION));
+    hll_add(cpu, hash);
+    std::copy(cpu.begin(),
+              cpu.end(),
+              percpu.begin() + ((i % ncpus) << HLL_PRECISION));
+  }
+
+  std::vector<uint8_t> merged(1 << HLL_PRECISION);
+  for (int cpu = 0; cpu < ncpus; cpu++)
+    hll_merge(merged, percpu.data() + (cpu << HLL_PRECISION));
+  EXPECT_EQ(merged, single);
+}
+
+} // namespace sketch
+} // namespace test
+} // namespace bpftrace
@@ -0,0 +1,81 @@
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <unistd.h>
+
+#include "traceable_funcs.h"
+
+namespace bpftrace {
+namespace test {
+namespace traceable_funcs {
+
+class traceable_funcs : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    char path[] = "/tmp/available_filter_functionsXXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    std::string funcs = "vfs_write\n"
+                        "func_in_mod [kernel_mod]\n"
+                        "vfs_read\n"
+                        "func\n"
+                        "func_in_mod\n";
+    ASSERT_EQ(write(fd, funcs.data(), funcs.size()), (ssize_t)funcs.size());
+    close(fd);
+    path_ = path;
+    setenv("BPFTRACE_AVAILABLE_FUNCTIONS_TEST", path, true);
+  }
+
+  void TearDown() override
+  {
+    unsetenv("BPFTRACE_AVAILABLE_FUNCTIONS_TEST");
+    std::remove(path_.c_str());
+  }
+
+  std::string path_;
+};
+
+TEST_F(traceable_funcs, contains)
+{
+  TraceableFuncs funcs;
+  EXPECT_FALSE(funcs.empty());
+  EXPECT_TRUE(funcs.contains("vfs_read"));
+  EXPECT_TRUE(funcs.contains("vfs_write"));
+  EXPECT_TRUE(funcs.contains("func"));
+  EXPECT_TRUE(funcs.contains("func_in_mod"));
+  EXPECT_FALSE(funcs.contains("fun"));
+  EXPECT_FALSE(funcs.contains("vfs"));
+  EXPECT_FALSE(funcs.contains("zzz"));
+  EXPECT_FALSE(funcs.contains("func_in_mod [kernel_mod]"));
+}
+
+TEST_F(traceable_funcs, lines)
+{
+  TraceableFuncs funcs;
+  auto lines = funcs.lines();
+  std::set<std::string> read;
+  std::string line;
+  while (std::getline(*lines, line))
+    read.insert(line);
+  std::set<std::string> expected = {
+    "vfs_write", "func_in_mod [kernel_mod]", "vfs_read", "func", "func_in_mod"
+  };
+  EXPECT_EQ(read, expected);
+}
+
+TEST_F(traceable_funcs, missing)
+{
+  setenv("BPFTRACE_AVAILABLE_FUNCTIONS_TEST", "/nonexistent", true);
+  TraceableFuncs funcs;
+  EXPECT_TRUE(funcs.empty());
+  EXPECT_FALSE(funcs.contains("vfs_read"));
+}
+
+} // namespace traceable_funcs
+} // namespace test
+} // namespace bpftrace
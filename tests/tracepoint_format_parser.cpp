@@ -1,3 +1,7 @@
+#include <filesystem>
+#include <fstream>
+
+#include "driver.h"
 #include "tracepoint_format_parser.h"
 #include "mocks.h"
 #include "gtest/gtest.h"
@@ -251,6 +255,182 @@ TEST(tracepoint_format_parser, tracepoint_struct_btf)
   EXPECT_THAT(bpftrace.btf_set_, Contains("size_t"));
 }
 
+// A tracefs events directory, read by TracepointFormatParser::parse while
+// the object lives
+class EventsDir
+{
+public:
+  EventsDir()
+  {
+    char dir[] = "/tmp/bpftrace-test-events-XXXXXX";
+    if (mkdtemp(dir))
+      dir_ = dir;
+    setenv("BPFTRACE_TRACEPOINT_EVENTS_TEST", dir_.c_str(), true);
+  }
+
+  ~EventsDir()
+  {
+    unsetenv("BPFTRACE_TRACEPOINT_EVENTS_TEST");
+    if (!dir_.empty())
+      std::filesystem::remove_all(dir_);
+  }
+
+  void add(const std::string &category,
+           const std::string &event,
+           const std::string &fields)
+  {
+    std::string path = dir_ + "/" + category + "/" + event;
+    std::filesystem::create_directories(path);
+    std::ofstream(path + "/format")
+        << "name: " << event << "\n"
+        << "ID: 1\n"
+        << "format:\n"
+        << "\tfield:unsigned short common_type;\toffset:0;\tsize:2;\tsigned:0;\n"
+        << "\tfield:int common_pid;\toffset:4;\tsize:4;\tsigned:1;\n"
+        << "\n"
+        << fields << "\n"
+        << "print fmt: \"\"\n";
+  }
+
+private:
+  std::string dir_;
+};
+
+// Run the parser on a program, as main does after parsing it
+static bool parse(BPFtrace &bpftrace,
+                  const std::string &input,
+                  std::string &c_definitions)
+{
+  Driver driver(bpftrace);
+  EXPECT_EQ(driver.parse_str(input), 0);
+  TracepointFormatParser::clear_struct_list();
+  bool ok = TracepointFormatParser::parse(driver.root_.get(), bpftrace);
+  c_definitions = driver.root_->c_definitions;
+  return ok;
+}
+
+TEST(tracepoint_format_parser, parse_format_files)
+{
+  EventsDir events;
+  events.add("bpftrace_test",
+             "event_a",
+             "\tfield:int a;\toffset:8;\tsize:4;\tsigned:1;");
+  events.add("bpftrace_test",
+             "event_b",
+             "\tfield:long b;\toffset:8;\tsize:8;\tsigned:1;");
+
+  MockBPFtrace bpftrace;
+  std::string defs;
+  ASSERT_TRUE(parse(
+      bpftrace, "tracepoint:bpftrace_test:event_a { @ = args->a }", defs));
+  EXPECT_NE(defs.find("struct _tracepoint_bpftrace_test_event_a\n"),
+            std::string::npos);
+  EXPECT_NE(defs.find("  int a;\n"), std::string::npos);
+  EXPECT_EQ(defs.find("event_b"), std::string::npos);
+
+  // Wildcards define the struct of each event they match
+  ASSERT_TRUE(parse(
+      bpftrace, "tracepoint:bpftrace_test:event_* { @ = args->a }", defs));
+  EXPECT_NE(defs.find("struct _tracepoint_bpftrace_test_event_a\n"),
+            std::string::npos);
+  EXPECT_NE(defs.find("struct _tracepoint_bpftrace_test_event_b\n"),
+            std::string::npos);
+
+  // No struct is needed without args
+  ASSERT_TRUE(
+      parse(bpftrace, "tracepoint:bpftrace_test:event_a { @ = 1 }", defs));
+  EXPECT_EQ(defs.find("_tracepoint_bpftrace_test"), std::string::npos);
+
+  EXPECT_FALSE(parse(
+      bpftrace, "tracepoint:bpftrace_test:event_c { @ = args->a }", defs));
+  EXPECT_FALSE(parse(
+      bpftrace, "tracepoint:bpftrace_test:x* { @ = args->a }", defs));
+}
+
+#ifdef HAVE_LIBBPF_BTF_DUMP
+
+#include "btf_common.h"
+
+class tracepoint_format_parser_btf : public test_btf
+{
+};
+
+TEST_F(tracepoint_format_parser_btf, args_from_btf)
+{
+  BPFtrace bpftrace;
+  std::string name = "struct _tracepoint_test_sample";
+  ASSERT_TRUE(bpftrace.btf_.resolve_tracepoint(
+      "sample", name, bpftrace.structs_, bpftrace.enums_));
+  ASSERT_EQ(bpftrace.structs_.count(name), 1U);
+
+  // Named as in the format file
+  auto &args = bpftrace.structs_[name];
+  EXPECT_EQ(args.size, 32);
+  EXPECT_EQ(args.fields.size(), 7U);
+  EXPECT_EQ(args.fields.count("ent"), 0U);
+  EXPECT_EQ(args.fields.count("__data"), 0U);
+
+  EXPECT_TRUE(args.fields["common_type"].type.IsIntTy());
+  EXPECT_FALSE(args.fields["common_type"].type.IsSigned());
+  EXPECT_EQ(args.fields["common_type"].type.size, 2U);
+  EXPECT_EQ(args.fields["common_type"].offset, 0);
+  EXPECT_EQ(args.fields["common_preempt_count"].offset, 3);
+  EXPECT_TRUE(args.fields["common_pid"].type.IsSigned());
+  EXPECT_EQ(args.fields["common_pid"].offset, 4);
+
+  EXPECT_TRUE(args.fields["comm"].type.IsStringTy());
+  EXPECT_EQ(args.fields["comm"].type.size, 16U);
+  EXPECT_EQ(args.fields["comm"].offset, 8);
+  EXPECT_EQ(args.fields["pid"].offset, 24);
+
+  // __data_loc fields are ints, as the format parser declares them
+  EXPECT_TRUE(args.fields["data_loc_name"].type.IsIntTy());
+  EXPECT_TRUE(args.fields["data_loc_name"].type.IsSigned());
+  EXPECT_EQ(args.fields["data_loc_name"].type.size, 4U);
+  EXPECT_EQ(args.fields["data_loc_name"].offset, 28);
+
+  // Events without a struct of their own use their format file
+  EXPECT_FALSE(bpftrace.btf_.resolve_tracepoint(
+      "sys_enter_read", name, bpftrace.structs_, bpftrace.enums_));
+  // So do the ones whose struct BTF does not show to be theirs
+  EXPECT_FALSE(bpftrace.btf_.resolve_tracepoint(
+      "orphan", name, bpftrace.structs_, bpftrace.enums_));
+}
+
+TEST_F(tracepoint_format_parser_btf, parse_btf_and_format_files)
+{
+  // The format files declare other fields than BTF, to tell which was used
+  EventsDir events;
+  events.add("bpftrace_test",
+             "sample",
+             "\tfield:int format_file;\toffset:8;\tsize:4;\tsigned:1;");
+  events.add("bpftrace_test",
+             "orphan",
+             "\tfield:int format_file;\toffset:8;\tsize:4;\tsigned:1;");
+
+  BPFtrace bpftrace;
+  std::string defs;
+  ASSERT_TRUE(parse(bpftrace,
+                    "tracepoint:bpftrace_test:sample { @a = args->pid }"
+                    "tracepoint:bpftrace_test:orphan { @b = args->x }",
+                    defs));
+
+  // sample is its own class: its struct comes from BTF, with no C
+  std::string sample = "struct _tracepoint_bpftrace_test_sample";
+  ASSERT_EQ(bpftrace.structs_.count(sample), 1U);
+  EXPECT_EQ(bpftrace.structs_[sample].fields.count("pid"), 1U);
+  EXPECT_EQ(bpftrace.structs_[sample].fields.count("format_file"), 0U);
+  EXPECT_EQ(defs.find(sample), std::string::npos);
+
+  // orphan has a trace_event_raw_orphan struct, but no class of that name
+  std::string orphan = "struct _tracepoint_bpftrace_test_orphan";
+  EXPECT_EQ(bpftrace.structs_.count(orphan), 0U);
+  EXPECT_NE(defs.find(orphan + "\n"), std::string::npos);
+  EXPECT_NE(defs.find("  int format_file;\n"), std::string::npos);
+}
+
+#endif // HAVE_LIBBPF_BTF_DUMP
+
 } // namespace tracepoint_format_parser
 } // namespace test
 } // namespace bpftrace